@@ -0,0 +1,111 @@
+// Setup that is shared by the benchmarks. Each benchmark uses only some of it,
+// and includes `dirs.rs` itself, so that the directories are defined at the
+// root of its crate.
+#![allow(dead_code)]
+
+use anyhow::Context;
+use lazy_static::lazy_static;
+use std::collections::BTreeMap;
+use std::path::{Path, PathBuf};
+use std::time::Instant;
+use std::{env, fs, usize};
+use tree_sitter::Language;
+use tree_sitter_loader::Loader;
+
+use super::{GRAMMARS_DIR, SCRATCH_DIR};
+
+lazy_static! {
+    pub static ref LANGUAGE_FILTER: Option<String> =
+        env::var("TREE_SITTER_BENCHMARK_LANGUAGE_FILTER").ok();
+    pub static ref EXAMPLE_FILTER: Option<String> =
+        env::var("TREE_SITTER_BENCHMARK_EXAMPLE_FILTER").ok();
+    pub static ref REPETITION_COUNT: usize = env::var("TREE_SITTER_BENCHMARK_REPETITION_COUNT")
+        .map(|s| usize::from_str_radix(&s, 10).unwrap())
+        .unwrap_or(5);
+    pub static ref TEST_LOADER: Loader = Loader::with_parser_lib_path(SCRATCH_DIR.clone());
+    pub static ref EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR: BTreeMap<PathBuf, (Vec<PathBuf>, Vec<PathBuf>)> = {
+        fn files_in_dir(dir: &Path) -> Vec<PathBuf> {
+            let mut result = fs::read_dir(dir)
+                .map(|entries| {
+                    entries
+                        .map(|entry| entry.unwrap().path())
+                        .filter(|path| path.is_file())
+                        .collect::<Vec<_>>()
+                })
+                .unwrap_or(Vec::new());
+            result.sort();
+            result
+        }
+
+        fn process_dir(result: &mut BTreeMap<PathBuf, (Vec<PathBuf>, Vec<PathBuf>)>, dir: &Path) {
+            if dir.join("grammar.js").exists() {
+                let relative_path = dir.strip_prefix(GRAMMARS_DIR.as_path()).unwrap();
+                result.insert(
+                    relative_path.to_owned(),
+                    (
+                        files_in_dir(&dir.join("examples")),
+                        files_in_dir(&dir.join("queries")),
+                    ),
+                );
+            } else {
+                for entry in fs::read_dir(&dir).unwrap() {
+                    let entry = entry.unwrap().path();
+                    if entry.is_dir() {
+                        process_dir(result, &entry);
+                    }
+                }
+            }
+        }
+
+        let mut result = BTreeMap::new();
+        process_dir(&mut result, &GRAMMARS_DIR);
+        result
+    };
+}
+
+pub fn language_name(path: &Path) -> &str {
+    path.file_name().unwrap().to_str().unwrap()
+}
+
+pub fn is_language_filtered_out(path: &Path) -> bool {
+    LANGUAGE_FILTER
+        .as_ref()
+        .map_or(false, |filter| language_name(path) != filter.as_str())
+}
+
+pub fn is_example_filtered_out(path: &Path) -> bool {
+    EXAMPLE_FILTER.as_ref().map_or(false, |filter| {
+        !path.to_str().unwrap().contains(filter.as_str())
+    })
+}
+
+// Run the action on the contents of the file, and print and return the number
+// of bytes that it processed per millisecond.
+pub fn parse(path: &Path, max_path_length: usize, mut action: impl FnMut(&[u8])) -> usize {
+    eprint!(
+        "    {:width$}\t",
+        path.file_name().unwrap().to_str().unwrap(),
+        width = max_path_length
+    );
+
+    let source_code = fs::read(path)
+        .with_context(|| format!("Failed to read {:?}", path))
+        .unwrap();
+    let time = Instant::now();
+    for _ in 0..*REPETITION_COUNT {
+        action(&source_code);
+    }
+    let duration = time.elapsed() / (*REPETITION_COUNT as u32);
+    let duration_ms = duration.as_millis();
+    let speed = source_code.len() as u128 / (duration_ms + 1);
+    eprintln!("time {} ms\tspeed {} bytes/ms", duration_ms as usize, speed);
+    speed as usize
+}
+
+pub fn get_language(path: &Path) -> Language {
+    let src_dir = GRAMMARS_DIR.join(path).join("src");
+    TEST_LOADER
+        .load_language_at_path(&src_dir, &src_dir)
+        .with_context(|| format!("Failed to load language at path {:?}", src_dir))
+        .unwrap()
+}
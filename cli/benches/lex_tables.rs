@@ -0,0 +1,169 @@
+mod common;
+
+use anyhow::Context;
+use common::{
+    is_language_filtered_out, language_name, parse, EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR,
+    REPETITION_COUNT,
+};
+use lazy_static::lazy_static;
+use std::path::{Path, PathBuf};
+use std::process::Command;
+use std::{env, fs};
+use tree_sitter::{Language, Parser};
+use tree_sitter_cli::generate;
+use tree_sitter_loader::Loader;
+
+include!("../src/tests/helpers/dirs.rs");
+
+// Compares parsers whose lexers are generated as `switch` statements with
+// parsers whose lexers are generated as tables. Both variants are generated
+// from each fixture grammar's `grammar.json`, so that they only differ in
+// the representation of their lexers.
+
+lazy_static! {
+    static ref LEX_FUNCTIONS_DIR: PathBuf = SCRATCH_DIR.join("lex-functions-benchmark");
+    static ref LEX_TABLES_DIR: PathBuf = SCRATCH_DIR.join("lex-tables-benchmark");
+    static ref LEX_FUNCTIONS_LOADER: Loader =
+        Loader::with_parser_lib_path(LEX_FUNCTIONS_DIR.clone());
+    static ref LEX_TABLES_LOADER: Loader = Loader::with_parser_lib_path(LEX_TABLES_DIR.clone());
+}
+
+struct Variant {
+    object_size: u64,
+    speeds: Vec<usize>,
+}
+
+fn main() {
+    eprintln!("Benchmarking with {} repetitions", *REPETITION_COUNT);
+
+    let mut total_sizes = (0, 0);
+    let mut all_speeds = (Vec::new(), Vec::new());
+    for (language_path, (example_paths, _)) in EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR.iter() {
+        let grammar_dir = GRAMMARS_DIR.join(language_path);
+        if is_language_filtered_out(language_path)
+            || example_paths.is_empty()
+            || !grammar_dir.join("src").join("grammar.json").exists()
+        {
+            continue;
+        }
+
+        eprintln!("\nLanguage: {}", language_name(language_path));
+        let functions = run_variant(&grammar_dir, &example_paths, false);
+        let tables = run_variant(&grammar_dir, &example_paths, true);
+        eprintln!(
+            "  Object size:   {} bytes (functions)\t{} bytes (tables)",
+            functions.object_size, tables.object_size
+        );
+        eprintln!(
+            "  Average Speed: {} bytes/ms (functions)\t{} bytes/ms (tables)",
+            average(&functions.speeds),
+            average(&tables.speeds)
+        );
+
+        total_sizes.0 += functions.object_size;
+        total_sizes.1 += tables.object_size;
+        all_speeds.0.extend(functions.speeds);
+        all_speeds.1.extend(tables.speeds);
+    }
+
+    eprintln!("\n  Overall");
+    eprintln!(
+        "  Object size:   {} bytes (functions)\t{} bytes (tables)",
+        total_sizes.0, total_sizes.1
+    );
+    eprintln!(
+        "  Average Speed: {} bytes/ms (functions)\t{} bytes/ms (tables)",
+        average(&all_speeds.0),
+        average(&all_speeds.1)
+    );
+    eprintln!("");
+}
+
+fn run_variant(grammar_dir: &Path, example_paths: &[PathBuf], use_lex_tables: bool) -> Variant {
+    eprintln!(
+        "  Parsing with lex {}:",
+        if use_lex_tables {
+            "tables"
+        } else {
+            "functions"
+        }
+    );
+    let (language, object_size) = get_language(grammar_dir, use_lex_tables);
+    let mut parser = Parser::new();
+    parser.set_language(language).unwrap();
+
+    let max_path_length = example_paths
+        .iter()
+        .map(|p| p.file_name().unwrap().to_str().unwrap().len())
+        .max()
+        .unwrap_or(0);
+    let speeds = example_paths
+        .iter()
+        .map(|example_path| {
+            parse(example_path, max_path_length, |code| {
+                parser.parse(code, None).expect("Failed to parse");
+            })
+        })
+        .collect();
+
+    Variant {
+        object_size,
+        speeds,
+    }
+}
+
+fn average(speeds: &Vec<usize>) -> usize {
+    if speeds.is_empty() {
+        0
+    } else {
+        speeds.iter().sum::<usize>() / speeds.len()
+    }
+}
+
+fn get_language(grammar_dir: &Path, use_lex_tables: bool) -> (Language, u64) {
+    let (scratch_dir, loader) = if use_lex_tables {
+        (LEX_TABLES_DIR.as_path(), &*LEX_TABLES_LOADER)
+    } else {
+        (LEX_FUNCTIONS_DIR.as_path(), &*LEX_FUNCTIONS_LOADER)
+    };
+    let src_dir = grammar_dir.join("src");
+    let grammar_json = fs::read_to_string(src_dir.join("grammar.json")).unwrap();
+    let (name, c_code) =
+        generate::generate_parser_for_grammar_with_lex_tables(&grammar_json, use_lex_tables)
+            .with_context(|| format!("Failed to generate parser for {:?}", grammar_dir))
+            .unwrap();
+
+    fs::create_dir_all(scratch_dir).unwrap();
+    let parser_path = scratch_dir.join(&format!("{}-parser.c", name));
+    if fs::read_to_string(&parser_path).ok().as_ref() != Some(&c_code) {
+        fs::write(&parser_path, &c_code).unwrap();
+    }
+    let scanner_path = ["scanner.c", "scanner.cc"]
+        .iter()
+        .map(|file_name| src_dir.join(file_name))
+        .find(|path| path.exists());
+
+    let language = loader
+        .load_language_from_sources(&name, &HEADER_DIR, &parser_path, &scanner_path)
+        .with_context(|| format!("Failed to load language {:?}", name))
+        .unwrap();
+    (language, compile_object(&parser_path))
+}
+
+// The loaded libraries also contain debug info and the external scanners, so
+// the generated code is measured by compiling it into an object file.
+fn compile_object(parser_path: &Path) -> u64 {
+    let object_path = parser_path.with_extension("o");
+    let compiler = env::var("CC").unwrap_or("cc".to_string());
+    let status = Command::new(&compiler)
+        .args(&["-c", "-O2", "-I"])
+        .arg(HEADER_DIR.as_path())
+        .arg("-o")
+        .arg(&object_path)
+        .arg(parser_path)
+        .status()
+        .with_context(|| format!("Failed to run {:?}", compiler))
+        .unwrap();
+    assert!(status.success(), "Failed to compile {:?}", parser_path);
+    fs::metadata(&object_path).unwrap().len()
+}
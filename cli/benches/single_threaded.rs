@@ -0,0 +1,95 @@
+mod common;
+
+use anyhow::Context;
+use common::{
+    get_language, is_language_filtered_out, language_name, EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR,
+    REPETITION_COUNT,
+};
+use lazy_static::lazy_static;
+use std::fs;
+use std::path::PathBuf;
+use std::time::{Duration, Instant};
+use tree_sitter::{Language, Parser};
+
+include!("../src/tests/helpers/dirs.rs");
+
+// Compares parsers in the default mode, where the reference counts of syntax
+// nodes are updated atomically, with parsers in single-threaded mode, where
+// they are not. Building, balancing, and dropping each tree are timed
+// separately, because they are all dominated by reference counting.
+
+#[derive(Default)]
+struct Timings {
+    parse: Duration,
+    balance: Duration,
+    drop: Duration,
+}
+
+impl Timings {
+    fn add(&mut self, other: &Timings) {
+        self.parse += other.parse;
+        self.balance += other.balance;
+        self.drop += other.drop;
+    }
+
+    fn print(&self, label: &str) {
+        eprintln!(
+            "  {:16}parse {} ms\tbalance {} ms\tdrop {} ms",
+            label,
+            self.parse.as_millis(),
+            self.balance.as_millis(),
+            self.drop.as_millis()
+        );
+    }
+}
+
+fn main() {
+    eprintln!("Benchmarking with {} repetitions", *REPETITION_COUNT);
+
+    let mut totals = (Timings::default(), Timings::default());
+    for (language_path, (example_paths, _)) in EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR.iter() {
+        if is_language_filtered_out(language_path) || example_paths.is_empty() {
+            continue;
+        }
+
+        eprintln!("\nLanguage: {}", language_name(language_path));
+        let language = get_language(language_path);
+        let atomic = run_variant(language, &example_paths, false);
+        let single_threaded = run_variant(language, &example_paths, true);
+        atomic.print("atomic:");
+        single_threaded.print("single-threaded:");
+        totals.0.add(&atomic);
+        totals.1.add(&single_threaded);
+    }
+
+    eprintln!("\n  Overall");
+    totals.0.print("atomic:");
+    totals.1.print("single-threaded:");
+    eprintln!("");
+}
+
+fn run_variant(language: Language, example_paths: &[PathBuf], single_threaded: bool) -> Timings {
+    let mut parser = Parser::new();
+    parser.set_language(language).unwrap();
+
+    // The trees are dropped on this thread, and are never sent to another.
+    unsafe { parser.set_single_threaded(single_threaded) };
+
+    let mut result = Timings::default();
+    for example_path in example_paths {
+        let source_code = fs::read(example_path)
+            .with_context(|| format!("Failed to read {:?}", example_path))
+            .unwrap();
+        for _ in 0..*REPETITION_COUNT {
+            let tree = parser.parse(&source_code, None).expect("Failed to parse");
+            let stats = parser.stats();
+            result.parse += stats.parse_duration;
+            result.balance += stats.balance_duration;
+
+            let time = Instant::now();
+            drop(tree);
+            result.drop += time.elapsed();
+        }
+    }
+    result
+}
@@ -0,0 +1,397 @@
+mod common;
+
+use anyhow::Context;
+use common::{
+    get_language, is_example_filtered_out, is_language_filtered_out, language_name,
+    EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR, REPETITION_COUNT,
+};
+use lazy_static::lazy_static;
+use serde::{Deserialize, Serialize};
+use std::collections::BTreeMap;
+use std::os::raw::c_void;
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+use std::{env, fs, process, usize};
+use tree_sitter::{Language, Parser, Query, QueryCursor, Tree};
+use tree_sitter_cli::parse::perform_edit;
+
+include!("../src/tests/helpers/dirs.rs");
+
+#[path = "../src/tests/helpers/random.rs"]
+mod random;
+
+#[allow(dead_code)]
+#[path = "../src/tests/helpers/edits.rs"]
+mod edits;
+
+// The edit helpers refer to the CLI's `Edit` type through this module.
+mod parse {
+    pub use tree_sitter_cli::parse::Edit;
+}
+
+use edits::{get_random_edit, invert_edit};
+use random::Rand;
+
+// Measures each operation of the runtime separately, for the example files of
+// each fixture grammar. For every scenario, the distribution of the time taken
+// by each operation is reported, along with the number of allocations that it
+// made. The results can be written to a JSON file, and compared with the
+// results of an earlier run.
+
+lazy_static! {
+    static ref SEED: usize = env::var("TREE_SITTER_BENCHMARK_SEED")
+        .map(|s| usize::from_str_radix(&s, 10).unwrap())
+        .unwrap_or(0);
+    static ref OUTPUT_PATH: Option<PathBuf> = env::var("TREE_SITTER_BENCHMARK_OUTPUT")
+        .ok()
+        .map(PathBuf::from);
+    static ref BASELINE_PATH: Option<PathBuf> = env::var("TREE_SITTER_BENCHMARK_BASELINE")
+        .ok()
+        .map(PathBuf::from);
+    static ref REGRESSION_THRESHOLD: f64 = env::var("TREE_SITTER_BENCHMARK_THRESHOLD")
+        .map(|s| s.parse().unwrap())
+        .unwrap_or(10.0);
+}
+
+static ALLOCATION_COUNT: AtomicU64 = AtomicU64::new(0);
+
+extern "C" {
+    fn malloc(size: usize) -> *mut c_void;
+    fn calloc(count: usize, size: usize) -> *mut c_void;
+    fn realloc(ptr: *mut c_void, size: usize) -> *mut c_void;
+    fn free(ptr: *mut c_void);
+}
+
+unsafe extern "C" fn ts_count_malloc(size: usize) -> *mut c_void {
+    ALLOCATION_COUNT.fetch_add(1, Ordering::Relaxed);
+    malloc(size)
+}
+
+unsafe extern "C" fn ts_count_calloc(count: usize, size: usize) -> *mut c_void {
+    ALLOCATION_COUNT.fetch_add(1, Ordering::Relaxed);
+    calloc(count, size)
+}
+
+unsafe extern "C" fn ts_count_realloc(ptr: *mut c_void, size: usize) -> *mut c_void {
+    ALLOCATION_COUNT.fetch_add(1, Ordering::Relaxed);
+    realloc(ptr, size)
+}
+
+unsafe extern "C" fn ts_count_free(ptr: *mut c_void) {
+    free(ptr)
+}
+
+#[derive(Default)]
+struct Samples {
+    durations: Vec<Duration>,
+    allocation_count: u64,
+    byte_count: usize,
+}
+
+#[derive(Default)]
+struct Scenarios {
+    parse: Samples,
+    reparse: Samples,
+    changed_ranges: Samples,
+    query: Samples,
+    tree_cursor: Samples,
+    node_access: Samples,
+    delete: Samples,
+}
+
+#[derive(Clone, Copy, Serialize, Deserialize)]
+struct Summary {
+    samples: usize,
+    p50_ns: u64,
+    p90_ns: u64,
+    p99_ns: u64,
+    max_ns: u64,
+    allocations_per_sample: f64,
+    bytes_per_ms: u64,
+}
+
+impl Samples {
+    fn measure<T>(&mut self, byte_count: usize, operation: impl FnOnce() -> T) -> T {
+        let allocation_count = ALLOCATION_COUNT.load(Ordering::Relaxed);
+        let time = Instant::now();
+        let result = operation();
+        self.durations.push(time.elapsed());
+        self.allocation_count += ALLOCATION_COUNT.load(Ordering::Relaxed) - allocation_count;
+        self.byte_count += byte_count;
+        result
+    }
+
+    fn extend(&mut self, other: &Samples) {
+        self.durations.extend_from_slice(&other.durations);
+        self.allocation_count += other.allocation_count;
+        self.byte_count += other.byte_count;
+    }
+
+    fn summary(&self) -> Option<Summary> {
+        if self.durations.is_empty() {
+            return None;
+        }
+        let mut durations = self.durations.clone();
+        durations.sort_unstable();
+        let percentile = |p: usize| durations[(durations.len() - 1) * p / 100].as_nanos() as u64;
+        let total_secs = durations.iter().sum::<Duration>().as_secs_f64();
+        Some(Summary {
+            samples: durations.len(),
+            p50_ns: percentile(50),
+            p90_ns: percentile(90),
+            p99_ns: percentile(99),
+            max_ns: percentile(100),
+            allocations_per_sample: self.allocation_count as f64 / durations.len() as f64,
+            bytes_per_ms: if total_secs > 0.0 {
+                (self.byte_count as f64 / (total_secs * 1000.0)) as u64
+            } else {
+                0
+            },
+        })
+    }
+}
+
+impl Scenarios {
+    fn iter_mut(&mut self) -> impl Iterator<Item = (&'static str, &mut Samples)> {
+        vec![
+            ("parse", &mut self.parse),
+            ("reparse", &mut self.reparse),
+            ("changed_ranges", &mut self.changed_ranges),
+            ("query", &mut self.query),
+            ("tree_cursor", &mut self.tree_cursor),
+            ("node_access", &mut self.node_access),
+            ("delete", &mut self.delete),
+        ]
+        .into_iter()
+    }
+}
+
+fn main() {
+    unsafe {
+        tree_sitter::set_allocator(
+            Some(ts_count_malloc),
+            Some(ts_count_calloc),
+            Some(ts_count_realloc),
+            Some(ts_count_free),
+        )
+    };
+
+    eprintln!(
+        "Benchmarking with {} repetitions, seed {}",
+        *REPETITION_COUNT, *SEED
+    );
+
+    let mut results = BTreeMap::new();
+    let mut totals = Scenarios::default();
+    for (language_path, (example_paths, query_paths)) in
+        EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR.iter()
+    {
+        if is_language_filtered_out(language_path) {
+            continue;
+        }
+
+        let language_name = language_name(language_path);
+        let example_paths = example_paths
+            .iter()
+            .filter(|path| !is_example_filtered_out(path))
+            .cloned()
+            .collect::<Vec<_>>();
+        if example_paths.is_empty() {
+            continue;
+        }
+
+        eprintln!("\nLanguage: {}", language_name);
+        let language = get_language(language_path);
+        let queries = query_paths
+            .iter()
+            .map(|path| {
+                let source = fs::read_to_string(path)
+                    .with_context(|| format!("Failed to read {:?}", path))
+                    .unwrap();
+                Query::new(language, &source)
+                    .with_context(|| format!("Failed to parse query {:?}", path))
+                    .unwrap()
+            })
+            .collect::<Vec<_>>();
+
+        let mut scenarios = run_scenarios(language, &example_paths, &queries);
+        for ((name, samples), (_, total)) in scenarios.iter_mut().zip(totals.iter_mut()) {
+            if let Some(summary) = samples.summary() {
+                print_summary(name, &summary);
+                results.insert(format!("{}/{}", language_name, name), summary);
+            }
+            total.extend(samples);
+        }
+    }
+
+    eprintln!("\n  Overall");
+    for (name, total) in totals.iter_mut() {
+        if let Some(summary) = total.summary() {
+            print_summary(name, &summary);
+            results.insert(format!("overall/{}", name), summary);
+        }
+    }
+    eprintln!("");
+
+    if let Some(path) = OUTPUT_PATH.as_ref() {
+        fs::write(path, serde_json::to_string_pretty(&results).unwrap())
+            .with_context(|| format!("Failed to write {:?}", path))
+            .unwrap();
+    }
+
+    if let Some(path) = BASELINE_PATH.as_ref() {
+        let baseline = fs::read_to_string(path)
+            .with_context(|| format!("Failed to read {:?}", path))
+            .unwrap();
+        let baseline = serde_json::from_str(&baseline)
+            .with_context(|| format!("Failed to parse {:?}", path))
+            .unwrap();
+        if !compare(&baseline, &results) {
+            process::exit(1);
+        }
+    }
+}
+
+fn run_scenarios(language: Language, example_paths: &[PathBuf], queries: &[Query]) -> Scenarios {
+    let mut result = Scenarios::default();
+    let mut parser = Parser::new();
+    parser.set_language(language).unwrap();
+    let mut query_cursor = QueryCursor::new();
+    let mut rand = Rand::new(*SEED);
+
+    for example_path in example_paths {
+        let source_code = fs::read(example_path)
+            .with_context(|| format!("Failed to read {:?}", example_path))
+            .unwrap();
+
+        for _ in 0..*REPETITION_COUNT {
+            let tree = result.parse.measure(source_code.len(), || {
+                parser.parse(&source_code, None).expect("Failed to parse")
+            });
+
+            for query in queries {
+                result.query.measure(source_code.len(), || {
+                    query_cursor
+                        .matches(query, tree.root_node(), source_code.as_slice())
+                        .count()
+                });
+            }
+            result.tree_cursor.measure(0, || walk_tree(&tree));
+            result.node_access.measure(0, || visit_nodes(&tree));
+            result.delete.measure(0, || drop(tree));
+        }
+
+        // Apply each random edit and then undo it, so that every edit is made to
+        // a valid version of the example file.
+        let mut input = source_code;
+        let mut tree = parser.parse(&input, None).expect("Failed to parse");
+        for _ in 0..*REPETITION_COUNT {
+            let edit = get_random_edit(&mut rand, &input);
+            let undo = invert_edit(&input, &edit);
+            for edit in &[edit, undo] {
+                perform_edit(&mut tree, &mut input, edit);
+                let new_tree = result.reparse.measure(input.len(), || {
+                    parser.parse(&input, Some(&tree)).expect("Failed to parse")
+                });
+                result
+                    .changed_ranges
+                    .measure(0, || tree.changed_ranges(&new_tree).count());
+                tree = new_tree;
+            }
+        }
+    }
+    result
+}
+
+// Visit every node with a tree cursor.
+fn walk_tree(tree: &Tree) -> usize {
+    let mut cursor = tree.walk();
+    let mut count = 1;
+    loop {
+        if cursor.goto_first_child() || cursor.goto_next_sibling() {
+            count += 1;
+            continue;
+        }
+        loop {
+            if !cursor.goto_parent() {
+                return count;
+            }
+            if cursor.goto_next_sibling() {
+                count += 1;
+                break;
+            }
+        }
+    }
+}
+
+// Visit every node by index, and find each node's parent.
+fn visit_nodes(tree: &Tree) -> usize {
+    let mut count = 0;
+    let mut stack = vec![tree.root_node()];
+    while let Some(node) = stack.pop() {
+        for i in 0..node.child_count() {
+            let child = node.child(i).unwrap();
+            if child.parent() == Some(node) {
+                count += 1;
+            }
+            stack.push(child);
+        }
+    }
+    count
+}
+
+fn print_summary(scenario: &str, summary: &Summary) {
+    eprint!(
+        "  {:16}p50 {:>9} ns\tp90 {:>9} ns\tp99 {:>9} ns\tmax {:>9} ns\t{:.1} allocations",
+        scenario,
+        summary.p50_ns,
+        summary.p90_ns,
+        summary.p99_ns,
+        summary.max_ns,
+        summary.allocations_per_sample
+    );
+    if summary.bytes_per_ms > 0 {
+        eprint!("\t{} bytes/ms", summary.bytes_per_ms);
+    }
+    eprintln!("");
+}
+
+// Compare the median times and the allocation counts with those of a baseline,
+// returning false if any of them have increased by more than the threshold.
+// Increases of less than one allocation per sample are ignored, because
+// operations that rarely allocate are sensitive to the order of the samples.
+fn compare(baseline: &BTreeMap<String, Summary>, results: &BTreeMap<String, Summary>) -> bool {
+    let threshold = *REGRESSION_THRESHOLD;
+    let change = |old: f64, new: f64| {
+        if old == new {
+            0.0
+        } else if old == 0.0 {
+            f64::INFINITY
+        } else {
+            (new - old) / old * 100.0
+        }
+    };
+
+    eprintln!("Comparison with baseline (threshold {}%)", threshold);
+    let mut passed = true;
+    for (name, result) in results {
+        if let Some(old) = baseline.get(name) {
+            let time_change = change(old.p50_ns as f64, result.p50_ns as f64);
+            let allocation_change =
+                change(old.allocations_per_sample, result.allocations_per_sample);
+            let regressed = time_change > threshold
+                || (allocation_change > threshold
+                    && result.allocations_per_sample - old.allocations_per_sample >= 1.0);
+            eprintln!(
+                "  {:32}p50 {:+.1}%\tallocations {:+.1}%{}",
+                name,
+                time_change,
+                allocation_change,
+                if regressed { "\tREGRESSION" } else { "" }
+            );
+            passed &= !regressed;
+        }
+    }
+    passed
+}
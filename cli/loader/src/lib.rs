@@ -1,16 +1,17 @@
 use anyhow::{anyhow, Context, Error, Result};
 use libloading::{Library, Symbol};
-use once_cell::unsync::OnceCell;
+use once_cell::sync::OnceCell;
 use regex::{Regex, RegexBuilder};
 use serde::{Deserialize, Deserializer, Serialize};
 use std::collections::HashMap;
 use std::io::BufReader;
 use std::ops::Range;
 use std::path::{Path, PathBuf};
-use std::process::Command;
+use std::process::{self, Command, Output, Stdio};
+use std::sync::atomic::{AtomicUsize, Ordering};
 use std::sync::Mutex;
-use std::time::SystemTime;
-use std::{fs, mem};
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+use std::{env, fs, mem, thread};
 use tree_sitter::{Language, QueryError, QueryErrorKind};
 use tree_sitter_highlight::HighlightConfiguration;
 use tree_sitter_tags::{Error as TagsError, TagsConfiguration};
@@ -75,6 +76,40 @@ const DYLIB_EXTENSION: &'static str = "dll";
 
 const BUILD_TARGET: &'static str = env!("BUILD_TARGET");
 
+// The number of compiled libraries that are kept for each grammar name. Several
+// versions of a grammar can be in use at once, e.g. in different checkouts.
+const MAX_LIBRARIES_PER_GRAMMAR: usize = 4;
+
+static NEXT_BUILD_ID: AtomicUsize = AtomicUsize::new(0);
+
+// The file in the user's cache directory that stores the digests of grammars'
+// source files. It is kept out of the parser library directory, which may be
+// shared with other machines, because the digests are only valid on the machine
+// that computed them.
+const SOURCE_DIGESTS_FILE_NAME: &'static str = "source-digests.json";
+
+// A file whose contents changed more recently than this is always read again.
+// Its modification time may have been rounded, so that a later write of the same
+// size could leave its metadata unchanged.
+const SOURCE_DIGEST_MIN_AGE: Duration = Duration::from_secs(2);
+
+// The extensions of files in a grammar's source directory that can be included by
+// its parser or external scanner.
+const HEADER_EXTENSIONS: &[&str] = &["h", "hh", "hpp", "hxx", "inc"];
+
+#[cfg(unix)]
+const COMPILER_FLAGS: &[&str] = &[
+    "-fPIC",
+    "-fno-exceptions",
+    "-g",
+    // For conditional compilation of external scanner code when
+    // used internally by `tree-siteer parse` and other sub commands.
+    "-DTREE_SITTER_INTERNAL_BUILD",
+];
+
+#[cfg(windows)]
+const COMPILER_FLAGS: &[&str] = &["/nologo"];
+
 pub struct LanguageConfiguration<'a> {
     pub scope: Option<String>,
     pub content_regex: Option<Regex>,
@@ -101,20 +136,55 @@ pub struct Loader {
     highlight_names: Box<Mutex<Vec<String>>>,
     use_all_highlight_names: bool,
     debug_build: bool,
+    compiler_version: OnceCell<Vec<u8>>,
+    source_digests_path: Option<PathBuf>,
+    source_digests: Mutex<Option<HashMap<PathBuf, SourceDigest>>>,
+}
+
+// The digest of a source file's contents, along with the metadata that the file
+// had when it was read. On Unix, this includes the inode number and the time of
+// the last status change, which can't be set back like the modification time.
+#[derive(Clone, Copy, PartialEq, Deserialize, Serialize)]
+struct SourceDigest {
+    size: u64,
+    modified_secs: u64,
+    modified_nanos: u32,
+    inode: u64,
+    changed_secs: i64,
+    changed_nanos: i64,
+    digest: u64,
 }
 
+// A 64-bit FNV-1a hasher. Unlike `DefaultHasher`, its output is fixed, so library
+// names stay the same across Rust releases.
+struct Fnv1a(u64);
+
 unsafe impl Send for Loader {}
 unsafe impl Sync for Loader {}
 
 impl Loader {
     pub fn new() -> Result<Self> {
-        let parser_lib_path = dirs::cache_dir()
-            .ok_or(anyhow!("Cannot determine cache directory"))?
-            .join("tree-sitter/lib");
-        Ok(Self::with_parser_lib_path(parser_lib_path))
+        // The compiled libraries can be shared by pointing multiple machines or
+        // checkouts at the same directory.
+        let parser_lib_path = match env::var_os("TREE_SITTER_LIBDIR") {
+            Some(path) => PathBuf::from(path),
+            None => dirs::cache_dir()
+                .ok_or(anyhow!("Cannot determine cache directory"))?
+                .join("tree-sitter/lib"),
+        };
+        let source_digests_path =
+            dirs::cache_dir().map(|dir| dir.join("tree-sitter").join(SOURCE_DIGESTS_FILE_NAME));
+        Ok(Self::with_paths(parser_lib_path, source_digests_path))
     }
 
     pub fn with_parser_lib_path(parser_lib_path: PathBuf) -> Self {
+        Self::with_paths(parser_lib_path, None)
+    }
+
+    // Create a loader that stores compiled libraries in `parser_lib_path`, and the
+    // digests of their source files in `source_digests_path`. Without a digests path,
+    // the digests are only kept in memory.
+    pub fn with_paths(parser_lib_path: PathBuf, source_digests_path: Option<PathBuf>) -> Self {
         Loader {
             parser_lib_path,
             languages_by_id: Vec::new(),
@@ -123,6 +193,9 @@ impl Loader {
             highlight_names: Box::new(Mutex::new(Vec::new())),
             use_all_highlight_names: true,
             debug_build: false,
+            compiler_version: OnceCell::new(),
+            source_digests_path,
+            source_digests: Mutex::new(None),
         }
     }
 
@@ -204,6 +277,49 @@ impl Loader {
         &self,
         path: &Path,
     ) -> Result<Option<(Language, &LanguageConfiguration)>> {
+        if let Some(id) = self.language_configuration_id_for_file_name(path)? {
+            let configuration = &self.language_configurations[id];
+            let language = self.language_for_id(configuration.language_id)?;
+            Ok(Some((language, configuration)))
+        } else {
+            Ok(None)
+        }
+    }
+
+    /// Load the languages for the given paths' file names on up to `jobs` threads
+    /// at once, so that grammars which have not been compiled yet are compiled in
+    /// parallel.
+    pub fn load_languages_for_file_names(&self, paths: &[&Path], jobs: usize) -> Result<()> {
+        let mut language_ids = Vec::new();
+        for path in paths {
+            if let Some(id) = self.language_configuration_id_for_file_name(path)? {
+                language_ids.push(self.language_configurations[id].language_id);
+            }
+        }
+        language_ids.sort();
+        language_ids.dedup();
+
+        let next_index = AtomicUsize::new(0);
+        thread::scope(|s| {
+            let threads = (0..jobs.max(1).min(language_ids.len()))
+                .map(|_| {
+                    s.spawn(|| loop {
+                        let i = next_index.fetch_add(1, Ordering::Relaxed);
+                        match language_ids.get(i) {
+                            Some(id) => self.language_for_id(*id)?,
+                            None => return Ok(()),
+                        };
+                    })
+                })
+                .collect::<Vec<_>>();
+            threads
+                .into_iter()
+                .map(|thread| thread.join().unwrap())
+                .collect::<Result<()>>()
+        })
+    }
+
+    fn language_configuration_id_for_file_name(&self, path: &Path) -> Result<Option<usize>> {
         // Find all the language configurations that match this file name
         // or a suffix of the file name.
         let configuration_ids = path
@@ -220,11 +336,9 @@ impl Loader {
 
         if let Some(configuration_ids) = configuration_ids {
             if !configuration_ids.is_empty() {
-                let configuration;
-
                 // If there is only one language configuration, then use it.
                 if configuration_ids.len() == 1 {
-                    configuration = &self.language_configurations[configuration_ids[0]];
+                    return Ok(Some(configuration_ids[0]));
                 }
                 // If multiple language configurations match, then determine which
                 // one to use by applying the configurations' content regexes.
@@ -260,11 +374,8 @@ impl Loader {
                         }
                     }
 
-                    configuration = &self.language_configurations[best_configuration_id.unwrap()];
+                    return Ok(best_configuration_id);
                 }
-
-                let language = self.language_for_id(configuration.language_id)?;
-                return Ok(Some((language, configuration)));
             }
         }
 
@@ -348,90 +459,44 @@ impl Loader {
         parser_path: &Path,
         scanner_path: &Option<PathBuf>,
     ) -> Result<Language> {
-        let mut lib_name = name.to_string();
-        if self.debug_build {
-            lib_name.push_str(".debug._");
-        }
-        let mut library_path = self.parser_lib_path.join(lib_name);
-        library_path.set_extension(DYLIB_EXTENSION);
-
-        let recompile = needs_recompile(&library_path, &parser_path, &scanner_path)
-            .with_context(|| "Failed to compare source and binary timestamps")?;
-
-        if recompile {
-            fs::create_dir_all(&self.parser_lib_path)?;
-            let mut config = cc::Build::new();
-            config
-                .cpp(true)
-                .opt_level(2)
-                .cargo_metadata(false)
-                .target(BUILD_TARGET)
-                .host(BUILD_TARGET);
-            let compiler = config.get_compiler();
-            let mut command = Command::new(compiler.path());
-            for (key, value) in compiler.env() {
-                command.env(key, value);
+        let compiler = self.compiler();
+        let library_path = self
+            .library_path(name, &compiler, header_path, parser_path, scanner_path)
+            .with_context(|| "Failed to read parser source files")?;
+
+        // Another process that shares the parser library directory may remove the
+        // library before it is opened, while pruning old libraries. In that case, it
+        // is built again.
+        let mut did_build = false;
+        let library = loop {
+            if !library_path.exists() {
+                self.build_library(
+                    &compiler,
+                    &library_path,
+                    header_path,
+                    parser_path,
+                    scanner_path,
+                )?;
+                did_build = true;
             }
-
-            if cfg!(windows) {
-                command.args(&["/nologo", "/LD", "/I"]).arg(header_path);
-                if self.debug_build {
-                    command.arg("/Od");
-                } else {
-                    command.arg("/O2");
-                }
-                command.arg(parser_path);
-                if let Some(scanner_path) = scanner_path.as_ref() {
-                    command.arg(scanner_path);
-                }
-                command
-                    .arg("/link")
-                    .arg(format!("/out:{}", library_path.to_str().unwrap()));
-            } else {
-                command
-                    .arg("-shared")
-                    .arg("-fPIC")
-                    .arg("-fno-exceptions")
-                    .arg("-g")
-                    .arg("-I")
-                    .arg(header_path)
-                    .arg("-o")
-                    .arg(&library_path);
-
-                if self.debug_build {
-                    command.arg("-O0");
-                } else {
-                    command.arg("-O2");
-                }
-
-                // For conditional compilation of external scanner code when
-                // used internally by `tree-siteer parse` and other sub commands.
-                command.arg("-DTREE_SITTER_INTERNAL_BUILD");
-
-                if let Some(scanner_path) = scanner_path.as_ref() {
-                    if scanner_path.extension() == Some("c".as_ref()) {
-                        command.arg("-xc").arg("-std=c99").arg(scanner_path);
-                    } else {
-                        command.arg(scanner_path);
+            match unsafe { Library::new(&library_path) } {
+                Ok(library) => break library,
+                Err(error) => {
+                    if did_build || library_path.exists() {
+                        return Err(error).with_context(|| {
+                            format!("Error opening dynamic library {:?}", &library_path)
+                        });
                     }
                 }
-                command.arg("-xc").arg(parser_path);
             }
+        };
 
-            let output = command
-                .output()
-                .with_context(|| "Failed to execute C compiler")?;
-            if !output.status.success() {
-                return Err(anyhow!(
-                    "Parser compilation failed.\nStdout: {}\nStderr: {}",
-                    String::from_utf8_lossy(&output.stdout),
-                    String::from_utf8_lossy(&output.stderr)
-                ));
-            }
+        // Libraries are only removed once the new one has been loaded, which keeps
+        // the loaded library in use on platforms that don't allow removing it.
+        if did_build {
+            self.remove_old_libraries(name, &library_path);
         }
 
-        let library = unsafe { Library::new(&library_path) }
-            .with_context(|| format!("Error opening dynamic library {:?}", &library_path))?;
         let language_fn_name = format!("tree_sitter_{}", replace_dashes_with_underscores(name));
         let language = unsafe {
             let language_fn: Symbol<unsafe extern "C" fn() -> Language> = library
@@ -443,6 +508,393 @@ impl Loader {
         Ok(language)
     }
 
+    fn compiler(&self) -> cc::Tool {
+        cc::Build::new()
+            .cpp(true)
+            .opt_level(2)
+            .cargo_metadata(false)
+            .target(BUILD_TARGET)
+            .host(BUILD_TARGET)
+            .get_compiler()
+    }
+
+    // Get the compiler's version banner, which tells apart different compilers that
+    // are installed at the same path, e.g. before and after an upgrade.
+    fn compiler_version(&self, compiler: &cc::Tool) -> Result<&[u8]> {
+        self.compiler_version
+            .get_or_try_init(|| {
+                let mut command = Command::new(compiler.path());
+                for (key, value) in compiler.env() {
+                    command.env(key, value);
+                }
+                // MSVC prints its banner when it is run without arguments.
+                if !cfg!(windows) {
+                    command.arg("--version");
+                }
+                let output = command
+                    .output()
+                    .with_context(|| "Failed to execute C compiler")?;
+                let mut result = output.stdout;
+                result.extend(output.stderr);
+                Ok(result)
+            })
+            .map(Vec::as_slice)
+    }
+
+    // The flags that are passed to the compiler for one source file, in addition to
+    // `COMPILER_FLAGS`.
+    fn source_flags(&self, source_path: &Path, is_parser: bool) -> Vec<&'static str> {
+        if cfg!(windows) {
+            vec![if self.debug_build { "/Od" } else { "/O2" }]
+        } else {
+            let mut result = vec![if self.debug_build { "-O0" } else { "-O2" }];
+            if is_parser {
+                result.push("-xc");
+            } else if source_path.extension() == Some("c".as_ref()) {
+                result.extend(&["-xc", "-std=c99"]);
+            }
+            result
+        }
+    }
+
+    // Compiled libraries are named after a hash of everything that determines their
+    // contents, so that one can be reused by any checkout of the same grammar, and is
+    // not reused after the grammar or the compiler configuration has changed. Headers
+    // that are included from outside of the grammar's source directories are not
+    // part of the hash, apart from `tree_sitter/parser.h`.
+    fn library_path(
+        &self,
+        name: &str,
+        compiler: &cc::Tool,
+        header_path: &Path,
+        parser_path: &Path,
+        scanner_path: &Option<PathBuf>,
+    ) -> Result<PathBuf> {
+        let mut hasher = Fnv1a::new();
+        hasher.write_field(env!("CARGO_PKG_VERSION").as_bytes());
+        hasher.write_field(BUILD_TARGET.as_bytes());
+        hasher.write_field(&[self.debug_build as u8]);
+        hasher.write_field(compiler.path().to_string_lossy().as_bytes());
+        hasher.write_field(self.compiler_version(compiler)?);
+        for (key, value) in compiler.env() {
+            hasher.write_field(key.to_string_lossy().as_bytes());
+            hasher.write_field(value.to_string_lossy().as_bytes());
+        }
+        for flag in COMPILER_FLAGS {
+            hasher.write_field(flag.as_bytes());
+        }
+        for flag in self.source_flags(parser_path, true) {
+            hasher.write_field(flag.as_bytes());
+        }
+        if let Some(scanner_path) = scanner_path {
+            for flag in self.source_flags(scanner_path, false) {
+                hasher.write_field(flag.as_bytes());
+            }
+        }
+
+        // Each source file is identified by its path relative to the directory that
+        // it was found in, so that the hash doesn't depend on where the grammar is.
+        let mut source_paths = Vec::new();
+        let parser_header_path = header_path.join("tree_sitter").join("parser.h");
+        if parser_header_path.exists() {
+            source_paths.push((PathBuf::from("tree_sitter/parser.h"), parser_header_path));
+        }
+        source_paths.push((
+            PathBuf::from(parser_path.file_name().unwrap()),
+            parser_path.into(),
+        ));
+        if let Some(scanner_path) = scanner_path {
+            source_paths.push((
+                PathBuf::from(scanner_path.file_name().unwrap()),
+                scanner_path.clone(),
+            ));
+        }
+        let mut source_dirs = vec![parser_path.parent().unwrap()];
+        source_dirs.extend(scanner_path.as_ref().and_then(|p| p.parent()));
+        source_dirs.dedup();
+        for source_dir in source_dirs {
+            let start_index = source_paths.len();
+            find_headers(source_dir, Path::new(""), &mut source_paths);
+            source_paths[start_index..].sort_unstable();
+        }
+
+        let mut digests = Vec::with_capacity(source_paths.len());
+        for (_, path) in &source_paths {
+            digests.push(self.source_digest(path)?);
+        }
+        for ((relative_path, _), digest) in source_paths.iter().zip(digests) {
+            hasher.write_field(relative_path.to_string_lossy().as_bytes());
+            hasher.write_field(&digest.to_le_bytes());
+        }
+        self.save_source_digests();
+
+        Ok(self
+            .parser_lib_path
+            .join(format!("{}-{:016x}.{}", name, hasher.0, DYLIB_EXTENSION)))
+    }
+
+    // Get the digest of a source file's contents. Reading large generated parsers on
+    // every load is slow, so the digests are stored in the user's cache directory,
+    // and a file is only read again when its metadata changes. This is only a
+    // speed-up for the local machine: a digest is never trusted for a file that
+    // changed recently, or whose size, modification time, inode or status change
+    // time differ from when it was read. The last two are only known on Unix, so
+    // elsewhere, a file that is rewritten with the same size and then has its
+    // modification time set back is not read again.
+    fn source_digest(&self, path: &Path) -> Result<u64> {
+        let path = fs::canonicalize(path)?;
+        let metadata = fs::metadata(&path)?;
+        let mut entry = source_digest_entry(&metadata)?;
+
+        {
+            let mut digests = self.source_digests.lock().unwrap();
+            let digests = digests.get_or_insert_with(|| self.read_source_digests());
+            if let Some(cached_entry) = digests.get(&path) {
+                if (SourceDigest {
+                    digest: 0,
+                    ..*cached_entry
+                }) == entry
+                {
+                    return Ok(cached_entry.digest);
+                }
+            }
+        }
+
+        let mut hasher = Fnv1a::new();
+        hasher.write(&fs::read(&path)?);
+        entry.digest = hasher.0;
+
+        let changed = Duration::new(entry.modified_secs, entry.modified_nanos).max(Duration::new(
+            entry.changed_secs.max(0) as u64,
+            entry.changed_nanos.max(0) as u32,
+        ));
+        let now = SystemTime::now().duration_since(UNIX_EPOCH)?;
+        if now
+            .checked_sub(changed)
+            .map_or(false, |age| age >= SOURCE_DIGEST_MIN_AGE)
+        {
+            let mut digests = self.source_digests.lock().unwrap();
+            digests.get_or_insert_with(HashMap::new).insert(path, entry);
+        }
+        Ok(entry.digest)
+    }
+
+    fn read_source_digests(&self) -> HashMap<PathBuf, SourceDigest> {
+        self.source_digests_path
+            .as_ref()
+            .and_then(|path| fs::read(path).ok())
+            .and_then(|json| serde_json::from_slice(&json).ok())
+            .unwrap_or_default()
+    }
+
+    // Write the source digests if any of them have changed since they were read.
+    // They are merged with the digests that other processes have written since
+    // then, and digests of files that no longer exist are dropped. Two processes
+    // may still write the file at the same time, in which case the digests that
+    // one of them found are lost, and will be computed again.
+    fn save_source_digests(&self) {
+        let digests_path = match &self.source_digests_path {
+            Some(path) => path,
+            None => return,
+        };
+        let digests = self.source_digests.lock().unwrap();
+        let digests = match digests.as_ref() {
+            Some(digests) => digests,
+            None => return,
+        };
+        let mut saved_digests = self.read_source_digests();
+        if digests
+            .iter()
+            .all(|(path, digest)| saved_digests.get(path) == Some(digest))
+        {
+            return;
+        }
+        saved_digests.extend(digests.iter().map(|(path, digest)| (path.clone(), *digest)));
+        saved_digests.retain(|path, _| path.exists());
+        let json = match serde_json::to_vec(&saved_digests) {
+            Ok(json) => json,
+            Err(_) => return,
+        };
+        let temp_path = digests_path.with_extension(format!("json.tmp.{}", process::id()));
+        if fs::create_dir_all(digests_path.parent().unwrap()).is_ok()
+            && fs::write(&temp_path, json).is_ok()
+            && fs::rename(&temp_path, digests_path).is_err()
+        {
+            fs::remove_file(&temp_path).ok();
+        }
+    }
+
+    fn build_library(
+        &self,
+        compiler: &cc::Tool,
+        library_path: &Path,
+        header_path: &Path,
+        parser_path: &Path,
+        scanner_path: &Option<PathBuf>,
+    ) -> Result<()> {
+        fs::create_dir_all(&self.parser_lib_path)?;
+
+        // Build the library in a separate directory, and then move it into place,
+        // so that other processes that share the parser library directory never
+        // load a library that is only partially written.
+        let build_dir = library_path.with_extension(format!(
+            "build-{}-{}",
+            process::id(),
+            NEXT_BUILD_ID.fetch_add(1, Ordering::Relaxed)
+        ));
+        fs::create_dir_all(&build_dir)?;
+        let result = self.compile_library(
+            compiler,
+            &build_dir,
+            library_path,
+            header_path,
+            parser_path,
+            scanner_path,
+        );
+        fs::remove_dir_all(&build_dir).ok();
+        result
+    }
+
+    fn compile_library(
+        &self,
+        compiler: &cc::Tool,
+        build_dir: &Path,
+        library_path: &Path,
+        header_path: &Path,
+        parser_path: &Path,
+        scanner_path: &Option<PathBuf>,
+    ) -> Result<()> {
+        // The parser and the external scanner are compiled in parallel, because
+        // they are independent, and parsers can take a long time to compile.
+        let mut source_paths = vec![parser_path];
+        source_paths.extend(scanner_path.as_deref());
+        let compilations = source_paths
+            .into_iter()
+            .enumerate()
+            .map(|(i, source_path)| {
+                let mut object_path = build_dir.join(i.to_string());
+                object_path.set_extension(if cfg!(windows) { "obj" } else { "o" });
+                let mut command = self.compiler_command(compiler);
+                let source_flags = self.source_flags(source_path, source_path == parser_path);
+                if cfg!(windows) {
+                    command
+                        .arg("/c")
+                        .arg("/I")
+                        .arg(header_path)
+                        .args(&source_flags)
+                        .arg(format!("/Fo{}", object_path.to_str().unwrap()))
+                        .arg(source_path);
+                } else {
+                    command
+                        .arg("-c")
+                        .arg("-I")
+                        .arg(header_path)
+                        .args(&source_flags)
+                        .arg("-o")
+                        .arg(&object_path)
+                        .arg(source_path);
+                }
+                let child = command
+                    .stdout(Stdio::piped())
+                    .stderr(Stdio::piped())
+                    .spawn()
+                    .with_context(|| "Failed to execute C compiler")?;
+                Ok((child, object_path))
+            })
+            .collect::<Result<Vec<_>>>()?;
+
+        let mut object_paths = Vec::new();
+        for (child, object_path) in compilations {
+            check_compiler_output(child.wait_with_output()?)?;
+            object_paths.push(object_path);
+        }
+
+        let built_library_path = build_dir.join(library_path.file_name().unwrap());
+        let mut command = self.compiler_command(compiler);
+        if cfg!(windows) {
+            command
+                .arg("/LD")
+                .args(&object_paths)
+                .arg("/link")
+                .arg(format!("/out:{}", built_library_path.to_str().unwrap()));
+        } else {
+            command
+                .arg("-shared")
+                .args(&object_paths)
+                .arg("-o")
+                .arg(&built_library_path);
+        }
+        check_compiler_output(
+            command
+                .output()
+                .with_context(|| "Failed to execute C compiler")?,
+        )?;
+
+        // Another process may have built the same library in the meantime.
+        if let Err(error) = fs::rename(&built_library_path, library_path) {
+            if !library_path.exists() {
+                return Err(error.into());
+            }
+        }
+        Ok(())
+    }
+
+    fn compiler_command(&self, compiler: &cc::Tool) -> Command {
+        let mut command = Command::new(compiler.path());
+        for (key, value) in compiler.env() {
+            command.env(key, value);
+        }
+        command.args(COMPILER_FLAGS);
+        command
+    }
+
+    // Remove all but the most recently compiled libraries for a grammar, so that the
+    // parser library directory doesn't grow each time the grammar changes. Libraries
+    // that were named after the grammar alone, before libraries were named after a
+    // hash, are removed too. Libraries that are loaded by other processes can't be
+    // removed on some platforms, which is fine.
+    fn remove_old_libraries(&self, name: &str, current_library_path: &Path) {
+        let prefix = format!("{}-", name);
+        let legacy_file_names = [
+            format!("{}.{}", name, DYLIB_EXTENSION),
+            format!("{}.debug._.{}", name, DYLIB_EXTENSION),
+        ];
+        let mut libraries = Vec::new();
+        for entry in fs::read_dir(&self.parser_lib_path).into_iter().flatten() {
+            let entry = match entry {
+                Ok(entry) => entry,
+                Err(_) => continue,
+            };
+            let file_name = entry.file_name();
+            let file_name = match file_name.to_str() {
+                Some(file_name) => file_name,
+                None => continue,
+            };
+            if legacy_file_names.iter().any(|name| name == file_name) {
+                fs::remove_file(entry.path()).ok();
+                continue;
+            }
+            let hash = file_name
+                .strip_prefix(&prefix)
+                .and_then(|name| name.strip_suffix(DYLIB_EXTENSION))
+                .and_then(|name| name.strip_suffix('.'));
+            match hash {
+                Some(hash) if hash.len() == 16 && hash.bytes().all(|b| b.is_ascii_hexdigit()) => {}
+                _ => continue,
+            }
+            if entry.path() == current_library_path {
+                continue;
+            }
+            if let Some(modified) = entry.metadata().and_then(|m| m.modified()).ok() {
+                libraries.push((modified, entry.path()));
+            }
+        }
+        libraries.sort_unstable_by(|a, b| b.0.cmp(&a.0));
+        for (_, path) in libraries.into_iter().skip(MAX_LIBRARIES_PER_GRAMMAR - 1) {
+            fs::remove_file(path).ok();
+        }
+    }
+
     pub fn highlight_config_for_injection_string<'a>(
         &'a self,
         string: &str,
@@ -812,28 +1264,87 @@ impl<'a> LanguageConfiguration<'a> {
     }
 }
 
-fn needs_recompile(
-    lib_path: &Path,
-    parser_c_path: &Path,
-    scanner_path: &Option<PathBuf>,
-) -> Result<bool> {
-    if !lib_path.exists() {
-        return Ok(true);
+impl Fnv1a {
+    fn new() -> Self {
+        Fnv1a(0xcbf29ce484222325)
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for byte in bytes {
+            self.0 ^= *byte as u64;
+            self.0 = self.0.wrapping_mul(0x100000001b3);
+        }
     }
-    let lib_mtime = mtime(lib_path)?;
-    if mtime(parser_c_path)? > lib_mtime {
-        return Ok(true);
+
+    // Write a value, preceded by its length, so that the boundaries between
+    // consecutive values are part of the hash.
+    fn write_field(&mut self, bytes: &[u8]) {
+        self.write(&(bytes.len() as u64).to_le_bytes());
+        self.write(bytes);
     }
-    if let Some(scanner_path) = scanner_path {
-        if mtime(scanner_path)? > lib_mtime {
-            return Ok(true);
+}
+
+// Find the header files in the given directory and its subdirectories, and add them
+// to `paths`, along with their paths relative to the directory. Entries that are
+// removed while the directory is being read, such as other processes' build
+// directories, are skipped.
+fn find_headers(dir: &Path, relative_dir: &Path, paths: &mut Vec<(PathBuf, PathBuf)>) {
+    let entries = match fs::read_dir(dir.join(relative_dir)) {
+        Ok(entries) => entries,
+        Err(_) => return,
+    };
+    for entry in entries.flatten() {
+        let relative_path = relative_dir.join(entry.file_name());
+        let is_dir = match entry.file_type() {
+            Ok(file_type) => file_type.is_dir(),
+            Err(_) => continue,
+        };
+        if is_dir {
+            find_headers(dir, &relative_path, paths);
+        } else if relative_path
+            .extension()
+            .and_then(|e| e.to_str())
+            .map_or(false, |e| HEADER_EXTENSIONS.contains(&e))
+        {
+            paths.push((relative_path, entry.path()));
         }
     }
-    Ok(false)
 }
 
-fn mtime(path: &Path) -> Result<SystemTime> {
-    Ok(fs::metadata(path)?.modified()?)
+// Describe a source file by its metadata, with an empty digest.
+fn source_digest_entry(metadata: &fs::Metadata) -> Result<SourceDigest> {
+    let modified = metadata.modified()?.duration_since(UNIX_EPOCH)?;
+    let mut result = SourceDigest {
+        size: metadata.len(),
+        modified_secs: modified.as_secs(),
+        modified_nanos: modified.subsec_nanos(),
+        inode: 0,
+        changed_secs: 0,
+        changed_nanos: 0,
+        digest: 0,
+    };
+
+    #[cfg(unix)]
+    {
+        use std::os::unix::fs::MetadataExt;
+        result.inode = metadata.ino();
+        result.changed_secs = metadata.ctime();
+        result.changed_nanos = metadata.ctime_nsec();
+    }
+
+    Ok(result)
+}
+
+fn check_compiler_output(output: Output) -> Result<()> {
+    if output.status.success() {
+        Ok(())
+    } else {
+        Err(anyhow!(
+            "Parser compilation failed.\nStdout: {}\nStderr: {}",
+            String::from_utf8_lossy(&output.stdout),
+            String::from_utf8_lossy(&output.stderr)
+        ))
+    }
 }
 
 fn replace_dashes_with_underscores(name: &str) -> String {
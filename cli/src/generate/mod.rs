@@ -44,6 +44,7 @@ pub fn generate_parser_in_directory(
     abi_version: usize,
     generate_bindings: bool,
     report_symbol_name: Option<&str>,
+    use_lex_tables: bool,
 ) -> Result<()> {
     let src_path = repo_path.join("src");
     let header_path = src_path.join("tree_sitter");
@@ -83,6 +84,7 @@ pub fn generate_parser_in_directory(
         simple_aliases,
         abi_version,
         report_symbol_name,
+        use_lex_tables,
     )?;
 
     write_file(&src_path.join("parser.c"), c_code)?;
@@ -97,6 +99,13 @@ pub fn generate_parser_in_directory(
 }
 
 pub fn generate_parser_for_grammar(grammar_json: &str) -> Result<(String, String)> {
+    generate_parser_for_grammar_with_lex_tables(grammar_json, false)
+}
+
+pub fn generate_parser_for_grammar_with_lex_tables(
+    grammar_json: &str,
+    use_lex_tables: bool,
+) -> Result<(String, String)> {
     let grammar_json = JSON_COMMENT_REGEX.replace_all(grammar_json, "\n");
     let input_grammar = parse_grammar(&grammar_json)?;
     let (syntax_grammar, lexical_grammar, inlines, simple_aliases) =
@@ -109,6 +118,7 @@ pub fn generate_parser_for_grammar(grammar_json: &str) -> Result<(String, String
         simple_aliases,
         tree_sitter::LANGUAGE_VERSION,
         None,
+        use_lex_tables,
     )?;
     Ok((input_grammar.name, parser.c_code))
 }
@@ -121,6 +131,7 @@ fn generate_parser_for_grammar_with_opts(
     simple_aliases: AliasMap,
     abi_version: usize,
     report_symbol_name: Option<&str>,
+    use_lex_tables: bool,
 ) -> Result<GeneratedParser> {
     let variable_info =
         node_types::get_variable_info(&syntax_grammar, &lexical_grammar, &simple_aliases)?;
@@ -148,6 +159,7 @@ fn generate_parser_for_grammar_with_opts(
         lexical_grammar,
         simple_aliases,
         abi_version,
+        use_lex_tables,
     );
     Ok(GeneratedParser {
         c_code,
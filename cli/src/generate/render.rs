@@ -16,6 +16,8 @@ use std::{
 };
 
 const LARGE_CHARACTER_RANGE_COUNT: usize = 8;
+const ASCII_CHARACTER_COUNT: u32 = 128;
+const LEX_TABLE_SKIP_FLAG: u16 = 0x8000;
 const SMALL_STATE_THRESHOLD: usize = 64;
 const ABI_VERSION_MIN: usize = 13;
 const ABI_VERSION_MAX: usize = tree_sitter::LANGUAGE_VERSION;
@@ -74,6 +76,7 @@ struct Generator {
     unique_aliases: Vec<Alias>,
     symbol_map: HashMap<Symbol, Symbol>,
     field_names: Vec<String>,
+    use_lex_tables: bool,
 
     #[allow(unused)]
     abi_version: usize,
@@ -671,6 +674,79 @@ impl Generator {
         lex_table: LexTable,
         extract_helper_functions: bool,
     ) {
+        let (state_transition_summaries, large_character_sets) =
+            self.summarize_lex_transitions(&lex_table, extract_helper_functions);
+
+        // The table-driven lexer encodes states in 15 bits, so it cannot be
+        // used for very large lex tables.
+        if self.use_lex_tables && lex_table.states.len() < LEX_TABLE_SKIP_FLAG as usize {
+            self.add_lex_table(
+                name,
+                lex_table,
+                &state_transition_summaries,
+                &large_character_sets,
+            );
+            return;
+        }
+
+        // Generate a helper function for each large character set.
+        let mut sorted_large_char_sets: Vec<_> = large_character_sets.iter().map(|e| e).collect();
+        sorted_large_char_sets.sort_unstable_by_key(|info| (info.symbol, info.index));
+        for info in sorted_large_char_sets {
+            add_line!(
+                self,
+                "static inline bool {}_character_set_{}(int32_t c) {{",
+                self.symbol_ids[&info.symbol],
+                info.index
+            );
+            indent!(self);
+            add_whitespace!(self);
+            add!(self, "return ");
+            let tree = CharacterTree::from_ranges(&info.ranges);
+            self.add_character_tree(tree.as_ref());
+            add!(self, ";\n");
+            dedent!(self);
+            add_line!(self, "}}");
+            add_line!(self, "");
+        }
+
+        add_line!(
+            self,
+            "static bool {}(TSLexer *lexer, TSStateId state) {{",
+            name
+        );
+        indent!(self);
+
+        add_line!(self, "START_LEXER();");
+        add_line!(self, "eof = lexer->eof(lexer);");
+        add_line!(self, "switch (state) {{");
+
+        indent!(self);
+        for (i, state) in lex_table.states.into_iter().enumerate() {
+            add_line!(self, "case {}:", i);
+            indent!(self);
+            self.add_lex_state(state, &state_transition_summaries[i], &large_character_sets);
+            dedent!(self);
+        }
+
+        add_line!(self, "default:");
+        indent!(self);
+        add_line!(self, "return false;");
+        dedent!(self);
+
+        dedent!(self);
+        add_line!(self, "}}");
+
+        dedent!(self);
+        add_line!(self, "}}");
+        add_line!(self, "");
+    }
+
+    fn summarize_lex_transitions(
+        &self,
+        lex_table: &LexTable,
+        extract_helper_functions: bool,
+    ) -> (Vec<Vec<TransitionSummary>>, Vec<LargeCharacterSetInfo>) {
         let mut ruled_out_chars = HashSet::new();
         let mut large_character_sets = Vec::<LargeCharacterSetInfo>::new();
 
@@ -735,57 +811,7 @@ impl Generator {
             })
             .collect();
 
-        // Generate a helper function for each large character set.
-        let mut sorted_large_char_sets: Vec<_> = large_character_sets.iter().map(|e| e).collect();
-        sorted_large_char_sets.sort_unstable_by_key(|info| (info.symbol, info.index));
-        for info in sorted_large_char_sets {
-            add_line!(
-                self,
-                "static inline bool {}_character_set_{}(int32_t c) {{",
-                self.symbol_ids[&info.symbol],
-                info.index
-            );
-            indent!(self);
-            add_whitespace!(self);
-            add!(self, "return ");
-            let tree = CharacterTree::from_ranges(&info.ranges);
-            self.add_character_tree(tree.as_ref());
-            add!(self, ";\n");
-            dedent!(self);
-            add_line!(self, "}}");
-            add_line!(self, "");
-        }
-
-        add_line!(
-            self,
-            "static bool {}(TSLexer *lexer, TSStateId state) {{",
-            name
-        );
-        indent!(self);
-
-        add_line!(self, "START_LEXER();");
-        add_line!(self, "eof = lexer->eof(lexer);");
-        add_line!(self, "switch (state) {{");
-
-        indent!(self);
-        for (i, state) in lex_table.states.into_iter().enumerate() {
-            add_line!(self, "case {}:", i);
-            indent!(self);
-            self.add_lex_state(state, &state_transition_summaries[i], &large_character_sets);
-            dedent!(self);
-        }
-
-        add_line!(self, "default:");
-        indent!(self);
-        add_line!(self, "return false;");
-        dedent!(self);
-
-        dedent!(self);
-        add_line!(self, "}}");
-
-        dedent!(self);
-        add_line!(self, "}}");
-        add_line!(self, "");
+        (state_transition_summaries, large_character_sets)
     }
 
     fn symbol_for_advance_action(
@@ -862,6 +888,239 @@ impl Generator {
         add_line!(self, "END_STATE();");
     }
 
+    // Generate a table-driven lexer, which behaves exactly like the `switch`
+    // statement generated by `add_lex_state`, including for lookahead values
+    // that are not valid characters.
+    //
+    // ASCII characters that lead to the same transitions in every state are
+    // grouped into classes, and each state's transitions for those classes
+    // are stored in a row of a two-dimensional table. Class zero is used for
+    // negative lookahead values, which indicate invalid UTF8. The transitions
+    // for non-ASCII characters are stored as a sorted list of ranges.
+    fn add_lex_table(
+        &mut self,
+        name: &str,
+        lex_table: LexTable,
+        transition_info: &Vec<Vec<TransitionSummary>>,
+        large_character_sets: &Vec<LargeCharacterSetInfo>,
+    ) {
+        let large_character_set_trees = large_character_sets
+            .iter()
+            .map(|info| CharacterTree::from_ranges(&info.ranges))
+            .collect::<Vec<_>>();
+        let lookup = |state_id: usize, c: i64| -> u16 {
+            for (i, (_, action)) in lex_table.states[state_id]
+                .advance_actions
+                .iter()
+                .enumerate()
+            {
+                let transition = &transition_info[state_id][i];
+                let is_match = if let Some(call_id) = transition.call_id {
+                    let tree = large_character_set_trees[call_id].as_ref();
+                    evaluate_character_tree(tree, c) == transition.is_included
+                } else {
+                    evaluate_character_range_conditions(
+                        &transition.ranges,
+                        transition.is_included,
+                        c,
+                    )
+                };
+                if is_match {
+                    return encode_lex_table_action(action);
+                }
+            }
+            0
+        };
+
+        // Group the ASCII characters into classes.
+        let mut class_ids_by_signature = HashMap::new();
+        let mut class_representatives = vec![-1];
+        let mut character_classes = Vec::with_capacity(ASCII_CHARACTER_COUNT as usize);
+        for c in 0..ASCII_CHARACTER_COUNT as i64 {
+            let signature = (0..lex_table.states.len())
+                .map(|state_id| lookup(state_id, c))
+                .collect::<Vec<_>>();
+            let class_count = class_representatives.len();
+            let class_id = *class_ids_by_signature
+                .entry(signature)
+                .or_insert(class_count);
+            if class_id == class_count {
+                class_representatives.push(c);
+            }
+            character_classes.push(class_id);
+        }
+
+        // Build each state's row of ASCII transitions, and its list of
+        // non-ASCII ranges, sharing identical rows and lists between states.
+        let mut row_ids = HashMap::new();
+        let mut rows = Vec::new();
+        let mut range_list_indices = HashMap::new();
+        let mut ranges = Vec::<(u32, u16)>::new();
+        let mut state_entries = Vec::with_capacity(lex_table.states.len());
+        for (state_id, state) in lex_table.states.iter().enumerate() {
+            let row = class_representatives
+                .iter()
+                .map(|c| lookup(state_id, *c))
+                .collect::<Vec<_>>();
+            let row_count = rows.len();
+            let row_id = *row_ids.entry(row.clone()).or_insert(row_count);
+            if row_id == row_count {
+                rows.push(row);
+            }
+
+            // The transitions can only change at the boundaries of the
+            // character ranges that are checked in this state.
+            let mut boundaries = vec![ASCII_CHARACTER_COUNT];
+            for transition in &transition_info[state_id] {
+                let transition_ranges = match transition.call_id {
+                    Some(call_id) => &large_character_sets[call_id].ranges,
+                    None => &transition.ranges,
+                };
+                for range in transition_ranges {
+                    for boundary in &[range.start as u32, range.end as u32 + 1] {
+                        if *boundary > ASCII_CHARACTER_COUNT {
+                            boundaries.push(*boundary);
+                        }
+                    }
+                }
+            }
+            boundaries.sort_unstable();
+            boundaries.dedup();
+            let mut range_list = Vec::<(u32, u16)>::new();
+            for boundary in boundaries {
+                let action = lookup(state_id, boundary as i64);
+                if range_list.last().map_or(true, |(_, a)| *a != action) {
+                    range_list.push((boundary, action));
+                }
+            }
+            let range_count = range_list.len();
+            let range_index = *range_list_indices
+                .entry(range_list.clone())
+                .or_insert(ranges.len());
+            if range_index == ranges.len() {
+                ranges.extend(range_list);
+            }
+
+            state_entries.push((state, row_id, range_index, range_count));
+        }
+
+        add_line!(
+            self,
+            "static const uint8_t {}_character_classes[{}] = {{",
+            name,
+            ASCII_CHARACTER_COUNT
+        );
+        indent!(self);
+        for chunk in character_classes.chunks(16) {
+            add_whitespace!(self);
+            for (i, class_id) in chunk.iter().enumerate() {
+                if i > 0 {
+                    add!(self, " ");
+                }
+                add!(self, "{},", class_id);
+            }
+            add!(self, "\n");
+        }
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(
+            self,
+            "static const uint16_t {}_transitions[{}][{}] = {{",
+            name,
+            rows.len(),
+            class_representatives.len()
+        );
+        indent!(self);
+        for (i, row) in rows.iter().enumerate() {
+            add_whitespace!(self);
+            add!(self, "[{}] = {{", i);
+            for (j, action) in row.iter().enumerate() {
+                if j > 0 {
+                    add!(self, ", ");
+                }
+                add!(self, "{}", action);
+            }
+            add!(self, "}},\n");
+        }
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(
+            self,
+            "static const TSLexRange {}_ranges[{}] = {{",
+            name,
+            ranges.len()
+        );
+        indent!(self);
+        for (start, action) in &ranges {
+            add_line!(self, "{{{}, {}}},", start, action);
+        }
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(
+            self,
+            "static const TSLexState {}_states[{}] = {{",
+            name,
+            state_entries.len()
+        );
+        indent!(self);
+        for (i, (state, row_id, range_index, range_count)) in state_entries.iter().enumerate() {
+            add_whitespace!(self);
+            add!(self, "[{}] = {{", i);
+            if let Some(accept_action) = state.accept_action {
+                add!(
+                    self,
+                    ".accept_symbol = {}, .accepts = true, ",
+                    self.symbol_ids[&accept_action]
+                );
+            }
+            if let Some(eof_action) = &state.eof_action {
+                add!(self, ".eof_action = {}, ", eof_action.state + 1);
+            }
+            add!(
+                self,
+                ".transitions = {}, .range_count = {}, .range_index = {}}},\n",
+                row_id,
+                range_count,
+                range_index
+            );
+        }
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(self, "static const TSLexTable {}_table = {{", name);
+        indent!(self);
+        add_line!(self, ".character_classes = {}_character_classes,", name);
+        add_line!(self, ".transitions = &{}_transitions[0][0],", name);
+        add_line!(self, ".class_count = {},", class_representatives.len());
+        add_line!(self, ".states = {}_states,", name);
+        add_line!(self, ".ranges = {}_ranges,", name);
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(
+            self,
+            "static bool {}(TSLexer *lexer, TSStateId state) {{",
+            name
+        );
+        indent!(self);
+        add_line!(
+            self,
+            "return ts_lex_table_run(&{}_table, lexer, state);",
+            name
+        );
+        dedent!(self);
+        add_line!(self, "}}");
+        add_line!(self, "");
+    }
+
     fn add_character_range_conditions(
         &mut self,
         ranges: &[Range<char>],
@@ -1614,6 +1873,67 @@ impl Generator {
     }
 }
 
+fn encode_lex_table_action(action: &AdvanceAction) -> u16 {
+    let result = action.state as u16 + 1;
+    if action.in_main_token {
+        result
+    } else {
+        result | LEX_TABLE_SKIP_FLAG
+    }
+}
+
+// Evaluate the condition generated by `add_character_range_conditions` for
+// a given lookahead value.
+fn evaluate_character_range_conditions(ranges: &[Range<char>], is_included: bool, c: i64) -> bool {
+    if ranges.is_empty() {
+        return true;
+    }
+    if is_included {
+        ranges
+            .iter()
+            .any(|range| range.start as i64 <= c && c <= range.end as i64)
+    } else {
+        ranges.iter().all(|range| {
+            let (start, end) = (range.start as i64, range.end as i64);
+            if end == start || end == start + 1 {
+                c != start && c != end
+            } else if range.start != '\0' {
+                c < start || end < c
+            } else {
+                c > end
+            }
+        })
+    }
+}
+
+// Evaluate the expression generated by `add_character_tree` for a given
+// lookahead value.
+fn evaluate_character_tree(tree: Option<&CharacterTree>, c: i64) -> bool {
+    match tree {
+        Some(CharacterTree::Compare {
+            value,
+            operator,
+            consequence,
+            alternative,
+        }) => {
+            let value = *value as i64;
+            let is_true = match operator {
+                Comparator::Less => c < value,
+                Comparator::LessOrEqual => c <= value,
+                Comparator::Equal => c == value,
+                Comparator::GreaterOrEqual => c >= value,
+            };
+            if is_true {
+                evaluate_character_tree(consequence.as_ref().map(Box::as_ref), c)
+            } else {
+                evaluate_character_tree(alternative.as_ref().map(Box::as_ref), c)
+            }
+        }
+        Some(CharacterTree::Yes) => true,
+        None => false,
+    }
+}
+
 /// Returns a String of C code for the given components of a parser.
 ///
 /// # Arguments
@@ -1632,6 +1952,8 @@ impl Generator {
 /// * `abi_version` - The language ABI version that should be generated. Usually
 ///    you want Tree-sitter's current version, but right after making an ABI
 ///    change, it may be useful to generate code with the previous ABI.
+/// * `use_lex_tables` - Whether to represent the lex functions as tables that
+///    are interpreted by the runtime, instead of as `switch` statements.
 pub(crate) fn render_c_code(
     name: &str,
     parse_table: ParseTable,
@@ -1642,6 +1964,7 @@ pub(crate) fn render_c_code(
     lexical_grammar: LexicalGrammar,
     default_aliases: AliasMap,
     abi_version: usize,
+    use_lex_tables: bool,
 ) -> String {
     if !(ABI_VERSION_MIN..=ABI_VERSION_MAX).contains(&abi_version) {
         panic!(
@@ -1668,6 +1991,7 @@ pub(crate) fn render_c_code(
         symbol_map: HashMap::new(),
         unique_aliases: Vec::new(),
         field_names: Vec::new(),
+        use_lex_tables,
         abi_version,
     }
     .generate()
@@ -2,7 +2,9 @@ use anyhow::{anyhow, Context, Result};
 use clap::{App, AppSettings, Arg, SubCommand};
 use glob::glob;
 use std::path::Path;
-use std::{env, fs, u64};
+use std::time::Instant;
+use std::{env, fs, io, u64};
+use tree_sitter::Parser;
 use tree_sitter_cli::{
     generate, highlight, logger, parse, playground, query, tags, test, test_highlight, test_tags,
     util, wasm,
@@ -112,7 +114,12 @@ fn run() -> Result<()> {
                         .value_name("rule-name")
                         .takes_value(true),
                 )
-                .arg(Arg::with_name("no-minimize").long("no-minimize")),
+                .arg(Arg::with_name("no-minimize").long("no-minimize"))
+                .arg(
+                    Arg::with_name("lex-tables")
+                        .long("lex-tables")
+                        .help("Generate lexers as tables that are interpreted at runtime"),
+                ),
         )
         .subcommand(
             SubCommand::with_name("parse")
@@ -137,6 +144,13 @@ fn run() -> Result<()> {
                         .long("timeout")
                         .takes_value(true),
                 )
+                .arg(
+                    Arg::with_name("jobs")
+                        .help("The number of files to parse in parallel")
+                        .long("jobs")
+                        .short("j")
+                        .takes_value(true),
+                )
                 .arg(&time_arg)
                 .arg(&quiet_arg)
                 .arg(
@@ -291,12 +305,14 @@ fn run() -> Result<()> {
                         }
                     });
             let generate_bindings = !matches.is_present("no-bindings");
+            let use_lex_tables = matches.is_present("lex-tables");
             generate::generate_parser_in_directory(
                 &current_dir,
                 grammar_path,
                 abi_version,
                 generate_bindings,
                 report_symbol_name,
+                use_lex_tables,
             )?;
         }
 
@@ -369,6 +385,17 @@ fn run() -> Result<()> {
                 .value_of("timeout")
                 .map_or(0, |t| u64::from_str_radix(t, 10).unwrap());
 
+            // Debugging output can't be attributed to a file when files are parsed in
+            // parallel.
+            let jobs = if debug || debug_graph {
+                1
+            } else {
+                matches
+                    .value_of("jobs")
+                    .map_or(1, |j| usize::from_str_radix(j, 10).unwrap())
+                    .max(1)
+            };
+
             let paths = collect_paths(matches.value_of("paths-file"), matches.values_of("paths"))?;
 
             let max_path_length = paths.iter().map(|p| p.chars().count()).max().unwrap_or(0);
@@ -379,33 +406,78 @@ fn run() -> Result<()> {
             let should_track_stats = matches.is_present("stat");
             let mut stats = parse::Stats::default();
 
-            for path in paths {
-                let path = Path::new(&path);
-                let language =
-                    loader.select_language(path, &current_dir, matches.value_of("scope"))?;
+            // The total time only covers parsing, not selecting or compiling languages.
+            if jobs > 1 {
+                // Compile the grammars for all of the files' types in parallel, before
+                // selecting the language for each file.
+                if matches.value_of("scope").is_none() {
+                    let paths = paths.iter().map(Path::new).collect::<Vec<_>>();
+                    loader.load_languages_for_file_names(&paths, jobs)?;
+                }
 
-                let this_file_errored = parse::parse_file_at_path(
-                    language,
-                    path,
+                let files = paths
+                    .iter()
+                    .map(|path| {
+                        let path = Path::new(path);
+                        let language = loader.select_language(
+                            path,
+                            &current_dir,
+                            matches.value_of("scope"),
+                        )?;
+                        Ok((path, language))
+                    })
+                    .collect::<Result<Vec<_>>>()?;
+
+                let start_time = Instant::now();
+                parse::parse_files_at_paths(
+                    &files,
                     &edits,
                     max_path_length,
                     quiet,
                     time,
                     timeout,
-                    debug,
-                    debug_graph,
                     debug_xml,
+                    jobs,
                     Some(&cancellation_flag),
+                    |path, result| {
+                        if should_track_stats {
+                            stats.add(path, result);
+                        }
+                        has_error |= result.has_error;
+                    },
                 )?;
-
-                if should_track_stats {
-                    stats.total_parses += 1;
-                    if !this_file_errored {
-                        stats.successful_parses += 1;
+                stats.total_duration = start_time.elapsed();
+            } else {
+                let mut parser = Parser::new();
+                for path in paths {
+                    let path = Path::new(&path);
+                    let language =
+                        loader.select_language(path, &current_dir, matches.value_of("scope"))?;
+
+                    let start_time = Instant::now();
+                    let result = parse::parse_file_at_path(
+                        &mut parser,
+                        language,
+                        path,
+                        &edits,
+                        max_path_length,
+                        quiet,
+                        time,
+                        timeout,
+                        debug,
+                        debug_graph,
+                        debug_xml,
+                        Some(&cancellation_flag),
+                        &mut io::stdout().lock(),
+                    )?;
+                    stats.total_duration += start_time.elapsed();
+
+                    if should_track_stats {
+                        stats.add(path, &result);
                     }
-                }
 
-                has_error |= this_file_errored;
+                    has_error |= result.has_error;
+                }
             }
 
             if should_track_stats {
@@ -2,9 +2,10 @@ use super::util;
 use anyhow::{anyhow, Context, Result};
 use std::io::{self, Write};
 use std::path::Path;
-use std::sync::atomic::AtomicUsize;
-use std::time::Instant;
-use std::{fmt, fs, usize};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::mpsc;
+use std::time::{Duration, Instant};
+use std::{fmt, fs, thread, usize};
 use tree_sitter::{InputEdit, Language, LogType, Parser, Point, Tree};
 
 #[derive(Debug)]
@@ -14,23 +15,175 @@ pub struct Edit {
     pub inserted_text: Vec<u8>,
 }
 
+#[derive(Debug)]
+pub struct ParseResult {
+    pub has_error: bool,
+    pub bytes: usize,
+    pub duration: Duration,
+}
+
 #[derive(Debug, Default)]
 pub struct Stats {
     pub successful_parses: usize,
     pub total_parses: usize,
+    pub total_bytes: usize,
+    pub total_duration: Duration,
+    pub parse_durations: Vec<(Duration, String)>,
+}
+
+const SLOWEST_FILE_COUNT: usize = 10;
+
+impl Stats {
+    pub fn add(&mut self, path: &Path, result: &ParseResult) {
+        self.total_parses += 1;
+        if !result.has_error {
+            self.successful_parses += 1;
+        }
+        self.total_bytes += result.bytes;
+        self.parse_durations
+            .push((result.duration, path.to_string_lossy().to_string()));
+    }
 }
 
 impl fmt::Display for Stats {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
-        return writeln!(f, "Total parses: {}; successful parses: {}; failed parses: {}; success percentage: {:.2}%",
+        writeln!(f, "Total parses: {}; successful parses: {}; failed parses: {}; success percentage: {:.2}%",
                  self.total_parses,
                  self.successful_parses,
                  self.total_parses - self.successful_parses,
-                 (self.successful_parses as f64) / (self.total_parses as f64) * 100.0);
+                 (self.successful_parses as f64) / (self.total_parses as f64) * 100.0)?;
+        if self.parse_durations.is_empty() {
+            return Ok(());
+        }
+
+        // The speed is measured against the elapsed time, so that it reflects the number
+        // of threads that parsed the files.
+        writeln!(
+            f,
+            "Total bytes: {}; total time: {} ms; speed: {} bytes/ms",
+            self.total_bytes,
+            self.total_duration.as_millis(),
+            self.total_bytes as u128 / (self.total_duration.as_millis() + 1)
+        )?;
+
+        let mut durations = self.parse_durations.iter().collect::<Vec<_>>();
+        durations.sort_unstable_by(|a, b| b.0.cmp(&a.0));
+        let percentile = |p: usize| {
+            let index = (durations.len() - 1) * (100 - p) / 100;
+            durations[index].0.as_secs_f64() * 1000.0
+        };
+        writeln!(
+            f,
+            "Parse time percentiles: p50: {:.2} ms; p90: {:.2} ms; p99: {:.2} ms; max: {:.2} ms",
+            percentile(50),
+            percentile(90),
+            percentile(99),
+            percentile(100)
+        )?;
+
+        writeln!(f, "Slowest files:")?;
+        let max_path_length = durations
+            .iter()
+            .take(SLOWEST_FILE_COUNT)
+            .map(|(_, path)| path.chars().count())
+            .max()
+            .unwrap_or(0);
+        for (duration, path) in durations.iter().take(SLOWEST_FILE_COUNT) {
+            writeln!(
+                f,
+                "  {:width$}\t{:.2} ms",
+                path,
+                duration.as_secs_f64() * 1000.0,
+                width = max_path_length
+            )?;
+        }
+        Ok(())
     }
 }
 
+/// Parse each of the given files on one of `jobs` threads, each of which reuses a single
+/// parser. The threads take the next unparsed file whenever they finish one, and the
+/// output for each file is printed in the order of the files.
+pub fn parse_files_at_paths(
+    files: &[(&Path, Language)],
+    edits: &Vec<&str>,
+    max_path_length: usize,
+    quiet: bool,
+    print_time: bool,
+    timeout: u64,
+    debug_xml: bool,
+    jobs: usize,
+    cancellation_flag: Option<&AtomicUsize>,
+    mut handle_result: impl FnMut(&Path, &ParseResult),
+) -> Result<()> {
+    let next_index = AtomicUsize::new(0);
+    let did_fail = AtomicBool::new(false);
+    thread::scope(|scope| {
+        let (sender, receiver) = mpsc::channel();
+        for _ in 0..jobs.min(files.len()) {
+            let sender = sender.clone();
+            let next_index = &next_index;
+            let did_fail = &did_fail;
+            scope.spawn(move || {
+                let mut parser = Parser::new();
+                loop {
+                    let index = next_index.fetch_add(1, Ordering::Relaxed);
+                    if index >= files.len() || did_fail.load(Ordering::Relaxed) {
+                        break;
+                    }
+                    let (path, language) = files[index];
+                    let mut output = Vec::new();
+                    let result = parse_file_at_path(
+                        &mut parser,
+                        language,
+                        path,
+                        edits,
+                        max_path_length,
+                        quiet,
+                        print_time,
+                        timeout,
+                        false,
+                        false,
+                        debug_xml,
+                        cancellation_flag,
+                        &mut output,
+                    );
+                    if sender.send((index, result, output)).is_err() {
+                        break;
+                    }
+                }
+            });
+        }
+        drop(sender);
+
+        // Buffer the results that finish early, until all of the results before them
+        // have been printed.
+        let stdout = io::stdout();
+        let mut results = files.iter().map(|_| None).collect::<Vec<_>>();
+        let mut next_result_index = 0;
+        for (index, result, output) in receiver {
+            results[index] = Some((result, output));
+            while let Some(Some((result, output))) =
+                results.get_mut(next_result_index).map(Option::take)
+            {
+                stdout.lock().write_all(&output)?;
+                let result = match result {
+                    Ok(result) => result,
+                    Err(error) => {
+                        did_fail.store(true, Ordering::Relaxed);
+                        return Err(error);
+                    }
+                };
+                handle_result(files[next_result_index].0, &result);
+                next_result_index += 1;
+            }
+        }
+        Ok(())
+    })
+}
+
 pub fn parse_file_at_path(
+    parser: &mut Parser,
     language: Language,
     path: &Path,
     edits: &Vec<&str>,
@@ -42,12 +195,25 @@ pub fn parse_file_at_path(
     debug_graph: bool,
     debug_xml: bool,
     cancellation_flag: Option<&AtomicUsize>,
-) -> Result<bool> {
+    stdout: &mut impl Write,
+) -> Result<ParseResult> {
     let mut _log_session = None;
-    let mut parser = Parser::new();
-    parser.set_language(language)?;
+
+    // A parser that prints debugging graphs holds a handle to the graph file, which must
+    // be closed before the log session ends, so that parser is not reused.
+    let mut graph_parser;
+    let parser = if debug_graph {
+        graph_parser = Parser::new();
+        &mut graph_parser
+    } else {
+        parser
+    };
+    if parser.language() != Some(language) {
+        parser.set_language(language)?;
+    }
     let mut source_code =
         fs::read(path).with_context(|| format!("Error reading source file {:?}", path))?;
+    let bytes = source_code.len();
 
     // If the `--cancel` flag was passed, then cancel the parse
     // when the user types a newline.
@@ -58,7 +224,7 @@ pub fn parse_file_at_path(
 
     // Render an HTML graph if `--debug-graph` was passed
     if debug_graph {
-        _log_session = Some(util::log_graphs(&mut parser, "log.html")?);
+        _log_session = Some(util::log_graphs(parser, "log.html")?);
     }
     // Log to stderr if `--debug` was passed
     else if debug {
@@ -73,12 +239,9 @@ pub fn parse_file_at_path(
     let time = Instant::now();
     let tree = parser.parse(&source_code, None);
 
-    let stdout = io::stdout();
-    let mut stdout = stdout.lock();
-
     if let Some(mut tree) = tree {
         if debug_graph && !edits.is_empty() {
-            println!("BEFORE:\n{}", String::from_utf8_lossy(&source_code));
+            writeln!(stdout, "BEFORE:\n{}", String::from_utf8_lossy(&source_code))?;
         }
 
         for (i, edit) in edits.iter().enumerate() {
@@ -87,7 +250,12 @@ pub fn parse_file_at_path(
             tree = parser.parse(&source_code, Some(&tree)).unwrap();
 
             if debug_graph {
-                println!("AFTER {}:\n{}", i, String::from_utf8_lossy(&source_code));
+                writeln!(
+                    stdout,
+                    "AFTER {}:\n{}",
+                    i,
+                    String::from_utf8_lossy(&source_code)
+                )?;
             }
         }
 
@@ -126,10 +294,10 @@ pub fn parse_file_at_path(
                         let start = node.start_position();
                         let end = node.end_position();
                         if let Some(field_name) = cursor.field_name() {
-                            write!(&mut stdout, "{}: ", field_name)?;
+                            write!(stdout, "{}: ", field_name)?;
                         }
                         write!(
-                            &mut stdout,
+                            stdout,
                             "({} [{}, {}] - [{}, {}]",
                             node.kind(),
                             start.row,
@@ -148,7 +316,7 @@ pub fn parse_file_at_path(
                 }
             }
             cursor.reset(tree.root_node());
-            println!("");
+            writeln!(stdout, "")?;
         }
 
         if debug_xml {
@@ -162,7 +330,7 @@ pub fn parse_file_at_path(
                 if did_visit_children {
                     if is_named {
                         let tag = tags.pop();
-                        write!(&mut stdout, "</{}>\n", tag.expect("there is a tag"))?;
+                        write!(stdout, "</{}>\n", tag.expect("there is a tag"))?;
                         needs_newline = true;
                     }
                     if cursor.goto_next_sibling() {
@@ -181,11 +349,11 @@ pub fn parse_file_at_path(
                         for _ in 0..indent_level {
                             stdout.write(b"  ")?;
                         }
-                        write!(&mut stdout, "<{}", node.kind())?;
+                        write!(stdout, "<{}", node.kind())?;
                         if let Some(field_name) = cursor.field_name() {
-                            write!(&mut stdout, " type=\"{}\"", field_name)?;
+                            write!(stdout, " type=\"{}\"", field_name)?;
                         }
-                        write!(&mut stdout, ">")?;
+                        write!(stdout, ">")?;
                         tags.push(node.kind());
                         needs_newline = true;
                     }
@@ -198,12 +366,12 @@ pub fn parse_file_at_path(
                         let end = node.end_byte();
                         let value =
                             std::str::from_utf8(&source_code[start..end]).expect("has a string");
-                        write!(&mut stdout, "{}", html_escape::encode_text(value))?;
+                        write!(stdout, "{}", html_escape::encode_text(value))?;
                     }
                 }
             }
             cursor.reset(tree.root_node());
-            println!("");
+            writeln!(stdout, "")?;
         }
 
         let mut first_error = None;
@@ -225,7 +393,7 @@ pub fn parse_file_at_path(
 
         if first_error.is_some() || print_time {
             write!(
-                &mut stdout,
+                stdout,
                 "{:width$}\t{} ms",
                 path.to_str().unwrap(),
                 duration_ms,
@@ -234,35 +402,41 @@ pub fn parse_file_at_path(
             if let Some(node) = first_error {
                 let start = node.start_position();
                 let end = node.end_position();
-                write!(&mut stdout, "\t(")?;
+                write!(stdout, "\t(")?;
                 if node.is_missing() {
                     if node.is_named() {
-                        write!(&mut stdout, "MISSING {}", node.kind())?;
+                        write!(stdout, "MISSING {}", node.kind())?;
                     } else {
-                        write!(
-                            &mut stdout,
-                            "MISSING \"{}\"",
-                            node.kind().replace("\n", "\\n")
-                        )?;
+                        write!(stdout, "MISSING \"{}\"", node.kind().replace("\n", "\\n"))?;
                     }
                 } else {
-                    write!(&mut stdout, "{}", node.kind())?;
+                    write!(stdout, "{}", node.kind())?;
                 }
                 write!(
-                    &mut stdout,
+                    stdout,
                     " [{}, {}] - [{}, {}])",
                     start.row, start.column, end.row, end.column
                 )?;
             }
-            write!(&mut stdout, "\n")?;
+            write!(stdout, "\n")?;
         }
 
-        return Ok(first_error.is_some());
-    } else if print_time {
-        let duration = time.elapsed();
+        return Ok(ParseResult {
+            has_error: first_error.is_some(),
+            bytes,
+            duration,
+        });
+    }
+
+    // The parse was halted by the timeout or the cancellation flag. Discard it, so that
+    // the next file isn't parsed as a continuation of this one.
+    parser.reset();
+
+    let duration = time.elapsed();
+    if print_time {
         let duration_ms = duration.as_secs() * 1000 + duration.subsec_nanos() as u64 / 1000000;
         writeln!(
-            &mut stdout,
+            stdout,
             "{:width$}\t{} ms (timed out)",
             path.to_str().unwrap(),
             duration_ms,
@@ -270,7 +444,11 @@ pub fn parse_file_at_path(
         )?;
     }
 
-    Ok(false)
+    Ok(ParseResult {
+        has_error: false,
+        bytes,
+        duration,
+    })
 }
 
 pub fn perform_edit(tree: &mut Tree, input: &mut Vec<u8>, edit: &Edit) -> InputEdit {
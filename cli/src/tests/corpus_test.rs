@@ -1,7 +1,7 @@
 use super::helpers::{
     allocations,
     edits::{get_random_edit, invert_edit},
-    fixtures::{fixtures_dir, get_language, get_test_language},
+    fixtures::{fixtures_dir, get_language, get_test_language, get_test_language_with_lex_tables},
     random::Rand,
     scope_sequence::ScopeSequence,
     EDIT_COUNT, EXAMPLE_FILTER, ITERATION_COUNT, LANGUAGE_FILTER, LOG_ENABLED, LOG_GRAPH_ENABLED,
@@ -286,6 +286,19 @@ fn test_feature_corpus_files() {
             let corpus_path = test_path.join("corpus.txt");
             let c_code = generate_result.unwrap().1;
             let language = get_test_language(language_name, &c_code, Some(&test_path));
+
+            // Every example must also parse the same way when the grammar's lexers
+            // are generated as tables instead of as code.
+            let lex_tables_c_code =
+                generate::generate_parser_for_grammar_with_lex_tables(&grammar_json, true)
+                    .unwrap()
+                    .1;
+            let lex_tables_language = get_test_language_with_lex_tables(
+                language_name,
+                &lex_tables_c_code,
+                Some(&test_path),
+            );
+
             let test = parse_tests(&corpus_path).unwrap();
             let tests = flatten_tests(test);
 
@@ -296,28 +309,30 @@ fn test_feature_corpus_files() {
             for (name, input, expected_output, has_fields) in tests {
                 eprintln!("  example: {:?}", name);
 
-                let passed = allocations::record(|| {
-                    let mut log_session = None;
-                    let mut parser = get_parser(&mut log_session, "log.html");
-                    parser.set_language(language).unwrap();
-                    let tree = parser.parse(&input, None).unwrap();
-                    let mut actual_output = tree.root_node().to_sexp();
-                    if !has_fields {
-                        actual_output = strip_sexp_fields(actual_output);
-                    }
-                    if actual_output == expected_output {
-                        true
-                    } else {
-                        print_diff_key();
-                        print_diff(&actual_output, &expected_output);
-                        println!("");
-                        false
+                for language in [language, lex_tables_language].iter() {
+                    let passed = allocations::record(|| {
+                        let mut log_session = None;
+                        let mut parser = get_parser(&mut log_session, "log.html");
+                        parser.set_language(*language).unwrap();
+                        let tree = parser.parse(&input, None).unwrap();
+                        let mut actual_output = tree.root_node().to_sexp();
+                        if !has_fields {
+                            actual_output = strip_sexp_fields(actual_output);
+                        }
+                        if actual_output == expected_output {
+                            true
+                        } else {
+                            print_diff_key();
+                            print_diff(&actual_output, &expected_output);
+                            println!("");
+                            false
+                        }
+                    });
+
+                    if !passed {
+                        failure_count += 1;
+                        break;
                     }
-                });
-
-                if !passed {
-                    failure_count += 1;
-                    continue;
                 }
             }
         }
@@ -10,6 +10,13 @@ include!("./dirs.rs");
 
 lazy_static! {
     static ref TEST_LOADER: Loader = Loader::with_parser_lib_path(SCRATCH_DIR.clone());
+    static ref LEX_TABLES_SCRATCH_DIR: PathBuf = {
+        let result = SCRATCH_DIR.join("lex-tables");
+        fs::create_dir_all(&result).unwrap();
+        result
+    };
+    static ref LEX_TABLES_TEST_LOADER: Loader =
+        Loader::with_parser_lib_path(LEX_TABLES_SCRATCH_DIR.clone());
 }
 
 pub fn test_loader<'a>() -> &'a Loader {
@@ -64,7 +71,34 @@ pub fn get_tags_config(language_name: &str) -> TagsConfiguration {
 }
 
 pub fn get_test_language(name: &str, parser_code: &str, path: Option<&Path>) -> Language {
-    let parser_c_path = SCRATCH_DIR.join(&format!("{}-parser.c", name));
+    load_test_language(&TEST_LOADER, &SCRATCH_DIR, name, parser_code, path)
+}
+
+// Languages whose lexers are generated as tables are compiled into their own
+// directory, so that they don't replace the libraries of the same name that
+// were generated with the default lex functions.
+pub fn get_test_language_with_lex_tables(
+    name: &str,
+    parser_code: &str,
+    path: Option<&Path>,
+) -> Language {
+    load_test_language(
+        &LEX_TABLES_TEST_LOADER,
+        &LEX_TABLES_SCRATCH_DIR,
+        name,
+        parser_code,
+        path,
+    )
+}
+
+fn load_test_language(
+    loader: &Loader,
+    scratch_dir: &Path,
+    name: &str,
+    parser_code: &str,
+    path: Option<&Path>,
+) -> Language {
+    let parser_c_path = scratch_dir.join(&format!("{}-parser.c", name));
     if !fs::read_to_string(&parser_c_path)
         .map(|content| content == parser_code)
         .unwrap_or(false)
@@ -79,7 +113,7 @@ pub fn get_test_language(name: &str, parser_code: &str, path: Option<&Path>) ->
             None
         }
     });
-    TEST_LOADER
+    loader
         .load_language_from_sources(name, &HEADER_DIR, &parser_c_path, &scanner_path)
         .unwrap()
 }
@@ -1,11 +1,13 @@
 use super::helpers::fixtures::{get_highlight_config, get_language, get_language_queries_path};
 use lazy_static::lazy_static;
 use std::ffi::CString;
-use std::os::raw::c_char;
+use std::os::raw::{c_char, c_void};
 use std::sync::atomic::{AtomicUsize, Ordering};
 use std::{fs, ptr, slice, str};
+use tree_sitter::{InputEdit, Point};
 use tree_sitter_highlight::{
-    c, Error, Highlight, HighlightConfiguration, HighlightEvent, Highlighter, HtmlRenderer,
+    c, Error, Highlight, HighlightConfiguration, HighlightEvent, HighlightSession, Highlighter,
+    HtmlRenderer,
 };
 
 lazy_static! {
@@ -480,6 +482,137 @@ fn test_highlighting_cancellation() {
     panic!("Expected an error while iterating highlighter");
 }
 
+#[test]
+fn test_highlighting_incrementally_in_a_session() {
+    let mut source = String::new();
+    for i in 0..20 {
+        source += &format!("<div class=\"item-{}\">\n  <p>Item {}</p>\n</div>\n", i, i);
+        if i % 5 == 0 {
+            source += "<script>\n  const x = document.getElementById('a');\n</script>\n";
+        }
+    }
+
+    let mut session = HighlightSession::new(&HTML_HIGHLIGHT, source.into_bytes());
+    let range = session
+        .highlight(None, &test_language_for_injection_string)
+        .unwrap();
+    assert_eq!(range, 0..session.source().len());
+
+    let edits: &[(&str, &str, &str)] = &[
+        // Change the text of an element.
+        ("<p>Item 7</p>", "Item 7", "Item seven"),
+        // Change the JavaScript in an injected layer.
+        ("const x", "getElementById", "querySelector"),
+        // Add an element.
+        ("<div class=\"item-12\">", "<div", "<span>new</span>\n<div"),
+        // Add a script, which adds a layer.
+        (
+            "<div class=\"item-16\">",
+            "<div",
+            "<script>let y = 1;</script>\n<div",
+        ),
+        // Remove a script, which removes a layer.
+        ("<script>let y", "<script>let y = 1;</script>\n", ""),
+        // Replace text that starts in an injected layer and ends after it.
+        (
+            "querySelector('a');\n</script>",
+            "('a');\n</scr",
+            "('b');\n</scr",
+        ),
+        // Replace text that starts before an injected layer and ends inside it.
+        (
+            "<script>\n  const x = document.getElementById('a')",
+            "<script>\n  const",
+            "<script>\n  let",
+        ),
+    ];
+    for (context, old_text, new_text) in edits {
+        let start = find(session.source(), context.as_bytes())
+            + find(context.as_bytes(), old_text.as_bytes());
+        let edit = input_edit(session.source(), start, old_text.len(), new_text.as_bytes());
+        session.edit(&edit, new_text.as_bytes());
+
+        let range = session
+            .highlight(None, &test_language_for_injection_string)
+            .unwrap();
+        assert!(range.start <= start && range.end >= start + new_text.len());
+        assert!(range.len() < session.source().len());
+
+        let src = str::from_utf8(session.source()).unwrap();
+        assert_eq!(
+            events_to_html(session.source(), session.events().iter().cloned().map(Ok)),
+            to_html(src, &HTML_HIGHLIGHT).unwrap(),
+            "after replacing {:?} with {:?}",
+            old_text,
+            new_text,
+        );
+    }
+
+    // Without any edits, nothing is highlighted again.
+    let range = session
+        .highlight(None, &test_language_for_injection_string)
+        .unwrap();
+    assert_eq!(range, 0..0);
+
+    // An injected layer's combined injections are parsed from all of their content nodes,
+    // even when only part of the layer is highlighted again. Here, the HTML in a macro is
+    // split by an EJS tag, and the end tag only matches the start tag before the split.
+    let rust_queries = get_language_queries_path("rust");
+    let mut rust_with_ejs = HighlightConfiguration::new(
+        get_language("rust"),
+        &fs::read_to_string(rust_queries.join("highlights.scm")).unwrap(),
+        r#"((macro_invocation (token_tree) @injection.content)
+            (#set! injection.language "ejs")
+            (#set! injection.include-children))"#,
+        "",
+    )
+    .unwrap();
+    rust_with_ejs.configure(&HIGHLIGHT_NAMES[..]);
+    let injection_callback = |name: &str| match name {
+        "ejs" => Some(&*EJS_HIGHLIGHT),
+        _ => test_language_for_injection_string(name),
+    };
+    let source = "ejs! {\n  <div>\n    <% a %>\n    <p>item</p>\n  </div>\n}\n";
+    let mut session = HighlightSession::new(&rust_with_ejs, source.as_bytes().to_vec());
+    session.highlight(None, injection_callback).unwrap();
+    let start = find(session.source(), b"item");
+    let old_text = "item</p>\n  </div>";
+    let new_text = "other</p>\n  </div>";
+    let edit = input_edit(session.source(), start, old_text.len(), new_text.as_bytes());
+    session.edit(&edit, new_text.as_bytes());
+    let range = session.highlight(None, injection_callback).unwrap();
+    assert!(range.start <= start && range.end >= start + new_text.len());
+    assert!(range.len() < session.source().len());
+    let mut highlighter = Highlighter::new();
+    let events = highlighter
+        .highlight(&rust_with_ejs, session.source(), None, injection_callback)
+        .unwrap();
+    assert_eq!(
+        events_to_html(session.source(), session.events().iter().cloned().map(Ok)),
+        events_to_html(session.source(), events),
+    );
+
+    // Local variables can be defined anywhere in a JavaScript document, so it is always
+    // highlighted in full.
+    let source = "function a(b) {\n  return b;\n}\nfunction c(d) {\n  return b;\n}\n";
+    let mut session = HighlightSession::new(&JS_HIGHLIGHT, source.as_bytes().to_vec());
+    session
+        .highlight(None, &test_language_for_injection_string)
+        .unwrap();
+    let start = find(session.source(), b"c(d)") + 2;
+    let edit = input_edit(session.source(), start, 1, b"b");
+    session.edit(&edit, b"b");
+    let range = session
+        .highlight(None, &test_language_for_injection_string)
+        .unwrap();
+    assert_eq!(range, 0..session.source().len());
+    let src = str::from_utf8(session.source()).unwrap();
+    assert_eq!(
+        events_to_html(session.source(), session.events().iter().cloned().map(Ok)),
+        to_html(src, &JS_HIGHLIGHT).unwrap(),
+    );
+}
+
 #[test]
 fn test_highlighting_via_c_api() {
     let highlights = vec![
@@ -583,10 +716,90 @@ fn test_highlighting_via_c_api() {
         ]
     );
 
+    // The lines can also be passed to a callback as soon as they are rendered.
+    extern "C" fn add_line(line: *const u8, length: u32, payload: *mut c_void) {
+        let lines = unsafe { &mut *(payload as *mut Vec<String>) };
+        let line = unsafe { slice::from_raw_parts(line, length as usize) };
+        lines.push(str::from_utf8(line).unwrap().to_string());
+    }
+    let mut streamed_lines = Vec::<String>::new();
+    c::ts_highlighter_highlight_lines(
+        highlighter,
+        html_scope.as_ptr(),
+        source_code.as_ptr(),
+        source_code.as_bytes().len() as u32,
+        buffer,
+        ptr::null_mut(),
+        Some(add_line),
+        &mut streamed_lines as *mut Vec<String> as *mut c_void,
+    );
+    assert_eq!(streamed_lines, lines);
+    assert_eq!(c::ts_highlight_buffer_len(buffer), 0);
+
+    // The callback is required.
+    let result = c::ts_highlighter_highlight_lines(
+        highlighter,
+        html_scope.as_ptr(),
+        source_code.as_ptr(),
+        source_code.as_bytes().len() as u32,
+        buffer,
+        ptr::null_mut(),
+        None,
+        ptr::null_mut(),
+    );
+    assert!(matches!(result, c::ErrorCode::MissingCallback));
+
     c::ts_highlighter_delete(highlighter);
     c::ts_highlight_buffer_delete(buffer);
 }
 
+#[test]
+fn test_highlighting_to_html_one_line_at_a_time() {
+    let source = "<div>\r\n<script>\nconst a = `b\nc`;\n</script>\n</div>";
+    let expected_lines = to_html(source, &HTML_HIGHLIGHT).unwrap();
+
+    let mut highlighter = Highlighter::new();
+    let mut renderer = HtmlRenderer::new();
+    let mut lines = Vec::new();
+    let events = highlighter
+        .highlight(
+            &HTML_HIGHLIGHT,
+            source.as_bytes(),
+            None,
+            &test_language_for_injection_string,
+        )
+        .unwrap();
+    renderer
+        .render_lines(
+            events,
+            source.as_bytes(),
+            &|highlight| HTML_ATTRS[highlight.0].as_bytes(),
+            |line| lines.push(line.to_string()),
+        )
+        .unwrap();
+    assert_eq!(lines, expected_lines);
+    assert_eq!(renderer.lines().collect::<Vec<_>>(), vec![""]);
+
+    let mut output = Vec::new();
+    let events = highlighter
+        .highlight(
+            &HTML_HIGHLIGHT,
+            source.as_bytes(),
+            None,
+            &test_language_for_injection_string,
+        )
+        .unwrap();
+    renderer
+        .render_to_writer(
+            events,
+            source.as_bytes(),
+            &|highlight| HTML_ATTRS[highlight.0].as_bytes(),
+            &mut output,
+        )
+        .unwrap();
+    assert_eq!(str::from_utf8(&output).unwrap(), expected_lines.concat());
+}
+
 #[test]
 fn test_decode_utf8_lossy() {
     use tree_sitter::LossyUtf8;
@@ -623,7 +836,6 @@ fn to_html<'a>(
     language_config: &'a HighlightConfiguration,
 ) -> Result<Vec<String>, Error> {
     let src = src.as_bytes();
-    let mut renderer = HtmlRenderer::new();
     let mut highlighter = Highlighter::new();
     let events = highlighter.highlight(
         language_config,
@@ -631,7 +843,14 @@ fn to_html<'a>(
         None,
         &test_language_for_injection_string,
     )?;
+    Ok(events_to_html(src, events))
+}
 
+fn events_to_html(
+    src: &[u8],
+    events: impl Iterator<Item = Result<HighlightEvent, Error>>,
+) -> Vec<String> {
+    let mut renderer = HtmlRenderer::new();
     renderer.set_carriage_return_highlight(
         HIGHLIGHT_NAMES
             .iter()
@@ -641,7 +860,37 @@ fn to_html<'a>(
     renderer
         .render(events, src, &|highlight| HTML_ATTRS[highlight.0].as_bytes())
         .unwrap();
-    Ok(renderer.lines().map(|s| s.to_string()).collect())
+    renderer.lines().map(|s| s.to_string()).collect()
+}
+
+fn find(haystack: &[u8], needle: &[u8]) -> usize {
+    haystack
+        .windows(needle.len())
+        .position(|window| window == needle)
+        .unwrap()
+}
+
+fn input_edit(src: &[u8], start: usize, deleted_length: usize, inserted_text: &[u8]) -> InputEdit {
+    let position = |src: &[u8], offset: usize| {
+        let row = src[0..offset].iter().filter(|c| **c == b'\n').count();
+        let line_start = src[0..offset]
+            .iter()
+            .rposition(|c| *c == b'\n')
+            .map_or(0, |i| i + 1);
+        Point::new(row, offset - line_start)
+    };
+    let old_end_byte = start + deleted_length;
+    let new_end_byte = start + inserted_text.len();
+    let mut new_src = src.to_vec();
+    new_src.splice(start..old_end_byte, inserted_text.iter().cloned());
+    InputEdit {
+        start_byte: start,
+        old_end_byte,
+        new_end_byte,
+        start_position: position(src, start),
+        old_end_position: position(src, old_end_byte),
+        new_end_position: position(&new_src, new_end_byte),
+    }
 }
 
 fn to_token_vector<'a>(
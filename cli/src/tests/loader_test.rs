@@ -0,0 +1,154 @@
+use crate::generate::generate_parser_for_grammar;
+use std::{
+    fs,
+    path::{Path, PathBuf},
+    thread,
+    time::{Duration, SystemTime},
+};
+use tree_sitter::Parser;
+use tree_sitter_loader::Loader;
+
+const GRAMMAR: &'static str = r#"{
+    "name": "loader_test",
+    "externals": [{"type": "SYMBOL", "name": "word"}],
+    "rules": {
+        "source": {
+            "type": "REPEAT",
+            "content": {"type": "SYMBOL", "name": "word"}
+        }
+    }
+}"#;
+
+// The external scanner recognizes words made of the character that is defined in a
+// header file, so changing the header changes the language.
+const SCANNER: &'static str = r#"
+#include <tree_sitter/parser.h>
+#include "word_char.h"
+
+void *tree_sitter_loader_test_external_scanner_create() { return NULL; }
+void tree_sitter_loader_test_external_scanner_destroy(void *payload) {}
+unsigned tree_sitter_loader_test_external_scanner_serialize(void *payload, char *buffer) { return 0; }
+void tree_sitter_loader_test_external_scanner_deserialize(void *payload, const char *buffer, unsigned length) {}
+
+bool tree_sitter_loader_test_external_scanner_scan(
+  void *payload,
+  TSLexer *lexer,
+  const bool *valid_symbols
+) {
+  while (lexer->lookahead == ' ') lexer->advance(lexer, true);
+  if (lexer->lookahead != WORD_CHAR) return false;
+  while (lexer->lookahead == WORD_CHAR) lexer->advance(lexer, false);
+  lexer->result_symbol = 0;
+  return true;
+}
+"#;
+
+#[test]
+fn test_loader_reuses_and_replaces_compiled_libraries() {
+    let library_dir = tempfile::tempdir().unwrap();
+    let digests_dir = tempfile::tempdir().unwrap();
+    let digests_path = digests_dir.path().join("source-digests.json");
+    let grammar_dir = tempfile::tempdir().unwrap();
+    let src_dir = grammar_dir.path().join("src");
+    fs::create_dir_all(src_dir.join("tree_sitter")).unwrap();
+    let (_, parser_code) = generate_parser_for_grammar(GRAMMAR).unwrap();
+    fs::write(src_dir.join("grammar.json"), GRAMMAR).unwrap();
+    fs::write(src_dir.join("parser.c"), parser_code).unwrap();
+    fs::write(src_dir.join("scanner.c"), SCANNER).unwrap();
+    fs::write(src_dir.join("word_char.h"), "#define WORD_CHAR 'a'\n").unwrap();
+    fs::copy(
+        Path::new(env!("CARGO_MANIFEST_DIR"))
+            .parent()
+            .unwrap()
+            .join("lib/include/tree_sitter/parser.h"),
+        src_dir.join("tree_sitter/parser.h"),
+    )
+    .unwrap();
+
+    // A library named after the grammar alone, by an earlier version of the loader.
+    let legacy_library_path = library_dir
+        .path()
+        .join(format!("loader_test.{}", dylib_extension()));
+    fs::write(&legacy_library_path, "").unwrap();
+
+    // The loader doesn't store the digests of files that have just changed.
+    thread::sleep(Duration::from_secs(2));
+
+    let new_loader =
+        || Loader::with_paths(library_dir.path().to_owned(), Some(digests_path.clone()));
+    let parse = |loader: &Loader, source: &str| {
+        let mut parser = Parser::new();
+        parser
+            .set_language(loader.load_language_at_path(&src_dir, &src_dir).unwrap())
+            .unwrap();
+        parser.parse(source, None).unwrap().root_node().to_sexp()
+    };
+
+    // The first load compiles the grammar, and removes the legacy library.
+    assert_eq!(parse(&new_loader(), "aa a"), "(source (word) (word))");
+    let libraries = compiled_libraries(library_dir.path());
+    assert_eq!(libraries.len(), 1);
+    assert!(!legacy_library_path.exists());
+
+    // Loading the unchanged grammar again reuses the compiled library. By now, the
+    // digests of its source files have been stored.
+    assert_eq!(parse(&new_loader(), "aa a"), "(source (word) (word))");
+    assert_eq!(compiled_libraries(library_dir.path()), libraries);
+    assert!(digests_path.exists());
+
+    // Changing a header that the scanner includes causes the grammar to be compiled
+    // again. On Unix, this is true even if its size and modification time stay the
+    // same.
+    let header_path = src_dir.join("word_char.h");
+    #[cfg(unix)]
+    {
+        let modified = fs::metadata(&header_path).unwrap().modified().unwrap();
+        fs::write(&header_path, "#define WORD_CHAR 'b'\n").unwrap();
+        fs::File::options()
+            .write(true)
+            .open(&header_path)
+            .unwrap()
+            .set_modified(modified)
+            .unwrap();
+        assert_eq!(parse(&new_loader(), "bb b"), "(source (word) (word))");
+        assert_eq!(compiled_libraries(library_dir.path()).len(), 2);
+    }
+
+    let library_count = compiled_libraries(library_dir.path()).len();
+    fs::write(&header_path, "#define WORD_CHAR 'c' // changed\n").unwrap();
+    assert_eq!(parse(&new_loader(), "cc c"), "(source (word) (word))");
+    assert_eq!(
+        compiled_libraries(library_dir.path()).len(),
+        library_count + 1
+    );
+
+    // Only the most recently compiled libraries are kept.
+    for i in 0..4 {
+        let header = format!("#define WORD_CHAR 'b' // {}\n", "changed ".repeat(i + 2));
+        fs::write(src_dir.join("word_char.h"), header).unwrap();
+        assert_eq!(parse(&new_loader(), "bb b"), "(source (word) (word))");
+    }
+    assert_eq!(compiled_libraries(library_dir.path()).len(), 4);
+}
+
+fn compiled_libraries(dir: &Path) -> Vec<(PathBuf, SystemTime)> {
+    let mut result = fs::read_dir(dir)
+        .unwrap()
+        .map(|entry| entry.unwrap())
+        .filter(|entry| {
+            let file_name = entry.file_name().to_string_lossy().to_string();
+            file_name.starts_with("loader_test-") && file_name.ends_with(dylib_extension())
+        })
+        .map(|entry| (entry.path(), entry.metadata().unwrap().modified().unwrap()))
+        .collect::<Vec<_>>();
+    result.sort_unstable();
+    result
+}
+
+fn dylib_extension() -> &'static str {
+    if cfg!(windows) {
+        "dll"
+    } else {
+        "so"
+    }
+}
@@ -1,6 +1,7 @@
 mod corpus_test;
 mod helpers;
 mod highlight_test;
+mod loader_test;
 mod node_test;
 mod parser_test;
 mod pathological_test;
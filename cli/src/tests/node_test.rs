@@ -4,7 +4,7 @@ use super::helpers::random::Rand;
 use crate::generate::generate_parser_for_grammar;
 use crate::parse::perform_edit;
 use std::fs;
-use tree_sitter::{Node, Parser, Point, Tree};
+use tree_sitter::{InputEdit, Node, Parser, Point, Tree};
 
 const JSON_EXAMPLE: &'static str = r#"
 
@@ -248,6 +248,45 @@ fn test_node_parent_of_child_by_field_name() {
     );
 }
 
+#[test]
+fn test_node_parent_with_parent_index() {
+    let mut parser = Parser::new();
+    parser.set_language(get_language("javascript")).unwrap();
+    let mut tree = parser
+        .parse("function f(a, b) { return a.b(c, [d, e]) + g; }", None)
+        .unwrap();
+
+    let parent_ranges = |tree: &Tree| {
+        get_all_nodes(tree)
+            .into_iter()
+            .map(|node| node.parent().map(|parent| parent.byte_range()))
+            .collect::<Vec<_>>()
+    };
+
+    let expected_ranges = parent_ranges(&tree);
+    assert_eq!(tree.parent_index_memory_usage(), 0);
+    tree.build_parent_index();
+    assert!(tree.parent_index_memory_usage() > 0);
+    assert_eq!(parent_ranges(&tree), expected_ranges);
+
+    // After an edit, the index is discarded and rebuilt on demand.
+    tree.edit(&InputEdit {
+        start_byte: 0,
+        old_end_byte: 0,
+        new_end_byte: 1,
+        start_position: Point::new(0, 0),
+        old_end_position: Point::new(0, 0),
+        new_end_position: Point::new(0, 1),
+    });
+    assert_eq!(tree.parent_index_memory_usage(), 0);
+    let expected_ranges = expected_ranges
+        .into_iter()
+        .map(|range| range.map(|r| r.start + 1..r.end + 1))
+        .collect::<Vec<_>>();
+    assert_eq!(parent_ranges(&tree), expected_ranges);
+    assert!(tree.parent_index_memory_usage() > 0);
+}
+
 #[test]
 fn test_node_field_name_for_child() {
     let mut parser = Parser::new();
@@ -385,6 +424,45 @@ fn test_node_named_child_with_aliases_and_extras() {
     assert_eq!(root.named_child(4).unwrap().kind(), "C");
 }
 
+#[test]
+fn test_node_child_with_many_children() {
+    let (parser_name, parser_code) =
+        generate_parser_for_grammar(GRAMMAR_WITH_ALIASES_AND_EXTRAS).unwrap();
+
+    let mut parser = Parser::new();
+    parser
+        .set_language(get_test_language(&parser_name, &parser_code, None))
+        .unwrap();
+
+    // Extras are stored directly in the root node, so that node has enough
+    // children to be given a child index.
+    let source = format!("b {}b {}c", "... ".repeat(40), "... ".repeat(20));
+    let tree = parser.parse(&source, None).unwrap();
+    let root = tree.root_node();
+    assert_eq!(root.child_count(), 63);
+
+    let children = root.children(&mut tree.walk()).collect::<Vec<_>>();
+    let named_children = children
+        .iter()
+        .filter(|child| child.is_named())
+        .collect::<Vec<_>>();
+    for (i, child) in children.iter().enumerate() {
+        assert_eq!(root.child(i).as_ref(), Some(child));
+        assert_eq!(
+            root.child(i).unwrap().start_position(),
+            child.start_position()
+        );
+    }
+    for (i, child) in named_children.iter().enumerate() {
+        assert_eq!(root.named_child(i).as_ref(), Some(*child));
+    }
+    assert_eq!(root.child(children.len()), None);
+    assert_eq!(root.named_child(named_children.len()), None);
+    assert_eq!(root.child(2).unwrap().kind(), "comment");
+    assert_eq!(root.named_child(41).unwrap().kind(), "B");
+    assert_eq!(root.named_child(62).unwrap().kind(), "C");
+}
+
 #[test]
 fn test_node_descendant_for_range() {
     let tree = parse_json_example();
@@ -6,9 +6,11 @@ use super::helpers::{
 };
 use crate::{
     generate::generate_parser_for_grammar,
-    parse::{perform_edit, Edit},
+    parse::{parse_file_at_path, perform_edit, Edit},
 };
 use std::{
+    fs,
+    path::Path,
     sync::atomic::{AtomicUsize, Ordering},
     thread, time,
 };
@@ -635,6 +637,66 @@ fn test_parsing_cancelled_by_another_thread() {
     assert!(tree.is_none());
 }
 
+#[test]
+fn test_parsing_in_parallel() {
+    // Repeat this source file so that it is split into several chunks.
+    let source = include_str!("parser_test.rs").repeat(4);
+
+    let mut parser = Parser::new();
+    parser.set_language(get_language("rust")).unwrap();
+    let tree = parser.parse(&source, None).unwrap();
+
+    let new_tree = parser.parse_parallel(&source, None, 4).unwrap();
+    assert_eq!(new_tree.root_node().to_sexp(), tree.root_node().to_sexp());
+    assert_eq!(
+        new_tree.root_node().end_position(),
+        tree.root_node().end_position()
+    );
+
+    // Use the old tree to split the source at the boundaries between items.
+    let new_tree = parser.parse_parallel(&source, Some(&tree), 4).unwrap();
+    assert_eq!(new_tree.root_node().to_sexp(), tree.root_node().to_sexp());
+}
+
+#[test]
+fn test_parsing_with_chunks_split_in_the_middle_of_tokens() {
+    let source = "let x = \"one two\";\nlet y = [1, 2, 3];\nlet z = x + y;\n";
+
+    let mut parser = Parser::new();
+    parser.set_language(get_language("javascript")).unwrap();
+    let tree = parser.parse(source, None).unwrap();
+
+    // Split the source inside of a string and inside of an array.
+    let point = |offset: usize| {
+        let row = source[..offset].matches('\n').count();
+        let column = offset - source[..offset].rfind('\n').map_or(0, |i| i + 1);
+        Point::new(row, column)
+    };
+    let chunks = [0, 12, 29, source.len()]
+        .windows(2)
+        .map(|bounds| {
+            let (start, end) = (bounds[0], bounds[1]);
+            parser
+                .set_included_ranges(&[Range {
+                    start_byte: start,
+                    end_byte: end,
+                    start_point: point(start),
+                    end_point: point(end),
+                }])
+                .unwrap();
+            parser.parse(source, None).unwrap()
+        })
+        .collect::<Vec<_>>();
+    parser.set_included_ranges(&[]).unwrap();
+
+    let new_tree = parser.parse_with_chunks(source, &chunks).unwrap();
+    assert_eq!(new_tree.root_node().to_sexp(), tree.root_node().to_sexp());
+    assert_eq!(
+        new_tree.root_node().end_position(),
+        tree.root_node().end_position()
+    );
+}
+
 // Timeouts
 
 #[test]
@@ -782,6 +844,54 @@ fn test_parsing_with_a_timeout_and_implicit_reset() {
     });
 }
 
+#[test]
+fn test_parsing_files_with_a_timeout() {
+    let dir = tempfile::tempdir().unwrap();
+    let slow_path = dir.path().join("slow.json");
+    let fast_path = dir.path().join("fast.json");
+    fs::write(
+        &slow_path,
+        "[\"ok\", 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32]",
+    )
+    .unwrap();
+    fs::write(
+        &fast_path,
+        "[null, 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32]",
+    )
+    .unwrap();
+
+    // The same parser is reused for each file, as it is by `tree-sitter parse`.
+    let mut parser = Parser::new();
+    let mut parse_file = |path: &Path, timeout: u64| {
+        let mut output = Vec::new();
+        parse_file_at_path(
+            &mut parser,
+            get_language("json"),
+            path,
+            &Vec::new(),
+            0,
+            false,
+            false,
+            timeout,
+            false,
+            false,
+            false,
+            None,
+            &mut output,
+        )
+        .unwrap();
+        String::from_utf8(output).unwrap()
+    };
+
+    assert_eq!(parse_file(&slow_path, 5), "");
+
+    // The halted parse of the first file is discarded, rather than being resumed
+    // with the contents of the second file.
+    let output = parse_file(&fast_path, 0);
+    assert!(output.contains("(null [0, 1] - [0, 5])"));
+    assert!(!output.contains("(string"));
+}
+
 #[test]
 fn test_parsing_with_timeout_and_no_completion() {
     allocations::record(|| {
@@ -799,6 +909,174 @@ fn test_parsing_with_timeout_and_no_completion() {
     });
 }
 
+// Arena allocation
+
+#[test]
+fn test_parsing_with_arena_allocation() {
+    allocations::record(|| {
+        let mut parser = Parser::new();
+        parser.set_language(get_language("javascript")).unwrap();
+        assert!(!parser.arena_allocation());
+        parser.set_arena_allocation(true);
+        assert!(parser.arena_allocation());
+
+        let mut code = b"123 + 456 * (10 + x);".to_vec();
+        let mut tree = parser.parse(&code, None).unwrap();
+        let tree_copy = tree.clone();
+
+        perform_edit(
+            &mut tree,
+            &mut code,
+            &Edit {
+                position: 3,
+                deleted_length: 0,
+                inserted_text: b" || 5".to_vec(),
+            },
+        );
+
+        // The new tree shares nodes with the old tree, so it must remain valid
+        // after both the old tree and its copy have been dropped.
+        let new_tree = parser.parse(&code, Some(&tree)).unwrap();
+        drop(tree);
+        drop(tree_copy);
+
+        parser.set_arena_allocation(false);
+        let expected_tree = parser.parse(&code, None).unwrap();
+        assert_eq!(
+            new_tree.root_node().to_sexp(),
+            expected_tree.root_node().to_sexp()
+        );
+
+        // Editing an arena-allocated tree after the parser has stopped using
+        // arenas must not mutate the arena's nodes in place.
+        let mut tree = new_tree;
+        perform_edit(
+            &mut tree,
+            &mut code,
+            &Edit {
+                position: 0,
+                deleted_length: 4,
+                inserted_text: Vec::new(),
+            },
+        );
+        let tree = parser.parse(&code, Some(&tree)).unwrap();
+        assert_eq!(
+            tree.root_node().to_sexp(),
+            parser.parse(&code, None).unwrap().root_node().to_sexp()
+        );
+    });
+}
+
+// Single-threaded mode
+
+#[test]
+fn test_parsing_in_single_threaded_mode() {
+    allocations::record(|| {
+        let mut parser = Parser::new();
+        parser.set_language(get_language("javascript")).unwrap();
+        assert!(!parser.single_threaded());
+        unsafe { parser.set_single_threaded(true) };
+        assert!(parser.single_threaded());
+
+        let mut code = b"let x = [1, 2, 3].map(n => n * 2);".to_vec();
+        let mut tree = parser.parse(&code, None).unwrap();
+        perform_edit(
+            &mut tree,
+            &mut code,
+            &Edit {
+                position: 10,
+                deleted_length: 0,
+                inserted_text: b"0".to_vec(),
+            },
+        );
+        let new_tree = parser.parse(&code, Some(&tree)).unwrap();
+        drop(tree);
+
+        // A copy of a tree can be used on another thread, even though the
+        // tree shares nodes with trees that were built in single-threaded mode.
+        let tree_copy = new_tree.clone();
+        let sexp = thread::spawn(move || tree_copy.root_node().to_sexp())
+            .join()
+            .unwrap();
+        drop(new_tree);
+
+        unsafe { parser.set_single_threaded(false) };
+        let expected_tree = parser.parse(&code, None).unwrap();
+        assert_eq!(sexp, expected_tree.root_node().to_sexp());
+    });
+}
+
+// Token cache
+
+#[test]
+fn test_parsing_token_cache_stats() {
+    let mut parser = Parser::new();
+    parser.set_language(get_language("javascript")).unwrap();
+    let stats = parser.stats();
+    assert_eq!(stats.token_cache_hit_count, 0);
+    assert_eq!(stats.token_cache_miss_count, 0);
+
+    // Parenthesized expressions and arrow function parameters are ambiguous
+    // until the `=>`, so several stack versions lex the same tokens.
+    let code = "let f = (a, b, [c, d]) => a + b;\nlet g = (a, b, [c, d]) + e;";
+    parser.parse(code, None).unwrap();
+    let stats = parser.stats();
+    assert!(stats.token_cache_hit_count > 0);
+    assert!(stats.token_cache_miss_count > 0);
+
+    // The counts are reset for each parse.
+    parser.parse(code, None).unwrap();
+    assert_eq!(
+        parser.stats().token_cache_hit_count,
+        stats.token_cache_hit_count
+    );
+    assert_eq!(
+        parser.stats().token_cache_miss_count,
+        stats.token_cache_miss_count
+    );
+}
+
+// Parser stats
+
+#[test]
+fn test_parsing_stats() {
+    let mut parser = Parser::new();
+    parser.set_language(get_language("javascript")).unwrap();
+
+    let mut code = b"let f = (a, b, [c, d]) => a + b;\nlet g = (a, b, [c, d]) + e;".to_vec();
+    let mut tree = parser.parse(&code, None).unwrap();
+    let stats = parser.stats();
+    assert_eq!(stats.reused_node_count, 0);
+    assert!(stats.created_node_count > 0);
+    assert!(stats.reduction_count > 0);
+    assert!(stats.max_version_count > 1);
+    assert!(stats.total_version_count >= stats.condense_stack_count);
+    assert!(stats.lexed_byte_count >= code.len() as u64);
+    assert_eq!(stats.error_recovery_count, 0);
+    assert_eq!(stats.error_cost, 0);
+
+    // After a small edit, most of the old tree is reused.
+    perform_edit(
+        &mut tree,
+        &mut code,
+        &Edit {
+            position: 4,
+            deleted_length: 1,
+            inserted_text: b"h".to_vec(),
+        },
+    );
+    parser.parse(&code, Some(&tree)).unwrap();
+    let reparse_stats = parser.stats();
+    assert!(reparse_stats.reused_node_count > 0);
+    assert!(reparse_stats.lexed_byte_count < stats.lexed_byte_count);
+
+    // Syntax errors are counted.
+    parser.parse("let f = (a, b;", None).unwrap();
+    let error_stats = parser.stats();
+    assert!(error_stats.error_recovery_count > 0);
+    assert!(error_stats.error_cost > 0);
+}
+
 // Included Ranges
 
 #[test]
@@ -1,14 +1,17 @@
 use super::helpers::{
     allocations,
+    edits::get_random_edit,
     fixtures::get_language,
     query_helpers::{Match, Pattern},
+    random::Rand,
 };
+use crate::parse::perform_edit;
 use lazy_static::lazy_static;
 use rand::{prelude::StdRng, SeedableRng};
 use std::{env, fmt::Write};
 use tree_sitter::{
     CaptureQuantifier, Language, Node, Parser, Point, Query, QueryCapture, QueryCursor, QueryError,
-    QueryErrorKind, QueryMatch, QueryPredicate, QueryPredicateArg, QueryProperty,
+    QueryErrorKind, QueryMatch, QueryMatchCache, QueryPredicate, QueryPredicateArg, QueryProperty,
 };
 
 lazy_static! {
@@ -2736,6 +2739,168 @@ fn test_query_captures_with_text_conditions() {
     });
 }
 
+#[test]
+fn test_query_captures_with_any_of_conditions() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let query = Query::new(
+            language,
+            r#"
+            ((identifier) @animal
+             (#any-of? @animal "toad" "panda"))
+
+            ((identifier) @variable
+             (#not-any-of? @variable "toad" "panda" "require"))
+
+            ((identifier) @numbered
+             (#match? @numbered "\\d"))
+            "#,
+        )
+        .unwrap();
+
+        let source = "
+          toad;
+          panda;
+          x1;
+          require('./ab');
+          y;
+        ";
+
+        let mut parser = Parser::new();
+        parser.set_language(language).unwrap();
+        let tree = parser.parse(&source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+
+        let captures = cursor.captures(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_captures(captures, &query, source),
+            &[
+                ("animal", "toad"),
+                ("animal", "panda"),
+                ("variable", "x1"),
+                ("numbered", "x1"),
+                ("variable", "y"),
+            ],
+        );
+
+        let matches = cursor.matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[
+                (0, vec![("animal", "toad")]),
+                (0, vec![("animal", "panda")]),
+                (1, vec![("variable", "x1")]),
+                (2, vec![("numbered", "x1")]),
+                (1, vec![("variable", "y")]),
+            ],
+        );
+    });
+}
+
+#[test]
+fn test_query_captures_with_built_in_match_conditions() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let identifiers =
+            "a abc abcabc ab_c Abc aBC _ $x x1 x12 xyz café über naïve 日本語 日本 Δx ñ"
+                .split(' ')
+                .collect::<Vec<_>>();
+        let source = identifiers
+            .iter()
+            .map(|identifier| format!("{};\n", identifier))
+            .collect::<String>();
+
+        let mut parser = Parser::new();
+        parser.set_language(language).unwrap();
+        let tree = parser.parse(&source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+
+        // The query cursor's own regex engine must agree with the `regex` crate,
+        // which the binding falls back to for the patterns that it can't handle.
+        for pattern in &[
+            "^a",
+            "c$",
+            "^abc$",
+            r"\Aa",
+            r"c\z",
+            "[a-c]",
+            "^[^a-z]",
+            "^[A-Z]",
+            "[_$]",
+            "[^a-z_$0-9]",
+            r"[\]\-]",
+            "abc|xyz",
+            "^(abc|ab_c)$",
+            "^(ab|c)+$",
+            "^(abc){2}$",
+            "^x[0-9]{1,2}$",
+            "^x[0-9]{2,}$",
+            "^a.?c$",
+            "^a.*?c$",
+            "^ab*$",
+            "^a.+",
+            "é",
+            "^[à-ÿ]",
+            "^.$",
+            "^...$",
+            "^日本",
+            "語$",
+            r"^[Δ-Ω]x",
+            r"^\x{394}",
+            "^(café|über)$",
+            "^na.ve$",
+        ] {
+            let escaped_pattern = pattern.replace('\\', "\\\\");
+            let query = Query::new(
+                language,
+                &format!(
+                    r#"
+                    ((identifier) @match (#match? @match "{0}"))
+                    ((identifier) @no-match (#not-match? @no-match "{0}"))
+                    "#,
+                    escaped_pattern
+                ),
+            )
+            .unwrap();
+            assert!(query.is_predicate_built_in(0, 0), "{}", pattern);
+            assert!(query.is_predicate_built_in(1, 0), "{}", pattern);
+
+            let regex = regex::bytes::Regex::new(pattern).unwrap();
+            let expected = identifiers
+                .iter()
+                .map(|identifier| {
+                    if regex.is_match(identifier.as_bytes()) {
+                        ("match", *identifier)
+                    } else {
+                        ("no-match", *identifier)
+                    }
+                })
+                .collect::<Vec<_>>();
+
+            let captures = cursor.captures(&query, tree.root_node(), source.as_bytes());
+            assert_eq!(
+                collect_captures(captures, &query, &source),
+                expected,
+                "{}",
+                pattern
+            );
+        }
+
+        // Patterns that use other syntax are evaluated by the binding.
+        let query = Query::new(
+            language,
+            r#"((identifier) @match (#match? @match "^\\w\\d+$"))"#,
+        )
+        .unwrap();
+        assert!(!query.is_predicate_built_in(0, 0));
+        let captures = cursor.captures(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_captures(captures, &query, &source),
+            &[("match", "x1"), ("match", "x12")]
+        );
+    });
+}
+
 #[test]
 fn test_query_captures_with_predicates() {
     allocations::record(|| {
@@ -3583,6 +3748,233 @@ fn test_query_disable_pattern() {
     });
 }
 
+#[test]
+fn test_query_disable_pattern_with_wildcard_root() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let mut query = Query::new(
+            language,
+            "
+                (_) @any
+                (number) @number
+                (string) @string
+            ",
+        )
+        .unwrap();
+
+        query.disable_pattern(0);
+
+        let source = "f(1, 'two');";
+        let mut parser = Parser::new();
+        parser.set_language(language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+        let matches = cursor.matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[(1, vec![("number", "1")]), (2, vec![("string", "'two'")]),],
+        );
+    });
+}
+
+#[test]
+fn test_query_combine() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let sources = [
+            "(function_declaration name: (identifier) @name)",
+            "
+            (class_declaration name: (identifier) @name)
+            ((identifier) @constant (#match? @constant \"^[A-Z]+$\"))
+            ",
+            "(number) @number",
+        ];
+        let queries = sources
+            .iter()
+            .map(|source| Query::new(language, source).unwrap())
+            .collect::<Vec<_>>();
+        let query = Query::combine(&queries.iter().collect::<Vec<_>>()).unwrap();
+        drop(queries);
+
+        let concatenated_query = Query::new(language, &sources.concat()).unwrap();
+        assert_eq!(query.pattern_count(), concatenated_query.pattern_count());
+        assert_eq!(query.capture_names(), concatenated_query.capture_names());
+        assert_eq!(
+            (0..query.pattern_count())
+                .map(|i| query.query_index_for_pattern(i))
+                .collect::<Vec<_>>(),
+            &[0, 1, 1, 2]
+        );
+
+        // Byte offsets refer to the concatenated sources.
+        let concatenated_source = sources.concat();
+        for i in 0..query.pattern_count() {
+            assert_eq!(
+                query.start_byte_for_pattern(i),
+                concatenated_query.start_byte_for_pattern(i)
+            );
+        }
+        for offset in 0..concatenated_source.len() {
+            assert_eq!(
+                query.is_pattern_guaranteed_at_step(offset),
+                concatenated_query.is_pattern_guaranteed_at_step(offset),
+            );
+        }
+        let offset = concatenated_source.find("(identifier) @name)").unwrap();
+        assert!(query.is_pattern_guaranteed_at_step(offset));
+
+        let source = "class A {} function b() { return C + 1; }";
+        let mut parser = Parser::new();
+        parser.set_language(language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+        let expected_matches = collect_matches(
+            cursor.matches(&concatenated_query, tree.root_node(), source.as_bytes()),
+            &concatenated_query,
+            source,
+        );
+        let matches = collect_matches(
+            cursor.matches(&query, tree.root_node(), source.as_bytes()),
+            &query,
+            source,
+        );
+        assert_eq!(matches, expected_matches);
+        assert_eq!(matches.len(), 5);
+        assert!(matches.contains(&(2, vec![("constant", "C")])));
+        assert!(!matches.contains(&(2, vec![("constant", "b")])));
+
+        let rust_query = Query::new(get_language("rust"), "(identifier) @id").unwrap();
+        assert!(Query::combine(&[&concatenated_query, &rust_query]).is_none());
+        assert!(Query::combine(&[]).is_none());
+    });
+}
+
+#[test]
+fn test_query_matches_in_parallel() {
+    let language = get_language("javascript");
+    let query = Query::new(
+        language,
+        r#"
+        (function_declaration name: (identifier) @name)
+        ((identifier) @constant (#match? @constant "^[A-Z_][A-Z_0-9]*$"))
+        ((comment)+ @comments . (class_declaration) @class)
+        (program (expression_statement) @first . (expression_statement) @second)
+        "#,
+    )
+    .unwrap();
+
+    // Repeat this source so that the tree is split into several ranges.
+    let source = (0..2000)
+        .map(|i| {
+            format!(
+                "// A comment\n// Another comment\nclass C{0} {{}}\nfunction f{0}() {{ return N_{0} + {0}; }}\nx{0};\ny{0};\n",
+                i
+            )
+        })
+        .collect::<String>();
+
+    let mut parser = Parser::new();
+    parser.set_language(language).unwrap();
+    let tree = parser.parse(&source, None).unwrap();
+
+    let mut cursor = QueryCursor::new();
+    let mut expected_matches = cursor
+        .matches(&query, tree.root_node(), source.as_bytes())
+        .map(|m| {
+            (
+                m.captures
+                    .iter()
+                    .map(|c| c.node.start_byte())
+                    .min()
+                    .unwrap(),
+                m.pattern_index,
+                format_captures(m.captures.iter().cloned(), &query, &source),
+            )
+        })
+        .collect::<Vec<_>>();
+    expected_matches.sort_by_key(|m| (m.0, m.1));
+    let expected_matches = expected_matches
+        .into_iter()
+        .map(|m| (m.1, m.2))
+        .collect::<Vec<_>>();
+    assert!(expected_matches.len() > 2000 * 4);
+
+    for thread_count in [1, 2, 4] {
+        let matches = cursor
+            .matches_parallel(&query, &tree, source.as_bytes(), thread_count)
+            .into_iter()
+            .map(|m| {
+                (
+                    m.pattern_index,
+                    format_captures(m.captures.into_iter(), &query, &source),
+                )
+            })
+            .collect::<Vec<_>>();
+        assert_eq!(matches, expected_matches);
+    }
+}
+
+#[test]
+fn test_query_match_cache() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let query = Query::new(
+            language,
+            r#"
+            (function_declaration name: (identifier) @name)
+            (call_expression function: (identifier) @fn arguments: (arguments . (_) @first-arg))
+            ((identifier) @constant (#match? @constant "^[A-Z_][A-Z_0-9]*$"))
+            ((comment) @doc . (function_declaration) @fn-decl)
+            "#,
+        )
+        .unwrap();
+        assert_eq!(
+            (0..query.pattern_count())
+                .map(|i| query.pattern_depth(i))
+                .collect::<Vec<_>>(),
+            &[1, 2, 0, 0]
+        );
+
+        let mut input = (0..20)
+            .map(|i| {
+                format!(
+                    "// Function {0}\nfunction f{0}(a, b) {{\n  return g(A_{0}, b) + h();\n}}\n",
+                    i
+                )
+            })
+            .collect::<String>()
+            .into_bytes();
+
+        let mut parser = Parser::new();
+        parser.set_language(language).unwrap();
+        let mut tree = parser.parse(&input, None).unwrap();
+        let mut cache = QueryMatchCache::new(&query, &tree, &input);
+        assert_eq!(cache.matches().len(), 20 * 4);
+
+        let mut rand = Rand::new(0);
+        for _ in 0..20 {
+            for _ in 0..rand.unsigned(2) + 1 {
+                let edit = get_random_edit(&mut rand, &input);
+                let edit = perform_edit(&mut tree, &mut input, &edit);
+                cache.edit(&edit);
+            }
+            let new_tree = parser.parse(&input, Some(&tree)).unwrap();
+            cache.update(&new_tree, &input, tree.changed_ranges(&new_tree));
+            tree = new_tree;
+
+            let expected_cache = QueryMatchCache::new(&query, &tree, &input);
+            assert_eq!(cache.matches(), expected_cache.matches());
+            for m in cache.matches() {
+                for capture in &m.captures {
+                    let node = capture.node(&tree).unwrap();
+                    assert_eq!(node.range(), capture.range);
+                    assert_eq!(node.kind_id(), capture.kind_id);
+                }
+            }
+        }
+    });
+}
+
 #[test]
 fn test_query_alternative_predicate_prefix() {
     allocations::record(|| {
@@ -4,10 +4,14 @@ use super::helpers::{
 };
 use std::{
     ffi::{CStr, CString},
-    fs, ptr, slice, str,
+    fs, io, ptr, slice, str,
+};
+use tree_sitter::{InputEdit, Point};
+use tree_sitter_tags::{
+    c_lib as c,
+    index::{TagsIndex, TagsIndexBuilder},
+    Error, TagsConfiguration, TagsContext,
 };
-use tree_sitter::Point;
-use tree_sitter_tags::{c_lib as c, Error, TagsConfiguration, TagsContext};
 
 const PYTHON_TAG_QUERY: &'static str = r#"
 (
@@ -291,6 +295,153 @@ fn test_tags_cancellation() {
     });
 }
 
+#[test]
+fn test_tags_index() {
+    let language = get_language("python");
+    let tags_config = TagsConfiguration::new(language, PYTHON_TAG_QUERY, "").unwrap();
+    let mut tag_context = TagsContext::new();
+    let index_dir = tempfile::tempdir().unwrap();
+    let index_path = index_dir.path().join("tags");
+
+    let mut builder = TagsIndexBuilder::new(None).unwrap();
+    for (path, source) in &[
+        ("a.py", "class A:\n    def one(self):\n        two()\n"),
+        ("b.py", "def two():\n    one()\n"),
+        ("c.py", "def three():\n    pass\n"),
+    ] {
+        assert!(builder
+            .add_file(
+                &mut tag_context,
+                &tags_config,
+                path,
+                source.as_bytes(),
+                None
+            )
+            .unwrap());
+    }
+    builder.write(&index_path).unwrap();
+
+    let index = TagsIndex::open(&index_path).unwrap();
+    assert_eq!(index.file_count(), 3);
+    assert_eq!(
+        index
+            .find_tags("two", None)
+            .unwrap()
+            .iter()
+            .map(|t| (t.path.as_str(), t.kind.as_str(), t.span.start))
+            .collect::<Vec<_>>(),
+        &[
+            ("b.py", "function", Point::new(0, 4)),
+            ("a.py", "call", Point::new(2, 8))
+        ]
+    );
+    assert_eq!(
+        index
+            .find_tags("one", Some("call"))
+            .unwrap()
+            .iter()
+            .map(|t| (t.path.as_str(), t.name_range.clone()))
+            .collect::<Vec<_>>(),
+        &[("b.py", 15..18)]
+    );
+    assert!(index.find_tags("four", None).unwrap().is_empty());
+
+    // Only the files whose content has changed are tagged again, and the files
+    // that are not added to the builder are removed from the index.
+    let mut builder = TagsIndexBuilder::new(Some(index)).unwrap();
+    assert!(!builder
+        .add_file(
+            &mut tag_context,
+            &tags_config,
+            "a.py",
+            b"class A:\n    def one(self):\n        two()\n",
+            None,
+        )
+        .unwrap());
+
+    // Edited files are parsed incrementally.
+    let source = b"def two():\n    one()\n";
+    let mut tree = builder
+        .add_edited_file(&mut tag_context, &tags_config, "b.py", source, None, None)
+        .unwrap();
+    let source = b"def too_two():\n    one()\n";
+    tree.edit(&InputEdit {
+        start_byte: 4,
+        old_end_byte: 4,
+        new_end_byte: 8,
+        start_position: Point::new(0, 4),
+        old_end_position: Point::new(0, 4),
+        new_end_position: Point::new(0, 8),
+    });
+    builder
+        .add_edited_file(
+            &mut tag_context,
+            &tags_config,
+            "b.py",
+            source,
+            Some(&tree),
+            None,
+        )
+        .unwrap();
+    builder.write(&index_path).unwrap();
+
+    let index = TagsIndex::open(&index_path).unwrap();
+    assert_eq!(index.file_count(), 2);
+    assert!(index.file_hash("c.py").unwrap().is_none());
+    assert_eq!(
+        index.file_hash("b.py").unwrap(),
+        Some(tree_sitter_tags::index::content_hash(source))
+    );
+    assert!(index.find_tags("three", None).unwrap().is_empty());
+    assert_eq!(
+        index
+            .find_tags("two", None)
+            .unwrap()
+            .iter()
+            .map(|t| (t.path.as_str(), t.kind.as_str()))
+            .collect::<Vec<_>>(),
+        &[("a.py", "call")]
+    );
+    assert_eq!(
+        index
+            .find_tags("too_two", Some("function"))
+            .unwrap()
+            .iter()
+            .map(|t| (t.path.as_str(), t.name_range.clone()))
+            .collect::<Vec<_>>(),
+        &[("b.py", 4..11)]
+    );
+
+    // Counts and lengths that don't fit in the file are rejected before anything is
+    // allocated for them.
+    let bytes = fs::read(&index_path).unwrap();
+    let corrupt_path = index_dir.path().join("corrupt-tags");
+    let open_corrupt = |bytes: &[u8]| {
+        fs::write(&corrupt_path, bytes).unwrap();
+        TagsIndex::open(&corrupt_path)
+    };
+
+    // The file ends just after the header.
+    let error = open_corrupt(&bytes[0..64]).err().unwrap();
+    assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+
+    // The number of kinds is too large.
+    let mut corrupt_bytes = bytes.clone();
+    corrupt_bytes[12..16].copy_from_slice(&u32::MAX.to_le_bytes());
+    let error = open_corrupt(&corrupt_bytes).err().unwrap();
+    assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+
+    // The length of the first file's path is too large.
+    let mut corrupt_bytes = bytes.clone();
+    let mut files_offset = [0; 8];
+    files_offset.copy_from_slice(&bytes[32..40]);
+    let path_len_offset = u64::from_le_bytes(files_offset) as usize + 8;
+    corrupt_bytes[path_len_offset..path_len_offset + 4].copy_from_slice(&u32::MAX.to_le_bytes());
+    let index = open_corrupt(&corrupt_bytes).unwrap();
+    let error = index.file_hash("a.py").err().unwrap();
+    assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+}
+
 #[test]
 fn test_invalid_capture() {
     let language = get_language("python");
@@ -268,6 +268,92 @@ fn test_tree_cursor() {
     assert_eq!(cursor.node().is_named(), true);
 }
 
+#[test]
+fn test_tree_cursor_previous_sibling() {
+    let mut parser = Parser::new();
+    parser.set_language(get_language("rust")).unwrap();
+
+    let tree = parser
+        .parse("struct Stuff { a: A, b: Option<B> }", None)
+        .unwrap();
+
+    let mut cursor = tree.walk();
+    assert!(cursor.goto_first_child());
+    assert!(cursor.goto_first_child());
+    assert_eq!(cursor.node().kind(), "struct");
+    assert!(!cursor.goto_previous_sibling());
+    assert_eq!(cursor.node().kind(), "struct");
+
+    assert!(cursor.goto_next_sibling());
+    assert!(cursor.goto_next_sibling());
+    assert_eq!(cursor.node().kind(), "field_declaration_list");
+
+    assert!(cursor.goto_previous_sibling());
+    assert_eq!(cursor.node().kind(), "type_identifier");
+    assert!(cursor.goto_previous_sibling());
+    assert_eq!(cursor.node().kind(), "struct");
+    assert!(!cursor.goto_previous_sibling());
+
+    // The cursor does not move past the parent's children.
+    assert!(cursor.goto_parent());
+    assert_eq!(cursor.node().kind(), "struct_item");
+    assert!(!cursor.goto_previous_sibling());
+    assert_eq!(cursor.node().kind(), "struct_item");
+}
+
+#[test]
+fn test_tree_cursor_descendants() {
+    let mut parser = Parser::new();
+    parser.set_language(get_language("rust")).unwrap();
+
+    let source = "
+        struct Stuff {
+            a: A,
+            b: Option<B>,
+        }
+
+        fn main() {
+            let x = Stuff { a: A, b: None };
+        }
+    ";
+    let tree = parser.parse(source, None).unwrap();
+
+    // Record every node in the order that a depth-first walk visits them.
+    let mut nodes = Vec::new();
+    let mut cursor = tree.walk();
+    loop {
+        assert_eq!(cursor.descendant_index(), nodes.len());
+        nodes.push(cursor.node());
+        if cursor.goto_first_child() || cursor.goto_next_sibling() {
+            continue;
+        }
+        while cursor.goto_parent() && !cursor.goto_next_sibling() {}
+        if cursor.node() == tree.root_node() {
+            break;
+        }
+    }
+    assert_eq!(tree.root_node().descendant_count(), nodes.len());
+
+    let mut cursor = tree.walk();
+    for i in (0..nodes.len()).rev().chain(0..nodes.len()) {
+        cursor.goto_descendant(i);
+        assert_eq!(cursor.node(), nodes[i]);
+        assert_eq!(cursor.descendant_index(), i);
+    }
+
+    // Each node's descendants are the nodes that follow it, until the next
+    // node that starts after it ends.
+    for (i, node) in nodes.iter().enumerate() {
+        let count = node.descendant_count();
+        assert!(nodes[i..i + count]
+            .iter()
+            .all(|descendant| descendant.end_byte() <= node.end_byte()));
+        if let Some(next) = nodes.get(i + count) {
+            assert!(next.start_byte() >= node.end_byte());
+        }
+    }
+}
+
 #[test]
 fn test_tree_cursor_fields() {
     let mut parser = Parser::new();
@@ -531,6 +617,63 @@ fn test_get_changed_ranges() {
     }
 }
 
+#[test]
+fn test_tree_serialization() {
+    let mut source_code = b"
+    function a(b) {
+        if (b) return c(`${d}`);
+        return [1, 'two', /three/];
+    }
+    "
+    .to_vec();
+
+    let mut parser = Parser::new();
+    parser.set_language(get_language("javascript")).unwrap();
+    let tree = parser.parse(&source_code, None).unwrap();
+
+    let data = tree.serialize();
+    let mut loaded_tree = Tree::deserialize(&data, get_language("javascript")).unwrap();
+    assert_eq!(
+        loaded_tree.root_node().to_sexp(),
+        tree.root_node().to_sexp()
+    );
+    assert_eq!(
+        loaded_tree.root_node().end_position(),
+        tree.root_node().end_position()
+    );
+    assert_eq!(loaded_tree.serialize(), data);
+
+    // The loaded tree can be reused when parsing an edited document.
+    let edit = Edit {
+        position: index_of(&source_code, "c("),
+        deleted_length: 1,
+        inserted_text: b"e.f".to_vec(),
+    };
+    let mut tree = tree.clone();
+    let mut edited_source_code = source_code.clone();
+    perform_edit(&mut tree, &mut edited_source_code, &edit);
+    perform_edit(&mut loaded_tree, &mut source_code, &edit);
+    let new_tree = parser.parse(&source_code, Some(&tree)).unwrap();
+    let new_loaded_tree = parser.parse(&source_code, Some(&loaded_tree)).unwrap();
+    assert_eq!(
+        new_loaded_tree.root_node().to_sexp(),
+        new_tree.root_node().to_sexp()
+    );
+    assert_eq!(
+        loaded_tree
+            .changed_ranges(&new_loaded_tree)
+            .collect::<Vec<_>>(),
+        tree.changed_ranges(&new_tree).collect::<Vec<_>>()
+    );
+
+    // Invalid data is rejected.
+    assert!(Tree::deserialize(&data[0..data.len() - 1], get_language("javascript")).is_none());
+    assert!(Tree::deserialize(&data, get_language("rust")).is_none());
+    let mut corrupted_data = data.clone();
+    corrupted_data[data.len() / 2] ^= 1;
+    assert!(Tree::deserialize(&corrupted_data, get_language("javascript")).is_none());
+}
+
 fn index_of(text: &Vec<u8>, substring: &str) -> usize {
     str::from_utf8(text.as_slice())
         .unwrap()
@@ -15,6 +15,7 @@ typedef enum {
   TSHighlightInvalidUtf8,
   TSHighlightInvalidRegex,
   TSHighlightInvalidQuery,
+  TSHighlightMissingCallback,
 } TSHighlightError;
 
 typedef struct TSHighlighter TSHighlighter;
@@ -62,6 +63,23 @@ TSHighlightError ts_highlighter_highlight(
   const size_t *cancellation_flag
 );
 
+// Compute syntax highlighting for a given document, and pass the HTML for
+// each line to `line_callback` as soon as it is complete, along with the
+// given `payload`. The line is only valid during the call. Only the line
+// that is being rendered is stored in the `TSHighlightBuffer`, which is
+// empty afterward. To stop early, set the cancellation flag. Returns
+// `TSHighlightMissingCallback` if `line_callback` is NULL.
+TSHighlightError ts_highlighter_highlight_lines(
+  const TSHighlighter *self,
+  const char *scope_name,
+  const char *source_code,
+  uint32_t source_code_len,
+  TSHighlightBuffer *output,
+  const size_t *cancellation_flag,
+  void (*line_callback)(const uint8_t *line, uint32_t length, void *payload),
+  void *payload
+);
+
 // TSHighlightBuffer: This struct stores the HTML output of syntax
 // highlighting. It can be reused for multiple highlighting calls.
 TSHighlightBuffer *ts_highlight_buffer_new();
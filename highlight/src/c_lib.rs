@@ -2,7 +2,7 @@ use super::{Error, Highlight, HighlightConfiguration, Highlighter, HtmlRenderer}
 use regex::Regex;
 use std::collections::HashMap;
 use std::ffi::CStr;
-use std::os::raw::c_char;
+use std::os::raw::{c_char, c_void};
 use std::process::abort;
 use std::sync::atomic::AtomicUsize;
 use std::{fmt, slice, str};
@@ -29,6 +29,7 @@ pub enum ErrorCode {
     InvalidUtf8,
     InvalidRegex,
     InvalidQuery,
+    MissingCallback,
 }
 
 #[no_mangle]
@@ -181,7 +182,37 @@ pub extern "C" fn ts_highlighter_highlight(
     let source_code =
         unsafe { slice::from_raw_parts(source_code as *const u8, source_code_len as usize) };
     let cancellation_flag = unsafe { cancellation_flag.as_ref() };
-    this.highlight(source_code, scope_name, output, cancellation_flag)
+    this.highlight(source_code, scope_name, output, cancellation_flag, None)
+}
+
+#[no_mangle]
+pub extern "C" fn ts_highlighter_highlight_lines(
+    this: *const TSHighlighter,
+    scope_name: *const c_char,
+    source_code: *const c_char,
+    source_code_len: u32,
+    output: *mut TSHighlightBuffer,
+    cancellation_flag: *const AtomicUsize,
+    line_callback: Option<extern "C" fn(*const u8, u32, *mut c_void)>,
+    payload: *mut c_void,
+) -> ErrorCode {
+    let line_callback = match line_callback {
+        Some(line_callback) => line_callback,
+        None => return ErrorCode::MissingCallback,
+    };
+    let this = unwrap_ptr(this);
+    let output = unwrap_mut_ptr(output);
+    let scope_name = unwrap(unsafe { CStr::from_ptr(scope_name).to_str() });
+    let source_code =
+        unsafe { slice::from_raw_parts(source_code as *const u8, source_code_len as usize) };
+    let cancellation_flag = unsafe { cancellation_flag.as_ref() };
+    this.highlight(
+        source_code,
+        scope_name,
+        output,
+        cancellation_flag,
+        Some(&mut |line: &str| line_callback(line.as_ptr(), line.len() as u32, payload)),
+    )
 }
 
 impl TSHighlighter {
@@ -191,6 +222,7 @@ impl TSHighlighter {
         scope_name: &str,
         output: &mut TSHighlightBuffer,
         cancellation_flag: Option<&AtomicUsize>,
+        line_callback: Option<&mut dyn FnMut(&str)>,
     ) -> ErrorCode {
         let entry = self.languages.get(scope_name);
         if entry.is_none() {
@@ -221,9 +253,18 @@ impl TSHighlighter {
             output
                 .renderer
                 .set_carriage_return_highlight(self.carriage_return_index.map(Highlight));
-            let result = output
-                .renderer
-                .render(highlights, source_code, &|s| self.attribute_strings[s.0]);
+            let attribute_callback = |s: Highlight| self.attribute_strings[s.0];
+            let result = match line_callback {
+                Some(line_callback) => output.renderer.render_lines(
+                    highlights,
+                    source_code,
+                    &attribute_callback,
+                    line_callback,
+                ),
+                None => output
+                    .renderer
+                    .render(highlights, source_code, &attribute_callback),
+            };
             match result {
                 Err(Error::Cancelled) => {
                     return ErrorCode::Timeout;
@@ -3,11 +3,11 @@ pub mod util;
 pub use c_lib as c;
 
 use std::sync::atomic::{AtomicUsize, Ordering};
-use std::{iter, mem, ops, str, usize};
+use std::{io, iter, mem, ops, str, usize};
 use thiserror::Error;
 use tree_sitter::{
-    Language, LossyUtf8, Node, Parser, Point, Query, QueryCaptures, QueryCursor, QueryError,
-    QueryMatch, Range, Tree,
+    InputEdit, Language, LossyUtf8, Node, Parser, Point, Query, QueryCaptures, QueryCursor,
+    QueryError, QueryMatch, Range, Tree,
 };
 
 const CANCELLATION_CHECK_INTERVAL: usize = 100;
@@ -64,6 +64,23 @@ pub struct HighlightConfiguration {
 pub struct Highlighter {
     parser: Parser,
     cursors: Vec<QueryCursor>,
+    layer_trees: Vec<LayerTree>,
+    new_layer_trees: Option<Vec<LayerTree>>,
+}
+
+/// Highlights a document that is being edited.
+///
+/// A session keeps the syntax tree for each language layer of the document, along with
+/// the highlight events that it produced. After the document is edited, each layer is
+/// reparsed incrementally, and when possible, only the part of the document whose syntax
+/// has changed is highlighted again. Those events are spliced into the cached events.
+pub struct HighlightSession<'a> {
+    highlighter: Highlighter,
+    config: &'a HighlightConfiguration,
+    source: Vec<u8>,
+    events: Vec<HighlightEvent>,
+    edited_range: Option<EditedRange>,
+    events_are_valid: bool,
 }
 
 /// Converts a general-purpose syntax highlighting iterator into a sequence of lines of HTML.
@@ -73,6 +90,24 @@ pub struct HtmlRenderer {
     carriage_return_highlight: Option<Highlight>,
 }
 
+// The syntax tree for one language layer of a document, which is kept by a
+// `HighlightSession` so that the layer can be reparsed incrementally.
+struct LayerTree {
+    language: Language,
+    depth: usize,
+    ranges: Vec<Range>,
+    tree: Tree,
+}
+
+// The part of a document that has been edited since it was last highlighted: its start,
+// and its end both before and after the edits.
+#[derive(Clone, Copy)]
+struct EditedRange {
+    start: usize,
+    old_end: usize,
+    new_end: usize,
+}
+
 #[derive(Debug)]
 struct LocalDef<'a> {
     name: &'a str,
@@ -93,6 +128,8 @@ where
 {
     source: &'a [u8],
     byte_offset: usize,
+    byte_range: ops::Range<usize>,
+    outside_byte_range: bool,
     highlighter: &'a mut Highlighter,
     injection_callback: F,
     cancellation_flag: Option<&'a AtomicUsize>,
@@ -118,6 +155,8 @@ impl Highlighter {
         Highlighter {
             parser: Parser::new(),
             cursors: Vec::new(),
+            layer_trees: Vec::new(),
+            new_layer_trees: None,
         }
     }
 
@@ -131,8 +170,30 @@ impl Highlighter {
         config: &'a HighlightConfiguration,
         source: &'a [u8],
         cancellation_flag: Option<&'a AtomicUsize>,
-        mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+        injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
     ) -> Result<impl Iterator<Item = Result<HighlightEvent, Error>> + 'a, Error> {
+        self.highlight_range(
+            config,
+            source,
+            0..usize::MAX,
+            cancellation_flag,
+            injection_callback,
+        )
+    }
+
+    // Highlight the part of the document that intersects the given byte range. The events
+    // start at the beginning of the range, and end at the end of the range or document.
+    fn highlight_range<'a, F>(
+        &'a mut self,
+        config: &'a HighlightConfiguration,
+        source: &'a [u8],
+        byte_range: ops::Range<usize>,
+        cancellation_flag: Option<&'a AtomicUsize>,
+        mut injection_callback: F,
+    ) -> Result<HighlightIter<'a, F>, Error>
+    where
+        F: FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+    {
         let layers = HighlightIterLayer::new(
             source,
             self,
@@ -140,17 +201,15 @@ impl Highlighter {
             &mut injection_callback,
             config,
             0,
-            vec![Range {
-                start_byte: 0,
-                end_byte: usize::MAX,
-                start_point: Point::new(0, 0),
-                end_point: Point::new(usize::MAX, usize::MAX),
-            }],
+            vec![document_range()],
+            &byte_range,
         )?;
         assert_ne!(layers.len(), 0);
         let mut result = HighlightIter {
             source,
-            byte_offset: 0,
+            byte_offset: byte_range.start,
+            byte_range,
+            outside_byte_range: false,
             injection_callback,
             cancellation_flag,
             highlighter: self,
@@ -162,6 +221,329 @@ impl Highlighter {
         result.sort_layers();
         Ok(result)
     }
+
+    // Remove and return a tree from a previous parse of the given language layer. Layers are
+    // identified by their language, their depth, and the start of their ranges, which have
+    // been edited along with the trees.
+    fn take_layer_tree(
+        &mut self,
+        language: Language,
+        depth: usize,
+        ranges: &[Range],
+    ) -> Option<LayerTree> {
+        let start_byte = ranges.first()?.start_byte;
+        let index = self.layer_trees.iter().position(|layer| {
+            layer.language == language
+                && layer.depth == depth
+                && layer.ranges[0].start_byte == start_byte
+        })?;
+        Some(self.layer_trees.swap_remove(index))
+    }
+}
+
+impl<'a> HighlightSession<'a> {
+    /// Create a session for highlighting the given document in the language described by
+    /// `config`. The document is not highlighted until `highlight` is called.
+    pub fn new(config: &'a HighlightConfiguration, source: Vec<u8>) -> Self {
+        HighlightSession {
+            highlighter: Highlighter::new(),
+            config,
+            source,
+            events: Vec::new(),
+            edited_range: None,
+            events_are_valid: false,
+        }
+    }
+
+    /// Get the current text of the document.
+    pub fn source(&self) -> &[u8] {
+        &self.source
+    }
+
+    /// Get the highlight events for the whole document, as of the last successful call
+    /// to `highlight`.
+    pub fn events(&self) -> &[HighlightEvent] {
+        &self.events
+    }
+
+    /// Edit the document, replacing the text between `edit.start_byte` and
+    /// `edit.old_end_byte` with `inserted_text`.
+    ///
+    /// The syntax trees of all of the document's layers are edited as well, so that they
+    /// can be reparsed incrementally by the next call to `highlight`.
+    pub fn edit(&mut self, edit: &InputEdit, inserted_text: &[u8]) {
+        assert_eq!(edit.new_end_byte, edit.start_byte + inserted_text.len());
+        self.source.splice(
+            edit.start_byte..edit.old_end_byte,
+            inserted_text.iter().cloned(),
+        );
+        for layer in &mut self.highlighter.layer_trees {
+            layer.tree.edit(edit);
+            for range in &mut layer.ranges {
+                edit_range(range, edit);
+            }
+        }
+
+        // Merge the edit with the previous ones. The text after the merged range is the
+        // same as the text after it was before any of the edits.
+        self.edited_range = Some(match self.edited_range {
+            None => EditedRange {
+                start: edit.start_byte,
+                old_end: edit.old_end_byte,
+                new_end: edit.new_end_byte,
+            },
+            Some(range) => {
+                let end = range.new_end.max(edit.old_end_byte);
+                EditedRange {
+                    start: range.start.min(edit.start_byte),
+                    old_end: range.old_end + (end - range.new_end),
+                    new_end: end - edit.old_end_byte + edit.new_end_byte,
+                }
+            }
+        });
+    }
+
+    /// Bring the highlight events up to date with the document.
+    ///
+    /// Returns the byte range of the document whose events were replaced. It is empty if
+    /// the document has not been edited since it was last highlighted.
+    pub fn highlight(
+        &mut self,
+        cancellation_flag: Option<&AtomicUsize>,
+        mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration>,
+    ) -> Result<ops::Range<usize>, Error> {
+        if self.events_are_valid && self.edited_range.is_none() {
+            return Ok(0..0);
+        }
+
+        // Parse the outermost layer first, because the parts of it whose syntax has changed
+        // determine which part of the document needs to be highlighted again.
+        let ranges = vec![document_range()];
+        let old_layer = self
+            .highlighter
+            .take_layer_tree(self.config.language, 0, &ranges);
+        let parser = &mut self.highlighter.parser;
+        parser
+            .set_included_ranges(&ranges)
+            .map_err(|_| Error::Unknown)?;
+        parser
+            .set_language(self.config.language)
+            .map_err(|_| Error::InvalidLanguage)?;
+        unsafe { parser.set_cancellation_flag(cancellation_flag) };
+        let tree = parser.parse(&self.source, old_layer.as_ref().map(|layer| &layer.tree));
+        unsafe { parser.set_cancellation_flag(None) };
+        let tree = match tree {
+            Some(tree) => tree,
+            None => {
+                self.highlighter.layer_trees.extend(old_layer);
+                return Err(Error::Cancelled);
+            }
+        };
+
+        let changed_range = match &old_layer {
+            Some(old_layer) if self.events_are_valid && self.can_splice(&tree) => {
+                Some((self.changed_range(&old_layer.tree, &tree), tree.clone()))
+            }
+            _ => None,
+        };
+        self.highlighter.layer_trees.push(LayerTree {
+            language: self.config.language,
+            depth: 0,
+            ranges,
+            tree,
+        });
+
+        // Highlight the part of the document that contains the changes, starting with the
+        // children of the smallest node that contains them. If any highlight spans the edges
+        // of that part, try again with the node's parent.
+        if let Some((changed_range, tree)) = changed_range {
+            let edited_range = self.edited_range.unwrap();
+            let mut node = smallest_node_containing(tree.root_node(), &changed_range);
+            let mut previous_range = None;
+            loop {
+                let new_range = self.splice_range(node, &changed_range);
+                if previous_range.as_ref() != Some(&new_range) {
+                    let old_range = new_range.start
+                        ..new_range.end - edited_range.new_end + edited_range.old_end;
+                    let events = self.highlight_layers(
+                        new_range.clone(),
+                        cancellation_flag,
+                        &mut injection_callback,
+                    )?;
+                    if let Some(events) = events {
+                        if self.splice_events(old_range, new_range.clone(), events) {
+                            self.edited_range = None;
+                            return Ok(new_range);
+                        }
+                    }
+                    previous_range = Some(new_range);
+                }
+                match node.parent() {
+                    Some(parent) => node = parent,
+                    None => break,
+                }
+            }
+        }
+
+        let range = 0..self.source.len();
+        let events =
+            self.highlight_layers(range.clone(), cancellation_flag, &mut injection_callback)?;
+        self.events = events.ok_or(Error::Unknown)?;
+        self.edited_range = None;
+        self.events_are_valid = true;
+        Ok(range)
+    }
+
+    // Highlighting part of the document only produces the same events as highlighting the
+    // whole document if no highlight depends on text outside of that part. Local variables
+    // and combined injections in the outermost layer can span the entire document, and
+    // syntax errors can cause any part of the document to be parsed differently.
+    fn can_splice(&self, tree: &Tree) -> bool {
+        self.config.locals_pattern_index == self.config.highlights_pattern_index
+            && self.config.combined_injections_query.is_none()
+            && !tree.root_node().has_error()
+    }
+
+    // Get the part of the edited document that covers every edit and every syntax change.
+    fn changed_range(&self, old_tree: &Tree, new_tree: &Tree) -> ops::Range<usize> {
+        let edited_range = self.edited_range.unwrap();
+        let mut start = edited_range.start;
+        let mut end = edited_range.new_end;
+        for range in old_tree.changed_ranges(new_tree) {
+            start = start.min(range.start_byte);
+            end = end.max(range.end_byte);
+        }
+        start..end
+    }
+
+    // Extend the changed part of the document to the boundaries between the given node's
+    // children, so that only the node and its ancestors can span its edges.
+    fn splice_range(&self, node: Node, changed_range: &ops::Range<usize>) -> ops::Range<usize> {
+        let mut result = if node.parent().is_none() {
+            0..self.source.len()
+        } else {
+            node.byte_range()
+        };
+        let mut cursor = node.walk();
+        for child in node.children(&mut cursor) {
+            if child.end_byte() < changed_range.start {
+                result.start = child.end_byte();
+            } else if child.start_byte() > changed_range.end {
+                result.end = child.start_byte();
+                break;
+            }
+        }
+        result
+    }
+
+    // Highlight the part of the document in the given range, reusing the trees of the
+    // layers that were parsed before. The trees of the layers within the range are
+    // replaced with the new ones. Returns `None` if any highlight extends outside of the
+    // range.
+    fn highlight_layers<'b>(
+        &'b mut self,
+        byte_range: ops::Range<usize>,
+        cancellation_flag: Option<&'b AtomicUsize>,
+        injection_callback: &'b mut impl FnMut(&str) -> Option<&'a HighlightConfiguration>,
+    ) -> Result<Option<Vec<HighlightEvent>>, Error> {
+        self.highlighter.new_layer_trees = Some(Vec::new());
+        let result = (|| {
+            let mut events = Vec::new();
+            let mut iter = self.highlighter.highlight_range(
+                self.config,
+                &self.source,
+                byte_range.clone(),
+                cancellation_flag,
+                |name: &str| injection_callback(name),
+            )?;
+            while let Some(event) = iter.next() {
+                events.push(event?);
+            }
+            Ok(if iter.outside_byte_range {
+                None
+            } else {
+                Some(events)
+            })
+        })();
+
+        // Keep the trees of the layers outside of the range, whose text and syntax have
+        // not changed. The layers within the range that were not parsed again no longer
+        // exist.
+        let new_layer_trees = self.highlighter.new_layer_trees.take().unwrap_or_default();
+        self.highlighter.layer_trees.retain(|layer| {
+            layer.ranges.last().unwrap().end_byte <= byte_range.start
+                || layer.ranges[0].start_byte >= byte_range.end
+        });
+        self.highlighter.layer_trees.extend(new_layer_trees);
+        if result.is_err() {
+            self.events_are_valid = false;
+        }
+        result
+    }
+
+    // Replace the cached events for the given range of the old document with the events
+    // for the given range of the new document. Returns false if any cached highlight
+    // spans the edges of the old range, in which case the events are left unchanged.
+    fn splice_events(
+        &mut self,
+        old_range: ops::Range<usize>,
+        new_range: ops::Range<usize>,
+        new_events: Vec<HighlightEvent>,
+    ) -> bool {
+        let mut prefix = Vec::with_capacity(self.events.len() + new_events.len());
+        let mut suffix = Vec::new();
+        let mut prefix_depth = 0;
+        let mut removed_depth = 0;
+        let mut offset = 0;
+        let shift = |offset: usize| offset - old_range.end + new_range.end;
+        for event in &self.events {
+            match *event {
+                HighlightEvent::Source { start, end } => {
+                    if start < old_range.start {
+                        prefix.push(HighlightEvent::Source {
+                            start,
+                            end: end.min(old_range.start),
+                        });
+                    }
+                    if end > old_range.end {
+                        suffix.push(HighlightEvent::Source {
+                            start: shift(start.max(old_range.end)),
+                            end: shift(end),
+                        });
+                    }
+                    offset = end;
+                }
+                HighlightEvent::HighlightStart(_) => {
+                    if offset < old_range.start {
+                        prefix_depth += 1;
+                        prefix.push(*event);
+                    } else if offset >= old_range.end {
+                        suffix.push(*event);
+                    } else {
+                        removed_depth += 1;
+                    }
+                }
+                HighlightEvent::HighlightEnd => {
+                    if offset <= old_range.start {
+                        prefix_depth -= 1;
+                        prefix.push(*event);
+                    } else if offset > old_range.end {
+                        suffix.push(*event);
+                    } else {
+                        removed_depth -= 1;
+                    }
+                }
+            }
+        }
+
+        if prefix_depth != 0 || removed_depth != 0 {
+            return false;
+        }
+        prefix.extend(new_events);
+        prefix.extend(suffix);
+        self.events = prefix;
+        true
+    }
 }
 
 impl HighlightConfiguration {
@@ -337,6 +719,7 @@ impl<'a> HighlightIterLayer<'a> {
         mut config: &'a HighlightConfiguration,
         mut depth: usize,
         mut ranges: Vec<Range>,
+        byte_range: &ops::Range<usize>,
     ) -> Result<Vec<Self>, Error> {
         let mut result = Vec::with_capacity(1);
         let mut queue = Vec::new();
@@ -348,15 +731,34 @@ impl<'a> HighlightIterLayer<'a> {
                     .map_err(|_| Error::InvalidLanguage)?;
 
                 unsafe { highlighter.parser.set_cancellation_flag(cancellation_flag) };
-                let tree = highlighter
-                    .parser
-                    .parse(source, None)
-                    .ok_or(Error::Cancelled)?;
+                let tree = match highlighter.take_layer_tree(config.language, depth, &ranges) {
+                    // A layer whose text and ranges have not changed doesn't need to be
+                    // parsed again.
+                    Some(layer)
+                        if layer.ranges == ranges && !layer.tree.root_node().has_changes() =>
+                    {
+                        layer.tree
+                    }
+                    layer => highlighter
+                        .parser
+                        .parse(source, layer.as_ref().map(|layer| &layer.tree))
+                        .ok_or(Error::Cancelled)?,
+                };
                 unsafe { highlighter.parser.set_cancellation_flag(None) };
+                if let Some(new_layer_trees) = &mut highlighter.new_layer_trees {
+                    new_layer_trees.push(LayerTree {
+                        language: config.language,
+                        depth,
+                        ranges: ranges.clone(),
+                        tree: tree.clone(),
+                    });
+                }
                 let mut cursor = highlighter.cursors.pop().unwrap_or(QueryCursor::new());
 
-                // Process combined injections.
+                // Process combined injections. A combined injection is parsed from all of its
+                // content nodes in the layer, including those outside of the byte range.
                 if let Some(combined_injections_query) = &config.combined_injections_query {
+                    cursor.set_byte_range(0..usize::MAX);
                     let mut injections_by_pattern_index =
                         vec![(None, Vec::new(), false); combined_injections_query.pattern_count()];
                     let matches =
@@ -390,6 +792,14 @@ impl<'a> HighlightIterLayer<'a> {
                     }
                 }
 
+                // Local variables can only be tracked by visiting the entire layer. If the layer
+                // extends outside of the byte range, its events will too.
+                if config.locals_pattern_index == config.highlights_pattern_index {
+                    cursor.set_byte_range(byte_range.clone());
+                } else {
+                    cursor.set_byte_range(0..usize::MAX);
+                }
+
                 // The `captures` iterator borrows the `Tree` and the `QueryCursor`, which
                 // prevents them from being moved. But both of these values are really just
                 // pointers, so it's actually ok to move them.
@@ -557,6 +967,9 @@ where
         offset: usize,
         event: Option<HighlightEvent>,
     ) -> Option<Result<HighlightEvent, Error>> {
+        if offset < self.byte_range.start || offset > self.byte_range.end {
+            self.outside_byte_range = true;
+        }
         let result;
         if self.byte_offset < offset {
             result = Some(Ok(HighlightEvent::Source {
@@ -572,6 +985,10 @@ where
         result
     }
 
+    fn end_byte(&self) -> usize {
+        self.byte_range.end.min(self.source.len())
+    }
+
     fn sort_layers(&mut self) {
         while !self.layers.is_empty() {
             if let Some(sort_key) = self.layers[0].sort_key() {
@@ -642,12 +1059,13 @@ where
 
             // If none of the layers have any more highlight boundaries, terminate.
             if self.layers.is_empty() {
-                return if self.byte_offset < self.source.len() {
+                let end_byte = self.end_byte();
+                return if self.byte_offset < end_byte {
                     let result = Some(Ok(HighlightEvent::Source {
                         start: self.byte_offset,
-                        end: self.source.len(),
+                        end: end_byte,
                     }));
-                    self.byte_offset = self.source.len();
+                    self.byte_offset = end_byte;
                     result
                 } else {
                     None
@@ -677,7 +1095,7 @@ where
                 layer.highlight_end_stack.pop();
                 return self.emit_event(end_byte, Some(HighlightEvent::HighlightEnd));
             } else {
-                return self.emit_event(self.source.len(), None);
+                return self.emit_event(self.end_byte(), None);
             };
 
             let (mut match_, capture_index) = layer.captures.next().unwrap();
@@ -710,6 +1128,7 @@ where
                                 config,
                                 self.layers[0].depth + 1,
                                 ranges,
+                                &self.byte_range,
                             ) {
                                 Ok(layers) => {
                                     for layer in layers {
@@ -941,6 +1360,122 @@ impl HtmlRenderer {
         Ok(())
     }
 
+    /// Render the HTML one line at a time, passing each line to `line_callback` as soon as
+    /// it is complete. Only the line that is being rendered is buffered, so the memory that
+    /// is used doesn't depend on the size of the document.
+    pub fn render_lines<'a, F>(
+        &mut self,
+        highlighter: impl Iterator<Item = Result<HighlightEvent, Error>>,
+        source: &'a [u8],
+        attribute_callback: &F,
+        mut line_callback: impl FnMut(&str),
+    ) -> Result<(), Error>
+    where
+        F: Fn(Highlight) -> &'a [u8],
+    {
+        self.render_streaming(highlighter, source, attribute_callback, |line| {
+            line_callback(line);
+            true
+        })
+    }
+
+    /// Render the HTML to the given output one line at a time, like `render_lines`.
+    pub fn render_to_writer<'a, F>(
+        &mut self,
+        highlighter: impl Iterator<Item = Result<HighlightEvent, Error>>,
+        source: &'a [u8],
+        attribute_callback: &F,
+        output: &mut impl io::Write,
+    ) -> io::Result<()>
+    where
+        F: Fn(Highlight) -> &'a [u8],
+    {
+        let mut write_result = Ok(());
+        let result = self.render_streaming(highlighter, source, attribute_callback, |line| {
+            write_result = output.write_all(line.as_bytes());
+            write_result.is_ok()
+        });
+        write_result?;
+        result.map_err(|error| io::Error::new(io::ErrorKind::Other, error))
+    }
+
+    // Render the HTML, passing each line to `line_callback` once it is complete and then
+    // removing it from the buffer. Rendering stops if the callback returns false.
+    fn render_streaming<'a, F>(
+        &mut self,
+        highlighter: impl Iterator<Item = Result<HighlightEvent, Error>>,
+        source: &'a [u8],
+        attribute_callback: &F,
+        mut line_callback: impl FnMut(&str) -> bool,
+    ) -> Result<(), Error>
+    where
+        F: Fn(Highlight) -> &'a [u8],
+    {
+        self.reset();
+        let mut has_lines = false;
+        let mut highlights = Vec::new();
+        for event in highlighter {
+            match event {
+                Ok(HighlightEvent::HighlightStart(s)) => {
+                    highlights.push(s);
+                    self.start_highlight(s, attribute_callback);
+                }
+                Ok(HighlightEvent::HighlightEnd) => {
+                    highlights.pop();
+                    self.end_highlight();
+                }
+                Ok(HighlightEvent::Source { start, end }) => {
+                    // Splitting the text after each line break doesn't change how it is
+                    // rendered, because neither carriage returns nor invalid UTF-8 sequences
+                    // can continue past a line feed.
+                    for text in source[start..end].split_inclusive(|c| *c == b'\n') {
+                        self.add_text(text, &highlights, attribute_callback);
+                        if !self.flush_lines(&mut line_callback, &mut has_lines) {
+                            return Ok(());
+                        }
+                    }
+                }
+                Err(a) => return Err(a),
+            }
+        }
+        // Like `render`, end the last line with a line break. The buffer only contains the
+        // last line if it does not have one already.
+        if !self.html.is_empty() || !has_lines {
+            self.html.push(b'\n');
+            self.line_offsets.push(self.html.len() as u32);
+        }
+        self.flush_lines(&mut line_callback, &mut has_lines);
+        self.reset();
+        Ok(())
+    }
+
+    // Pass each complete line in the buffer to the callback, and then remove those lines
+    // from the buffer. Returns false if the callback does.
+    fn flush_lines(
+        &mut self,
+        line_callback: &mut impl FnMut(&str) -> bool,
+        has_lines: &mut bool,
+    ) -> bool {
+        if self.line_offsets.len() < 2 {
+            return true;
+        }
+        *has_lines = true;
+        let mut result = true;
+        for i in 1..self.line_offsets.len() {
+            let line_start = self.line_offsets[i - 1] as usize;
+            let line_end = self.line_offsets[i] as usize;
+            if !line_callback(str::from_utf8(&self.html[line_start..line_end]).unwrap()) {
+                result = false;
+                break;
+            }
+        }
+        let flushed_len = self.line_offsets.pop().unwrap();
+        self.html.drain(0..flushed_len as usize);
+        self.line_offsets.clear();
+        self.line_offsets.push(0);
+        result
+    }
+
     pub fn lines(&self) -> impl Iterator<Item = &str> {
         self.line_offsets
             .iter()
@@ -1067,6 +1602,76 @@ fn injection_for_match<'a>(
     (language_name, content_node, include_children)
 }
 
+fn smallest_node_containing<'a>(node: Node<'a>, range: &ops::Range<usize>) -> Node<'a> {
+    let mut cursor = node.walk();
+    let mut node = node;
+    'descend: loop {
+        for child in node.children(&mut cursor) {
+            if child.start_byte() <= range.start
+                && child.end_byte() >= range.end
+                && child.child_count() > 0
+            {
+                node = child;
+                continue 'descend;
+            }
+        }
+        return node;
+    }
+}
+
+// The range that covers an entire document.
+fn document_range() -> Range {
+    Range {
+        start_byte: 0,
+        end_byte: usize::MAX,
+        start_point: Point::new(0, 0),
+        end_point: Point::new(usize::MAX, usize::MAX),
+    }
+}
+
+// Edit a layer's range in the same way that `ts_tree_edit` edits a tree's included
+// ranges, so that the ranges stay in step with the layer's tree. A range is only
+// changed if it ends at or after the end of the edited text, and its start is only
+// shifted if it also starts there. A boundary that would overflow becomes unbounded.
+fn edit_range(range: &mut Range, edit: &InputEdit) {
+    fn point_add(a: Point, b: Point) -> Point {
+        if b.row > 0 {
+            Point::new(a.row.wrapping_add(b.row), b.column)
+        } else {
+            Point::new(a.row, a.column.wrapping_add(b.column))
+        }
+    }
+
+    fn point_sub(a: Point, b: Point) -> Point {
+        if a.row > b.row {
+            Point::new(a.row - b.row, a.column)
+        } else {
+            Point::new(0, a.column.wrapping_sub(b.column))
+        }
+    }
+
+    fn edit_position(byte: &mut usize, point: &mut Point, edit: &InputEdit) {
+        *byte = edit.new_end_byte.wrapping_add(*byte - edit.old_end_byte);
+        *point = point_add(
+            edit.new_end_position,
+            point_sub(*point, edit.old_end_position),
+        );
+        if *byte < edit.new_end_byte {
+            *byte = usize::MAX;
+            *point = Point::new(usize::MAX, usize::MAX);
+        }
+    }
+
+    if range.end_byte >= edit.old_end_byte {
+        if range.end_byte != usize::MAX {
+            edit_position(&mut range.end_byte, &mut range.end_point, edit);
+        }
+        if range.start_byte >= edit.old_end_byte {
+            edit_position(&mut range.start_byte, &mut range.start_point, edit);
+        }
+    }
+}
+
 fn shrink_and_clear<T>(vec: &mut Vec<T>, capacity: usize) {
     if vec.len() > capacity {
         vec.truncate(capacity);
@@ -79,6 +79,28 @@ pub struct TSLogger {
 }
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
+pub struct TSParserStats {
+    pub lexed_byte_count: u64,
+    pub relexed_byte_count: u64,
+    pub token_cache_hit_count: u32,
+    pub token_cache_miss_count: u32,
+    pub reused_node_count: u32,
+    pub created_node_count: u32,
+    pub max_version_count: u32,
+    pub total_version_count: u32,
+    pub reduction_count: u32,
+    pub error_recovery_count: u32,
+    pub error_cost: u32,
+    pub condense_stack_count: u32,
+    pub external_scanner_call_count: u32,
+    pub external_scanner_serialized_byte_count: u64,
+    pub stack_node_count: u64,
+    pub stack_allocator_call_count: u64,
+    pub parse_duration_micros: u64,
+    pub balance_duration_micros: u64,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
 pub struct TSInputEdit {
     pub start_byte: u32,
     pub old_end_byte: u32,
@@ -131,6 +153,18 @@ pub struct TSQueryPredicateStep {
     pub type_: TSQueryPredicateStepType,
     pub value_id: u32,
 }
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSQueryTextProvider {
+    pub payload: *mut ::std::os::raw::c_void,
+    pub text: ::std::option::Option<
+        unsafe extern "C" fn(
+            payload: *mut ::std::os::raw::c_void,
+            node: TSNode,
+            length: *mut u32,
+        ) -> *const ::std::os::raw::c_char,
+    >,
+}
 pub const TSQueryError_TSQueryErrorNone: TSQueryError = 0;
 pub const TSQueryError_TSQueryErrorSyntax: TSQueryError = 1;
 pub const TSQueryError_TSQueryErrorNodeType: TSQueryError = 2;
@@ -264,6 +298,44 @@ extern "C" {
         encoding: TSInputEncoding,
     ) -> *mut TSTree;
 }
+extern "C" {
+    #[doc = " Use the parser to parse the contents of a UTF8-encoded file. The first two"]
+    #[doc = " parameters are the same as in the `ts_parser_parse` function above."]
+    #[doc = ""]
+    #[doc = " Where possible, the file is mapped into memory rather than being copied. It"]
+    #[doc = " is unmapped before this function returns. In addition to the reasons given"]
+    #[doc = " for `ts_parser_parse`, this function returns `NULL` if the file cannot be"]
+    #[doc = " read, or if it is larger than 4GB."]
+    pub fn ts_parser_parse_file(
+        self_: *mut TSParser,
+        old_tree: *const TSTree,
+        path: *const ::std::os::raw::c_char,
+    ) -> *mut TSTree;
+}
+extern "C" {
+    #[doc = " Use the parser to parse some source code, reusing syntax trees that were"]
+    #[doc = " produced by parsing separate chunks of the same source code."]
+    #[doc = ""]
+    #[doc = " This makes it possible to parse a large document on several threads. Split"]
+    #[doc = " the document into consecutive chunks, ideally at boundaries between"]
+    #[doc = " top-level constructs, and parse each chunk with a separate parser whose"]
+    #[doc = " included ranges have been set to that chunk. Then pass the resulting trees,"]
+    #[doc = " in order, to this function. The nodes in the chunk trees are reused as if"]
+    #[doc = " they came from an old tree, except near the boundaries between chunks, and"]
+    #[doc = " anywhere that they do not fit together. Those parts of the document are"]
+    #[doc = " parsed again, so the result is the same as if the document had been parsed"]
+    #[doc = " from scratch."]
+    #[doc = ""]
+    #[doc = " The chunk trees are not modified, and they can be deleted afterwards. If the"]
+    #[doc = " parser has a parse that was halted early, it is resumed, and the chunk trees"]
+    #[doc = " are ignored."]
+    pub fn ts_parser_parse_chunks(
+        self_: *mut TSParser,
+        chunks: *mut *const TSTree,
+        chunk_count: u32,
+        input: TSInput,
+    ) -> *mut TSTree;
+}
 extern "C" {
     #[doc = " Instruct the parser to start the next parse from the beginning."]
     #[doc = ""]
@@ -286,6 +358,88 @@ extern "C" {
     #[doc = " Get the duration in microseconds that parsing is allowed to take."]
     pub fn ts_parser_timeout_micros(self_: *const TSParser) -> u64;
 }
+extern "C" {
+    #[doc = " Set whether the parser should allocate the nodes of each new syntax tree"]
+    #[doc = " from large memory blocks that belong to that tree."]
+    #[doc = ""]
+    #[doc = " When this is enabled, deleting a tree frees all of its memory at once,"]
+    #[doc = " instead of visiting each of its nodes, and parsing performs far fewer"]
+    #[doc = " individual allocations. The memory is only reclaimed when the tree and"]
+    #[doc = " every copy of it have been deleted. A tree that is produced by reparsing"]
+    #[doc = " an arena-allocated tree keeps the old tree's memory alive, because it may"]
+    #[doc = " share nodes with it. This mode is therefore best suited to parsing many"]
+    #[doc = " short-lived documents, rather than editing one document for a long time."]
+    #[doc = ""]
+    #[doc = " By default, this is disabled. Changing it does not affect a parse that"]
+    #[doc = " was halted early and is going to be resumed."]
+    pub fn ts_parser_set_arena_allocation(self_: *mut TSParser, enabled: bool);
+}
+extern "C" {
+    #[doc = " Get whether the parser allocates new syntax trees from per-tree arenas."]
+    pub fn ts_parser_arena_allocation(self_: *const TSParser) -> bool;
+}
+extern "C" {
+    #[doc = " Set whether the syntax trees returned by the parser will only be used on"]
+    #[doc = " the thread that created them."]
+    #[doc = ""]
+    #[doc = " Syntax trees share nodes with each other, both with their copies and with"]
+    #[doc = " the trees that are produced by reparsing them, so by default, the reference"]
+    #[doc = " counts of their nodes are updated with atomic operations. When this is"]
+    #[doc = " enabled, the nodes that the parser creates use plain reference counts"]
+    #[doc = " instead, which makes building, balancing, reparsing, and deleting trees"]
+    #[doc = " cheaper."]
+    #[doc = ""]
+    #[doc = " When this is enabled, a returned tree, and any other tree that shares"]
+    #[doc = " nodes with it, must not be used on a different thread. Call `ts_tree_copy`"]
+    #[doc = " to obtain a tree that can be passed to another thread."]
+    #[doc = ""]
+    #[doc = " By default, this is disabled."]
+    pub fn ts_parser_set_single_threaded(self_: *mut TSParser, enabled: bool);
+}
+extern "C" {
+    #[doc = " Get whether the parser's syntax trees are only used on one thread."]
+    pub fn ts_parser_single_threaded(self_: *const TSParser) -> bool;
+}
+extern "C" {
+    #[doc = " Get the counters that the parser collected during the most recent parse."]
+    #[doc = ""]
+    #[doc = " These are cheap enough to always be collected, and are meant to help"]
+    #[doc = " diagnose slow parses, such as an incremental reparse that ended up"]
+    #[doc = " reusing very little of the old tree:"]
+    #[doc = ""]
+    #[doc = " - `lexed_byte_count` - The number of bytes that the lexer scanned,"]
+    #[doc = "   including the bytes that it looked at past the end of each token."]
+    #[doc = " - `relexed_byte_count` - How many of those bytes belonged to tokens that"]
+    #[doc = "   had already been lexed earlier in the parse, and were scanned again."]
+    #[doc = " - `token_cache_hit_count`, `token_cache_miss_count` - The number of times"]
+    #[doc = "   that the parser found a token in its cache of recently lexed tokens, and"]
+    #[doc = "   the number of times that it had to run the lexer instead."]
+    #[doc = " - `reused_node_count` - The number of nodes taken from the old tree."]
+    #[doc = " - `created_node_count` - The number of tokens and nodes that were created."]
+    #[doc = " - `max_version_count` - The largest number of stack versions that the"]
+    #[doc = "   parser processed at once."]
+    #[doc = " - `total_version_count` - The sum, over every position that the parser"]
+    #[doc = "   stopped at, of the number of stack versions that it processed there."]
+    #[doc = " - `reduction_count` - The number of reduce actions that were performed."]
+    #[doc = " - `error_recovery_count` - The number of times that the parser had to"]
+    #[doc = "   recover from an error."]
+    #[doc = " - `error_cost` - The error cost of the resulting tree."]
+    #[doc = " - `condense_stack_count` - The number of times that the parser pruned and"]
+    #[doc = "   merged its stack versions."]
+    #[doc = " - `external_scanner_call_count` - The number of calls to the external"]
+    #[doc = "   scanner's `scan` function."]
+    #[doc = " - `external_scanner_serialized_byte_count` - The total size of the external"]
+    #[doc = "   scanner states that were serialized."]
+    #[doc = " - `stack_node_count`, `stack_allocator_call_count` - The number of parse"]
+    #[doc = "   stack nodes that were used, and the number of allocations that the"]
+    #[doc = "   parse stack needed in order to provide them."]
+    #[doc = " - `parse_duration_micros` - The time spent in the main parsing loop."]
+    #[doc = " - `balance_duration_micros` - The time spent balancing the resulting tree."]
+    #[doc = ""]
+    #[doc = " These are reset when a new parse starts, but not when a parse that was"]
+    #[doc = " halted early is resumed."]
+    pub fn ts_parser_stats(self_: *const TSParser) -> TSParserStats;
+}
 extern "C" {
     #[doc = " Set the parser's current cancellation flag pointer."]
     #[doc = ""]
@@ -372,6 +526,51 @@ extern "C" {
         length: *mut u32,
     ) -> *mut TSRange;
 }
+extern "C" {
+    #[doc = " Build an index that maps each node in the syntax tree to its parent, so"]
+    #[doc = " that `ts_node_parent` can find a node's parent without searching down"]
+    #[doc = " from the root."]
+    #[doc = ""]
+    #[doc = " Once this has been called, the index is also used by copies of the tree,"]
+    #[doc = " and by trees that are produced by reparsing it. These trees build their own"]
+    #[doc = " index the first time that `ts_node_parent` is called on them. Similarly,"]
+    #[doc = " when the tree is edited, its index is discarded and then rebuilt the next"]
+    #[doc = " time that it is needed."]
+    pub fn ts_tree_build_parent_index(self_: *mut TSTree);
+}
+extern "C" {
+    #[doc = " Get the number of bytes of memory used by the tree's parent index. This is"]
+    #[doc = " zero if the index has not been built."]
+    pub fn ts_tree_parent_index_memory_usage(self_: *const TSTree) -> usize;
+}
+extern "C" {
+    #[doc = " Serialize a syntax tree into a compact binary format, so that it can be"]
+    #[doc = " stored and loaded again later using `ts_tree_deserialize`."]
+    #[doc = ""]
+    #[doc = " The returned buffer is allocated using `malloc` and the caller is"]
+    #[doc = " responsible for freeing it using `free`. The length of the buffer will be"]
+    #[doc = " written to the given `length` pointer."]
+    pub fn ts_tree_serialize(self_: *const TSTree, length: *mut u32)
+        -> *mut ::std::os::raw::c_char;
+}
+extern "C" {
+    #[doc = " Load a syntax tree that was serialized using `ts_tree_serialize`."]
+    #[doc = ""]
+    #[doc = " The given language must be the same one that the tree was parsed with. The"]
+    #[doc = " loaded tree can be used in all of the same ways as the original tree,"]
+    #[doc = " including as the old tree when parsing an edited version of the document."]
+    #[doc = " It does not refer to the given buffer, so the buffer can be freed, or"]
+    #[doc = " unmapped if it was a memory-mapped file, as soon as this function returns."]
+    #[doc = ""]
+    #[doc = " Returns `NULL` if the data is not a valid serialized tree, if it has been"]
+    #[doc = " truncated or corrupted, or if it was created with a different language or"]
+    #[doc = " an incompatible version of the library."]
+    pub fn ts_tree_deserialize(
+        data: *const ::std::os::raw::c_char,
+        length: u32,
+        language: *const TSLanguage,
+    ) -> *mut TSTree;
+}
 extern "C" {
     #[doc = " Get the node's type as a null-terminated string."]
     pub fn ts_node_type(arg1: TSNode) -> *const ::std::os::raw::c_char;
@@ -463,6 +662,13 @@ extern "C" {
     #[doc = " See also `ts_node_is_named`."]
     pub fn ts_node_named_child_count(arg1: TSNode) -> u32;
 }
+extern "C" {
+    #[doc = " Get the node's number of descendants, including one for the node itself."]
+    #[doc = ""]
+    #[doc = " Only visible nodes are counted, so this is the number of nodes that a tree"]
+    #[doc = " cursor would visit while walking the node."]
+    pub fn ts_node_descendant_count(arg1: TSNode) -> u32;
+}
 extern "C" {
     #[doc = " Get the node's child with the given field name."]
     pub fn ts_node_child_by_field_name(
@@ -585,6 +791,13 @@ extern "C" {
     #[doc = " if there was no next sibling node."]
     pub fn ts_tree_cursor_goto_next_sibling(arg1: *mut TSTreeCursor) -> bool;
 }
+extern "C" {
+    #[doc = " Move the cursor to the previous sibling of its current node."]
+    #[doc = ""]
+    #[doc = " This returns `true` if the cursor successfully moved, and returns `false`"]
+    #[doc = " if there was no previous sibling node."]
+    pub fn ts_tree_cursor_goto_previous_sibling(arg1: *mut TSTreeCursor) -> bool;
+}
 extern "C" {
     #[doc = " Move the cursor to the first child of its current node."]
     #[doc = ""]
@@ -604,6 +817,23 @@ extern "C" {
     pub fn ts_tree_cursor_goto_first_child_for_point(arg1: *mut TSTreeCursor, arg2: TSPoint)
         -> i64;
 }
+extern "C" {
+    #[doc = " Move the cursor to the node that is the nth descendant of the original node"]
+    #[doc = " that the cursor was constructed with, where zero represents the original"]
+    #[doc = " node itself."]
+    #[doc = ""]
+    #[doc = " Descendants are numbered in the order that a depth-first walk would visit"]
+    #[doc = " them. The cursor skips over entire subtrees that do not contain the goal,"]
+    #[doc = " so the time that this takes depends on the depth of the goal node and the"]
+    #[doc = " number of children of its ancestors, rather than on its index. If the index"]
+    #[doc = " is out of range, the cursor moves to the original node."]
+    pub fn ts_tree_cursor_goto_descendant(arg1: *mut TSTreeCursor, arg2: u32);
+}
+extern "C" {
+    #[doc = " Get the index of the cursor's current node out of all of the descendants of"]
+    #[doc = " the original node that the cursor was constructed with."]
+    pub fn ts_tree_cursor_current_descendant_index(arg1: *const TSTreeCursor) -> u32;
+}
 extern "C" {
     pub fn ts_tree_cursor_copy(arg1: *const TSTreeCursor) -> TSTreeCursor;
 }
@@ -625,6 +855,31 @@ extern "C" {
         error_type: *mut TSQueryError,
     ) -> *mut TSQuery;
 }
+extern "C" {
+    #[doc = " Create a new query that contains all of the patterns from the given"]
+    #[doc = " queries, so that they can all be executed with a single query cursor,"]
+    #[doc = " using one traversal of the syntax tree."]
+    #[doc = ""]
+    #[doc = " The patterns are numbered in order: the patterns of the first query come"]
+    #[doc = " first, followed by those of the second query, and so on. Use"]
+    #[doc = " `ts_query_query_index_for_pattern` to find which query a pattern came"]
+    #[doc = " from. Captures and string literals with the same name are shared between"]
+    #[doc = " the queries, so capture ids in the combined query must be looked up using"]
+    #[doc = " `ts_query_capture_name_for_id` on the combined query. Patterns that were"]
+    #[doc = " disabled in any of the given queries are disabled in the combined query."]
+    #[doc = " Byte offsets, such as those used by `ts_query_start_byte_for_pattern`,"]
+    #[doc = " refer to the concatenation of the queries' source code, in order."]
+    #[doc = ""]
+    #[doc = " The given queries are not modified, and they can be deleted afterwards."]
+    #[doc = " This returns `NULL` if no queries are given, if the queries are for"]
+    #[doc = " different languages, or if the combined query would be too large."]
+    pub fn ts_query_combine(queries: *const *const TSQuery, query_count: u32) -> *mut TSQuery;
+}
+extern "C" {
+    #[doc = " Get the index of the query that the given pattern came from, in a query"]
+    #[doc = " created by `ts_query_combine`. For any other query, this returns zero."]
+    pub fn ts_query_query_index_for_pattern(self_: *const TSQuery, pattern_index: u32) -> u32;
+}
 extern "C" {
     #[doc = " Delete a query, freeing all of the memory that it used."]
     pub fn ts_query_delete(arg1: *mut TSQuery);
@@ -667,9 +922,37 @@ extern "C" {
         length: *mut u32,
     ) -> *const TSQueryPredicateStep;
 }
+extern "C" {
+    #[doc = " Check if one of the given pattern's predicates is evaluated by query"]
+    #[doc = " cursors themselves."]
+    #[doc = ""]
+    #[doc = " The predicate is identified by its position among the pattern's predicates."]
+    #[doc = " The `#eq?`, `#not-eq?`, `#match?`, `#not-match?`, `#any-of?` and"]
+    #[doc = " `#not-any-of?` predicates are built in, as long as their arguments are valid."]
+    #[doc = " A `#match?` predicate is only built in if its regular expression only uses"]
+    #[doc = " the syntax that is supported by the query cursor: literal characters, `.`,"]
+    #[doc = " bracketed character classes, anchors, groups, alternation and repetition."]
+    #[doc = ""]
+    #[doc = " Built-in predicates are only evaluated by cursors that have a text provider."]
+    #[doc = " See `ts_query_cursor_set_text_provider`."]
+    pub fn ts_query_is_predicate_built_in(
+        self_: *const TSQuery,
+        pattern_index: u32,
+        predicate_index: u32,
+    ) -> bool;
+}
 extern "C" {
     pub fn ts_query_is_pattern_rooted(self_: *const TSQuery, pattern_index: u32) -> bool;
 }
+extern "C" {
+    #[doc = " Get the depth of the deepest node in the given pattern, relative to the"]
+    #[doc = " pattern's root nodes, which have a depth of zero."]
+    #[doc = ""]
+    #[doc = " This can be used to find the nodes that may need to be searched again after"]
+    #[doc = " part of a syntax tree has changed: a match that involves a changed node has"]
+    #[doc = " a root node that is at most this many levels above the changed node's parent."]
+    pub fn ts_query_pattern_depth(self_: *const TSQuery, pattern_index: u32) -> u32;
+}
 extern "C" {
     pub fn ts_query_is_pattern_guaranteed_at_step(self_: *const TSQuery, byte_offset: u32) -> bool;
 }
@@ -775,6 +1058,17 @@ extern "C" {
 extern "C" {
     pub fn ts_query_cursor_set_point_range(arg1: *mut TSQueryCursor, arg2: TSPoint, arg3: TSPoint);
 }
+extern "C" {
+    #[doc = " Set the callback that the query cursor uses to obtain the text of captured"]
+    #[doc = " nodes."]
+    #[doc = ""]
+    #[doc = " When a text provider is set, the cursor evaluates the query's built-in"]
+    #[doc = " predicates itself, and discards any match that does not satisfy them before"]
+    #[doc = " returning it. The returned text must remain valid until the next call to"]
+    #[doc = " the callback. Pass a provider whose `text` function is `NULL` in order to"]
+    #[doc = " stop evaluating predicates."]
+    pub fn ts_query_cursor_set_text_provider(arg1: *mut TSQueryCursor, arg2: TSQueryTextProvider);
+}
 extern "C" {
     #[doc = " Advance to the next match of the currently running query."]
     #[doc = ""]
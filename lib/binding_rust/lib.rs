@@ -15,6 +15,7 @@ use std::{
     ptr::{self, NonNull},
     slice, str,
     sync::atomic::AtomicUsize,
+    time::Duration,
     u16,
 };
 
@@ -76,6 +77,32 @@ pub struct InputEdit {
     pub new_end_position: Point,
 }
 
+/// Counters that a [Parser] collects during each parse.
+///
+/// See [Parser::stats] for a description of each field.
+#[doc(alias = "TSParserStats")]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ParserStats {
+    pub lexed_byte_count: u64,
+    pub relexed_byte_count: u64,
+    pub token_cache_hit_count: u32,
+    pub token_cache_miss_count: u32,
+    pub reused_node_count: u32,
+    pub created_node_count: u32,
+    pub max_version_count: u32,
+    pub total_version_count: u32,
+    pub reduction_count: u32,
+    pub error_recovery_count: u32,
+    pub error_cost: u32,
+    pub condense_stack_count: u32,
+    pub external_scanner_call_count: u32,
+    pub external_scanner_serialized_byte_count: u64,
+    pub stack_node_count: u64,
+    pub stack_allocator_call_count: u64,
+    pub parse_duration: Duration,
+    pub balance_duration: Duration,
+}
+
 /// A single node within a syntax `Tree`.
 #[doc(alias = "TSNode")]
 #[derive(Clone, Copy)]
@@ -171,6 +198,39 @@ pub struct QueryMatch<'cursor, 'tree> {
     cursor: *mut ffi::TSQueryCursor,
 }
 
+/// A match of a `Query` that owns its list of captures, as returned by
+/// [QueryCursor::matches_parallel].
+#[derive(Clone, Debug)]
+pub struct OwnedQueryMatch<'tree> {
+    pub pattern_index: usize,
+    pub captures: Vec<QueryCapture<'tree>>,
+}
+
+/// The matches of a `Query` in a syntax tree, which can be kept up to date as
+/// the tree is edited by only searching the parts of the tree that changed.
+pub struct QueryMatchCache<'query> {
+    query: &'query Query,
+    matches: Vec<CachedQueryMatch>,
+    edited_ranges: Vec<ops::Range<usize>>,
+    search_depth: usize,
+}
+
+/// A match stored in a `QueryMatchCache`.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct CachedQueryMatch {
+    pub pattern_index: usize,
+    pub captures: Vec<CachedQueryCapture>,
+}
+
+/// A capture stored in a `QueryMatchCache`. The captured node is identified by its
+/// range and its kind, so that the capture stays valid when the tree is replaced.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct CachedQueryCapture {
+    pub index: u32,
+    pub kind_id: u16,
+    pub range: Range,
+}
+
 /// A sequence of `QueryMatch`es associated with a given `QueryCursor`.
 pub struct QueryMatches<'a, 'tree: 'a, T: TextProvider<'a>> {
     ptr: *mut ffi::TSQueryCursor,
@@ -240,6 +300,7 @@ enum TextPredicate {
     CaptureEqString(u32, String, bool),
     CaptureEqCapture(u32, u32, bool),
     CaptureMatchString(u32, regex::bytes::Regex, bool),
+    CaptureAnyString(u32, Vec<String>, bool),
 }
 
 // TODO: Remove this struct at at some point. If `core::str::lossy::Utf8Lossy`
@@ -461,11 +522,16 @@ impl Parser {
     #[doc(alias = "ts_parser_parse")]
     pub fn parse(&mut self, text: impl AsRef<[u8]>, old_tree: Option<&Tree>) -> Option<Tree> {
         let bytes = text.as_ref();
-        let len = bytes.len();
-        self.parse_with(
-            &mut |i, _| if i < len { &bytes[i..] } else { &[] },
-            old_tree,
-        )
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_string(
+                self.0.as_ptr(),
+                c_old_tree,
+                bytes.as_ptr() as *const c_char,
+                bytes.len() as u32,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
     }
 
     /// Parse a slice of UTF16 text.
@@ -595,6 +661,152 @@ impl Parser {
         }
     }
 
+    /// Parse a slice of UTF8 text, reusing the syntax trees of separately-parsed
+    /// chunks of the text.
+    ///
+    /// # Arguments:
+    /// * `text` The UTF8-encoded text to parse.
+    /// * `chunks` Syntax trees for consecutive chunks of `text`, in order. Each
+    ///   one must have been parsed from the entire `text`, with its included
+    ///   ranges set to the chunk.
+    ///
+    /// The result is the same as if the text had been parsed from scratch. See
+    /// [Parser::parse_parallel] for a way to produce the chunk trees.
+    #[doc(alias = "ts_parser_parse_chunks")]
+    pub fn parse_with_chunks(&mut self, text: impl AsRef<[u8]>, chunks: &[Tree]) -> Option<Tree> {
+        let mut bytes = text.as_ref();
+        let mut c_chunks: Vec<*const ffi::TSTree> = chunks
+            .iter()
+            .map(|tree| tree.0.as_ptr() as *const _)
+            .collect();
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_chunks(
+                self.0.as_ptr(),
+                c_chunks.as_mut_ptr(),
+                c_chunks.len() as u32,
+                utf8_slice_input(&mut bytes),
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
+    /// Parse a slice of UTF8 text by splitting it into chunks and parsing the
+    /// chunks on separate threads.
+    ///
+    /// # Arguments:
+    /// * `text` The UTF8-encoded text to parse.
+    /// * `old_tree` A previous syntax tree parsed from the same document. This
+    ///   is only used to choose where to split the text: the chunks begin at
+    ///   the start of its top-level nodes when possible, and at the start of
+    ///   a line otherwise.
+    /// * `thread_count` The maximum number of threads to use.
+    ///
+    /// The chunks are combined using [Parser::parse_with_chunks], so the result
+    /// is the same as if the text had been parsed from scratch. Small texts,
+    /// and parsers that have their own included ranges, are parsed on the
+    /// current thread.
+    pub fn parse_parallel(
+        &mut self,
+        text: impl AsRef<[u8]>,
+        old_tree: Option<&Tree>,
+        thread_count: usize,
+    ) -> Option<Tree> {
+        const MIN_CHUNK_SIZE: usize = 16 * 1024;
+
+        let bytes = text.as_ref();
+        let language = self.language()?;
+        let chunk_count = thread_count.min(bytes.len() / MIN_CHUNK_SIZE);
+        let has_included_ranges = unsafe {
+            let mut count = 0u32;
+            let ranges = ffi::ts_parser_included_ranges(self.0.as_ptr(), &mut count as *mut u32);
+            count != 1 || (*ranges).start_byte != 0 || (*ranges).end_byte != u32::MAX
+        };
+        if chunk_count <= 1 || has_included_ranges {
+            return self.parse(bytes, None);
+        }
+
+        // Choose the split points, preferring the boundaries between top-level
+        // nodes of the old tree, since those are likely to be boundaries between
+        // top-level nodes of the new tree.
+        let top_level_offsets = old_tree.map_or(Vec::new(), |tree| {
+            let root = tree.root_node();
+            let mut cursor = root.walk();
+            root.children(&mut cursor)
+                .map(|child| child.start_byte())
+                .collect::<Vec<_>>()
+        });
+        let mut offsets = vec![0];
+        for i in 1..chunk_count {
+            let ideal = bytes.len() * i / chunk_count;
+            let previous = *offsets.last().unwrap();
+            let offset = match top_level_offsets.binary_search(&ideal) {
+                Ok(j) => Some(top_level_offsets[j]),
+                Err(j) => top_level_offsets
+                    .get(j)
+                    .cloned()
+                    .filter(|offset| offset - ideal < MIN_CHUNK_SIZE),
+            }
+            .unwrap_or_else(|| {
+                bytes[ideal..]
+                    .iter()
+                    .position(|b| *b == b'\n')
+                    .map_or(bytes.len(), |j| ideal + j + 1)
+            });
+            if offset > previous && offset < bytes.len() {
+                offsets.push(offset);
+            }
+        }
+
+        let mut ranges: Vec<Range> = Vec::with_capacity(offsets.len());
+        let mut point = Point::new(0, 0);
+        let mut previous = 0;
+        for start_byte in offsets {
+            for b in &bytes[previous..start_byte] {
+                if *b == b'\n' {
+                    point.row += 1;
+                    point.column = 0;
+                } else {
+                    point.column += 1;
+                }
+            }
+            previous = start_byte;
+            if let Some(range) = ranges.last_mut() {
+                range.end_byte = start_byte;
+                range.end_point = point;
+            }
+            ranges.push(Range {
+                start_byte,
+                end_byte: u32::MAX as usize,
+                start_point: point,
+                end_point: Point::new(u32::MAX as usize, u32::MAX as usize),
+            });
+        }
+
+        // If any of the chunks could not be parsed, then parse the whole text.
+        let arena_allocation = self.arena_allocation();
+        let chunks = std::thread::scope(|scope| {
+            let threads = ranges
+                .into_iter()
+                .map(|range| {
+                    scope.spawn(move || {
+                        let mut parser = Parser::new();
+                        parser.set_language(language).ok()?;
+                        parser.set_arena_allocation(arena_allocation);
+                        parser.set_included_ranges(&[range]).ok()?;
+                        parser.parse(bytes, None)
+                    })
+                })
+                .collect::<Vec<_>>();
+            threads
+                .into_iter()
+                .map(|thread| thread.join().ok().flatten())
+                .collect::<Option<Vec<_>>>()
+                .unwrap_or_default()
+        });
+
+        self.parse_with_chunks(bytes, &chunks)
+    }
+
     /// Instruct the parser to start the next parse from the beginning.
     ///
     /// If the parser previously failed because of a timeout or a cancellation, then
@@ -624,6 +836,89 @@ impl Parser {
         unsafe { ffi::ts_parser_set_timeout_micros(self.0.as_ptr(), timeout_micros) }
     }
 
+    /// Get whether the parser allocates new syntax trees from per-tree arenas.
+    ///
+    /// This is set via [set_arena_allocation](Parser::set_arena_allocation).
+    #[doc(alias = "ts_parser_arena_allocation")]
+    pub fn arena_allocation(&self) -> bool {
+        unsafe { ffi::ts_parser_arena_allocation(self.0.as_ptr()) }
+    }
+
+    /// Set whether the parser should allocate new syntax trees from per-tree
+    /// arenas.
+    ///
+    /// When this is enabled, dropping a [Tree] releases all of its nodes at
+    /// once, instead of freeing them individually. A tree that is produced by
+    /// reparsing an arena-allocated tree keeps the old tree's memory alive, so
+    /// this is best suited to parsing many short-lived documents.
+    #[doc(alias = "ts_parser_set_arena_allocation")]
+    pub fn set_arena_allocation(&mut self, enabled: bool) {
+        unsafe { ffi::ts_parser_set_arena_allocation(self.0.as_ptr(), enabled) }
+    }
+
+    /// Get whether the parser's syntax trees are only used on one thread.
+    ///
+    /// This is set via [set_single_threaded](Parser::set_single_threaded).
+    #[doc(alias = "ts_parser_single_threaded")]
+    pub fn single_threaded(&self) -> bool {
+        unsafe { ffi::ts_parser_single_threaded(self.0.as_ptr()) }
+    }
+
+    /// Set whether the syntax trees returned by the parser will only be used
+    /// on the thread that created them.
+    ///
+    /// When this is enabled, the reference counts of the nodes that the parser
+    /// creates are never updated with atomic operations, which makes parsing,
+    /// reparsing, and dropping trees cheaper.
+    ///
+    /// # Safety
+    ///
+    /// A [Tree] returned while this is enabled, and any tree that shares nodes
+    /// with it, such as a tree produced by reparsing it, must not be sent to or
+    /// dropped on another thread. Cloning a tree makes it safe to move the
+    /// clone to a different thread.
+    #[doc(alias = "ts_parser_set_single_threaded")]
+    pub unsafe fn set_single_threaded(&mut self, enabled: bool) {
+        ffi::ts_parser_set_single_threaded(self.0.as_ptr(), enabled)
+    }
+
+    /// Get the counters that the parser collected during the most recent
+    /// parse.
+    ///
+    /// * `lexed_byte_count` - The number of bytes that the lexer scanned,
+    ///   including the bytes that it looked at past the end of each token.
+    /// * `relexed_byte_count` - How many of those bytes belonged to tokens that
+    ///   had already been lexed earlier in the parse.
+    /// * `token_cache_hit_count`, `token_cache_miss_count` - The number of
+    ///   times that the parser found a token in its cache of recently lexed
+    ///   tokens, and the number of times that it had to run the lexer instead.
+    /// * `reused_node_count` - The number of nodes taken from the old tree.
+    /// * `created_node_count` - The number of tokens and nodes that were created.
+    /// * `max_version_count`, `total_version_count` - The largest number of
+    ///   stack versions that the parser processed at one position, and the
+    ///   sum of those numbers over all positions.
+    /// * `reduction_count` - The number of reduce actions that were performed.
+    /// * `error_recovery_count`, `error_cost` - The number of times that the
+    ///   parser had to recover from an error, and the error cost of the
+    ///   resulting tree.
+    /// * `condense_stack_count` - The number of times that the parser pruned
+    ///   and merged its stack versions.
+    /// * `external_scanner_call_count`, `external_scanner_serialized_byte_count` -
+    ///   The number of calls to the external scanner, and the total size of the
+    ///   states that it serialized.
+    /// * `stack_node_count`, `stack_allocator_call_count` - The number of parse
+    ///   stack nodes that were used, and the number of allocations needed to
+    ///   provide them.
+    /// * `parse_duration`, `balance_duration` - The time spent in the main
+    ///   parsing loop, and balancing the resulting tree.
+    ///
+    /// These are reset when a new parse starts, but not when a parse that was
+    /// halted early is resumed.
+    #[doc(alias = "ts_parser_stats")]
+    pub fn stats(&self) -> ParserStats {
+        unsafe { ffi::ts_parser_stats(self.0.as_ptr()) }.into()
+    }
+
     /// Set the ranges of text that the parser should include when parsing.
     ///
     /// By default, the parser will always include entire documents. This function
@@ -693,6 +988,29 @@ impl Parser {
     }
 }
 
+// Create an input that reads the given UTF8 text directly, without calling
+// a Rust closure for each chunk. The input borrows `text`, so it must not be
+// used after `text` goes out of scope.
+fn utf8_slice_input(text: &mut &[u8]) -> ffi::TSInput {
+    unsafe extern "C" fn read(
+        payload: *mut c_void,
+        byte_offset: u32,
+        _: ffi::TSPoint,
+        bytes_read: *mut u32,
+    ) -> *const c_char {
+        let text = *(payload as *const &[u8]);
+        let slice = text.get(byte_offset as usize..).unwrap_or(&[]);
+        *bytes_read = slice.len() as u32;
+        slice.as_ptr() as *const c_char
+    }
+
+    ffi::TSInput {
+        payload: text as *mut &[u8] as *mut c_void,
+        read: Some(read),
+        encoding: ffi::TSInputEncoding_TSInputEncodingUTF8,
+    }
+}
+
 impl Drop for Parser {
     fn drop(&mut self) {
         self.stop_printing_dot_graphs();
@@ -763,6 +1081,55 @@ impl Tree {
             util::CBufferIter::new(ptr, count as usize).map(|r| r.into())
         }
     }
+
+    /// Build an index that maps each node in the tree to its parent, so that
+    /// [Node::parent] does not need to search down from the root.
+    ///
+    /// The index is also used by clones of this tree and by trees that are
+    /// produced by reparsing it. Editing the tree discards the index, and it
+    /// is rebuilt the next time that it is needed.
+    #[doc(alias = "ts_tree_build_parent_index")]
+    pub fn build_parent_index(&mut self) {
+        unsafe { ffi::ts_tree_build_parent_index(self.0.as_ptr()) }
+    }
+
+    /// Get the number of bytes of memory used by the tree's parent index.
+    #[doc(alias = "ts_tree_parent_index_memory_usage")]
+    pub fn parent_index_memory_usage(&self) -> usize {
+        unsafe { ffi::ts_tree_parent_index_memory_usage(self.0.as_ptr()) }
+    }
+
+    /// Serialize the tree into a compact binary format, so that it can be
+    /// stored and loaded again later using [Tree::deserialize].
+    #[doc(alias = "ts_tree_serialize")]
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut length = 0u32;
+        unsafe {
+            let ptr = ffi::ts_tree_serialize(self.0.as_ptr(), &mut length as *mut u32);
+            let result = slice::from_raw_parts(ptr as *const u8, length as usize).to_vec();
+            (FREE_FN)(ptr as *mut c_void);
+            result
+        }
+    }
+
+    /// Load a tree that was serialized using [Tree::serialize].
+    ///
+    /// The `language` must be the one that the tree was parsed with. Returns
+    /// `None` if the data is not a valid serialized tree for that language.
+    #[doc(alias = "ts_tree_deserialize")]
+    pub fn deserialize(data: &[u8], language: Language) -> Option<Tree> {
+        if data.len() > u32::MAX as usize {
+            return None;
+        }
+        unsafe {
+            let ptr = ffi::ts_tree_deserialize(
+                data.as_ptr() as *const c_char,
+                data.len() as u32,
+                language.0,
+            );
+            NonNull::new(ptr).map(Tree)
+        }
+    }
 }
 
 impl fmt::Debug for Tree {
@@ -948,6 +1315,15 @@ impl<'tree> Node<'tree> {
         unsafe { ffi::ts_node_named_child_count(self.0) as usize }
     }
 
+    /// Get this node's number of descendants, including one for the node itself.
+    ///
+    /// Only visible nodes are counted, so this is the number of nodes that a
+    /// [TreeCursor] would visit while walking the node.
+    #[doc(alias = "ts_node_descendant_count")]
+    pub fn descendant_count(&self) -> usize {
+        unsafe { ffi::ts_node_descendant_count(self.0) as usize }
+    }
+
     /// Get the first child with the given field name.
     ///
     /// If multiple children may have the same field name, access them using
@@ -1265,6 +1641,34 @@ impl<'a> TreeCursor<'a> {
         return unsafe { ffi::ts_tree_cursor_goto_next_sibling(&mut self.0) };
     }
 
+    /// Move this cursor to the previous sibling of its current node.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns `false`
+    /// if there was no previous sibling node.
+    #[doc(alias = "ts_tree_cursor_goto_previous_sibling")]
+    pub fn goto_previous_sibling(&mut self) -> bool {
+        return unsafe { ffi::ts_tree_cursor_goto_previous_sibling(&mut self.0) };
+    }
+
+    /// Move this cursor to the node that is the nth descendant of the original
+    /// node that the cursor was constructed with, where zero represents the
+    /// original node itself.
+    ///
+    /// Descendants are numbered in the order that a depth-first walk would visit
+    /// them, and whole subtrees that do not contain the goal are skipped. If the
+    /// index is out of range, the cursor moves to the original node.
+    #[doc(alias = "ts_tree_cursor_goto_descendant")]
+    pub fn goto_descendant(&mut self, descendant_index: usize) {
+        unsafe { ffi::ts_tree_cursor_goto_descendant(&mut self.0, descendant_index as u32) }
+    }
+
+    /// Get the index of the cursor's current node out of all of the
+    /// descendants of the original node that the cursor was constructed with.
+    #[doc(alias = "ts_tree_cursor_current_descendant_index")]
+    pub fn descendant_index(&self) -> usize {
+        unsafe { ffi::ts_tree_cursor_current_descendant_index(&self.0) as usize }
+    }
+
     /// Move this cursor to the first child of its current node that extends beyond
     /// the given byte offset.
     ///
@@ -1412,6 +1816,38 @@ impl Query {
             });
         }
 
+        unsafe { Query::from_raw(ptr, source) }
+    }
+
+    /// Create a query that contains all of the patterns from the given
+    /// queries, so that they can be executed using a single traversal of a
+    /// syntax tree.
+    ///
+    /// The patterns of the first query come first, followed by those of the
+    /// second query, and so on. Use [Query::query_index_for_pattern] to find
+    /// which query a pattern came from. Captures with the same name are shared
+    /// between the queries. Byte offsets, such as those returned by
+    /// [Query::start_byte_for_pattern], refer to the concatenation of the
+    /// queries' sources.
+    ///
+    /// Returns `None` if no queries are given, if the queries are for different
+    /// languages, or if the combined query would be too large.
+    #[doc(alias = "ts_query_combine")]
+    pub fn combine(queries: &[&Query]) -> Option<Self> {
+        let pointers = queries
+            .iter()
+            .map(|query| query.ptr.as_ptr() as *const ffi::TSQuery)
+            .collect::<Vec<_>>();
+        let ptr = unsafe { ffi::ts_query_combine(pointers.as_ptr(), pointers.len() as u32) };
+        if ptr.is_null() {
+            return None;
+        }
+
+        // The predicates have already been validated in the individual queries.
+        unsafe { Query::from_raw(ptr, "") }.ok()
+    }
+
+    unsafe fn from_raw(ptr: *mut ffi::TSQuery, source: &str) -> Result<Self, QueryError> {
         let string_count = unsafe { ffi::ts_query_string_count(ptr) };
         let capture_count = unsafe { ffi::ts_query_capture_count(ptr) };
         let pattern_count = unsafe { ffi::ts_query_pattern_count(ptr) as usize };
@@ -1490,11 +1926,18 @@ impl Query {
             let mut property_predicates = Vec::new();
             let mut property_settings = Vec::new();
             let mut general_predicates = Vec::new();
-            for p in predicate_steps.split(|s| s.type_ == type_done) {
+            for (predicate_index, p) in predicate_steps.split(|s| s.type_ == type_done).enumerate()
+            {
                 if p.is_empty() {
                     continue;
                 }
 
+                // Predicates that are built into the C library are evaluated by
+                // the query cursor, but are still validated here.
+                let is_built_in = unsafe {
+                    ffi::ts_query_is_predicate_built_in(ptr, i as u32, predicate_index as u32)
+                };
+
                 if p[0].type_ != type_string {
                     return Err(predicate_error(
                         row,
@@ -1526,6 +1969,9 @@ impl Query {
                         }
 
                         let is_positive = operator_name == "eq?";
+                        if is_built_in {
+                            continue;
+                        }
                         text_predicates.push(if p[2].type_ == type_capture {
                             TextPredicate::CaptureEqCapture(
                                 p[1].value_id,
@@ -1562,6 +2008,9 @@ impl Query {
                         }
 
                         let is_positive = operator_name == "match?";
+                        if is_built_in {
+                            continue;
+                        }
                         let regex = &string_values[p[2].value_id as usize];
                         text_predicates.push(TextPredicate::CaptureMatchString(
                             p[1].value_id,
@@ -1572,6 +2021,42 @@ impl Query {
                         ));
                     }
 
+                    "any-of?" | "not-any-of?" => {
+                        if p.len() < 2 {
+                            return Err(predicate_error(row, format!(
+                                "Wrong number of arguments to #any-of? predicate. Expected at least 1, got {}.",
+                                p.len() - 1
+                            )));
+                        }
+                        if p[1].type_ != type_capture {
+                            return Err(predicate_error(row, format!(
+                                "First argument to #any-of? predicate must be a capture name. Got literal \"{}\".",
+                                string_values[p[1].value_id as usize],
+                            )));
+                        }
+
+                        let mut values = Vec::new();
+                        for arg in &p[2..] {
+                            if arg.type_ == type_capture {
+                                return Err(predicate_error(row, format!(
+                                    "Arguments to #any-of? predicate must be literals. Got capture @{}.",
+                                    result.capture_names[arg.value_id as usize],
+                                )));
+                            }
+                            values.push(string_values[arg.value_id as usize].clone());
+                        }
+
+                        let is_positive = operator_name == "any-of?";
+                        if is_built_in {
+                            continue;
+                        }
+                        text_predicates.push(TextPredicate::CaptureAnyString(
+                            p[1].value_id,
+                            values,
+                            is_positive,
+                        ));
+                    }
+
                     "set!" => property_settings.push(Self::parse_property(
                         row,
                         &operator_name,
@@ -1625,6 +2110,22 @@ impl Query {
         Ok(result)
     }
 
+    /// Get the index of the query that the given pattern came from, in a query
+    /// that was created by [Query::combine]. For other queries, this is zero.
+    #[doc(alias = "ts_query_query_index_for_pattern")]
+    pub fn query_index_for_pattern(&self, pattern_index: usize) -> usize {
+        if pattern_index >= self.text_predicates.len() {
+            panic!(
+                "Pattern index is {} but the pattern count is {}",
+                pattern_index,
+                self.text_predicates.len(),
+            );
+        }
+        unsafe {
+            ffi::ts_query_query_index_for_pattern(self.ptr.as_ptr(), pattern_index as u32) as usize
+        }
+    }
+
     /// Get the byte offset where the given pattern starts in the query's source.
     #[doc(alias = "ts_query_start_byte_for_pattern")]
     pub fn start_byte_for_pattern(&self, pattern_index: usize) -> usize {
@@ -1719,6 +2220,13 @@ impl Query {
         unsafe { ffi::ts_query_is_pattern_rooted(self.ptr.as_ptr(), index as u32) }
     }
 
+    /// Get the depth of the deepest node in a given pattern, relative to the
+    /// pattern's root nodes.
+    #[doc(alias = "ts_query_pattern_depth")]
+    pub fn pattern_depth(&self, index: usize) -> usize {
+        unsafe { ffi::ts_query_pattern_depth(self.ptr.as_ptr(), index as u32) as usize }
+    }
+
     /// Check if a given step in a query is 'definite'.
     ///
     /// A query step is 'definite' if its parent pattern will be guaranteed to match
@@ -1730,6 +2238,22 @@ impl Query {
         }
     }
 
+    /// Check if one of a pattern's predicates is evaluated by query cursors
+    /// themselves, instead of by this binding.
+    ///
+    /// The predicate is identified by its position among all of the pattern's
+    /// predicates.
+    #[doc(alias = "ts_query_is_predicate_built_in")]
+    pub fn is_predicate_built_in(&self, pattern_index: usize, predicate_index: usize) -> bool {
+        unsafe {
+            ffi::ts_query_is_predicate_built_in(
+                self.ptr.as_ptr(),
+                pattern_index as u32,
+                predicate_index as u32,
+            )
+        }
+    }
+
     fn parse_property(
         row: usize,
         function_name: &str,
@@ -1873,6 +2397,139 @@ impl QueryCursor {
         }
     }
 
+    /// Find all of the matches of a query in a syntax tree, searching separate
+    /// byte ranges of the tree on separate threads.
+    ///
+    /// # Arguments:
+    /// * `query` The query to execute.
+    /// * `tree` The syntax tree to search. The whole tree is searched, regardless
+    ///   of this cursor's byte and point ranges. Only its match limit is used.
+    /// * `text` The source code of the tree, used to evaluate text predicates.
+    /// * `thread_count` The maximum number of threads to use.
+    ///
+    /// The tree is split at the boundaries between its top-level nodes. Each
+    /// match is reported by the thread whose range contains its earliest
+    /// capture, so a match that spans two ranges is only reported once. The
+    /// matches are sorted by the position of their earliest capture, and then
+    /// by pattern index. Small trees, and queries with patterns that can match
+    /// without capturing any nodes, are searched on the current thread.
+    pub fn matches_parallel<'tree>(
+        &self,
+        query: &Query,
+        tree: &'tree Tree,
+        text: &[u8],
+        thread_count: usize,
+    ) -> Vec<OwnedQueryMatch<'tree>> {
+        const MIN_RANGE_SIZE: usize = 16 * 1024;
+
+        // A match's earliest capture determines which range it belongs to.
+        struct RawMatch {
+            owner: usize,
+            pattern_index: usize,
+            captures: Vec<(ffi::TSNode, u32)>,
+        }
+
+        // The nodes all belong to `tree`, which outlives the threads.
+        unsafe impl Send for RawMatch {}
+
+        fn collect_matches(
+            match_limit: u32,
+            query: &Query,
+            tree: &Tree,
+            text: &[u8],
+            range: ops::Range<usize>,
+        ) -> Vec<RawMatch> {
+            // Extend the range by a byte on each side so that empty nodes at
+            // its boundaries are found.
+            let mut cursor = QueryCursor::new();
+            cursor.set_match_limit(match_limit);
+            cursor.set_byte_range(range.start.saturating_sub(1)..range.end.saturating_add(1));
+            let mut result = cursor
+                .matches(query, tree.root_node(), text)
+                .filter_map(|m| {
+                    let owner = m.captures.iter().map(|c| c.node.start_byte()).min()?;
+                    if !range.contains(&owner) {
+                        return None;
+                    }
+                    Some(RawMatch {
+                        owner,
+                        pattern_index: m.pattern_index,
+                        captures: m.captures.iter().map(|c| (c.node.0, c.index)).collect(),
+                    })
+                })
+                .collect::<Vec<_>>();
+            result.sort_by_key(|m| (m.owner, m.pattern_index));
+            result
+        }
+
+        // Split the tree at the boundaries between the children of the first
+        // node that has more than one child.
+        let mut root = tree.root_node();
+        while root.child_count() == 1 {
+            root = root.child(0).unwrap();
+        }
+        let range_count = thread_count
+            .min(root.child_count())
+            .min(root.byte_range().len() / MIN_RANGE_SIZE);
+        let every_pattern_captures = (0..query.pattern_count()).all(|i| {
+            query.capture_quantifiers(i).iter().any(|quantifier| {
+                *quantifier == CaptureQuantifier::One || *quantifier == CaptureQuantifier::OneOrMore
+            })
+        });
+
+        let match_limit = self.match_limit();
+        let matches = if range_count <= 1 || !every_pattern_captures {
+            collect_matches(match_limit, query, tree, text, 0..usize::MAX)
+        } else {
+            // Choose the children that start closest to evenly-spaced byte offsets.
+            let mut cursor = root.walk();
+            let top_level_offsets = root
+                .children(&mut cursor)
+                .map(|child| child.start_byte())
+                .collect::<Vec<_>>();
+            let mut offsets = vec![0];
+            for i in 1..range_count {
+                let ideal = root.start_byte() + root.byte_range().len() * i / range_count;
+                let j = top_level_offsets.partition_point(|offset| *offset < ideal);
+                if let Some(offset) = top_level_offsets.get(j) {
+                    if *offset > *offsets.last().unwrap() {
+                        offsets.push(*offset);
+                    }
+                }
+            }
+            offsets.push(usize::MAX);
+
+            std::thread::scope(|scope| {
+                let threads = offsets
+                    .windows(2)
+                    .map(|range| {
+                        let range = range[0]..range[1];
+                        scope.spawn(move || collect_matches(match_limit, query, tree, text, range))
+                    })
+                    .collect::<Vec<_>>();
+                threads
+                    .into_iter()
+                    .flat_map(|thread| thread.join().unwrap())
+                    .collect::<Vec<_>>()
+            })
+        };
+
+        matches
+            .into_iter()
+            .map(|m| OwnedQueryMatch {
+                pattern_index: m.pattern_index,
+                captures: m
+                    .captures
+                    .into_iter()
+                    .map(|(node, index)| QueryCapture {
+                        node: Node::new(node).unwrap(),
+                        index,
+                    })
+                    .collect(),
+            })
+            .collect()
+    }
+
     /// Set the range in which the query will be executed, in terms of byte offsets.
     #[doc(alias = "ts_query_cursor_set_byte_range")]
     pub fn set_byte_range(&mut self, range: ops::Range<usize>) -> &mut Self {
@@ -1900,6 +2557,226 @@ impl QueryCursor {
     }
 }
 
+impl<'query> QueryMatchCache<'query> {
+    /// Find all of the matches of a query in a syntax tree.
+    ///
+    /// Only matches that capture at least one node are stored.
+    pub fn new(query: &'query Query, tree: &Tree, text: &[u8]) -> Self {
+        // A change can affect any match whose root node is close enough
+        // to the changed node for the deepest pattern to reach it.
+        let search_depth = (0..query.pattern_count())
+            .map(|i| query.pattern_depth(i) + 1)
+            .max()
+            .unwrap_or(0);
+        let mut cursor = QueryCursor::new();
+        let matches = cursor
+            .matches(query, tree.root_node(), text)
+            .filter_map(|m| CachedQueryMatch::new(&m))
+            .collect::<Vec<_>>();
+        let mut result = QueryMatchCache {
+            query,
+            matches,
+            edited_ranges: Vec::new(),
+            search_depth,
+        };
+        result.sort();
+        result
+    }
+
+    /// Get the query whose matches are stored in this cache.
+    pub fn query(&self) -> &'query Query {
+        self.query
+    }
+
+    /// Get the stored matches, sorted by the position of their earliest
+    /// capture, and then by pattern index.
+    pub fn matches(&self) -> &[CachedQueryMatch] {
+        &self.matches
+    }
+
+    /// Edit the stored matches to keep them in sync with source code that has
+    /// been edited.
+    ///
+    /// This should be called with each edit that is passed to [Tree::edit]. The
+    /// matches that touch the edited text are discarded, and are found again
+    /// by the next call to [update](QueryMatchCache::update).
+    pub fn edit(&mut self, edit: &InputEdit) {
+        self.matches.retain(|m| {
+            let span = m.byte_span();
+            span.end < edit.start_byte || span.start > edit.old_end_byte
+        });
+        for m in &mut self.matches {
+            if m.captures[0].range.start_byte > edit.old_end_byte {
+                for capture in &mut m.captures {
+                    capture.range = edit_range(capture.range, edit);
+                }
+            }
+        }
+
+        for range in &mut self.edited_ranges {
+            range.start = edit_byte(range.start, edit, edit.start_byte);
+            range.end = edit_byte(range.end, edit, edit.new_end_byte);
+        }
+        self.edited_ranges.push(edit.start_byte..edit.new_end_byte);
+    }
+
+    /// Update the stored matches for a new syntax tree.
+    ///
+    /// # Arguments:
+    /// * `tree` The new syntax tree.
+    /// * `text` The source code of the new tree, used to evaluate text predicates.
+    /// * `changed_ranges` The ranges whose syntactic structure differs between
+    ///   the old tree and the new tree, as returned by [Tree::changed_ranges].
+    ///
+    /// The query is only executed within the nodes that enclose the changed
+    /// ranges and the edited text, expanded by the depth of the query's deepest
+    /// pattern, so that every match that could have been affected is found again.
+    pub fn update(
+        &mut self,
+        tree: &Tree,
+        text: &[u8],
+        changed_ranges: impl IntoIterator<Item = Range>,
+    ) {
+        let root = tree.root_node();
+        let search_depth = self.search_depth;
+        let mut ranges = changed_ranges
+            .into_iter()
+            .map(|range| range.start_byte..range.end_byte)
+            .chain(self.edited_ranges.drain(..))
+            .map(|range| {
+                let mut node = root
+                    .descendant_for_byte_range(range.start, range.end)
+                    .unwrap_or(root);
+                for _ in 0..search_depth {
+                    match node.parent() {
+                        Some(parent) => node = parent,
+                        None => break,
+                    }
+                }
+                node.start_byte().min(range.start)..node.end_byte().max(range.end)
+            })
+            .collect::<Vec<_>>();
+        ranges.sort_unstable_by_key(|range| range.start);
+
+        let mut search_ranges: Vec<ops::Range<usize>> = Vec::with_capacity(ranges.len());
+        for range in ranges {
+            if let Some(last) = search_ranges.last_mut() {
+                if range.start <= last.end {
+                    last.end = last.end.max(range.end);
+                    continue;
+                }
+            }
+            search_ranges.push(range);
+        }
+        if search_ranges.is_empty() {
+            return;
+        }
+
+        // Replace the matches within the search ranges. The cursor also finds
+        // matches that extend outside of the range it searches, so each match is
+        // only kept by the first search range that it intersects.
+        self.matches
+            .retain(|m| !search_ranges.iter().any(|range| m.intersects(range)));
+        let mut cursor = QueryCursor::new();
+        for (i, range) in search_ranges.iter().enumerate() {
+            cursor.set_byte_range(range.clone());
+            for m in cursor.matches(self.query, root, text) {
+                if let Some(m) = CachedQueryMatch::new(&m) {
+                    if m.intersects(range) && !search_ranges[..i].iter().any(|r| m.intersects(r)) {
+                        self.matches.push(m);
+                    }
+                }
+            }
+        }
+        self.sort();
+    }
+
+    fn sort(&mut self) {
+        self.matches
+            .sort_by_key(|m| (m.captures[0].range.start_byte, m.pattern_index));
+    }
+}
+
+impl CachedQueryMatch {
+    fn new(m: &QueryMatch) -> Option<Self> {
+        let mut captures = m
+            .captures
+            .iter()
+            .map(|capture| CachedQueryCapture {
+                index: capture.index,
+                kind_id: capture.node.kind_id(),
+                range: capture.node.range(),
+            })
+            .collect::<Vec<_>>();
+        if captures.is_empty() {
+            return None;
+        }
+
+        // Keep the earliest capture first, for sorting.
+        let earliest = (0..captures.len())
+            .min_by_key(|i| captures[*i].range.start_byte)
+            .unwrap();
+        if earliest != 0 {
+            let capture = captures.remove(earliest);
+            captures.insert(0, capture);
+        }
+        Some(CachedQueryMatch {
+            pattern_index: m.pattern_index,
+            captures,
+        })
+    }
+
+    fn byte_span(&self) -> ops::Range<usize> {
+        let end = self
+            .captures
+            .iter()
+            .map(|c| c.range.end_byte)
+            .max()
+            .unwrap();
+        self.captures[0].range.start_byte..end
+    }
+
+    fn intersects(&self, range: &ops::Range<usize>) -> bool {
+        let span = self.byte_span();
+        span.start < range.end && span.end.max(span.start + 1) > range.start
+    }
+}
+
+impl CachedQueryCapture {
+    /// Find the captured node in the syntax tree that the cache was last
+    /// updated with.
+    pub fn node<'tree>(&self, tree: &'tree Tree) -> Option<Node<'tree>> {
+        // Search all of the nodes that touch the start of the range, because
+        // the captured node may be empty.
+        let start = self.range.start_byte;
+        let end = self.range.end_byte;
+        let mut cursor = tree.walk();
+        loop {
+            let node = cursor.node();
+            if node.start_byte() == start
+                && node.end_byte() == end
+                && node.kind_id() == self.kind_id
+            {
+                return Some(node);
+            }
+            if node.start_byte() <= start
+                && node.end_byte() >= end
+                && cursor.goto_first_child_for_byte(start).is_some()
+            {
+                continue;
+            }
+            loop {
+                if cursor.goto_next_sibling() && cursor.node().start_byte() <= start {
+                    break;
+                }
+                if !cursor.goto_parent() {
+                    return None;
+                }
+            }
+        }
+    }
+}
+
 impl<'a, 'tree> QueryMatch<'a, 'tree> {
     pub fn id(&self) -> u32 {
         self.id
@@ -1948,24 +2825,6 @@ impl<'a, 'tree> QueryMatch<'a, 'tree> {
         buffer2: &mut Vec<u8>,
         text_provider: &mut impl TextProvider<'a>,
     ) -> bool {
-        fn get_text<'a, 'b: 'a, I: Iterator<Item = &'b [u8]>>(
-            buffer: &'a mut Vec<u8>,
-            mut chunks: I,
-        ) -> &'a [u8] {
-            let first_chunk = chunks.next().unwrap_or(&[]);
-            if let Some(next_chunk) = chunks.next() {
-                buffer.clear();
-                buffer.extend_from_slice(first_chunk);
-                buffer.extend_from_slice(next_chunk);
-                for chunk in chunks {
-                    buffer.extend_from_slice(chunk);
-                }
-                buffer.as_slice()
-            } else {
-                first_chunk
-            }
-        }
-
         query.text_predicates[self.pattern_index]
             .iter()
             .all(|predicate| match predicate {
@@ -2001,10 +2860,89 @@ impl<'a, 'tree> QueryMatch<'a, 'tree> {
                         None => true,
                     }
                 }
+                TextPredicate::CaptureAnyString(i, values, is_positive) => {
+                    let node = self.nodes_for_capture_index(*i).next();
+                    match node {
+                        Some(node) => {
+                            let text = get_text(buffer1, text_provider.text(node));
+                            values.iter().any(|value| text == value.as_bytes()) == *is_positive
+                        }
+                        None => true,
+                    }
+                }
             })
     }
 }
 
+fn get_text<'a, 'b: 'a, I: Iterator<Item = &'b [u8]>>(
+    buffer: &'a mut Vec<u8>,
+    mut chunks: I,
+) -> &'a [u8] {
+    let first_chunk = chunks.next().unwrap_or(&[]);
+    if let Some(next_chunk) = chunks.next() {
+        buffer.clear();
+        buffer.extend_from_slice(first_chunk);
+        buffer.extend_from_slice(next_chunk);
+        for chunk in chunks {
+            buffer.extend_from_slice(chunk);
+        }
+        buffer.as_slice()
+    } else {
+        first_chunk
+    }
+}
+
+struct TextCallbackPayload<'a, 'b, T: TextProvider<'a>> {
+    text_provider: &'b mut T,
+    buffer: &'b mut Vec<u8>,
+    _phantom: PhantomData<&'a ()>,
+}
+
+unsafe extern "C" fn text_callback<'a, T: TextProvider<'a>>(
+    payload: *mut c_void,
+    node: ffi::TSNode,
+    length: *mut u32,
+) -> *const c_char {
+    let payload = &mut *(payload as *mut TextCallbackPayload<'a, '_, T>);
+    let text = get_text(
+        payload.buffer,
+        payload.text_provider.text(Node::new(node).unwrap()),
+    );
+    *length = text.len() as u32;
+    text.as_ptr() as *const c_char
+}
+
+// Call one of the query cursor's iteration functions while it uses the given
+// text provider to evaluate the query's built-in predicates.
+unsafe fn with_text_provider<'a, T: TextProvider<'a>, R>(
+    ptr: *mut ffi::TSQueryCursor,
+    text_provider: &mut T,
+    buffer: &mut Vec<u8>,
+    f: impl FnOnce() -> R,
+) -> R {
+    let mut payload = TextCallbackPayload {
+        text_provider,
+        buffer,
+        _phantom: PhantomData,
+    };
+    ffi::ts_query_cursor_set_text_provider(
+        ptr,
+        ffi::TSQueryTextProvider {
+            payload: &mut payload as *mut TextCallbackPayload<'a, '_, T> as *mut c_void,
+            text: Some(text_callback::<T>),
+        },
+    );
+    let result = f();
+    ffi::ts_query_cursor_set_text_provider(
+        ptr,
+        ffi::TSQueryTextProvider {
+            payload: ptr::null_mut(),
+            text: None,
+        },
+    );
+    result
+}
+
 impl QueryProperty {
     pub fn new(key: &str, value: Option<&str>, capture_id: Option<usize>) -> Self {
         QueryProperty {
@@ -2022,7 +2960,10 @@ impl<'a, 'tree, T: TextProvider<'a>> Iterator for QueryMatches<'a, 'tree, T> {
         unsafe {
             loop {
                 let mut m = MaybeUninit::<ffi::TSQueryMatch>::uninit();
-                if ffi::ts_query_cursor_next_match(self.ptr, m.as_mut_ptr()) {
+                let ptr = self.ptr;
+                if with_text_provider(ptr, &mut self.text_provider, &mut self.buffer1, || {
+                    ffi::ts_query_cursor_next_match(ptr, m.as_mut_ptr())
+                }) {
                     let result = QueryMatch::new(m.assume_init(), self.ptr);
                     if result.satisfies_text_predicates(
                         self.query,
@@ -2048,11 +2989,14 @@ impl<'a, 'tree, T: TextProvider<'a>> Iterator for QueryCaptures<'a, 'tree, T> {
             loop {
                 let mut capture_index = 0u32;
                 let mut m = MaybeUninit::<ffi::TSQueryMatch>::uninit();
-                if ffi::ts_query_cursor_next_capture(
-                    self.ptr,
-                    m.as_mut_ptr(),
-                    &mut capture_index as *mut u32,
-                ) {
+                let ptr = self.ptr;
+                if with_text_provider(ptr, &mut self.text_provider, &mut self.buffer1, || {
+                    ffi::ts_query_cursor_next_capture(
+                        ptr,
+                        m.as_mut_ptr(),
+                        &mut capture_index as *mut u32,
+                    )
+                }) {
                     let result = QueryMatch::new(m.assume_init(), self.ptr);
                     if result.satisfies_text_predicates(
                         self.query,
@@ -2204,6 +3148,31 @@ impl From<ffi::TSRange> for Range {
     }
 }
 
+impl From<ffi::TSParserStats> for ParserStats {
+    fn from(stats: ffi::TSParserStats) -> Self {
+        Self {
+            lexed_byte_count: stats.lexed_byte_count,
+            relexed_byte_count: stats.relexed_byte_count,
+            token_cache_hit_count: stats.token_cache_hit_count,
+            token_cache_miss_count: stats.token_cache_miss_count,
+            reused_node_count: stats.reused_node_count,
+            created_node_count: stats.created_node_count,
+            max_version_count: stats.max_version_count,
+            total_version_count: stats.total_version_count,
+            reduction_count: stats.reduction_count,
+            error_recovery_count: stats.error_recovery_count,
+            error_cost: stats.error_cost,
+            condense_stack_count: stats.condense_stack_count,
+            external_scanner_call_count: stats.external_scanner_call_count,
+            external_scanner_serialized_byte_count: stats.external_scanner_serialized_byte_count,
+            stack_node_count: stats.stack_node_count,
+            stack_allocator_call_count: stats.stack_allocator_call_count,
+            parse_duration: Duration::from_micros(stats.parse_duration_micros),
+            balance_duration: Duration::from_micros(stats.balance_duration_micros),
+        }
+    }
+}
+
 impl<'a> Into<ffi::TSInputEdit> for &'a InputEdit {
     fn into(self) -> ffi::TSInputEdit {
         ffi::TSInputEdit {
@@ -2273,6 +3242,36 @@ fn predicate_error(row: usize, message: String) -> QueryError {
     }
 }
 
+// Shift a byte offset that is not before the given edit. Offsets within the
+// edited text are replaced with `default`.
+fn edit_byte(byte: usize, edit: &InputEdit, default: usize) -> usize {
+    if byte >= edit.old_end_byte {
+        byte - edit.old_end_byte + edit.new_end_byte
+    } else if byte > edit.start_byte {
+        default
+    } else {
+        byte
+    }
+}
+
+// Shift a range that lies after the given edit.
+fn edit_range(range: Range, edit: &InputEdit) -> Range {
+    let edit_point = |point: Point| Point {
+        row: point.row - edit.old_end_position.row + edit.new_end_position.row,
+        column: if point.row == edit.old_end_position.row {
+            point.column - edit.old_end_position.column + edit.new_end_position.column
+        } else {
+            point.column
+        },
+    };
+    Range {
+        start_byte: range.start_byte - edit.old_end_byte + edit.new_end_byte,
+        end_byte: range.end_byte - edit.old_end_byte + edit.new_end_byte,
+        start_point: edit_point(range.start_point),
+        end_point: edit_point(range.end_point),
+    }
+}
+
 impl fmt::Display for IncludedRangesError {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         write!(f, "Incorrect range by index: {}", self.0)
@@ -80,6 +80,27 @@ typedef struct {
   void (*log)(void *payload, TSLogType, const char *);
 } TSLogger;
 
+typedef struct {
+  uint64_t lexed_byte_count;
+  uint64_t relexed_byte_count;
+  uint32_t token_cache_hit_count;
+  uint32_t token_cache_miss_count;
+  uint32_t reused_node_count;
+  uint32_t created_node_count;
+  uint32_t max_version_count;
+  uint32_t total_version_count;
+  uint32_t reduction_count;
+  uint32_t error_recovery_count;
+  uint32_t error_cost;
+  uint32_t condense_stack_count;
+  uint32_t external_scanner_call_count;
+  uint64_t external_scanner_serialized_byte_count;
+  uint64_t stack_node_count;
+  uint64_t stack_allocator_call_count;
+  uint64_t parse_duration_micros;
+  uint64_t balance_duration_micros;
+} TSParserStats;
+
 typedef struct {
   uint32_t start_byte;
   uint32_t old_end_byte;
@@ -132,6 +153,11 @@ typedef struct {
   uint32_t value_id;
 } TSQueryPredicateStep;
 
+typedef struct {
+  void *payload;
+  const char *(*text)(void *payload, TSNode node, uint32_t *length);
+} TSQueryTextProvider;
+
 typedef enum {
   TSQueryErrorNone = 0,
   TSQueryErrorSyntax,
@@ -283,6 +309,46 @@ TSTree *ts_parser_parse_string_encoding(
   TSInputEncoding encoding
 );
 
+/**
+ * Use the parser to parse the contents of a UTF8-encoded file. The first two
+ * parameters are the same as in the `ts_parser_parse` function above.
+ *
+ * Where possible, the file is mapped into memory rather than being copied. It
+ * is unmapped before this function returns. In addition to the reasons given
+ * for `ts_parser_parse`, this function returns `NULL` if the file cannot be
+ * read, or if it is larger than 4GB.
+ */
+TSTree *ts_parser_parse_file(
+  TSParser *self,
+  const TSTree *old_tree,
+  const char *path
+);
+
+/**
+ * Use the parser to parse some source code, reusing syntax trees that were
+ * produced by parsing separate chunks of the same source code.
+ *
+ * This makes it possible to parse a large document on several threads. Split
+ * the document into consecutive chunks, ideally at boundaries between
+ * top-level constructs, and parse each chunk with a separate parser whose
+ * included ranges have been set to that chunk. Then pass the resulting trees,
+ * in order, to this function. The nodes in the chunk trees are reused as if
+ * they came from an old tree, except near the boundaries between chunks, and
+ * anywhere that they do not fit together. Those parts of the document are
+ * parsed again, so the result is the same as if the document had been parsed
+ * from scratch.
+ *
+ * The chunk trees are not modified, and they can be deleted afterwards. If the
+ * parser has a parse that was halted early, it is resumed, and the chunk trees
+ * are ignored.
+ */
+TSTree *ts_parser_parse_chunks(
+  TSParser *self,
+  const TSTree **chunks,
+  uint32_t chunk_count,
+  TSInput input
+);
+
 /**
  * Instruct the parser to start the next parse from the beginning.
  *
@@ -308,6 +374,93 @@ void ts_parser_set_timeout_micros(TSParser *self, uint64_t timeout);
  */
 uint64_t ts_parser_timeout_micros(const TSParser *self);
 
+/**
+ * Set whether the parser should allocate the nodes of each new syntax tree
+ * from large memory blocks that belong to that tree.
+ *
+ * When this is enabled, deleting a tree frees all of its memory at once,
+ * instead of visiting each of its nodes, and parsing performs far fewer
+ * individual allocations. The memory is only reclaimed when the tree and
+ * every copy of it have been deleted. A tree that is produced by reparsing
+ * an arena-allocated tree keeps the old tree's memory alive, because it may
+ * share nodes with it. This mode is therefore best suited to parsing many
+ * short-lived documents, rather than editing one document for a long time.
+ *
+ * By default, this is disabled. Changing it does not affect a parse that
+ * was halted early and is going to be resumed.
+ */
+void ts_parser_set_arena_allocation(TSParser *self, bool enabled);
+
+/**
+ * Get whether the parser allocates new syntax trees from per-tree arenas.
+ */
+bool ts_parser_arena_allocation(const TSParser *self);
+
+/**
+ * Set whether the syntax trees returned by the parser will only be used on
+ * the thread that created them.
+ *
+ * Syntax trees share nodes with each other, both with their copies and with
+ * the trees that are produced by reparsing them, so by default, the reference
+ * counts of their nodes are updated with atomic operations. When this is
+ * enabled, the nodes that the parser creates use plain reference counts
+ * instead, which makes building, balancing, reparsing, and deleting trees
+ * cheaper.
+ *
+ * When this is enabled, a returned tree, and any other tree that shares
+ * nodes with it, must not be used on a different thread. Call `ts_tree_copy`
+ * to obtain a tree that can be passed to another thread.
+ *
+ * By default, this is disabled.
+ */
+void ts_parser_set_single_threaded(TSParser *self, bool enabled);
+
+/**
+ * Get whether the parser's syntax trees are only used on one thread.
+ */
+bool ts_parser_single_threaded(const TSParser *self);
+
+/**
+ * Get the counters that the parser collected during the most recent parse.
+ *
+ * These are cheap enough to always be collected, and are meant to help
+ * diagnose slow parses, such as an incremental reparse that ended up
+ * reusing very little of the old tree:
+ *
+ * - `lexed_byte_count` - The number of bytes that the lexer scanned,
+ *   including the bytes that it looked at past the end of each token.
+ * - `relexed_byte_count` - How many of those bytes belonged to tokens that
+ *   had already been lexed earlier in the parse, and were scanned again.
+ * - `token_cache_hit_count`, `token_cache_miss_count` - The number of times
+ *   that the parser found a token in its cache of recently lexed tokens, and
+ *   the number of times that it had to run the lexer instead.
+ * - `reused_node_count` - The number of nodes taken from the old tree.
+ * - `created_node_count` - The number of tokens and nodes that were created.
+ * - `max_version_count` - The largest number of stack versions that the
+ *   parser processed at once.
+ * - `total_version_count` - The sum, over every position that the parser
+ *   stopped at, of the number of stack versions that it processed there.
+ * - `reduction_count` - The number of reduce actions that were performed.
+ * - `error_recovery_count` - The number of times that the parser had to
+ *   recover from an error.
+ * - `error_cost` - The error cost of the resulting tree.
+ * - `condense_stack_count` - The number of times that the parser pruned and
+ *   merged its stack versions.
+ * - `external_scanner_call_count` - The number of calls to the external
+ *   scanner's `scan` function.
+ * - `external_scanner_serialized_byte_count` - The total size of the external
+ *   scanner states that were serialized.
+ * - `stack_node_count`, `stack_allocator_call_count` - The number of parse
+ *   stack nodes that were used, and the number of allocations that the
+ *   parse stack needed in order to provide them.
+ * - `parse_duration_micros` - The time spent in the main parsing loop.
+ * - `balance_duration_micros` - The time spent balancing the resulting tree.
+ *
+ * These are reset when a new parse starts, but not when a parse that was
+ * halted early is resumed.
+ */
+TSParserStats ts_parser_stats(const TSParser *self);
+
 /**
  * Set the parser's current cancellation flag pointer.
  *
@@ -410,11 +563,59 @@ TSRange *ts_tree_get_changed_ranges(
   uint32_t *length
 );
 
+/**
+ * Build an index that maps each node in the syntax tree to its parent, so
+ * that `ts_node_parent` can find a node's parent without searching down
+ * from the root.
+ *
+ * Once this has been called, the index is also used by copies of the tree,
+ * and by trees that are produced by reparsing it. These trees build their own
+ * index the first time that `ts_node_parent` is called on them. Similarly,
+ * when the tree is edited, its index is discarded and then rebuilt the next
+ * time that it is needed.
+ */
+void ts_tree_build_parent_index(TSTree *self);
+
+/**
+ * Get the number of bytes of memory used by the tree's parent index. This is
+ * zero if the index has not been built.
+ */
+size_t ts_tree_parent_index_memory_usage(const TSTree *self);
+
 /**
  * Write a DOT graph describing the syntax tree to the given file.
  */
 void ts_tree_print_dot_graph(const TSTree *, FILE *);
 
+/**
+ * Serialize a syntax tree into a compact binary format, so that it can be
+ * stored and loaded again later using `ts_tree_deserialize`.
+ *
+ * The returned buffer is allocated using `malloc` and the caller is
+ * responsible for freeing it using `free`. The length of the buffer will be
+ * written to the given `length` pointer.
+ */
+char *ts_tree_serialize(const TSTree *self, uint32_t *length);
+
+/**
+ * Load a syntax tree that was serialized using `ts_tree_serialize`.
+ *
+ * The given language must be the same one that the tree was parsed with. The
+ * loaded tree can be used in all of the same ways as the original tree,
+ * including as the old tree when parsing an edited version of the document.
+ * It does not refer to the given buffer, so the buffer can be freed, or
+ * unmapped if it was a memory-mapped file, as soon as this function returns.
+ *
+ * Returns `NULL` if the data is not a valid serialized tree, if it has been
+ * truncated or corrupted, or if it was created with a different language or
+ * an incompatible version of the library.
+ */
+TSTree *ts_tree_deserialize(
+  const char *data,
+  uint32_t length,
+  const TSLanguage *language
+);
+
 /******************/
 /* Section - Node */
 /******************/
@@ -529,6 +730,14 @@ TSNode ts_node_named_child(TSNode, uint32_t);
  */
 uint32_t ts_node_named_child_count(TSNode);
 
+/**
+ * Get the node's number of descendants, including one for the node itself.
+ *
+ * Only visible nodes are counted, so this is the number of nodes that a tree
+ * cursor would visit while walking the node.
+ */
+uint32_t ts_node_descendant_count(TSNode);
+
 /**
  * Get the node's child with the given field name.
  */
@@ -658,6 +867,14 @@ bool ts_tree_cursor_goto_parent(TSTreeCursor *);
  */
 bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *);
 
+/**
+ * Move the cursor to the previous sibling of its current node.
+ *
+ * This returns `true` if the cursor successfully moved, and returns `false`
+ * if there was no previous sibling node.
+ */
+bool ts_tree_cursor_goto_previous_sibling(TSTreeCursor *);
+
 /**
  * Move the cursor to the first child of its current node.
  *
@@ -676,6 +893,25 @@ bool ts_tree_cursor_goto_first_child(TSTreeCursor *);
 int64_t ts_tree_cursor_goto_first_child_for_byte(TSTreeCursor *, uint32_t);
 int64_t ts_tree_cursor_goto_first_child_for_point(TSTreeCursor *, TSPoint);
 
+/**
+ * Move the cursor to the node that is the nth descendant of the original node
+ * that the cursor was constructed with, where zero represents the original
+ * node itself.
+ *
+ * Descendants are numbered in the order that a depth-first walk would visit
+ * them. The cursor skips over entire subtrees that do not contain the goal,
+ * so the time that this takes depends on the depth of the goal node and the
+ * number of children of its ancestors, rather than on its index. If the index
+ * is out of range, the cursor moves to the original node.
+ */
+void ts_tree_cursor_goto_descendant(TSTreeCursor *, uint32_t);
+
+/**
+ * Get the index of the cursor's current node out of all of the descendants of
+ * the original node that the cursor was constructed with.
+ */
+uint32_t ts_tree_cursor_current_descendant_index(const TSTreeCursor *);
+
 TSTreeCursor ts_tree_cursor_copy(const TSTreeCursor *);
 
 /*******************/
@@ -701,6 +937,33 @@ TSQuery *ts_query_new(
   TSQueryError *error_type
 );
 
+/**
+ * Create a new query that contains all of the patterns from the given
+ * queries, so that they can all be executed with a single query cursor,
+ * using one traversal of the syntax tree.
+ *
+ * The patterns are numbered in order: the patterns of the first query come
+ * first, followed by those of the second query, and so on. Use
+ * `ts_query_query_index_for_pattern` to find which query a pattern came
+ * from. Captures and string literals with the same name are shared between
+ * the queries, so capture ids in the combined query must be looked up using
+ * `ts_query_capture_name_for_id` on the combined query. Patterns that were
+ * disabled in any of the given queries are disabled in the combined query.
+ * Byte offsets, such as those used by `ts_query_start_byte_for_pattern`,
+ * refer to the concatenation of the queries' source code, in order.
+ *
+ * The given queries are not modified, and they can be deleted afterwards.
+ * This returns `NULL` if no queries are given, if the queries are for
+ * different languages, or if the combined query would be too large.
+ */
+TSQuery *ts_query_combine(const TSQuery *const *queries, uint32_t query_count);
+
+/**
+ * Get the index of the query that the given pattern came from, in a query
+ * created by `ts_query_combine`. For any other query, this returns zero.
+ */
+uint32_t ts_query_query_index_for_pattern(const TSQuery *self, uint32_t pattern_index);
+
 /**
  * Delete a query, freeing all of the memory that it used.
  */
@@ -743,11 +1006,44 @@ const TSQueryPredicateStep *ts_query_predicates_for_pattern(
   uint32_t *length
 );
 
+/**
+ * Check if one of the given pattern's predicates is evaluated by query
+ * cursors themselves.
+ *
+ * The predicate is identified by its position among the pattern's predicates.
+ * The `#eq?`, `#not-eq?`, `#match?`, `#not-match?`, `#any-of?` and
+ * `#not-any-of?` predicates are built in, as long as their arguments are valid.
+ * A `#match?` predicate is only built in if its regular expression only uses
+ * the syntax that is supported by the query cursor: literal characters, `.`,
+ * bracketed character classes, anchors, groups, alternation and repetition.
+ *
+ * Built-in predicates are only evaluated by cursors that have a text provider.
+ * See `ts_query_cursor_set_text_provider`.
+ */
+bool ts_query_is_predicate_built_in(
+  const TSQuery *self,
+  uint32_t pattern_index,
+  uint32_t predicate_index
+);
+
 bool ts_query_is_pattern_rooted(
   const TSQuery *self,
   uint32_t pattern_index
 );
 
+/**
+ * Get the depth of the deepest node in the given pattern, relative to the
+ * pattern's root nodes, which have a depth of zero.
+ *
+ * This can be used to find the nodes that may need to be searched again after
+ * part of a syntax tree has changed: a match that involves a changed node has
+ * a root node that is at most this many levels above the changed node's parent.
+ */
+uint32_t ts_query_pattern_depth(
+  const TSQuery *self,
+  uint32_t pattern_index
+);
+
 bool ts_query_is_pattern_guaranteed_at_step(
   const TSQuery *self,
   uint32_t byte_offset
@@ -853,6 +1149,18 @@ void ts_query_cursor_set_match_limit(TSQueryCursor *, uint32_t);
 void ts_query_cursor_set_byte_range(TSQueryCursor *, uint32_t, uint32_t);
 void ts_query_cursor_set_point_range(TSQueryCursor *, TSPoint, TSPoint);
 
+/**
+ * Set the callback that the query cursor uses to obtain the text of captured
+ * nodes.
+ *
+ * When a text provider is set, the cursor evaluates the query's built-in
+ * predicates itself, and discards any match that does not satisfy them before
+ * returning it. The returned text must remain valid until the next call to
+ * the callback. Pass a provider whose `text` function is `NULL` in order to
+ * stop evaluating predicates.
+ */
+void ts_query_cursor_set_text_provider(TSQueryCursor *, TSQueryTextProvider);
+
 /**
  * Advance to the next match of the currently running query.
  *
@@ -79,6 +79,28 @@ typedef struct {
   uint16_t external_lex_state;
 } TSLexMode;
 
+typedef struct {
+  uint32_t start;
+  uint16_t action;
+} TSLexRange;
+
+typedef struct {
+  TSSymbol accept_symbol;
+  bool accepts;
+  uint16_t eof_action;
+  uint16_t transitions;
+  uint16_t range_count;
+  uint32_t range_index;
+} TSLexState;
+
+typedef struct {
+  const uint8_t *character_classes;
+  const uint16_t *transitions;
+  uint16_t class_count;
+  const TSLexState *states;
+  const TSLexRange *ranges;
+} TSLexTable;
+
 typedef union {
   TSParseAction action;
   struct {
@@ -162,6 +184,62 @@ struct TSLanguage {
 
 #define END_STATE() return result;
 
+/*
+ *  Table-driven Lexer
+ *
+ *  Lex functions can also be generated as tables, which are interpreted by
+ *  `ts_lex_table_run`. A transition is stored as the next state plus one,
+ *  with the `TS_LEX_TABLE_SKIP` bit set if the character should be skipped,
+ *  or as zero if there is no transition. Each state's transitions for ASCII
+ *  characters are stored in a row of the `transitions` table, indexed by
+ *  each character's class, where class zero is used for negative lookahead
+ *  values. Its transitions for other characters are stored as a list of
+ *  ranges, sorted by their starting character, and each range extends to
+ *  the start of the next one.
+ */
+
+#define TS_LEX_TABLE_SKIP 0x8000
+
+static inline bool ts_lex_table_run(
+  const TSLexTable *table,
+  TSLexer *lexer,
+  TSStateId state
+) {
+  bool result = false;
+  for (;;) {
+    const TSLexState *entry = &table->states[state];
+    if (entry->accepts) {
+      result = true;
+      lexer->result_symbol = entry->accept_symbol;
+      lexer->mark_end(lexer);
+    }
+
+    uint16_t action;
+    int32_t lookahead = lexer->lookahead;
+    if (entry->eof_action && lexer->eof(lexer)) {
+      action = entry->eof_action;
+    } else if (lookahead < 128) {
+      uint8_t character_class = lookahead < 0 ? 0 : table->character_classes[lookahead];
+      action = table->transitions[entry->transitions * table->class_count + character_class];
+    } else {
+      const TSLexRange *ranges = &table->ranges[entry->range_index];
+      uint32_t size = entry->range_count;
+      uint32_t index = 0;
+      while (size > 1) {
+        uint32_t half_size = size / 2;
+        uint32_t mid_index = index + half_size;
+        if (ranges[mid_index].start <= (uint32_t)lookahead) index = mid_index;
+        size -= half_size;
+      }
+      action = ranges[index].action;
+    }
+
+    if (!action) return result;
+    state = (action & ~TS_LEX_TABLE_SKIP) - 1;
+    lexer->advance(lexer, action & TS_LEX_TABLE_SKIP);
+  }
+}
+
 /*
  *  Parse Table Macros
  */
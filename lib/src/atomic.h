@@ -1,6 +1,7 @@
 #ifndef TREE_SITTER_ATOMIC_H_
 #define TREE_SITTER_ATOMIC_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __TINYC__
@@ -19,6 +20,14 @@ static inline uint32_t atomic_dec(volatile uint32_t *p) {
   return *p;
 }
 
+static inline bool atomic_compare_exchange_pointer(void *volatile *p, void *expected, void *desired) {
+  if (*p != expected) return false;
+  *p = desired;
+  return true;
+}
+
+static inline void atomic_yield(void) {}
+
 #elif defined(_WIN32)
 
 #include <windows.h>
@@ -35,8 +44,18 @@ static inline uint32_t atomic_dec(volatile uint32_t *p) {
   return InterlockedDecrement((long volatile *)p);
 }
 
+static inline bool atomic_compare_exchange_pointer(void *volatile *p, void *expected, void *desired) {
+  return InterlockedCompareExchangePointer(p, desired, expected) == expected;
+}
+
+static inline void atomic_yield(void) {
+  SwitchToThread();
+}
+
 #else
 
+#include <sched.h>
+
 static inline size_t atomic_load(const volatile size_t *p) {
 #ifdef __ATOMIC_RELAXED
   return __atomic_load_n(p, __ATOMIC_RELAXED);
@@ -53,6 +72,14 @@ static inline uint32_t atomic_dec(volatile uint32_t *p) {
   return __sync_sub_and_fetch(p, 1u);
 }
 
+static inline bool atomic_compare_exchange_pointer(void *volatile *p, void *expected, void *desired) {
+  return __sync_bool_compare_and_swap(p, expected, desired);
+}
+
+static inline void atomic_yield(void) {
+  sched_yield();
+}
+
 #endif
 
 #endif  // TREE_SITTER_ATOMIC_H_
@@ -40,6 +40,10 @@ static inline TSClock clock_after(TSClock base, TSDuration duration) {
   return base + duration;
 }
 
+static inline TSDuration duration_between(TSClock start, TSClock end) {
+  return end > start ? end - start : 0;
+}
+
 static inline bool clock_is_null(TSClock self) {
   return !self;
 }
@@ -85,6 +89,13 @@ static inline TSClock clock_after(TSClock base, TSDuration duration) {
   return result;
 }
 
+static inline TSDuration duration_between(TSClock start, TSClock end) {
+  int64_t micros =
+    (int64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+    (int64_t)(end.tv_nsec - start.tv_nsec) / 1000;
+  return micros > 0 ? (TSDuration)micros : 0;
+}
+
 static inline bool clock_is_null(TSClock self) {
   return !self.tv_sec;
 }
@@ -128,6 +139,10 @@ static inline TSClock clock_after(TSClock base, TSDuration duration) {
   return base + duration;
 }
 
+static inline TSDuration duration_between(TSClock start, TSClock end) {
+  return end > start ? end - start : 0;
+}
+
 static inline bool clock_is_null(TSClock self) {
   return !self;
 }
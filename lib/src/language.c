@@ -1,8 +1,17 @@
 #include "./language.h"
+#include "./alloc.h"
+#include "./atomic.h"
 #include "./subtree.h"
 #include "./error_costs.h"
 #include <string.h>
 
+// The small state indices that are currently in use, and a lock that guards
+// the list. The lock is only held while the list is searched or updated, never
+// while an index is built, so it is acquired by spinning. A thread that finds
+// it held yields, so that the holder can run even on a single core.
+static SmallStateIndex *small_state_indices = NULL;
+static void *volatile small_state_index_lock = NULL;
+
 uint32_t ts_language_symbol_count(const TSLanguage *self) {
   return self->symbol_count + self->alias_count;
 }
@@ -15,8 +24,123 @@ uint32_t ts_language_field_count(const TSLanguage *self) {
   return self->field_count;
 }
 
+static void ts_language__lock_small_state_indices(void) {
+  while (!atomic_compare_exchange_pointer(&small_state_index_lock, NULL, (void *)1)) {
+    atomic_yield();
+  }
+}
+
+static void ts_language__unlock_small_state_indices(void) {
+  atomic_compare_exchange_pointer(&small_state_index_lock, (void *)1, NULL);
+}
+
+static SmallStateIndex *ts_language__find_small_state_index(const TSLanguage *self) {
+  for (SmallStateIndex *index = small_state_indices; index; index = index->next) {
+    if (index->language == self) return index;
+  }
+  return NULL;
+}
+
+static SmallStateIndex *ts_language__build_small_state_index(const TSLanguage *self) {
+  uint32_t small_state_count = self->state_count - self->large_state_count;
+  SmallStateIndex *result = ts_malloc(sizeof(SmallStateIndex));
+  result->language = self;
+  result->next = NULL;
+  result->ref_count = 1;
+  result->offsets = ts_malloc((small_state_count + 1) * sizeof(uint32_t));
+
+  uint32_t entry_count = 0;
+  for (uint32_t i = 0; i < small_state_count; i++) {
+    const uint16_t *data = &self->small_parse_table[self->small_parse_table_map[i]];
+    uint16_t group_count = *(data++);
+    for (unsigned j = 0; j < group_count; j++) {
+      uint16_t symbol_count = data[1];
+      entry_count += symbol_count;
+      data += 2 + symbol_count;
+    }
+  }
+  result->entries = ts_malloc(entry_count * sizeof(SmallStateEntry));
+
+  // Within a state, each symbol belongs to only one group, so the
+  // entries can be sorted by inserting each one into place.
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < small_state_count; i++) {
+    result->offsets[i] = offset;
+    SmallStateEntry *entries = &result->entries[offset];
+    uint32_t count = 0;
+    const uint16_t *data = &self->small_parse_table[self->small_parse_table_map[i]];
+    uint16_t group_count = *(data++);
+    for (unsigned j = 0; j < group_count; j++) {
+      uint16_t value = *(data++);
+      uint16_t symbol_count = *(data++);
+      for (unsigned k = 0; k < symbol_count; k++) {
+        TSSymbol symbol = *(data++);
+        uint32_t position = count++;
+        while (position > 0 && entries[position - 1].symbol > symbol) {
+          entries[position] = entries[position - 1];
+          position--;
+        }
+        entries[position] = (SmallStateEntry) {.symbol = symbol, .value = value};
+      }
+    }
+    offset += count;
+  }
+  result->offsets[small_state_count] = offset;
+  return result;
+}
+
+static void ts_language__delete_small_state_index(SmallStateIndex *self) {
+  ts_free(self->offsets);
+  ts_free(self->entries);
+  ts_free(self);
+}
+
+// Get the small state index for a language, building it if no other parser
+// is using it. The index is built without holding the lock. If two threads
+// build it at the same time, only one of the two indices is kept.
+const SmallStateIndex *ts_language_small_state_index_acquire(const TSLanguage *self) {
+  if (!self || self->state_count <= self->large_state_count) return NULL;
+
+  ts_language__lock_small_state_indices();
+  SmallStateIndex *result = ts_language__find_small_state_index(self);
+  if (result) result->ref_count++;
+  ts_language__unlock_small_state_indices();
+  if (result) return result;
+
+  SmallStateIndex *new_index = ts_language__build_small_state_index(self);
+  ts_language__lock_small_state_indices();
+  result = ts_language__find_small_state_index(self);
+  if (result) {
+    result->ref_count++;
+  } else {
+    result = new_index;
+    result->next = small_state_indices;
+    small_state_indices = result;
+    new_index = NULL;
+  }
+  ts_language__unlock_small_state_indices();
+  if (new_index) ts_language__delete_small_state_index(new_index);
+  return result;
+}
+
+void ts_language_small_state_index_release(const SmallStateIndex *self) {
+  if (!self) return;
+
+  SmallStateIndex *deleted_index = NULL;
+  ts_language__lock_small_state_indices();
+  SmallStateIndex **link = &small_state_indices;
+  while (*link != self) link = &(*link)->next;
+  if (--(*link)->ref_count == 0) {
+    deleted_index = *link;
+    *link = deleted_index->next;
+  }
+  ts_language__unlock_small_state_indices();
+  if (deleted_index) ts_language__delete_small_state_index(deleted_index);
+}
+
 void ts_language_table_entry(
   const TSLanguage *self,
+  const SmallStateIndex *small_state_index,
   TSStateId state,
   TSSymbol symbol,
   TableEntry *result
@@ -27,7 +151,7 @@ void ts_language_table_entry(
     result->actions = NULL;
   } else {
     assert(symbol < self->token_count);
-    uint32_t action_index = ts_language_lookup(self, state, symbol);
+    uint32_t action_index = ts_language_lookup(self, small_state_index, state, symbol);
     const TSParseActionEntry *entry = &self->parse_actions[action_index];
     result->action_count = entry->entry.count;
     result->is_reusable = entry->entry.reusable;
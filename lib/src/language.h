@@ -32,7 +32,33 @@ typedef struct {
   uint16_t action_count;
 } LookaheadIterator;
 
-void ts_language_table_entry(const TSLanguage *, TSStateId, TSSymbol, TableEntry *);
+typedef struct {
+  TSSymbol symbol;
+  uint16_t value;
+} SmallStateEntry;
+
+// An index of a language's 'small' parse states, which lists the table
+// values of each state sorted by symbol, so that they can be found with a
+// binary search. Indices are shared by all of the parsers that use the same
+// language, and are freed when the last of those parsers releases it.
+typedef struct SmallStateIndex {
+  const TSLanguage *language;
+  struct SmallStateIndex *next;
+  uint32_t ref_count;
+  uint32_t *offsets;
+  SmallStateEntry *entries;
+} SmallStateIndex;
+
+const SmallStateIndex *ts_language_small_state_index_acquire(const TSLanguage *);
+void ts_language_small_state_index_release(const SmallStateIndex *);
+
+void ts_language_table_entry(
+  const TSLanguage *,
+  const SmallStateIndex *,
+  TSStateId,
+  TSSymbol,
+  TableEntry *
+);
 
 TSSymbolMetadata ts_language_symbol_metadata(const TSLanguage *, TSSymbol);
 
@@ -44,23 +70,25 @@ static inline bool ts_language_is_symbol_external(const TSLanguage *self, TSSymb
 
 static inline const TSParseAction *ts_language_actions(
   const TSLanguage *self,
+  const SmallStateIndex *small_state_index,
   TSStateId state,
   TSSymbol symbol,
   uint32_t *count
 ) {
   TableEntry entry;
-  ts_language_table_entry(self, state, symbol, &entry);
+  ts_language_table_entry(self, small_state_index, state, symbol, &entry);
   *count = entry.action_count;
   return entry.actions;
 }
 
 static inline bool ts_language_has_reduce_action(
   const TSLanguage *self,
+  const SmallStateIndex *small_state_index,
   TSStateId state,
   TSSymbol symbol
 ) {
   TableEntry entry;
-  ts_language_table_entry(self, state, symbol, &entry);
+  ts_language_table_entry(self, small_state_index, state, symbol, &entry);
   return entry.action_count > 0 && entry.actions[0].type == TSParseActionTypeReduce;
 }
 
@@ -69,14 +97,30 @@ static inline bool ts_language_has_reduce_action(
 // For non-terminal symbols, the table value represents a successor state.
 // For terminal symbols, it represents an index in the actions table.
 // For 'large' parse states, this is a direct lookup. For 'small' parse
-// states, this requires searching through the symbol groups to find
-// the given symbol.
+// states, this requires searching for the given symbol, either with a
+// binary search of the language's small state index, or, if no index
+// is given, by scanning through the symbol groups.
 static inline uint16_t ts_language_lookup(
   const TSLanguage *self,
+  const SmallStateIndex *small_state_index,
   TSStateId state,
   TSSymbol symbol
 ) {
-  if (state >= self->large_state_count) {
+  if (state >= self->large_state_count && small_state_index) {
+    uint32_t small_state = state - self->large_state_count;
+    uint32_t start = small_state_index->offsets[small_state];
+    uint32_t size = small_state_index->offsets[small_state + 1] - start;
+    if (size == 0) return 0;
+    const SmallStateEntry *entries = &small_state_index->entries[start];
+    uint32_t index = 0;
+    while (size > 1) {
+      uint32_t half_size = size / 2;
+      uint32_t mid_index = index + half_size;
+      if (entries[mid_index].symbol <= symbol) index = mid_index;
+      size -= half_size;
+    }
+    return entries[index].symbol == symbol ? entries[index].value : 0;
+  } else if (state >= self->large_state_count) {
     uint32_t index = self->small_parse_table_map[state - self->large_state_count];
     const uint16_t *data = &self->small_parse_table[index];
     uint16_t group_count = *(data++);
@@ -95,10 +139,11 @@ static inline uint16_t ts_language_lookup(
 
 static inline bool ts_language_has_actions(
   const TSLanguage *self,
+  const SmallStateIndex *small_state_index,
   TSStateId state,
   TSSymbol symbol
 ) {
-  return ts_language_lookup(self, state, symbol) != 0;
+  return ts_language_lookup(self, small_state_index, state, symbol) != 0;
 }
 
 // Iterate over all of the symbols that are valid in the given state.
@@ -180,6 +225,7 @@ static inline bool ts_lookahead_iterator_next(LookaheadIterator *self) {
 
 static inline TSStateId ts_language_next_state(
   const TSLanguage *self,
+  const SmallStateIndex *small_state_index,
   TSStateId state,
   TSSymbol symbol
 ) {
@@ -187,7 +233,13 @@ static inline TSStateId ts_language_next_state(
     return 0;
   } else if (symbol < self->token_count) {
     uint32_t count;
-    const TSParseAction *actions = ts_language_actions(self, state, symbol, &count);
+    const TSParseAction *actions = ts_language_actions(
+      self,
+      small_state_index,
+      state,
+      symbol,
+      &count
+    );
     if (count > 0) {
       TSParseAction action = actions[count - 1];
       if (action.type == TSParseActionTypeShift) {
@@ -196,7 +248,7 @@ static inline TSStateId ts_language_next_state(
     }
     return 0;
   } else {
-    return ts_language_lookup(self, state, symbol);
+    return ts_language_lookup(self, small_state_index, state, symbol);
   }
 }
 
@@ -23,6 +23,11 @@
 
 static const int32_t BYTE_ORDER_MARK = 0xFEFF;
 
+// The maximum number of bytes that are scanned at once when searching for a
+// run of ASCII characters. This keeps the cost of scanning proportional to the
+// amount of text that is actually lexed, even when the chunk is very large.
+#define TS_LEXER_ASCII_SCAN_SIZE 256
+
 static const TSRange DEFAULT_RANGE = {
   .start_point = {
     .row = 0,
@@ -50,24 +55,74 @@ static void ts_lexer__clear_chunk(Lexer *self) {
   self->chunk = NULL;
   self->chunk_size = 0;
   self->chunk_start = 0;
+  self->ascii_run_start = 0;
+  self->ascii_run_end = 0;
 }
 
 // Call the lexer's input callback to obtain a new chunk of source code
-// for the current position.
+// for the current position. If the input is contiguous, then the whole
+// document is used as the chunk, and the callback is not called.
 static void ts_lexer__get_chunk(Lexer *self) {
-  self->chunk_start = self->current_position.bytes;
-  self->chunk = self->input.read(
-    self->input.payload,
-    self->current_position.bytes,
-    self->current_position.extent,
-    &self->chunk_size
-  );
+  if (self->contiguous) {
+    if (self->current_position.bytes < self->document_size) {
+      self->chunk_start = 0;
+      self->chunk = self->document;
+      self->chunk_size = self->document_size;
+    } else {
+      self->chunk_start = self->current_position.bytes;
+      self->chunk_size = 0;
+    }
+  } else {
+    self->chunk_start = self->current_position.bytes;
+    self->chunk = self->input.read(
+      self->input.payload,
+      self->current_position.bytes,
+      self->current_position.extent,
+      &self->chunk_size
+    );
+  }
+  self->ascii_run_start = 0;
+  self->ascii_run_end = 0;
   if (!self->chunk_size) {
     self->current_included_range_index = self->included_range_count;
     self->chunk = NULL;
   }
 }
 
+// Find the number of bytes at the start of the given string that encode
+// ASCII characters. The string is examined eight bytes at a time, so that
+// runs of ASCII text can be found without decoding each character.
+static uint32_t ts_lexer__ascii_prefix_length(
+  const uint8_t *string,
+  uint32_t length,
+  TSInputEncoding encoding
+) {
+  uint64_t mask;
+  uint32_t character_size;
+  if (encoding == TSInputEncodingUTF8) {
+    mask = 0x8080808080808080ull;
+    character_size = 1;
+  } else {
+    mask = 0xFF80FF80FF80FF80ull;
+    character_size = 2;
+  }
+
+  uint32_t i = 0;
+  while (i + sizeof(uint64_t) <= length) {
+    uint64_t word;
+    memcpy(&word, &string[i], sizeof(word));
+    if (word & mask) break;
+    i += sizeof(uint64_t);
+  }
+
+  if (character_size == 1) {
+    while (i < length && string[i] < 0x80) i++;
+  } else {
+    while (i + 2 <= length && *(const uint16_t *)&string[i] < 0x80) i += 2;
+  }
+  return i;
+}
+
 // Decode the next unicode character in the current chunk of source code.
 // This assumes that the lexer has already retrieved a chunk of source
 // code that spans the current position.
@@ -82,6 +137,32 @@ static void ts_lexer__get_lookahead(Lexer *self) {
   }
 
   const uint8_t *chunk = (const uint8_t *)self->chunk + position_in_chunk;
+
+  // Most source code is ASCII, so scan ahead for a run of ASCII characters,
+  // which can be read directly from the chunk without being decoded.
+  if (
+    self->current_position.bytes < self->ascii_run_start ||
+    self->current_position.bytes >= self->ascii_run_end
+  ) {
+    uint32_t scan_size = size < TS_LEXER_ASCII_SCAN_SIZE ? size : TS_LEXER_ASCII_SCAN_SIZE;
+    self->ascii_run_start = self->current_position.bytes;
+    self->ascii_run_end = self->current_position.bytes + ts_lexer__ascii_prefix_length(
+      chunk,
+      scan_size,
+      self->input.encoding
+    );
+  }
+  if (self->current_position.bytes < self->ascii_run_end) {
+    if (self->input.encoding == TSInputEncodingUTF8) {
+      self->data.lookahead = chunk[0];
+      self->lookahead_size = 1;
+    } else {
+      self->data.lookahead = *(const uint16_t *)chunk;
+      self->lookahead_size = 2;
+    }
+    return;
+  }
+
   UnicodeDecodeFunction decode = self->input.encoding == TSInputEncodingUTF8
     ? ts_decode_utf8
     : ts_decode_utf16;
@@ -90,7 +171,7 @@ static void ts_lexer__get_lookahead(Lexer *self) {
 
   // If this chunk ended in the middle of a multi-byte character,
   // try again with a fresh chunk.
-  if (self->data.lookahead == TS_DECODE_ERROR && size < 4) {
+  if (self->data.lookahead == TS_DECODE_ERROR && size < 4 && !self->contiguous) {
     ts_lexer__get_chunk(self);
     chunk = (const uint8_t *)self->chunk;
     size = self->chunk_size;
@@ -155,13 +236,13 @@ static void ts_lexer_goto(Lexer *self, Length position) {
 // Intended to be called only from functions that control logging.
 static void ts_lexer__do_advance(Lexer *self, bool skip) {
   if (self->lookahead_size) {
+    // Update the row and column without branching, since the branch on
+    // newlines is hard to predict.
+    uint32_t is_newline = self->data.lookahead == '\n';
     self->current_position.bytes += self->lookahead_size;
-    if (self->data.lookahead == '\n') {
-      self->current_position.extent.row++;
-      self->current_position.extent.column = 0;
-    } else {
-      self->current_position.extent.column += self->lookahead_size;
-    }
+    self->current_position.extent.row += is_newline;
+    self->current_position.extent.column =
+      (self->current_position.extent.column + self->lookahead_size) & (is_newline - 1);
   }
 
   const TSRange *current_range = NULL;
@@ -307,6 +388,20 @@ void ts_lexer_delete(Lexer *self) {
 
 void ts_lexer_set_input(Lexer *self, TSInput input) {
   self->input = input;
+  self->contiguous = false;
+  self->document = NULL;
+  self->document_size = 0;
+  ts_lexer__clear_chunk(self);
+  ts_lexer_goto(self, self->current_position);
+}
+
+// Set an input whose `read` function returns the whole document when it is
+// called at offset zero. The lexer reads directly from that buffer, which must
+// remain valid until parsing has finished.
+void ts_lexer_set_contiguous_input(Lexer *self, TSInput input) {
+  self->input = input;
+  self->contiguous = true;
+  self->document = input.read(input.payload, 0, POINT_ZERO, &self->document_size);
   ts_lexer__clear_chunk(self);
   ts_lexer_goto(self, self->current_position);
 }
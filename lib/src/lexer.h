@@ -18,6 +18,7 @@ typedef struct {
 
   TSRange *included_ranges;
   const char *chunk;
+  const char *document;
   TSInput input;
   TSLogger logger;
 
@@ -25,8 +26,12 @@ typedef struct {
   uint32_t current_included_range_index;
   uint32_t chunk_start;
   uint32_t chunk_size;
+  uint32_t document_size;
   uint32_t lookahead_size;
+  uint32_t ascii_run_start;
+  uint32_t ascii_run_end;
   bool did_get_column;
+  bool contiguous;
 
   char debug_buffer[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
 } Lexer;
@@ -34,6 +39,7 @@ typedef struct {
 void ts_lexer_init(Lexer *);
 void ts_lexer_delete(Lexer *);
 void ts_lexer_set_input(Lexer *, TSInput);
+void ts_lexer_set_contiguous_input(Lexer *, TSInput);
 void ts_lexer_reset(Lexer *, Length);
 void ts_lexer_start(Lexer *);
 void ts_lexer_finish(Lexer *, uint32_t *);
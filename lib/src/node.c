@@ -70,6 +70,21 @@ static inline NodeChildIterator ts_node_iterate_children(const TSNode *node) {
   };
 }
 
+// Start iterating over a node's children at the given child, using the node's
+// child index to find the child's position.
+static inline NodeChildIterator ts_node_iterate_children_from(
+  const TSNode *node,
+  const SubtreeChildIndex *child_index,
+  uint32_t index
+) {
+  NodeChildIterator result = ts_node_iterate_children(node);
+  const SubtreeChildIndexEntry *entry = &child_index->entries[index];
+  result.position = length_add(result.position, entry->offset);
+  result.child_index = index;
+  result.structural_child_index = entry->structural_index;
+  return result;
+}
+
 static inline bool ts_node_child_iterator_done(NodeChildIterator *self) {
   return self->child_index == self->parent.ptr->child_count;
 }
@@ -146,7 +161,31 @@ static inline TSNode ts_node__child(
 
     TSNode child;
     uint32_t index = 0;
-    NodeChildIterator iterator = ts_node_iterate_children(&result);
+    NodeChildIterator iterator;
+    const SubtreeChildIndex *table = ts_subtree_child_index(
+      ts_node__subtree(result),
+      result.tree->language
+    );
+    if (table) {
+      // Find the last child that is preceded by at most `child_index`
+      // relevant nodes.
+      uint32_t start = 0, end = table->child_count;
+      while (end - start > 1) {
+        uint32_t mid = start + (end - start) / 2;
+        const SubtreeChildIndexEntry *entry = &table->entries[mid];
+        uint32_t preceding = include_anonymous ? entry->visible_index : entry->named_index;
+        if (preceding <= child_index) {
+          start = mid;
+        } else {
+          end = mid;
+        }
+      }
+      const SubtreeChildIndexEntry *entry = &table->entries[start];
+      index = include_anonymous ? entry->visible_index : entry->named_index;
+      iterator = ts_node_iterate_children_from(&result, table, start);
+    } else {
+      iterator = ts_node_iterate_children(&result);
+    }
     while (ts_node_child_iterator_next(&iterator, &child)) {
       if (ts_node__is_relevant(child, include_anonymous)) {
         if (index == child_index) {
@@ -306,7 +345,29 @@ static inline TSNode ts_node__first_child_for_byte(
     did_descend = false;
 
     TSNode child;
-    NodeChildIterator iterator = ts_node_iterate_children(&node);
+    NodeChildIterator iterator;
+    const SubtreeChildIndex *table = ts_subtree_child_index(
+      ts_node__subtree(node),
+      node.tree->language
+    );
+    if (table) {
+      // Skip the children that end before the goal. The end of each child
+      // is stored as the offset of the following entry.
+      uint32_t start_byte = ts_node_start_byte(node);
+      uint32_t start = 0, end = table->child_count;
+      while (start < end) {
+        uint32_t mid = start + (end - start) / 2;
+        if (start_byte + table->entries[mid + 1].offset.bytes > goal) {
+          end = mid;
+        } else {
+          start = mid + 1;
+        }
+      }
+      if (start == table->child_count) break;
+      iterator = ts_node_iterate_children_from(&node, table, start);
+    } else {
+      iterator = ts_node_iterate_children(&node);
+    }
     while (ts_node_child_iterator_next(&iterator, &child)) {
       if (ts_node_end_byte(child) > goal) {
         if (ts_node__is_relevant(child, include_anonymous)) {
@@ -459,6 +520,11 @@ bool ts_node_has_error(TSNode self) {
 }
 
 TSNode ts_node_parent(TSNode self) {
+  const ParentCacheEntry *entry = ts_tree_parent_cache_find(self.tree, self.id);
+  if (entry && entry->child_start_byte == ts_node_start_byte(self)) {
+    return ts_node_new(self.tree, entry->parent, entry->position, entry->alias_symbol);
+  }
+
   TSNode node = ts_tree_root_node(self.tree);
   uint32_t end_byte = ts_node_end_byte(self);
   if (node.id == self.id) return ts_node__null();
@@ -621,6 +687,10 @@ uint32_t ts_node_named_child_count(TSNode self) {
   }
 }
 
+uint32_t ts_node_descendant_count(TSNode self) {
+  return ts_subtree_visible_descendant_count(ts_node__subtree(self)) + 1;
+}
+
 TSNode ts_node_next_sibling(TSNode self) {
   return ts_node__next_sibling(self, true);
 }
@@ -19,6 +19,13 @@
 #include "./subtree.h"
 #include "./tree.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define LOG(...)                                                                            \
   if (self->lexer.logger.log || self->dot_graph_file) {                                     \
     snprintf(self->lexer.debug_buffer, TREE_SITTER_SERIALIZATION_BUFFER_SIZE, __VA_ARGS__); \
@@ -77,10 +84,23 @@ static const unsigned MAX_SUMMARY_DEPTH = 16;
 static const unsigned MAX_COST_DIFFERENCE = 16 * ERROR_COST_PER_SKIPPED_TREE;
 static const unsigned OP_COUNT_PER_TIMEOUT_CHECK = 100;
 
+#define TOKEN_CACHE_SIZE 8
+
 typedef struct {
   Subtree token;
   Subtree last_external_token;
   uint32_t byte_index;
+  TSLexMode lex_mode;
+} TokenCacheEntry;
+
+// Tokens that were recently returned by the lexer. When there are several
+// stack versions, they often need to lex at the same positions, so several
+// entries are stored, keyed by position, lex mode and external scanner state.
+// When the cache is full, the entries are replaced in the order that they
+// were added.
+typedef struct {
+  TokenCacheEntry entries[TOKEN_CACHE_SIZE];
+  unsigned next_index;
 } TokenCache;
 
 struct TSParser {
@@ -88,6 +108,7 @@ struct TSParser {
   Stack *stack;
   SubtreePool tree_pool;
   const TSLanguage *language;
+  const SmallStateIndex *small_state_index;
   ReduceActionSet reduce_actions;
   Subtree finished_tree;
   SubtreeArray trailing_extras;
@@ -105,6 +126,12 @@ struct TSParser {
   Subtree old_tree;
   TSRangeArray included_range_differences;
   unsigned included_range_difference_index;
+  SubtreeArena *arena;
+  bool arena_allocation;
+  bool single_threaded;
+  TSParserStats stats;
+  StackAllocationStats stack_stats_at_start;
+  uint32_t lexed_end_byte;
 };
 
 typedef struct {
@@ -167,6 +194,27 @@ static void ts_parser__log(TSParser *self) {
   }
 }
 
+// Count the bytes that the lexer scanned in one pass, and how many of them
+// were part of a token that had already been lexed earlier in the parse. The
+// lookahead characters past the end of a token are not counted as relexed
+// when the next token is lexed.
+static void ts_parser__record_lexed_bytes(
+  TSParser *self,
+  uint32_t start_byte,
+  uint32_t lookahead_end_byte,
+  uint32_t token_end_byte
+) {
+  if (lookahead_end_byte <= start_byte) return;
+  self->stats.lexed_byte_count += lookahead_end_byte - start_byte;
+  if (self->lexed_end_byte > start_byte) {
+    uint32_t relexed_end_byte = lookahead_end_byte < self->lexed_end_byte
+      ? lookahead_end_byte
+      : self->lexed_end_byte;
+    self->stats.relexed_byte_count += relexed_end_byte - start_byte;
+  }
+  if (token_end_byte > self->lexed_end_byte) self->lexed_end_byte = token_end_byte;
+}
+
 static bool ts_parser__breakdown_top_of_stack(
   TSParser *self,
   StackVersion version
@@ -192,7 +240,12 @@ static bool ts_parser__breakdown_top_of_stack(
         if (ts_subtree_is_error(child)) {
           state = ERROR_STATE;
         } else if (!ts_subtree_extra(child)) {
-          state = ts_language_next_state(self->language, state, ts_subtree_symbol(child));
+          state = ts_language_next_state(
+            self->language,
+            self->small_state_index,
+            state,
+            ts_subtree_symbol(child)
+          );
         }
 
         ts_subtree_retain(child);
@@ -430,12 +483,20 @@ static Subtree ts_parser__lex(
         valid_external_tokens
       );
       ts_lexer_finish(&self->lexer, &lookahead_end_byte);
+      ts_parser__record_lexed_bytes(
+        self,
+        current_position.bytes,
+        lookahead_end_byte,
+        found_token ? self->lexer.token_end_position.bytes : 0
+      );
+      self->stats.external_scanner_call_count++;
 
       if (found_token) {
         external_scanner_state_len = self->language->external_scanner.serialize(
           self->external_scanner_payload,
           self->lexer.debug_buffer
         );
+        self->stats.external_scanner_serialized_byte_count += external_scanner_state_len;
         external_scanner_state_changed = !ts_external_scanner_state_eq(
           ts_subtree_external_scanner_state(external_token),
           self->lexer.debug_buffer,
@@ -478,6 +539,12 @@ static Subtree ts_parser__lex(
     ts_lexer_start(&self->lexer);
     bool found_token = self->language->lex_fn(&self->lexer.data, lex_mode.lex_state);
     ts_lexer_finish(&self->lexer, &lookahead_end_byte);
+    ts_parser__record_lexed_bytes(
+      self,
+      current_position.bytes,
+      lookahead_end_byte,
+      found_token ? self->lexer.token_end_position.bytes : 0
+    );
     if (found_token) break;
 
     if (!error_mode) {
@@ -541,10 +608,22 @@ static Subtree ts_parser__lex(
       uint32_t end_byte = self->lexer.token_end_position.bytes;
       ts_lexer_reset(&self->lexer, self->lexer.token_start_position);
       ts_lexer_start(&self->lexer);
+      bool found_keyword = self->language->keyword_lex_fn(&self->lexer.data, 0);
+      ts_parser__record_lexed_bytes(
+        self,
+        self->lexer.token_start_position.bytes,
+        self->lexer.current_position.bytes,
+        0
+      );
       if (
-        self->language->keyword_lex_fn(&self->lexer.data, 0) &&
+        found_keyword &&
         self->lexer.token_end_position.bytes == end_byte &&
-        ts_language_has_actions(self->language, parse_state, self->lexer.data.result_symbol)
+        ts_language_has_actions(
+          self->language,
+          self->small_state_index,
+          parse_state,
+          self->lexer.data.result_symbol
+        )
       ) {
         is_keyword = true;
         symbol = self->lexer.data.result_symbol;
@@ -566,8 +645,9 @@ static Subtree ts_parser__lex(
 
     if (found_external_token) {
       MutableSubtree mut_result = ts_subtree_to_mut_unsafe(result);
-      ts_external_scanner_state_init(
-        &mut_result.ptr->external_scanner_state,
+      ts_subtree_set_external_scanner_state(
+        &self->tree_pool,
+        mut_result,
         self->lexer.debug_buffer,
         external_scanner_state_len
       );
@@ -575,6 +655,7 @@ static Subtree ts_parser__lex(
     }
   }
 
+  self->stats.created_node_count++;
   LOG_LOOKAHEAD(
     SYM_NAME(ts_subtree_symbol(result)),
     ts_subtree_total_size(result).bytes
@@ -590,33 +671,85 @@ static Subtree ts_parser__get_cached_token(
   TableEntry *table_entry
 ) {
   TokenCache *cache = &self->token_cache;
-  if (
-    cache->token.ptr && cache->byte_index == position &&
-    ts_subtree_external_scanner_state_eq(cache->last_external_token, last_external_token)
-  ) {
-    ts_language_table_entry(self->language, state, ts_subtree_symbol(cache->token), table_entry);
-    if (ts_parser__can_reuse_first_leaf(self, state, cache->token, table_entry)) {
-      ts_subtree_retain(cache->token);
-      return cache->token;
+  TSLexMode lex_mode = self->language->lex_modes[state];
+
+  // Prefer a token that was lexed in the current lex mode. Tokens that were
+  // lexed in other modes are only tried afterwards, because they can only be
+  // reused in some states.
+  for (unsigned pass = 0; pass < 2; pass++) {
+    for (unsigned i = 0; i < TOKEN_CACHE_SIZE; i++) {
+      TokenCacheEntry *entry = &cache->entries[i];
+      if (
+        !entry->token.ptr || entry->byte_index != position ||
+        !ts_subtree_external_scanner_state_eq(entry->last_external_token, last_external_token)
+      ) continue;
+      bool has_same_lex_mode = memcmp(&entry->lex_mode, &lex_mode, sizeof(TSLexMode)) == 0;
+      if (has_same_lex_mode != (pass == 0)) continue;
+      ts_language_table_entry(
+        self->language,
+        self->small_state_index,
+        state,
+        ts_subtree_symbol(entry->token),
+        table_entry
+      );
+      if (ts_parser__can_reuse_first_leaf(self, state, entry->token, table_entry)) {
+        self->stats.token_cache_hit_count++;
+        ts_subtree_retain(entry->token);
+        return entry->token;
+      }
     }
   }
+  self->stats.token_cache_miss_count++;
   return NULL_SUBTREE;
 }
 
 static void ts_parser__set_cached_token(
   TSParser *self,
+  TSStateId state,
   uint32_t byte_index,
   Subtree last_external_token,
   Subtree token
 ) {
   TokenCache *cache = &self->token_cache;
-  if (token.ptr) ts_subtree_retain(token);
+  TSLexMode lex_mode = self->language->lex_modes[state];
+
+  // Replace the entry with the same key, if there is one.
+  TokenCacheEntry *entry = NULL;
+  for (unsigned i = 0; i < TOKEN_CACHE_SIZE; i++) {
+    TokenCacheEntry *candidate = &cache->entries[i];
+    if (
+      candidate->token.ptr && candidate->byte_index == byte_index &&
+      memcmp(&candidate->lex_mode, &lex_mode, sizeof(TSLexMode)) == 0 &&
+      ts_subtree_external_scanner_state_eq(candidate->last_external_token, last_external_token)
+    ) {
+      entry = candidate;
+      break;
+    }
+  }
+  if (!entry) {
+    entry = &cache->entries[cache->next_index];
+    cache->next_index = (cache->next_index + 1) % TOKEN_CACHE_SIZE;
+  }
+
+  ts_subtree_retain(token);
   if (last_external_token.ptr) ts_subtree_retain(last_external_token);
-  if (cache->token.ptr) ts_subtree_release(&self->tree_pool, cache->token);
-  if (cache->last_external_token.ptr) ts_subtree_release(&self->tree_pool, cache->last_external_token);
-  cache->token = token;
-  cache->byte_index = byte_index;
-  cache->last_external_token = last_external_token;
+  if (entry->token.ptr) ts_subtree_release(&self->tree_pool, entry->token);
+  if (entry->last_external_token.ptr) ts_subtree_release(&self->tree_pool, entry->last_external_token);
+  entry->token = token;
+  entry->byte_index = byte_index;
+  entry->lex_mode = lex_mode;
+  entry->last_external_token = last_external_token;
+}
+
+static void ts_parser__clear_token_cache(TSParser *self) {
+  TokenCache *cache = &self->token_cache;
+  for (unsigned i = 0; i < TOKEN_CACHE_SIZE; i++) {
+    TokenCacheEntry *entry = &cache->entries[i];
+    if (entry->token.ptr) ts_subtree_release(&self->tree_pool, entry->token);
+    if (entry->last_external_token.ptr) ts_subtree_release(&self->tree_pool, entry->last_external_token);
+    *entry = (TokenCacheEntry) {.token = NULL_SUBTREE};
+  }
+  cache->next_index = 0;
 }
 
 static bool ts_parser__has_included_range_difference(
@@ -692,7 +825,7 @@ static Subtree ts_parser__reuse_node(
     }
 
     TSSymbol leaf_symbol = ts_subtree_leaf_symbol(result);
-    ts_language_table_entry(self->language, *state, leaf_symbol, table_entry);
+    ts_language_table_entry(self->language, self->small_state_index, *state, leaf_symbol, table_entry);
     if (!ts_parser__can_reuse_first_leaf(self, *state, result, table_entry)) {
       LOG(
         "cant_reuse_node symbol:%s, first_leaf_symbol:%s",
@@ -704,6 +837,7 @@ static Subtree ts_parser__reuse_node(
     }
 
     LOG("reuse_node symbol:%s", TREE_NAME(result));
+    self->stats.reused_node_count++;
     ts_subtree_retain(result);
     return result;
   }
@@ -774,6 +908,7 @@ static bool ts_parser__select_children(
   // room for its own heap data. The scratch tree is never explicitly released,
   // so the same 'scratch trees' array can be reused again later.
   MutableSubtree scratch_tree = ts_subtree_new_node(
+    NULL,
     ts_subtree_symbol(left),
     &self->scratch_trees,
     0,
@@ -821,6 +956,7 @@ static StackVersion ts_parser__reduce(
   bool end_of_non_terminal_extra
 ) {
   uint32_t initial_version_count = ts_stack_version_count(self->stack);
+  self->stats.reduction_count++;
 
   // Pop the given number of nodes from the given version of the parse stack.
   // If stack versions have previously merged, then there may be more than one
@@ -857,8 +993,9 @@ static StackVersion ts_parser__reduce(
     ts_subtree_array_remove_trailing_extras(&children, &self->trailing_extras);
 
     MutableSubtree parent = ts_subtree_new_node(
-      symbol, &children, production_id, self->language
+      &self->tree_pool, symbol, &children, production_id, self->language
     );
+    self->stats.created_node_count++;
 
     // This pop operation may have caused multiple stack versions to collapse
     // into one, because they all diverged from a common state. In that case,
@@ -881,7 +1018,7 @@ static StackVersion ts_parser__reduce(
         ts_subtree_release(&self->tree_pool, ts_subtree_from_mut(parent));
         array_swap(&self->trailing_extras, &self->trailing_extras2);
         parent = ts_subtree_new_node(
-          symbol, &children, production_id, self->language
+          &self->tree_pool, symbol, &children, production_id, self->language
         );
       } else {
         array_clear(&self->trailing_extras2);
@@ -890,7 +1027,7 @@ static StackVersion ts_parser__reduce(
     }
 
     TSStateId state = ts_stack_state(self->stack, slice_version);
-    TSStateId next_state = ts_language_next_state(self->language, state, symbol);
+    TSStateId next_state = ts_language_next_state(self->language, self->small_state_index, state, symbol);
     if (end_of_non_terminal_extra && next_state == state) {
       parent.ptr->extra = true;
     }
@@ -949,6 +1086,7 @@ static void ts_parser__accept(
         }
         array_splice(&trees, j, 1, child_count, children);
         root = ts_subtree_from_mut(ts_subtree_new_node(
+          &self->tree_pool,
           ts_subtree_symbol(tree),
           &trees,
           tree.ptr->production_id,
@@ -1015,7 +1153,7 @@ static bool ts_parser__do_all_potential_reductions(
 
     for (TSSymbol symbol = first_symbol; symbol < end_symbol; symbol++) {
       TableEntry entry;
-      ts_language_table_entry(self->language, state, symbol, &entry);
+      ts_language_table_entry(self->language, self->small_state_index, state, symbol, &entry);
       for (uint32_t i = 0; i < entry.action_count; i++) {
         TSParseAction action = entry.actions[i];
         switch (action.type) {
@@ -1110,7 +1248,7 @@ static bool ts_parser__recover_to_state(
     ts_subtree_array_remove_trailing_extras(&slice.subtrees, &self->trailing_extras);
 
     if (slice.subtrees.size > 0) {
-      Subtree error = ts_subtree_new_error_node(&slice.subtrees, true, self->language);
+      Subtree error = ts_subtree_new_error_node(&self->tree_pool, &slice.subtrees, true, self->language);
       ts_stack_push(self->stack, slice.version, error, false, goal_state);
     } else {
       array_delete(&slice.subtrees);
@@ -1183,7 +1321,12 @@ static void ts_parser__recover(
 
       // If the current lookahead token is valid in some previous state, recover to that state.
       // Then stop looking for further recoveries.
-      if (ts_language_has_actions(self->language, entry.state, ts_subtree_symbol(lookahead))) {
+      if (ts_language_has_actions(
+        self->language,
+        self->small_state_index,
+        entry.state,
+        ts_subtree_symbol(lookahead)
+      )) {
         if (ts_parser__recover_to_state(self, version, depth, entry.state)) {
           did_recover = true;
           LOG("recover_to_previous state:%u, depth:%u", entry.state, depth);
@@ -1227,7 +1370,7 @@ static void ts_parser__recover(
   if (ts_subtree_is_eof(lookahead)) {
     LOG("recover_eof");
     SubtreeArray children = array_new();
-    Subtree parent = ts_subtree_new_error_node(&children, false, self->language);
+    Subtree parent = ts_subtree_new_error_node(&self->tree_pool, &children, false, self->language);
     ts_stack_push(self->stack, version, parent, false, 1);
     ts_parser__accept(self, version, lookahead);
     return;
@@ -1247,7 +1390,13 @@ static void ts_parser__recover(
   // If the current lookahead token is an extra token, mark it as extra. This means it won't
   // be counted in error cost calculations.
   unsigned n;
-  const TSParseAction *actions = ts_language_actions(self->language, 1, ts_subtree_symbol(lookahead), &n);
+  const TSParseAction *actions = ts_language_actions(
+    self->language,
+    self->small_state_index,
+    1,
+    ts_subtree_symbol(lookahead),
+    &n
+  );
   if (n > 0 && actions[n - 1].type == TSParseActionTypeShift && actions[n - 1].shift.extra) {
     MutableSubtree mutable_lookahead = ts_subtree_make_mut(&self->tree_pool, lookahead);
     ts_subtree_set_extra(&mutable_lookahead, true);
@@ -1260,6 +1409,7 @@ static void ts_parser__recover(
   array_reserve(&children, 1);
   array_push(&children, lookahead);
   MutableSubtree error_repeat = ts_subtree_new_node(
+    &self->tree_pool,
     ts_builtin_sym_error_repeat,
     &children,
     0,
@@ -1288,6 +1438,7 @@ static void ts_parser__recover(
     ts_stack_renumber_version(self->stack, pop.contents[0].version, version);
     array_push(&pop.contents[0].subtrees, ts_subtree_from_mut(error_repeat));
     error_repeat = ts_subtree_new_node(
+      &self->tree_pool,
       ts_builtin_sym_error_repeat,
       &pop.contents[0].subtrees,
       0,
@@ -1310,6 +1461,7 @@ static void ts_parser__handle_error(
   Subtree lookahead
 ) {
   uint32_t previous_version_count = ts_stack_version_count(self->stack);
+  self->stats.error_recovery_count++;
 
   // Perform any reductions that can happen in this state, regardless of the lookahead. After
   // skipping one or more invalid tokens, the parser might find a token that would have allowed
@@ -1330,7 +1482,7 @@ static void ts_parser__handle_error(
         missing_symbol++
       ) {
         TSStateId state_after_missing_symbol = ts_language_next_state(
-          self->language, state, missing_symbol
+          self->language, self->small_state_index, state, missing_symbol
         );
         if (state_after_missing_symbol == 0 || state_after_missing_symbol == state) {
           continue;
@@ -1338,6 +1490,7 @@ static void ts_parser__handle_error(
 
         if (ts_language_has_reduce_action(
           self->language,
+          self->small_state_index,
           state_after_missing_symbol,
           ts_subtree_leaf_symbol(lookahead)
         )) {
@@ -1439,15 +1592,27 @@ static bool ts_parser__advance(
       lookahead = ts_parser__lex(self, version, state);
 
       if (lookahead.ptr) {
-        ts_parser__set_cached_token(self, position, last_external_token, lookahead);
-        ts_language_table_entry(self->language, state, ts_subtree_symbol(lookahead), &table_entry);
+        ts_parser__set_cached_token(self, state, position, last_external_token, lookahead);
+        ts_language_table_entry(
+          self->language,
+          self->small_state_index,
+          state,
+          ts_subtree_symbol(lookahead),
+          &table_entry
+        );
       }
 
       // When parsing a non-terminal extra, a null lookahead indicates the
       // end of the rule. The reduction is stored in the EOF table entry.
       // After the reduction, the lexer needs to be run again.
       else {
-        ts_language_table_entry(self->language, state, ts_builtin_sym_end, &table_entry);
+        ts_language_table_entry(
+          self->language,
+          self->small_state_index,
+          state,
+          ts_builtin_sym_end,
+          &table_entry
+        );
       }
     }
 
@@ -1488,7 +1653,12 @@ static bool ts_parser__advance(
 
           if (ts_subtree_child_count(lookahead) > 0) {
             ts_parser__breakdown_lookahead(self, &lookahead, state, &self->reusable_node);
-            next_state = ts_language_next_state(self->language, state, ts_subtree_symbol(lookahead));
+            next_state = ts_language_next_state(
+              self->language,
+              self->small_state_index,
+              state,
+              ts_subtree_symbol(lookahead)
+            );
           }
 
           ts_parser__shift(self, version, next_state, lookahead, action.shift.extra);
@@ -1547,6 +1717,7 @@ static bool ts_parser__advance(
       } else {
         ts_language_table_entry(
           self->language,
+          self->small_state_index,
           state,
           ts_subtree_leaf_symbol(lookahead),
           &table_entry
@@ -1571,7 +1742,13 @@ static bool ts_parser__advance(
       ts_subtree_is_keyword(lookahead) &&
       ts_subtree_symbol(lookahead) != self->language->keyword_capture_token
     ) {
-      ts_language_table_entry(self->language, state, self->language->keyword_capture_token, &table_entry);
+      ts_language_table_entry(
+        self->language,
+        self->small_state_index,
+        state,
+        self->language->keyword_capture_token,
+        &table_entry
+      );
       if (table_entry.action_count > 0) {
         LOG(
           "switch from_keyword:%s, to_word_token:%s",
@@ -1618,6 +1795,7 @@ static bool ts_parser__advance(
 }
 
 static unsigned ts_parser__condense_stack(TSParser *self) {
+  self->stats.condense_stack_count++;
   bool made_changes = false;
   unsigned min_error_cost = UINT_MAX;
   for (StackVersion i = 0; i < ts_stack_version_count(self->stack); i++) {
@@ -1743,7 +1921,10 @@ TSParser *ts_parser_new(void) {
   self->old_tree = NULL_SUBTREE;
   self->included_range_differences = (TSRangeArray) array_new();
   self->included_range_difference_index = 0;
-  ts_parser__set_cached_token(self, 0, NULL_SUBTREE, NULL_SUBTREE);
+  self->arena = NULL;
+  self->arena_allocation = false;
+  self->single_threaded = false;
+  ts_parser__clear_token_cache(self);
   return self;
 }
 
@@ -1763,7 +1944,7 @@ void ts_parser_delete(TSParser *self) {
     self->old_tree = NULL_SUBTREE;
   }
   ts_lexer_delete(&self->lexer);
-  ts_parser__set_cached_token(self, 0, NULL_SUBTREE, NULL_SUBTREE);
+  ts_parser__clear_token_cache(self);
   ts_subtree_pool_delete(&self->tree_pool);
   reusable_node_delete(&self->reusable_node);
   array_delete(&self->trailing_extras);
@@ -1792,6 +1973,11 @@ bool ts_parser_set_language(TSParser *self, const TSLanguage *language) {
     self->external_scanner_payload = NULL;
   }
 
+  if (language != self->language) {
+    ts_language_small_state_index_release(self->small_state_index);
+    self->small_state_index = ts_language_small_state_index_acquire(language);
+  }
+
   self->language = language;
   ts_parser_reset(self);
   return true;
@@ -1833,6 +2019,32 @@ void ts_parser_set_timeout_micros(TSParser *self, uint64_t timeout_micros) {
   self->timeout_duration = duration_from_micros(timeout_micros);
 }
 
+bool ts_parser_arena_allocation(const TSParser *self) {
+  return self->arena_allocation;
+}
+
+void ts_parser_set_arena_allocation(TSParser *self, bool enabled) {
+  self->arena_allocation = enabled;
+}
+
+bool ts_parser_single_threaded(const TSParser *self) {
+  return self->single_threaded;
+}
+
+void ts_parser_set_single_threaded(TSParser *self, bool enabled) {
+  self->single_threaded = enabled;
+}
+
+TSParserStats ts_parser_stats(const TSParser *self) {
+  TSParserStats result = self->stats;
+  StackAllocationStats stack_stats = ts_stack_allocation_stats(self->stack);
+  result.stack_node_count =
+    stack_stats.node_count - self->stack_stats_at_start.node_count;
+  result.stack_allocator_call_count =
+    stack_stats.allocator_call_count - self->stack_stats_at_start.allocator_call_count;
+  return result;
+}
+
 bool ts_parser_set_included_ranges(
   TSParser *self,
   const TSRange *ranges,
@@ -1858,29 +2070,55 @@ void ts_parser_reset(TSParser *self) {
   reusable_node_clear(&self->reusable_node);
   ts_lexer_reset(&self->lexer, length_zero());
   ts_stack_clear(self->stack);
-  ts_parser__set_cached_token(self, 0, NULL_SUBTREE, NULL_SUBTREE);
+  ts_parser__clear_token_cache(self);
   if (self->finished_tree.ptr) {
     ts_subtree_release(&self->tree_pool, self->finished_tree);
     self->finished_tree = NULL_SUBTREE;
   }
+  if (self->arena) {
+    ts_subtree_arena_release(self->arena);
+    self->arena = NULL;
+    self->tree_pool.arena = NULL;
+  }
   self->accept_count = 0;
 }
 
-TSTree *ts_parser_parse(
+// Parse the given input. If `contiguous` is true, the input's `read` function
+// must return the entire document when it is called at offset zero.
+static TSTree *ts_parser__parse(
   TSParser *self,
   const TSTree *old_tree,
-  TSInput input
+  TSInput input,
+  bool contiguous
 ) {
   if (!self->language || !input.read) return NULL;
 
-  ts_lexer_set_input(&self->lexer, input);
+  if (contiguous) {
+    ts_lexer_set_contiguous_input(&self->lexer, input);
+  } else {
+    ts_lexer_set_input(&self->lexer, input);
+  }
 
   array_clear(&self->included_range_differences);
   self->included_range_difference_index = 0;
 
+  if (!ts_parser_has_outstanding_parse(self)) {
+    self->stats = (TSParserStats) {0};
+    self->stack_stats_at_start = ts_stack_allocation_stats(self->stack);
+    self->lexed_end_byte = 0;
+    self->tree_pool.is_shared = !self->single_threaded;
+  }
+
   if (ts_parser_has_outstanding_parse(self)) {
     LOG("resume_parsing");
   } else if (old_tree) {
+    if (self->arena_allocation) {
+      self->arena = ts_subtree_arena_new(old_tree->arena);
+      self->tree_pool.arena = self->arena;
+    } else if (old_tree->arena) {
+      ts_subtree_arena_retain(old_tree->arena);
+      self->arena = old_tree->arena;
+    }
     ts_subtree_retain(old_tree->root);
     self->old_tree = old_tree->root;
     ts_range_array_get_changed_ranges(
@@ -1896,6 +2134,10 @@ TSTree *ts_parser_parse(
       LOG("different_included_range %u - %u", range->start_byte, range->end_byte);
     }
   } else {
+    if (self->arena_allocation) {
+      self->arena = ts_subtree_arena_new(NULL);
+      self->tree_pool.arena = self->arena;
+    }
     reusable_node_clear(&self->reusable_node);
     LOG("new_parse");
   }
@@ -1907,6 +2149,7 @@ TSTree *ts_parser_parse(
     self->end_clock = clock_null();
   }
 
+  TSClock parse_start_clock = clock_now();
   uint32_t position = 0, last_position = 0, version_count = 0;
   do {
     for (
@@ -1915,6 +2158,10 @@ TSTree *ts_parser_parse(
       version < version_count;
       version++
     ) {
+      self->stats.total_version_count++;
+      if (version_count > self->stats.max_version_count) {
+        self->stats.max_version_count = version_count;
+      }
       bool allow_node_reuse = version_count == 1;
       while (ts_stack_is_active(self->stack, version)) {
         LOG(
@@ -1926,7 +2173,12 @@ TSTree *ts_parser_parse(
           ts_stack_position(self->stack, version).extent.column
         );
 
-        if (!ts_parser__advance(self, version, allow_node_reuse)) return NULL;
+        if (!ts_parser__advance(self, version, allow_node_reuse)) {
+          self->stats.parse_duration_micros += duration_to_micros(
+            duration_between(parse_start_clock, clock_now())
+          );
+          return NULL;
+        }
         LOG_STACK();
 
         position = ts_stack_position(self->stack, version).bytes;
@@ -1953,7 +2205,15 @@ TSTree *ts_parser_parse(
   } while (version_count != 0);
 
   assert(self->finished_tree.ptr);
+  TSClock balance_start_clock = clock_now();
+  self->stats.parse_duration_micros += duration_to_micros(
+    duration_between(parse_start_clock, balance_start_clock)
+  );
   ts_subtree_balance(self->finished_tree, &self->tree_pool, self->language);
+  self->stats.balance_duration_micros += duration_to_micros(
+    duration_between(balance_start_clock, clock_now())
+  );
+  self->stats.error_cost = ts_subtree_error_cost(self->finished_tree);
   LOG("done");
   LOG_TREE(self->finished_tree);
 
@@ -1961,13 +2221,25 @@ TSTree *ts_parser_parse(
     self->finished_tree,
     self->language,
     self->lexer.included_ranges,
-    self->lexer.included_range_count
+    self->lexer.included_range_count,
+    self->arena
   );
+  if (old_tree) result->parent_cache_enabled = old_tree->parent_cache_enabled;
   self->finished_tree = NULL_SUBTREE;
+  self->arena = NULL;
+  self->tree_pool.arena = NULL;
   ts_parser_reset(self);
   return result;
 }
 
+TSTree *ts_parser_parse(
+  TSParser *self,
+  const TSTree *old_tree,
+  TSInput input
+) {
+  return ts_parser__parse(self, old_tree, input, false);
+}
+
 TSTree *ts_parser_parse_string(
   TSParser *self,
   const TSTree *old_tree,
@@ -1985,11 +2257,164 @@ TSTree *ts_parser_parse_string_encoding(
   TSInputEncoding encoding
 ) {
   TSStringInput input = {string, length};
-  return ts_parser_parse(self, old_tree, (TSInput) {
+  return ts_parser__parse(self, old_tree, (TSInput) {
     &input,
     ts_string_input_read,
     encoding,
-  });
+  }, true);
+}
+
+TSTree *ts_parser_parse_file(
+  TSParser *self,
+  const TSTree *old_tree,
+  const char *path
+) {
+#ifdef _WIN32
+  FILE *file = fopen(path, "rb");
+  if (!file) return NULL;
+  char *contents = NULL;
+  long length = -1;
+  if (fseek(file, 0, SEEK_END) == 0) length = ftell(file);
+  if (length >= 0 && (uint64_t)length <= UINT32_MAX && fseek(file, 0, SEEK_SET) == 0) {
+    contents = ts_malloc(length ? length : 1);
+    if (fread(contents, 1, length, file) != (size_t)length) {
+      ts_free(contents);
+      contents = NULL;
+    }
+  }
+  fclose(file);
+  if (!contents) return NULL;
+  TSTree *result = ts_parser_parse_string(self, old_tree, contents, length);
+  ts_free(contents);
+  return result;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (uint64_t)file_stat.st_size > UINT32_MAX) {
+    close(fd);
+    return NULL;
+  }
+
+  // Empty files cannot be mapped.
+  uint32_t length = file_stat.st_size;
+  if (length == 0) {
+    close(fd);
+    return ts_parser_parse_string(self, old_tree, "", 0);
+  }
+
+  void *contents = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (contents == MAP_FAILED) return NULL;
+  TSTree *result = ts_parser_parse_string(self, old_tree, contents, length);
+  munmap(contents, length);
+  return result;
+#endif
+}
+
+// Combine the trees for consecutive chunks of a document into a single tree,
+// which is used as the old tree when parsing the entire document.
+//
+// The content of each chunk is shifted so that it immediately follows the
+// content of the previous chunks. Only the last chunk's EOF node is kept.
+// Nodes at the start of each chunk, and nodes whose lookahead reached the end
+// of a chunk, are marked as changed, so that they are not reused without being
+// checked against the surrounding chunks.
+static TSTree *ts_parser__stitch_chunks(
+  TSParser *self,
+  const TSTree **chunks,
+  uint32_t chunk_count
+) {
+  // The stitched nodes are allocated individually, because they are edited
+  // below. The arena only keeps the arenas of the chunk trees alive.
+  SubtreeArena *arena = NULL;
+  SubtreePool pool = ts_subtree_pool_new(0);
+
+  SubtreeArray children = array_new();
+  Length position = length_zero();
+  for (uint32_t i = 0; i < chunk_count; i++) {
+    const TSTree *chunk = chunks[i];
+    if (chunk->arena) {
+      if (!arena) arena = ts_subtree_arena_new(NULL);
+      ts_subtree_arena_add_dependency(arena, chunk->arena);
+    }
+
+    Subtree root = chunk->root;
+    ts_subtree_retain(root);
+    if (i > 0) {
+      root = ts_subtree_edit(root, &(TSInputEdit) {
+        .start_byte = 0,
+        .old_end_byte = position.bytes,
+        .new_end_byte = 0,
+        .start_point = POINT_ZERO,
+        .old_end_point = position.extent,
+        .new_end_point = POINT_ZERO,
+      }, &pool);
+    }
+
+    bool is_last_chunk = i + 1 == chunk_count;
+    uint32_t child_count = ts_subtree_child_count(root);
+    const Subtree *chunk_children = child_count > 0 ? ts_subtree_children(root) : &root;
+    if (child_count == 0) child_count = 1;
+    for (uint32_t j = 0; j < child_count; j++) {
+      Subtree child = chunk_children[j];
+      if (ts_subtree_is_eof(child) && !is_last_chunk) continue;
+      ts_subtree_retain(child);
+      array_push(&children, child);
+      position = length_add(position, ts_subtree_total_size(child));
+    }
+    ts_subtree_release(&pool, root);
+  }
+
+  Subtree root = ts_subtree_from_mut(ts_subtree_new_node(
+    &pool,
+    ts_subtree_symbol(chunks[0]->root),
+    &children,
+    0,
+    self->language
+  ));
+
+  for (uint32_t i = 0; i + 1 < chunk_count; i++) {
+    const TSTree *chunk = chunks[i];
+    if (chunk->included_range_count == 0) continue;
+    const TSRange *range = &chunk->included_ranges[chunk->included_range_count - 1];
+    if (range->end_byte == UINT32_MAX) continue;
+    root = ts_subtree_edit(root, &(TSInputEdit) {
+      .start_byte = range->end_byte,
+      .old_end_byte = range->end_byte,
+      .new_end_byte = range->end_byte,
+      .start_point = range->end_point,
+      .old_end_point = range->end_point,
+      .new_end_point = range->end_point,
+    }, &pool);
+  }
+
+  ts_subtree_pool_delete(&pool);
+  return ts_tree_new(
+    root,
+    self->language,
+    self->lexer.included_ranges,
+    self->lexer.included_range_count,
+    arena
+  );
+}
+
+TSTree *ts_parser_parse_chunks(
+  TSParser *self,
+  const TSTree **chunks,
+  uint32_t chunk_count,
+  TSInput input
+) {
+  bool can_stitch = chunk_count > 0 && !ts_parser_has_outstanding_parse(self);
+  for (uint32_t i = 0; i < chunk_count && can_stitch; i++) {
+    if (chunks[i]->language != self->language) can_stitch = false;
+  }
+  if (!can_stitch) return ts_parser_parse(self, NULL, input);
+
+  TSTree *old_tree = ts_parser__stitch_chunks(self, chunks, chunk_count);
+  TSTree *result = ts_parser_parse(self, old_tree, input);
+  ts_tree_delete(old_tree);
+  return result;
 }
 
 #undef LOG
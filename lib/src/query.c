@@ -3,6 +3,7 @@
 #include "./array.h"
 #include "./language.h"
 #include "./point.h"
+#include "./regex.h"
 #include "./tree_cursor.h"
 #include "./unicode.h"
 #include <wctype.h>
@@ -142,10 +143,37 @@ typedef struct {
   bool is_rooted;
 } PatternEntry;
 
+/*
+ * TextPredicate - A predicate that the query cursor can evaluate by itself,
+ * by comparing the text of a captured node to a string, to a regular
+ * expression, to a set of strings, or to the text of another captured node.
+ * The `value` field stores the id of the string, the index of the regex in
+ * the query's `regexes` array, or the id of the other capture. For `#any-of?`
+ * predicates, `values` is a slice of the query's `predicate_steps` array
+ * that contains the strings.
+ */
+typedef enum {
+  TextPredicateTypeEqString,
+  TextPredicateTypeEqCapture,
+  TextPredicateTypeMatchString,
+  TextPredicateTypeAnyOfStrings,
+} TextPredicateType;
+
+typedef struct {
+  TextPredicateType type;
+  uint32_t value;
+  Slice values;
+  uint16_t capture_id;
+  uint16_t predicate_index;
+  bool is_positive;
+} TextPredicate;
+
 typedef struct {
   Slice steps;
   Slice predicate_steps;
+  Slice text_predicates;
   uint32_t start_byte;
+  uint32_t query_index;
 } QueryPattern;
 
 typedef struct {
@@ -273,12 +301,16 @@ struct TSQuery {
   SymbolTable predicate_values;
   Array(QueryStep) steps;
   Array(PatternEntry) pattern_map;
+  Array(uint32_t) pattern_map_offsets;
   Array(TSQueryPredicateStep) predicate_steps;
+  Array(TextPredicate) text_predicates;
+  Array(Regex *) regexes;
   Array(QueryPattern) patterns;
   Array(StepOffset) step_offsets;
   Array(TSFieldId) negated_fields;
   Array(char) string_buffer;
   const TSLanguage *language;
+  uint32_t source_length;
   uint16_t wildcard_root_pattern_count;
 };
 
@@ -299,7 +331,11 @@ struct TSQueryCursor {
   uint32_t next_state_id;
   bool ascending;
   bool halted;
+  TSQueryTextProvider text_provider;
+  Array(char) text_buffer;
+  RegexScratch regex_scratch;
   bool did_exceed_match_limit;
+  bool has_unrooted_patterns;
 };
 
 static const TSQueryError PARENT_DONE = -1;
@@ -1039,9 +1075,11 @@ static inline int analysis_subgraph_node__compare(const AnalysisSubgraphNode *se
 // of the patterns in the query, and a `step_index`, which indicates the start
 // offset of that pattern's steps within the `steps` array.
 //
-// The entries are sorted by the patterns' root symbols, and lookups use a
-// binary search. This ensures that the cost of this initial lookup step
-// scales logarithmically with the number of patterns in the query.
+// The entries are sorted by the patterns' root symbols. While the query is
+// being built, this binary search finds the position at which to insert each
+// new entry. Once it is built, the query cursor finds a node's entries through
+// the `pattern_map_offsets` array instead, so the cost of this initial lookup
+// step doesn't depend on the number of patterns in the query.
 //
 // This returns `true` if the symbol is present and `false` otherwise.
 // If the symbol is not present `*result` is set to the index where the
@@ -1113,6 +1151,51 @@ static inline void ts_query__pattern_map_insert(
   array_insert(&self->pattern_map, index, new_entry);
 }
 
+// The `pattern_map_offsets` array allows the entries in the `pattern_map`
+// for a given node's symbol to be found without a search. For each symbol in
+// the language, followed by the `ERROR` symbol, it stores the index of the
+// first entry for that symbol, and the array ends with the size of the
+// `pattern_map`. So the entries for a symbol are those between its offset and
+// the next offset.
+static void ts_query__pattern_map_build_offsets(TSQuery *self) {
+  uint32_t symbol_count = self->language->symbol_count;
+  array_clear(&self->pattern_map_offsets);
+  array_reserve(&self->pattern_map_offsets, symbol_count + 2);
+
+  uint32_t index = self->wildcard_root_pattern_count;
+  for (uint32_t i = 0; i <= symbol_count; i++) {
+    TSSymbol symbol = i < symbol_count ? i : ts_builtin_sym_error;
+    while (
+      index < self->pattern_map.size &&
+      self->steps.contents[self->pattern_map.contents[index].step_index].symbol < symbol
+    ) index++;
+    array_push(&self->pattern_map_offsets, index);
+  }
+  array_push(&self->pattern_map_offsets, self->pattern_map.size);
+}
+
+// Find the range of entries in the `pattern_map` for patterns whose root
+// matches the given symbol.
+static inline void ts_query__pattern_map_range(
+  const TSQuery *self,
+  TSSymbol symbol,
+  uint32_t *start,
+  uint32_t *end
+) {
+  uint32_t symbol_count = self->language->symbol_count;
+  uint32_t i;
+  if (symbol < symbol_count) {
+    i = symbol;
+  } else if (symbol == ts_builtin_sym_error) {
+    i = symbol_count;
+  } else {
+    *start = *end = 0;
+    return;
+  }
+  *start = self->pattern_map_offsets.contents[i];
+  *end = self->pattern_map_offsets.contents[i + 1];
+}
+
 static bool ts_query__analyze_patterns(TSQuery *self, unsigned *error_offset) {
   // Walk forward through all of the steps in the query, computing some
   // basic information about each step. Mark all of the steps that contain
@@ -2543,6 +2626,100 @@ static TSQueryError ts_query__parse_pattern(
   return 0;
 }
 
+static bool ts_query__predicate_name_is(
+  const TSQuery *self,
+  const TSQueryPredicateStep *step,
+  const char *name
+) {
+  uint32_t length;
+  const char *value = symbol_table_name_for_id(&self->predicate_values, step->value_id, &length);
+  return length == strlen(name) && strncmp(value, name, length) == 0;
+}
+
+// Determine if a predicate is one that the query cursor can evaluate by
+// itself, and if so, store its information in `result`. The predicate's
+// steps do not include the terminating `Done` step.
+static bool ts_query__text_predicate_new(
+  TSQuery *self,
+  uint32_t step_index,
+  uint32_t step_count,
+  TextPredicate *result
+) {
+  const TSQueryPredicateStep *steps = &self->predicate_steps.contents[step_index];
+  if (
+    step_count < 3 ||
+    steps[0].type != TSQueryPredicateStepTypeString ||
+    steps[1].type != TSQueryPredicateStepTypeCapture
+  ) return false;
+
+  result->capture_id = steps[1].value_id;
+  if (
+    ts_query__predicate_name_is(self, &steps[0], "eq?") ||
+    ts_query__predicate_name_is(self, &steps[0], "not-eq?")
+  ) {
+    if (step_count != 3) return false;
+    result->is_positive = ts_query__predicate_name_is(self, &steps[0], "eq?");
+    result->type = steps[2].type == TSQueryPredicateStepTypeCapture
+      ? TextPredicateTypeEqCapture
+      : TextPredicateTypeEqString;
+    result->value = steps[2].value_id;
+  }
+
+  else if (
+    ts_query__predicate_name_is(self, &steps[0], "match?") ||
+    ts_query__predicate_name_is(self, &steps[0], "not-match?")
+  ) {
+    if (step_count != 3 || steps[2].type != TSQueryPredicateStepTypeString) return false;
+    uint32_t length;
+    const char *pattern = symbol_table_name_for_id(&self->predicate_values, steps[2].value_id, &length);
+    Regex *regex = ts_regex_new(pattern, length);
+    if (!regex) return false;
+    result->is_positive = ts_query__predicate_name_is(self, &steps[0], "match?");
+    result->type = TextPredicateTypeMatchString;
+    result->value = self->regexes.size;
+    array_push(&self->regexes, regex);
+  }
+
+  else if (
+    ts_query__predicate_name_is(self, &steps[0], "any-of?") ||
+    ts_query__predicate_name_is(self, &steps[0], "not-any-of?")
+  ) {
+    for (unsigned i = 2; i < step_count; i++) {
+      if (steps[i].type != TSQueryPredicateStepTypeString) return false;
+    }
+    result->is_positive = ts_query__predicate_name_is(self, &steps[0], "any-of?");
+    result->type = TextPredicateTypeAnyOfStrings;
+    result->values = (Slice) {.offset = step_index + 2, .length = step_count - 2};
+  }
+
+  else {
+    return false;
+  }
+
+  return true;
+}
+
+// Find each pattern's predicates that can be evaluated by the query cursor,
+// compiling any regular expressions that they use.
+static void ts_query__add_text_predicates(TSQuery *self) {
+  for (unsigned i = 0; i < self->patterns.size; i++) {
+    QueryPattern *pattern = &self->patterns.contents[i];
+    pattern->text_predicates = (Slice) {.offset = self->text_predicates.size};
+    uint16_t predicate_index = 0;
+    uint32_t end = pattern->predicate_steps.offset + pattern->predicate_steps.length;
+    for (uint32_t start = pattern->predicate_steps.offset; start < end; predicate_index++) {
+      uint32_t done = start;
+      while (self->predicate_steps.contents[done].type != TSQueryPredicateStepTypeDone) done++;
+      TextPredicate predicate = {.predicate_index = predicate_index};
+      if (ts_query__text_predicate_new(self, start, done - start, &predicate)) {
+        array_push(&self->text_predicates, predicate);
+      }
+      start = done + 1;
+    }
+    pattern->text_predicates.length = self->text_predicates.size - pattern->text_predicates.offset;
+  }
+}
+
 TSQuery *ts_query_new(
   const TSLanguage *language,
   const char *source,
@@ -2563,16 +2740,20 @@ TSQuery *ts_query_new(
   *self = (TSQuery) {
     .steps = array_new(),
     .pattern_map = array_new(),
+    .pattern_map_offsets = array_new(),
     .captures = symbol_table_new(),
     .capture_quantifiers = array_new(),
     .predicate_values = symbol_table_new(),
     .predicate_steps = array_new(),
+    .text_predicates = array_new(),
+    .regexes = array_new(),
     .patterns = array_new(),
     .step_offsets = array_new(),
     .string_buffer = array_new(),
     .negated_fields = array_new(),
     .wildcard_root_pattern_count = 0,
     .language = language,
+    .source_length = source_len,
   };
 
   array_push(&self->negated_fields, 0);
@@ -2672,15 +2853,165 @@ TSQuery *ts_query_new(
     return NULL;
   }
 
+  ts_query__pattern_map_build_offsets(self);
+  ts_query__add_text_predicates(self);
   array_delete(&self->string_buffer);
   return self;
 }
 
+TSQuery *ts_query_combine(const TSQuery *const *queries, uint32_t query_count) {
+  if (query_count == 0) return NULL;
+  const TSLanguage *language = queries[0]->language;
+  uint32_t step_count = 0, pattern_count = 0;
+  for (unsigned i = 0; i < query_count; i++) {
+    if (queries[i]->language != language) return NULL;
+    step_count += queries[i]->steps.size;
+    pattern_count += queries[i]->patterns.size;
+  }
+
+  // Steps and patterns are referred to using 16-bit indices.
+  if (step_count >= NONE || pattern_count >= NONE) return NULL;
+
+  TSQuery *self = ts_malloc(sizeof(TSQuery));
+  *self = (TSQuery) {
+    .steps = array_new(),
+    .pattern_map = array_new(),
+    .pattern_map_offsets = array_new(),
+    .captures = symbol_table_new(),
+    .capture_quantifiers = array_new(),
+    .predicate_values = symbol_table_new(),
+    .predicate_steps = array_new(),
+    .text_predicates = array_new(),
+    .regexes = array_new(),
+    .patterns = array_new(),
+    .step_offsets = array_new(),
+    .string_buffer = array_new(),
+    .negated_fields = array_new(),
+    .wildcard_root_pattern_count = 0,
+    .language = language,
+    .source_length = 0,
+  };
+  array_reserve(&self->steps, step_count);
+  array_reserve(&self->patterns, pattern_count);
+  array_push(&self->negated_fields, 0);
+
+  Array(uint16_t) capture_ids = array_new();
+  Array(uint16_t) value_ids = array_new();
+  for (unsigned i = 0; i < query_count; i++) {
+    const TSQuery *query = queries[i];
+    uint32_t step_offset = self->steps.size;
+    uint32_t pattern_offset = self->patterns.size;
+    uint32_t predicate_step_offset = self->predicate_steps.size;
+
+    // Byte offsets in the combined query refer to the concatenation of the
+    // queries' sources.
+    uint32_t byte_offset = self->source_length;
+    self->source_length += query->source_length;
+
+    // Captures and predicate values with the same name are shared between
+    // the queries, so map each query's ids to the ids in the combined query.
+    array_clear(&capture_ids);
+    for (unsigned j = 0; j < query->captures.slices.size; j++) {
+      uint32_t length;
+      const char *name = symbol_table_name_for_id(&query->captures, j, &length);
+      array_push(&capture_ids, symbol_table_insert_name(&self->captures, name, length));
+    }
+    array_clear(&value_ids);
+    for (unsigned j = 0; j < query->predicate_values.slices.size; j++) {
+      uint32_t length;
+      const char *value = symbol_table_name_for_id(&query->predicate_values, j, &length);
+      array_push(&value_ids, symbol_table_insert_name(&self->predicate_values, value, length));
+    }
+
+    // Each query's list of negated fields starts with an empty list, which
+    // is only needed once.
+    uint32_t negated_field_offset = self->negated_fields.size - 1;
+    array_extend(
+      &self->negated_fields,
+      query->negated_fields.size - 1,
+      &query->negated_fields.contents[1]
+    );
+
+    for (unsigned j = 0; j < query->steps.size; j++) {
+      QueryStep step = query->steps.contents[j];
+      for (unsigned k = 0; k < MAX_STEP_CAPTURE_COUNT; k++) {
+        if (step.capture_ids[k] == NONE) break;
+        step.capture_ids[k] = capture_ids.contents[step.capture_ids[k]];
+      }
+      if (step.alternative_index != NONE) step.alternative_index += step_offset;
+      if (step.negated_field_list_id) step.negated_field_list_id += negated_field_offset;
+      array_push(&self->steps, step);
+    }
+
+    for (unsigned j = 0; j < query->predicate_steps.size; j++) {
+      TSQueryPredicateStep step = query->predicate_steps.contents[j];
+      if (step.type == TSQueryPredicateStepTypeCapture) {
+        step.value_id = capture_ids.contents[step.value_id];
+      } else if (step.type == TSQueryPredicateStepTypeString) {
+        step.value_id = value_ids.contents[step.value_id];
+      }
+      array_push(&self->predicate_steps, step);
+    }
+
+    for (unsigned j = 0; j < query->patterns.size; j++) {
+      QueryPattern pattern = query->patterns.contents[j];
+      pattern.steps.offset += step_offset;
+      pattern.predicate_steps.offset += predicate_step_offset;
+      pattern.start_byte += byte_offset;
+      pattern.query_index = i;
+      array_push(&self->patterns, pattern);
+
+      CaptureQuantifiers capture_quantifiers = capture_quantifiers_new();
+      const CaptureQuantifiers *quantifiers = &query->capture_quantifiers.contents[j];
+      for (unsigned k = 0; k < quantifiers->size; k++) {
+        TSQuantifier quantifier = capture_quantifier_for_id(quantifiers, k);
+        if (quantifier != TSQuantifierZero) {
+          capture_quantifiers_add_for_id(&capture_quantifiers, capture_ids.contents[k], quantifier);
+        }
+      }
+      array_push(&self->capture_quantifiers, capture_quantifiers);
+    }
+
+    for (unsigned j = 0; j < query->step_offsets.size; j++) {
+      StepOffset entry = query->step_offsets.contents[j];
+      entry.step_index += step_offset;
+      entry.byte_offset += byte_offset;
+      array_push(&self->step_offsets, entry);
+    }
+
+    for (unsigned j = 0; j < query->pattern_map.size; j++) {
+      PatternEntry entry = query->pattern_map.contents[j];
+      entry.step_index += step_offset;
+      entry.pattern_index += pattern_offset;
+      TSSymbol symbol = self->steps.contents[entry.step_index].symbol;
+      ts_query__pattern_map_insert(self, symbol, entry);
+      if (symbol == WILDCARD_SYMBOL) self->wildcard_root_pattern_count++;
+    }
+  }
+  array_delete(&capture_ids);
+  array_delete(&value_ids);
+
+  ts_query__pattern_map_build_offsets(self);
+  ts_query__add_text_predicates(self);
+  array_delete(&self->string_buffer);
+  return self;
+}
+
+uint32_t ts_query_query_index_for_pattern(const TSQuery *self, uint32_t pattern_index) {
+  return self->patterns.contents[pattern_index].query_index;
+}
+
 void ts_query_delete(TSQuery *self) {
   if (self) {
     array_delete(&self->steps);
     array_delete(&self->pattern_map);
+    array_delete(&self->pattern_map_offsets);
     array_delete(&self->predicate_steps);
+    array_delete(&self->text_predicates);
+    for (uint32_t index = 0; index < self->regexes.size; index++) {
+      ts_regex_delete(self->regexes.contents[index]);
+    }
+    array_delete(&self->regexes);
     array_delete(&self->patterns);
     array_delete(&self->step_offsets);
     array_delete(&self->string_buffer);
@@ -2753,6 +3084,18 @@ uint32_t ts_query_start_byte_for_pattern(
   return self->patterns.contents[pattern_index].start_byte;
 }
 
+bool ts_query_is_predicate_built_in(
+  const TSQuery *self,
+  uint32_t pattern_index,
+  uint32_t predicate_index
+) {
+  Slice slice = self->patterns.contents[pattern_index].text_predicates;
+  for (unsigned i = slice.offset; i < slice.offset + slice.length; i++) {
+    if (self->text_predicates.contents[i].predicate_index == predicate_index) return true;
+  }
+  return false;
+}
+
 bool ts_query_is_pattern_rooted(
   const TSQuery *self,
   uint32_t pattern_index
@@ -2766,6 +3109,21 @@ bool ts_query_is_pattern_rooted(
   return true;
 }
 
+uint32_t ts_query_pattern_depth(
+  const TSQuery *self,
+  uint32_t pattern_index
+) {
+  const QueryPattern *pattern = &self->patterns.contents[pattern_index];
+  uint32_t result = 0;
+  for (unsigned i = 0; i < pattern->steps.length; i++) {
+    const QueryStep *step = &self->steps.contents[pattern->steps.offset + i];
+    if (step->depth != PATTERN_DONE_MARKER && step->depth > result) {
+      result = step->depth;
+    }
+  }
+  return result;
+}
+
 bool ts_query_is_pattern_guaranteed_at_step(
   const TSQuery *self,
   uint32_t byte_offset
@@ -2823,9 +3181,11 @@ void ts_query_disable_pattern(
     PatternEntry *pattern = &self->pattern_map.contents[i];
     if (pattern->pattern_index == pattern_index) {
       array_erase(&self->pattern_map, i);
+      if (i < self->wildcard_root_pattern_count) self->wildcard_root_pattern_count--;
       i--;
     }
   }
+  ts_query__pattern_map_build_offsets(self);
 }
 
 /***************
@@ -2841,6 +3201,9 @@ TSQueryCursor *ts_query_cursor_new(void) {
     .states = array_new(),
     .finished_states = array_new(),
     .capture_list_pool = capture_list_pool_new(),
+    .text_provider = {NULL, NULL},
+    .text_buffer = array_new(),
+    .regex_scratch = array_new(),
     .start_byte = 0,
     .end_byte = UINT32_MAX,
     .start_point = {0, 0},
@@ -2856,6 +3219,8 @@ void ts_query_cursor_delete(TSQueryCursor *self) {
   array_delete(&self->finished_states);
   ts_tree_cursor_delete(&self->cursor);
   capture_list_pool_delete(&self->capture_list_pool);
+  array_delete(&self->text_buffer);
+  array_delete(&self->regex_scratch);
   ts_free(self);
 }
 
@@ -2871,6 +3236,13 @@ void ts_query_cursor_set_match_limit(TSQueryCursor *self, uint32_t limit) {
   self->capture_list_pool.max_capture_list_count = limit;
 }
 
+void ts_query_cursor_set_text_provider(
+  TSQueryCursor *self,
+  TSQueryTextProvider provider
+) {
+  self->text_provider = provider;
+}
+
 void ts_query_cursor_exec(
   TSQueryCursor *self,
   const TSQuery *query,
@@ -2886,6 +3258,13 @@ void ts_query_cursor_exec(
   self->halted = false;
   self->query = query;
   self->did_exceed_match_limit = false;
+  self->has_unrooted_patterns = false;
+  for (unsigned i = 0; i < query->pattern_map.size; i++) {
+    if (!query->pattern_map.contents[i].is_rooted) {
+      self->has_unrooted_patterns = true;
+      break;
+    }
+  }
 }
 
 void ts_query_cursor_set_byte_range(
@@ -3214,6 +3593,129 @@ static QueryState *ts_query_cursor__copy_state(
   return &self->states.contents[state_index + 1];
 }
 
+// Get the text of the first node in the capture list with the given capture id.
+static bool ts_query_cursor__capture_text(
+  TSQueryCursor *self,
+  const CaptureList *captures,
+  uint16_t capture_id,
+  const char **text,
+  uint32_t *length
+) {
+  for (unsigned i = 0; i < captures->size; i++) {
+    if (captures->contents[i].index == capture_id) {
+      *length = 0;
+      *text = self->text_provider.text(
+        self->text_provider.payload,
+        captures->contents[i].node,
+        length
+      );
+      if (!*text) *length = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool text_eq(const char *left, uint32_t left_length, const char *right, uint32_t right_length) {
+  return left_length == right_length && (left_length == 0 || memcmp(left, right, left_length) == 0);
+}
+
+// Check if a state's captures satisfy the built-in predicates of its pattern.
+// Predicates that refer to captures that have not been made are satisfied, so
+// that this can also be used for matches that are still in progress.
+static bool ts_query_cursor__satisfies_text_predicates(
+  TSQueryCursor *self,
+  const QueryState *state
+) {
+  if (!self->text_provider.text) return true;
+  const TSQuery *query = self->query;
+  Slice slice = query->patterns.contents[state->pattern_index].text_predicates;
+  if (slice.length == 0) return true;
+
+  const CaptureList *captures = capture_list_pool_get(
+    &self->capture_list_pool,
+    state->capture_list_id
+  );
+  for (unsigned i = slice.offset; i < slice.offset + slice.length; i++) {
+    const TextPredicate *predicate = &query->text_predicates.contents[i];
+    const char *text;
+    uint32_t length;
+    if (!ts_query_cursor__capture_text(self, captures, predicate->capture_id, &text, &length)) {
+      continue;
+    }
+
+    bool is_match = false;
+    switch (predicate->type) {
+      case TextPredicateTypeEqString: {
+        uint32_t value_length;
+        const char *value = symbol_table_name_for_id(
+          &query->predicate_values,
+          predicate->value,
+          &value_length
+        );
+        is_match = text_eq(text, length, value, value_length);
+        break;
+      }
+
+      // The text provider's buffer may be reused by the next call, so keep a
+      // copy of the first capture's text.
+      case TextPredicateTypeEqCapture: {
+        array_clear(&self->text_buffer);
+        array_extend(&self->text_buffer, length, text);
+        if (!ts_query_cursor__capture_text(self, captures, predicate->value, &text, &length)) {
+          continue;
+        }
+        is_match = text_eq(self->text_buffer.contents, self->text_buffer.size, text, length);
+        break;
+      }
+
+      case TextPredicateTypeMatchString:
+        is_match = ts_regex_is_match(
+          query->regexes.contents[predicate->value],
+          text,
+          length,
+          &self->regex_scratch
+        );
+        break;
+
+      case TextPredicateTypeAnyOfStrings:
+        for (unsigned j = 0; j < predicate->values.length; j++) {
+          uint32_t value_length;
+          const char *value = symbol_table_name_for_id(
+            &query->predicate_values,
+            query->predicate_steps.contents[predicate->values.offset + j].value_id,
+            &value_length
+          );
+          if (text_eq(text, length, value, value_length)) {
+            is_match = true;
+            break;
+          }
+        }
+        break;
+    }
+
+    if (is_match != predicate->is_positive) return false;
+  }
+  return true;
+}
+
+// Add a state whose pattern is complete to the list of finished states. If
+// the state's captures do not satisfy the pattern's built-in predicates, then
+// discard it instead. Return whether the state was added.
+static bool ts_query_cursor__finish_state(
+  TSQueryCursor *self,
+  const QueryState *state
+) {
+  if (!ts_query_cursor__satisfies_text_predicates(self, state)) {
+    LOG("  discard match that fails predicates. pattern:%u\n", state->pattern_index);
+    capture_list_pool_release(&self->capture_list_pool, state->capture_list_id);
+    return false;
+  }
+  LOG("  finish pattern %u\n", state->pattern_index);
+  array_push(&self->finished_states, *state);
+  return true;
+}
+
 // Walk the tree, processing patterns until at least one pattern finishes,
 // If one or more patterns finish, return `true` and store their states in the
 // `finished_states` array. Multiple patterns can finish on the same node. If
@@ -3264,9 +3766,7 @@ static inline bool ts_query_cursor__advance(
         // in order to search for longer matches, mark it as finished.
         if (step->depth == PATTERN_DONE_MARKER) {
           if (state->start_depth > self->depth || self->halted) {
-            LOG("  finish pattern %u\n", state->pattern_index);
-            array_push(&self->finished_states, *state);
-            did_match = true;
+            if (ts_query_cursor__finish_state(self, state)) did_match = true;
             deleted_count++;
             continue;
           }
@@ -3302,6 +3802,44 @@ static inline bool ts_query_cursor__advance(
       TSNode parent_node = ts_tree_cursor_parent_node(&self->cursor);
       TSSymbol symbol = ts_node_symbol(node);
       bool is_named = ts_node_is_named(node);
+      bool node_intersects_range = (
+        ts_node_end_byte(node) > self->start_byte &&
+        ts_node_start_byte(node) < self->end_byte &&
+        point_gt(ts_node_end_point(node), self->start_point) &&
+        point_lt(ts_node_start_point(node), self->end_point)
+      );
+      bool parent_intersects_range = ts_node_is_null(parent_node) || (
+        ts_node_end_byte(parent_node) > self->start_byte &&
+        ts_node_start_byte(parent_node) < self->end_byte &&
+        point_gt(ts_node_end_point(parent_node), self->start_point) &&
+        point_lt(ts_node_start_point(parent_node), self->end_point)
+      );
+
+      // If there are no in-progress states, then a node outside of the range
+      // can only start a new match if its parent is inside of the range and
+      // the query has patterns without a single root node. Skip the other
+      // nodes without inspecting them, and stop once the rest of the tree is
+      // past the end of the range.
+      if (
+        !node_intersects_range &&
+        self->states.size == 0 &&
+        (!parent_intersects_range || !self->has_unrooted_patterns)
+      ) {
+        if (
+          !self->has_unrooted_patterns && (
+            ts_node_start_byte(node) >= self->end_byte ||
+            !point_lt(ts_node_start_point(node), self->end_point)
+          )
+        ) {
+          LOG("halt after range\n");
+          self->halted = true;
+        } else {
+          LOG("  skip node outside of range\n");
+          self->ascending = true;
+        }
+        continue;
+      }
+
       bool has_later_siblings;
       bool has_later_named_siblings;
       bool can_have_later_siblings_with_this_field;
@@ -3327,18 +3865,6 @@ static inline bool ts_query_cursor__advance(
         self->finished_states.size
       );
 
-      bool node_intersects_range = (
-        ts_node_end_byte(node) > self->start_byte &&
-        ts_node_start_byte(node) < self->end_byte &&
-        point_gt(ts_node_end_point(node), self->start_point) &&
-        point_lt(ts_node_start_point(node), self->end_point)
-      );
-      bool parent_intersects_range = ts_node_is_null(parent_node) || (
-        ts_node_end_byte(parent_node) > self->start_byte &&
-        ts_node_start_byte(parent_node) < self->end_byte &&
-        point_gt(ts_node_end_point(parent_node), self->start_point) &&
-        point_lt(ts_node_start_point(parent_node), self->end_point)
-      );
       bool node_is_error = symbol == ts_builtin_sym_error;
       bool parent_is_error =
         !ts_node_is_null(parent_node) &&
@@ -3365,29 +3891,22 @@ static inline bool ts_query_cursor__advance(
       }
 
       // Add new states for any patterns whose root node matches this node.
-      unsigned i;
-      if (ts_query__pattern_map_search(self->query, symbol, &i)) {
+      uint32_t start, end;
+      ts_query__pattern_map_range(self->query, symbol, &start, &end);
+      for (uint32_t i = start; i < end; i++) {
         PatternEntry *pattern = &self->query->pattern_map.contents[i];
-
         QueryStep *step = &self->query->steps.contents[pattern->step_index];
-        do {
-          // If this node matches the first step of the pattern, then add a new
-          // state at the start of this pattern.
-          if (
-            (pattern->is_rooted ?
-              node_intersects_range :
-              (parent_intersects_range && !parent_is_error)) &&
-            (!step->field || field_id == step->field)
-          ) {
-            ts_query_cursor__add_state(self, pattern);
-          }
 
-          // Advance to the next pattern whose root node matches this node.
-          i++;
-          if (i == self->query->pattern_map.size) break;
-          pattern = &self->query->pattern_map.contents[i];
-          step = &self->query->steps.contents[pattern->step_index];
-        } while (step->symbol == symbol);
+        // If this node matches the first step of the pattern, then add a new
+        // state at the start of this pattern.
+        if (
+          (pattern->is_rooted ?
+            node_intersects_range :
+            (parent_intersects_range && !parent_is_error)) &&
+          (!step->field || field_id == step->field)
+        ) {
+          ts_query_cursor__add_state(self, pattern);
+        }
       }
 
       // Update all of the in-progress states with current node.
@@ -3667,10 +4186,8 @@ static inline bool ts_query_cursor__advance(
             if (state->has_in_progress_alternatives) {
               LOG("  defer finishing pattern %u\n", state->pattern_index);
             } else {
-              LOG("  finish pattern %u\n", state->pattern_index);
-              array_push(&self->finished_states, *state);
+              if (ts_query_cursor__finish_state(self, state)) did_match = true;
               array_erase(&self->states, (uint32_t)(state - self->states.contents));
-              did_match = true;
               i--;
             }
           }
@@ -3702,7 +4219,13 @@ static inline bool ts_query_cursor__advance(
         );
       }
 
-      if (should_descend && ts_tree_cursor_goto_first_child(&self->cursor)) {
+      // When no states are in progress, skip over any children that end
+      // before the start of the range.
+      if (should_descend && (
+        self->states.size == 0 && !self->has_unrooted_patterns && self->start_byte > 0
+          ? ts_tree_cursor_goto_first_child_for_byte(&self->cursor, self->start_byte) >= 0
+          : ts_tree_cursor_goto_first_child(&self->cursor)
+      )) {
         self->depth++;
       } else {
         self->ascending = true;
@@ -3781,7 +4304,7 @@ bool ts_query_cursor_next_capture(
     uint32_t first_unfinished_pattern_index;
     uint32_t first_unfinished_state_index;
     bool first_unfinished_state_is_definite = false;
-    ts_query_cursor__first_in_progress_capture(
+    bool found_unfinished_state = ts_query_cursor__first_in_progress_capture(
       self,
       &first_unfinished_state_index,
       &first_unfinished_capture_byte,
@@ -3841,6 +4364,15 @@ bool ts_query_cursor_next_capture(
       state = first_finished_state;
     } else if (first_unfinished_state_is_definite) {
       state = &self->states.contents[first_unfinished_state_index];
+
+      // Captures can be returned before their match is finished, so discard
+      // the match if the captures so far already fail its predicates.
+      if (!ts_query_cursor__satisfies_text_predicates(self, state)) {
+        LOG("  discard match that fails predicates. pattern:%u\n", state->pattern_index);
+        capture_list_pool_release(&self->capture_list_pool, state->capture_list_id);
+        array_erase(&self->states, first_unfinished_state_index);
+        continue;
+      }
     } else {
       state = NULL;
     }
@@ -3860,7 +4392,7 @@ bool ts_query_cursor_next_capture(
       return true;
     }
 
-    if (capture_list_pool_is_empty(&self->capture_list_pool)) {
+    if (found_unfinished_state && capture_list_pool_is_empty(&self->capture_list_pool)) {
       LOG(
         "  abandon state. index:%u, pattern:%u, offset:%u.\n",
         first_unfinished_state_index,
@@ -0,0 +1,588 @@
+#include "./alloc.h"
+#include "./array.h"
+#include "./regex.h"
+#include "./unicode.h"
+#include <string.h>
+
+// The regular expression is compiled into a program for a simple virtual
+// machine, which is executed by simulating all of its possible threads in
+// lockstep, so that matching takes time proportional to the length of the
+// text times the length of the program.
+
+#define MAX_REPETITION_COUNT 1000
+#define MAX_PROGRAM_SIZE 8192
+#define PLACEHOLDER UINT32_MAX
+
+typedef enum {
+  RegexOpChar,
+  RegexOpAny,
+  RegexOpClass,
+  RegexOpSplit,
+  RegexOpJump,
+  RegexOpAssertStart,
+  RegexOpAssertEnd,
+  RegexOpMatch,
+} RegexOp;
+
+/*
+ * RegexInstruction - One instruction of a compiled regular expression.
+ * - `Char` consumes the code point `value`.
+ * - `Any` consumes any code point other than a newline.
+ * - `Class` consumes a code point within (or, if `negated` is set, not within)
+ *   the `count` ranges that begin at index `value` of the `ranges` array.
+ * - `Split` continues at both `value` and `alternative`.
+ * - `Jump` continues at `value`.
+ * - `AssertStart` and `AssertEnd` only continue at the start and the end of
+ *   the text.
+ */
+typedef struct {
+  uint8_t op;
+  bool negated;
+  uint32_t value;
+  uint32_t alternative;
+  uint32_t count;
+} RegexInstruction;
+
+typedef struct {
+  int32_t start;
+  int32_t end;
+} RegexRange;
+
+typedef Array(RegexInstruction) RegexProgram;
+
+struct Regex {
+  RegexProgram program;
+  Array(RegexRange) ranges;
+  bool is_anchored;
+};
+
+typedef struct {
+  const uint8_t *input;
+  const uint8_t *end;
+  Regex *regex;
+} RegexParser;
+
+static bool regex_parser__parse_alternation(RegexParser *self);
+
+/***********
+ * Parsing
+ ***********/
+
+static inline bool regex_parser__peek(RegexParser *self, char c) {
+  return self->input < self->end && *self->input == (uint8_t)c;
+}
+
+static inline bool regex_parser__accept(RegexParser *self, char c) {
+  if (regex_parser__peek(self, c)) {
+    self->input++;
+    return true;
+  }
+  return false;
+}
+
+static inline bool regex_parser__emit(RegexParser *self, RegexInstruction instruction) {
+  if (self->regex->program.size >= MAX_PROGRAM_SIZE) return false;
+  array_push(&self->regex->program, instruction);
+  return true;
+}
+
+static inline bool regex_parser__is_jump(RegexInstruction instruction) {
+  return instruction.op == RegexOpSplit || instruction.op == RegexOpJump;
+}
+
+// Insert an instruction into the program, adjusting the targets of the
+// instructions after it.
+static bool regex_parser__insert(
+  RegexParser *self,
+  uint32_t index,
+  RegexInstruction instruction
+) {
+  RegexProgram *program = &self->regex->program;
+  if (program->size >= MAX_PROGRAM_SIZE) return false;
+  for (uint32_t i = index; i < program->size; i++) {
+    RegexInstruction *other = &program->contents[i];
+    if (regex_parser__is_jump(*other)) {
+      if (other->value != PLACEHOLDER && other->value >= index) other->value++;
+      if (other->op == RegexOpSplit && other->alternative != PLACEHOLDER && other->alternative >= index) {
+        other->alternative++;
+      }
+    }
+  }
+  array_insert(program, index, instruction);
+  return true;
+}
+
+// Append a copy of a fragment of a program, which originally started at
+// the given index, adjusting the targets of its instructions.
+static bool regex_parser__emit_fragment(
+  RegexParser *self,
+  const RegexProgram *fragment,
+  uint32_t original_start
+) {
+  uint32_t start = self->regex->program.size;
+  for (uint32_t i = 0; i < fragment->size; i++) {
+    RegexInstruction instruction = fragment->contents[i];
+    if (regex_parser__is_jump(instruction)) {
+      instruction.value = instruction.value - original_start + start;
+      if (instruction.op == RegexOpSplit) {
+        instruction.alternative = instruction.alternative - original_start + start;
+      }
+    }
+    if (!regex_parser__emit(self, instruction)) return false;
+  }
+  return true;
+}
+
+static bool regex_parser__parse_decimal(RegexParser *self, uint32_t *result) {
+  const uint8_t *start = self->input;
+  *result = 0;
+  while (self->input < self->end && *self->input >= '0' && *self->input <= '9') {
+    *result = *result * 10 + (*self->input - '0');
+    if (*result > MAX_REPETITION_COUNT) return false;
+    self->input++;
+  }
+  return self->input > start;
+}
+
+static bool regex_parser__parse_hex(RegexParser *self, int32_t *code_point) {
+  bool is_braced = regex_parser__accept(self, '{');
+  uint32_t digit_count = 0;
+  *code_point = 0;
+  while (self->input < self->end) {
+    uint8_t c = *self->input;
+    int32_t digit;
+    if (c >= '0' && c <= '9') digit = c - '0';
+    else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+    else break;
+    if (!is_braced && digit_count == 2) break;
+    *code_point = *code_point * 16 + digit;
+    if (*code_point > 0x10FFFF) return false;
+    digit_count++;
+    self->input++;
+  }
+  if (is_braced) {
+    return digit_count > 0 && regex_parser__accept(self, '}');
+  } else {
+    return digit_count == 2;
+  }
+}
+
+// Parse an escape sequence that represents a single code point.
+static bool regex_parser__parse_escape(RegexParser *self, int32_t *code_point) {
+  if (self->input == self->end) return false;
+  uint8_t c = *self->input++;
+  switch (c) {
+    case 'n': *code_point = '\n'; return true;
+    case 't': *code_point = '\t'; return true;
+    case 'r': *code_point = '\r'; return true;
+    case 'f': *code_point = '\f'; return true;
+    case 'v': *code_point = '\v'; return true;
+    case 'x': return regex_parser__parse_hex(self, code_point);
+    default:
+      if (c < 128 && ((c >= '!' && c <= '/') || (c >= ':' && c <= '@') || (c >= '[' && c <= '`') || (c >= '{' && c <= '~'))) {
+        *code_point = c;
+        return true;
+      }
+      return false;
+  }
+}
+
+static bool regex_parser__parse_code_point(RegexParser *self, int32_t *code_point) {
+  uint32_t size = ts_decode_utf8(self->input, self->end - self->input, code_point);
+  self->input += size;
+  return *code_point >= 0;
+}
+
+// Parse one endpoint of a range within a bracketed character class.
+static bool regex_parser__parse_class_member(RegexParser *self, int32_t *code_point) {
+  if (self->input == self->end) return false;
+
+  // Nested classes, and the set operations between classes, are not supported.
+  if (*self->input == '[') return false;
+  if (self->end - self->input >= 2) {
+    uint8_t c = self->input[0];
+    if ((c == '&' || c == '-' || c == '~') && self->input[1] == c) return false;
+  }
+
+  if (regex_parser__accept(self, '\\')) {
+    return regex_parser__parse_escape(self, code_point);
+  }
+  return regex_parser__parse_code_point(self, code_point);
+}
+
+static bool regex_parser__parse_class(RegexParser *self) {
+  Regex *regex = self->regex;
+  RegexInstruction instruction = {
+    .op = RegexOpClass,
+    .negated = regex_parser__accept(self, '^'),
+    .value = regex->ranges.size,
+  };
+
+  bool is_first = true;
+  for (;;) {
+    if (self->input == self->end) return false;
+    if (!is_first && regex_parser__accept(self, ']')) break;
+
+    int32_t start, end;
+    if (is_first && regex_parser__accept(self, ']')) {
+      start = ']';
+    } else if (!regex_parser__parse_class_member(self, &start)) {
+      return false;
+    }
+    end = start;
+    if (
+      self->end - self->input >= 2 &&
+      self->input[0] == '-' &&
+      self->input[1] != ']'
+    ) {
+      self->input++;
+      if (!regex_parser__parse_class_member(self, &end) || end < start) return false;
+    }
+    array_push(&regex->ranges, ((RegexRange) {start, end}));
+    is_first = false;
+  }
+
+  instruction.count = regex->ranges.size - instruction.value;
+  return regex_parser__emit(self, instruction);
+}
+
+// Parse a single item, with no repetition operator.
+static bool regex_parser__parse_atom(RegexParser *self, bool *can_repeat) {
+  *can_repeat = true;
+  uint8_t c = *self->input++;
+  switch (c) {
+    case '(':
+      if (regex_parser__accept(self, '?') && !regex_parser__accept(self, ':')) return false;
+      return regex_parser__parse_alternation(self) && regex_parser__accept(self, ')');
+    case '.':
+      return regex_parser__emit(self, (RegexInstruction) {.op = RegexOpAny});
+    case '^':
+      *can_repeat = false;
+      return regex_parser__emit(self, (RegexInstruction) {.op = RegexOpAssertStart});
+    case '$':
+      *can_repeat = false;
+      return regex_parser__emit(self, (RegexInstruction) {.op = RegexOpAssertEnd});
+    case '[':
+      return regex_parser__parse_class(self);
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+      return false;
+    case '\\': {
+      if (regex_parser__accept(self, 'A')) {
+        *can_repeat = false;
+        return regex_parser__emit(self, (RegexInstruction) {.op = RegexOpAssertStart});
+      }
+      if (regex_parser__accept(self, 'z')) {
+        *can_repeat = false;
+        return regex_parser__emit(self, (RegexInstruction) {.op = RegexOpAssertEnd});
+      }
+      int32_t code_point;
+      return
+        regex_parser__parse_escape(self, &code_point) &&
+        regex_parser__emit(self, (RegexInstruction) {.op = RegexOpChar, .value = code_point});
+    }
+    default: {
+      self->input--;
+      int32_t code_point;
+      return
+        regex_parser__parse_code_point(self, &code_point) &&
+        regex_parser__emit(self, (RegexInstruction) {.op = RegexOpChar, .value = code_point});
+    }
+  }
+}
+
+// Parse a repetition operator, if there is one.
+static bool regex_parser__parse_repetition(RegexParser *self, uint32_t *min, uint32_t *max) {
+  if (regex_parser__accept(self, '*')) {
+    *min = 0;
+    *max = PLACEHOLDER;
+  } else if (regex_parser__accept(self, '+')) {
+    *min = 1;
+    *max = PLACEHOLDER;
+  } else if (regex_parser__accept(self, '?')) {
+    *min = 0;
+    *max = 1;
+  } else if (regex_parser__accept(self, '{')) {
+    if (!regex_parser__parse_decimal(self, min)) return false;
+    *max = *min;
+    if (regex_parser__accept(self, ',')) {
+      if (regex_parser__peek(self, '}')) {
+        *max = PLACEHOLDER;
+      } else if (!regex_parser__parse_decimal(self, max) || *max < *min) {
+        return false;
+      }
+    }
+    if (!regex_parser__accept(self, '}')) return false;
+  } else {
+    *min = 1;
+    *max = 1;
+    return true;
+  }
+
+  // Lazy repetition matches the same texts as greedy repetition.
+  regex_parser__accept(self, '?');
+  return true;
+}
+
+// Replace the fragment of the program that starts at the given index with
+// a sequence of copies of it.
+static bool regex_parser__repeat(RegexParser *self, uint32_t start, uint32_t min, uint32_t max) {
+  RegexProgram *program = &self->regex->program;
+  RegexProgram fragment = array_new();
+  array_extend(&fragment, program->size - start, &program->contents[start]);
+  program->size = start;
+
+  bool result = true;
+  for (uint32_t i = 0; i < min && result; i++) {
+    result = regex_parser__emit_fragment(self, &fragment, start);
+  }
+
+  if (max == PLACEHOLDER) {
+    uint32_t loop_start = program->size;
+    result = result &&
+      regex_parser__emit(self, (RegexInstruction) {.op = RegexOpSplit, .value = loop_start + 1}) &&
+      regex_parser__emit_fragment(self, &fragment, start) &&
+      regex_parser__emit(self, (RegexInstruction) {.op = RegexOpJump, .value = loop_start});
+    if (result) program->contents[loop_start].alternative = program->size;
+  } else {
+    uint32_t optional_start = program->size;
+    for (uint32_t i = min; i < max && result; i++) {
+      result =
+        regex_parser__emit(self, (RegexInstruction) {
+          .op = RegexOpSplit,
+          .value = program->size + 1,
+          .alternative = PLACEHOLDER,
+        }) &&
+        regex_parser__emit_fragment(self, &fragment, start);
+    }
+    for (uint32_t i = optional_start; i < program->size && result; i++) {
+      RegexInstruction *instruction = &program->contents[i];
+      if (instruction->op == RegexOpSplit && instruction->alternative == PLACEHOLDER) {
+        instruction->alternative = program->size;
+      }
+    }
+  }
+
+  array_delete(&fragment);
+  return result;
+}
+
+static bool regex_parser__parse_concatenation(RegexParser *self) {
+  while (
+    self->input < self->end &&
+    !regex_parser__peek(self, '|') &&
+    !regex_parser__peek(self, ')')
+  ) {
+    uint32_t start = self->regex->program.size;
+    uint32_t min, max;
+    bool can_repeat;
+    if (!regex_parser__parse_atom(self, &can_repeat)) return false;
+    const uint8_t *operator_start = self->input;
+    if (!regex_parser__parse_repetition(self, &min, &max)) return false;
+    if (operator_start == self->input) continue;
+    if (!can_repeat) return false;
+    if (!regex_parser__repeat(self, start, min, max)) return false;
+
+    // Repetition operators cannot be stacked directly.
+    if (
+      regex_parser__peek(self, '*') ||
+      regex_parser__peek(self, '+') ||
+      regex_parser__peek(self, '?') ||
+      regex_parser__peek(self, '{')
+    ) return false;
+  }
+  return true;
+}
+
+static bool regex_parser__parse_alternation(RegexParser *self) {
+  RegexProgram *program = &self->regex->program;
+  uint32_t start = program->size;
+  if (!regex_parser__parse_concatenation(self)) return false;
+
+  uint32_t alternation_start = start;
+  while (regex_parser__accept(self, '|')) {
+    if (
+      !regex_parser__insert(self, start, (RegexInstruction) {
+        .op = RegexOpSplit,
+        .value = start + 1,
+      }) ||
+      !regex_parser__emit(self, (RegexInstruction) {.op = RegexOpJump, .value = PLACEHOLDER})
+    ) return false;
+    program->contents[start].alternative = program->size;
+    start = program->size;
+    if (!regex_parser__parse_concatenation(self)) return false;
+  }
+
+  for (uint32_t i = alternation_start; i < program->size; i++) {
+    RegexInstruction *instruction = &program->contents[i];
+    if (instruction->op == RegexOpJump && instruction->value == PLACEHOLDER) {
+      instruction->value = program->size;
+    }
+  }
+  return true;
+}
+
+Regex *ts_regex_new(const char *pattern, uint32_t length) {
+  Regex *self = ts_malloc(sizeof(Regex));
+  *self = (Regex) {
+    .program = array_new(),
+    .ranges = array_new(),
+    .is_anchored = false,
+  };
+  RegexParser parser = {
+    .input = (const uint8_t *)pattern,
+    .end = (const uint8_t *)pattern + length,
+    .regex = self,
+  };
+  if (
+    !regex_parser__parse_alternation(&parser) ||
+    parser.input != parser.end ||
+    !regex_parser__emit(&parser, (RegexInstruction) {.op = RegexOpMatch})
+  ) {
+    ts_regex_delete(self);
+    return NULL;
+  }
+  self->is_anchored = self->program.contents[0].op == RegexOpAssertStart;
+  return self;
+}
+
+void ts_regex_delete(Regex *self) {
+  array_delete(&self->program);
+  array_delete(&self->ranges);
+  ts_free(self);
+}
+
+/************
+ * Matching
+ ************/
+
+typedef struct {
+  const Regex *regex;
+  uint32_t *marks;
+  uint32_t *stack;
+  uint32_t generation;
+  uint32_t position;
+  uint32_t length;
+} RegexMatcher;
+
+// Add a thread at the given instruction to a list of threads, following
+// all of the instructions that do not consume any text. Returns true if
+// the regular expression has matched.
+static bool regex_matcher__add_thread(
+  RegexMatcher *self,
+  uint32_t *list,
+  uint32_t *count,
+  uint32_t instruction_index
+) {
+  uint32_t stack_size = 0;
+  self->stack[stack_size++] = instruction_index;
+  while (stack_size > 0) {
+    uint32_t index = self->stack[--stack_size];
+    if (self->marks[index] == self->generation) continue;
+    self->marks[index] = self->generation;
+
+    const RegexInstruction *instruction = &self->regex->program.contents[index];
+    switch (instruction->op) {
+      case RegexOpMatch:
+        return true;
+      case RegexOpJump:
+        self->stack[stack_size++] = instruction->value;
+        break;
+      case RegexOpSplit:
+        self->stack[stack_size++] = instruction->alternative;
+        self->stack[stack_size++] = instruction->value;
+        break;
+      case RegexOpAssertStart:
+        if (self->position == 0) self->stack[stack_size++] = index + 1;
+        break;
+      case RegexOpAssertEnd:
+        if (self->position == self->length) self->stack[stack_size++] = index + 1;
+        break;
+      default:
+        list[(*count)++] = index;
+        break;
+    }
+  }
+  return false;
+}
+
+static bool regex__consumes(const Regex *self, const RegexInstruction *instruction, int32_t code_point) {
+  if (code_point < 0) return false;
+  switch (instruction->op) {
+    case RegexOpChar:
+      return code_point == (int32_t)instruction->value;
+    case RegexOpAny:
+      return code_point != '\n';
+    case RegexOpClass: {
+      const RegexRange *ranges = &self->ranges.contents[instruction->value];
+      bool is_member = false;
+      for (uint32_t i = 0; i < instruction->count; i++) {
+        if (code_point >= ranges[i].start && code_point <= ranges[i].end) {
+          is_member = true;
+          break;
+        }
+      }
+      return is_member != instruction->negated;
+    }
+    default:
+      return false;
+  }
+}
+
+bool ts_regex_is_match(
+  const Regex *self,
+  const char *text,
+  uint32_t length,
+  RegexScratch *scratch
+) {
+  // The scratch memory holds two lists of threads, a mark for each instruction
+  // indicating the last position where a thread was added for it, and a stack,
+  // where each instruction can be pushed at most twice.
+  uint32_t program_size = self->program.size;
+  array_reserve(scratch, program_size * 5 + 1);
+  uint32_t *current = scratch->contents;
+  uint32_t *next = current + program_size;
+  RegexMatcher matcher = {
+    .regex = self,
+    .marks = next + program_size,
+    .stack = next + program_size * 2,
+    .generation = 1,
+    .position = 0,
+    .length = length,
+  };
+  memset(matcher.marks, 0, program_size * sizeof(uint32_t));
+
+  uint32_t count = 0;
+  for (;;) {
+    if (!self->is_anchored || matcher.position == 0) {
+      if (regex_matcher__add_thread(&matcher, current, &count, 0)) return true;
+    }
+    if (matcher.position == length || (count == 0 && self->is_anchored)) return false;
+
+    int32_t code_point;
+    uint32_t size = ts_decode_utf8(
+      (const uint8_t *)text + matcher.position,
+      length - matcher.position,
+      &code_point
+    );
+    if (size == 0) size = 1;
+    matcher.position += size;
+    matcher.generation++;
+
+    uint32_t next_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t index = current[i];
+      if (regex__consumes(self, &self->program.contents[index], code_point)) {
+        if (regex_matcher__add_thread(&matcher, next, &next_count, index + 1)) return true;
+      }
+    }
+
+    uint32_t *temp = current;
+    current = next;
+    next = temp;
+    count = next_count;
+  }
+}
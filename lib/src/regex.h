@@ -0,0 +1,44 @@
+#ifndef TREE_SITTER_REGEX_H_
+#define TREE_SITTER_REGEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "./array.h"
+
+// A compiled regular expression, used to evaluate the `#match?` predicates
+// in queries.
+//
+// Only a subset of the usual regular expression syntax is supported: literal
+// characters, `.`, bracketed character classes, the anchors `^`, `$`, `\A`
+// and `\z`, groups, alternation, and the `*`, `+`, `?` and `{n,m}` repetition
+// operators. Character classes whose meaning depends on unicode tables, like
+// `\w` and `\d`, flags, and backreferences are not supported. Text is matched
+// one UTF8-encoded code point at a time, and invalid UTF8 bytes never match
+// `.` or a character class.
+typedef struct Regex Regex;
+
+// Memory that is reused between calls to `ts_regex_is_match`.
+typedef Array(uint32_t) RegexScratch;
+
+// Compile a regular expression. Returns NULL if the pattern is invalid, or if
+// it uses syntax that is not supported.
+Regex *ts_regex_new(const char *pattern, uint32_t length);
+void ts_regex_delete(Regex *);
+
+// Check if the regular expression matches any part of the given text.
+bool ts_regex_is_match(
+  const Regex *,
+  const char *text,
+  uint32_t length,
+  RegexScratch *scratch
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TREE_SITTER_REGEX_H_
@@ -0,0 +1,83 @@
+#ifndef TREE_SITTER_SERIALIZATION_H_
+#define TREE_SITTER_SERIALIZATION_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "./array.h"
+
+// Helpers for reading and writing the binary format of serialized syntax
+// trees. Integers are written as variable-length sequences of bytes, seven
+// bits at a time, with the least significant bits first. Signed integers are
+// zigzag-encoded so that small negative numbers are also short.
+
+typedef Array(uint8_t) ByteArray;
+
+typedef struct {
+  const uint8_t *position;
+  const uint8_t *end;
+} ByteReader;
+
+static inline void byte_array_push_uint(ByteArray *self, uint32_t value) {
+  while (value >= 0x80) {
+    array_push(self, (uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  array_push(self, (uint8_t)value);
+}
+
+static inline void byte_array_push_int(ByteArray *self, int32_t value) {
+  byte_array_push_uint(self, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static inline void byte_array_push_bytes(ByteArray *self, const void *bytes, uint32_t length) {
+  array_extend(self, length, bytes);
+}
+
+static inline bool byte_reader_read_uint(ByteReader *self, uint32_t *value) {
+  uint32_t result = 0;
+  for (unsigned shift = 0; shift < 32; shift += 7) {
+    if (self->position == self->end) return false;
+    uint8_t byte = *self->position++;
+    result |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline bool byte_reader_read_int(ByteReader *self, int32_t *value) {
+  uint32_t encoded;
+  if (!byte_reader_read_uint(self, &encoded)) return false;
+  *value = (int32_t)(encoded >> 1) ^ -(int32_t)(encoded & 1);
+  return true;
+}
+
+static inline bool byte_reader_read_bytes(ByteReader *self, const uint8_t **bytes, uint32_t length) {
+  if ((size_t)(self->end - self->position) < length) return false;
+  *bytes = self->position;
+  self->position += length;
+  return true;
+}
+
+// Compute a checksum of the given bytes, which is used to detect serialized
+// data that has been truncated or corrupted. This is the 32-bit FNV-1a hash.
+static inline uint32_t serialization_checksum(const uint8_t *bytes, uint32_t length) {
+  uint32_t result = 2166136261u;
+  for (uint32_t i = 0; i < length; i++) {
+    result ^= bytes[i];
+    result *= 16777619u;
+  }
+  return result;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TREE_SITTER_SERIALIZATION_H_
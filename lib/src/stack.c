@@ -8,8 +8,10 @@
 #include <stdio.h>
 
 #define MAX_LINK_COUNT 8
-#define MAX_NODE_POOL_SIZE 50
 #define MAX_ITERATOR_COUNT 64
+#define STACK_NODE_SLAB_SIZE 128
+#define MAX_RETAINED_SLAB_COUNT 4
+#define MAX_LINK_POOL_SIZE 32
 
 #if defined _WIN32 && !defined __GNUC__
 #define inline __forceinline
@@ -25,17 +27,35 @@ typedef struct {
   bool is_pending;
 } StackLink;
 
+// Most stack nodes only ever have a single link, so that link is stored
+// inline. When a second link is added, the node's links are moved into an
+// array of `MAX_LINK_COUNT` links taken from the stack's link pool.
 struct StackNode {
   TSStateId state;
-  Length position;
-  StackLink links[MAX_LINK_COUNT];
   short unsigned int link_count;
+  Length position;
+  StackLink *links;
+  StackLink first_link;
   uint32_t ref_count;
   unsigned error_cost;
   unsigned node_count;
   int dynamic_precedence;
 };
 
+// Stack nodes are carved out of fixed-size slabs, which are only returned
+// to the allocator when the stack is deleted or reset. Released nodes are
+// kept in an intrusive free list, threaded through their `first_link.node`
+// fields.
+typedef struct {
+  Array(StackNode *) slabs;
+  uint32_t slab_index;
+  uint32_t slab_offset;
+  StackNode *free_list;
+  Array(StackLink *) link_pool;
+  uint32_t live_node_count;
+  StackAllocationStats stats;
+} StackNodePool;
+
 typedef struct {
   StackNode *node;
   SubtreeArray subtrees;
@@ -43,8 +63,6 @@ typedef struct {
   bool is_pending;
 } StackIterator;
 
-typedef Array(StackNode *) StackNodeArray;
-
 typedef enum {
   StackStatusActive,
   StackStatusPaused,
@@ -64,7 +82,7 @@ struct Stack {
   Array(StackHead) heads;
   StackSliceArray slices;
   Array(StackIterator) iterators;
-  StackNodeArray node_pool;
+  StackNodePool node_pool;
   StackNode *base_node;
   SubtreePool *subtree_pool;
 };
@@ -78,6 +96,74 @@ enum {
 
 typedef StackAction (*StackCallback)(void *, const StackIterator *);
 
+static StackNode *stack_node_pool_alloc(StackNodePool *self) {
+  StackNode *node;
+  if (self->free_list) {
+    node = self->free_list;
+    self->free_list = node->first_link.node;
+  } else {
+    if (self->slab_offset == STACK_NODE_SLAB_SIZE) {
+      self->slab_index++;
+      self->slab_offset = 0;
+    }
+    if (self->slab_index == self->slabs.size) {
+      array_push(&self->slabs, ts_malloc(STACK_NODE_SLAB_SIZE * sizeof(StackNode)));
+      self->stats.allocator_call_count++;
+    }
+    node = &self->slabs.contents[self->slab_index][self->slab_offset++];
+  }
+  self->live_node_count++;
+  if (self->live_node_count > self->stats.max_live_node_count) {
+    self->stats.max_live_node_count = self->live_node_count;
+  }
+  self->stats.node_count++;
+  return node;
+}
+
+static void stack_node_pool_free(StackNodePool *self, StackNode *node) {
+  if (node->links != &node->first_link) {
+    if (self->link_pool.size < MAX_LINK_POOL_SIZE) {
+      array_push(&self->link_pool, node->links);
+    } else {
+      ts_free(node->links);
+    }
+  }
+  node->first_link.node = self->free_list;
+  self->free_list = node;
+  self->live_node_count--;
+}
+
+static StackLink *stack_node_pool_alloc_links(StackNodePool *self) {
+  self->stats.link_array_count++;
+  if (self->link_pool.size > 0) return array_pop(&self->link_pool);
+  self->stats.allocator_call_count++;
+  return ts_malloc(MAX_LINK_COUNT * sizeof(StackLink));
+}
+
+// Discard all of the pool's free nodes at once and resume carving nodes from
+// the beginning of the first slab. This is only possible when the only live
+// node is the stack's base node, which is always the first node allocated.
+static void stack_node_pool_reset(StackNodePool *self, StackNode *base_node) {
+  if (self->live_node_count != 1 || base_node != self->slabs.contents[0]) return;
+  while (self->slabs.size > MAX_RETAINED_SLAB_COUNT) {
+    ts_free(array_pop(&self->slabs));
+  }
+  self->slab_index = 0;
+  self->slab_offset = 1;
+  self->free_list = NULL;
+}
+
+static void stack_node_pool_delete(StackNodePool *self) {
+  for (uint32_t i = 0; i < self->slabs.size; i++) {
+    ts_free(self->slabs.contents[i]);
+  }
+  for (uint32_t i = 0; i < self->link_pool.size; i++) {
+    ts_free(self->link_pool.contents[i]);
+  }
+  array_delete(&self->slabs);
+  array_delete(&self->link_pool);
+}
+
 static void stack_node_retain(StackNode *self) {
   if (!self)
     return;
@@ -88,7 +174,7 @@ static void stack_node_retain(StackNode *self) {
 
 static void stack_node_release(
   StackNode *self,
-  StackNodeArray *pool,
+  StackNodePool *pool,
   SubtreePool *subtree_pool
 ) {
 recur:
@@ -108,11 +194,7 @@ recur:
     first_predecessor = self->links[0].node;
   }
 
-  if (pool->size < MAX_NODE_POOL_SIZE) {
-    array_push(pool, self);
-  } else {
-    ts_free(self);
-  }
+  stack_node_pool_free(pool, self);
 
   if (first_predecessor) {
     self = first_predecessor;
@@ -125,20 +207,19 @@ static StackNode *stack_node_new(
   Subtree subtree,
   bool is_pending,
   TSStateId state,
-  StackNodeArray *pool
+  StackNodePool *pool
 ) {
-  StackNode *node = pool->size > 0
-    ? array_pop(pool)
-    : ts_malloc(sizeof(StackNode));
+  StackNode *node = stack_node_pool_alloc(pool);
   *node = (StackNode) {
     .ref_count = 1,
     .link_count = 0,
     .state = state
   };
+  node->links = &node->first_link;
 
   if (previous_node) {
     node->link_count = 1;
-    node->links[0] = (StackLink) {
+    node->first_link = (StackLink) {
       .node = previous_node,
       .subtree = subtree,
       .is_pending = is_pending,
@@ -185,6 +266,7 @@ static bool stack__subtree_is_equivalent(Subtree left, Subtree right) {
 static void stack_node_add_link(
   StackNode *self,
   StackLink link,
+  StackNodePool *pool,
   SubtreePool *subtree_pool
 ) {
   if (link.node == self) return;
@@ -216,7 +298,7 @@ static void stack_node_add_link(
         existing_link->node->position.bytes == link.node->position.bytes
       ) {
         for (int j = 0; j < link.node->link_count; j++) {
-          stack_node_add_link(existing_link->node, link.node->links[j], subtree_pool);
+          stack_node_add_link(existing_link->node, link.node->links[j], pool, subtree_pool);
         }
         int32_t dynamic_precedence = link.node->dynamic_precedence;
         if (link.subtree.ptr) {
@@ -231,6 +313,10 @@ static void stack_node_add_link(
   }
 
   if (self->link_count == MAX_LINK_COUNT) return;
+  if (self->link_count == 1) {
+    self->links = stack_node_pool_alloc_links(pool);
+    self->links[0] = self->first_link;
+  }
 
   stack_node_retain(link.node);
   unsigned node_count = link.node->node_count;
@@ -249,7 +335,7 @@ static void stack_node_add_link(
 
 static void stack_head_delete(
   StackHead *self,
-  StackNodeArray *pool,
+  StackNodePool *pool,
   SubtreePool *subtree_pool
 ) {
   if (self->node) {
@@ -408,11 +494,11 @@ Stack *ts_stack_new(SubtreePool *subtree_pool) {
   array_init(&self->heads);
   array_init(&self->slices);
   array_init(&self->iterators);
-  array_init(&self->node_pool);
+  array_init(&self->node_pool.slabs);
+  array_init(&self->node_pool.link_pool);
   array_reserve(&self->heads, 4);
   array_reserve(&self->slices, 4);
   array_reserve(&self->iterators, 4);
-  array_reserve(&self->node_pool, MAX_NODE_POOL_SIZE);
 
   self->subtree_pool = subtree_pool;
   self->base_node = stack_node_new(NULL, NULL_SUBTREE, false, 1, &self->node_pool);
@@ -431,15 +517,15 @@ void ts_stack_delete(Stack *self) {
     stack_head_delete(&self->heads.contents[i], &self->node_pool, self->subtree_pool);
   }
   array_clear(&self->heads);
-  if (self->node_pool.contents) {
-    for (uint32_t i = 0; i < self->node_pool.size; i++)
-      ts_free(self->node_pool.contents[i]);
-    array_delete(&self->node_pool);
-  }
+  stack_node_pool_delete(&self->node_pool);
   array_delete(&self->heads);
   ts_free(self);
 }
 
+StackAllocationStats ts_stack_allocation_stats(const Stack *self) {
+  return self->node_pool.stats;
+}
+
 uint32_t ts_stack_version_count(const Stack *self) {
   return self->heads.size;
 }
@@ -681,7 +767,7 @@ bool ts_stack_merge(Stack *self, StackVersion version1, StackVersion version2) {
   StackHead *head1 = &self->heads.contents[version1];
   StackHead *head2 = &self->heads.contents[version2];
   for (uint32_t i = 0; i < head2->node->link_count; i++) {
-    stack_node_add_link(head1->node, head2->node->links[i], self->subtree_pool);
+    stack_node_add_link(head1->node, head2->node->links[i], &self->node_pool, self->subtree_pool);
   }
   if (head1->node->state == ERROR_STATE) {
     head1->node_count_at_last_error = head1->node->node_count;
@@ -739,6 +825,7 @@ void ts_stack_clear(Stack *self) {
   for (uint32_t i = 0; i < self->heads.size; i++) {
     stack_head_delete(&self->heads.contents[i], &self->node_pool, self->subtree_pool);
   }
+  stack_node_pool_reset(&self->node_pool, self->base_node);
   array_clear(&self->heads);
   array_push(&self->heads, ((StackHead) {
     .node = self->base_node,
@@ -28,12 +28,27 @@ typedef struct {
 } StackSummaryEntry;
 typedef Array(StackSummaryEntry) StackSummary;
 
+typedef struct {
+  // The number of stack nodes that have been handed out.
+  uint64_t node_count;
+  // The number of times that a stack node needed room for more than one link.
+  uint64_t link_array_count;
+  // The number of these requests that could not be served from the stack's
+  // own pools and had to call the allocator.
+  uint64_t allocator_call_count;
+  // The largest number of stack nodes that were alive at the same time.
+  uint32_t max_live_node_count;
+} StackAllocationStats;
+
 // Create a stack.
 Stack *ts_stack_new(SubtreePool *);
 
 // Release the memory reserved for a given stack.
 void ts_stack_delete(Stack *);
 
+// Get the counters that track the stack's memory usage since it was created.
+StackAllocationStats ts_stack_allocation_stats(const Stack *);
+
 // Get the stack's current number of versions.
 uint32_t ts_stack_version_count(const Stack *);
 
@@ -20,6 +20,21 @@ typedef struct {
 
 #define TS_MAX_INLINE_TREE_LENGTH UINT8_MAX
 #define TS_MAX_TREE_POOL_SIZE 32
+#define TS_SUBTREE_ARENA_BLOCK_SIZE (64 * 1024)
+#define TS_SUBTREE_ARENA_ALIGNMENT 8
+
+typedef struct SubtreeArenaBlock {
+  struct SubtreeArenaBlock *next;
+  size_t size;
+  size_t used;
+} SubtreeArenaBlock;
+
+struct SubtreeArena {
+  volatile uint32_t ref_count;
+  SubtreeArenaBlock *blocks;
+  SubtreeArray owned_subtrees;
+  Array(SubtreeArena *) dependencies;
+};
 
 // ExternalScannerState
 
@@ -118,7 +133,7 @@ void ts_subtree_array_reverse(SubtreeArray *self) {
 // SubtreePool
 
 SubtreePool ts_subtree_pool_new(uint32_t capacity) {
-  SubtreePool self = {array_new(), array_new()};
+  SubtreePool self = {array_new(), array_new(), NULL, false};
   array_reserve(&self.free_trees, capacity);
   return self;
 }
@@ -133,8 +148,127 @@ void ts_subtree_pool_delete(SubtreePool *self) {
   if (self->tree_stack.contents) array_delete(&self->tree_stack);
 }
 
+// SubtreeArena
+
+static inline size_t ts_subtree_arena__align(size_t size) {
+  return (size + TS_SUBTREE_ARENA_ALIGNMENT - 1) & ~(size_t)(TS_SUBTREE_ARENA_ALIGNMENT - 1);
+}
+
+static void *ts_subtree_arena__allocate(SubtreeArena *self, size_t size) {
+  const size_t header_size = ts_subtree_arena__align(sizeof(SubtreeArenaBlock));
+  size = ts_subtree_arena__align(size);
+
+  SubtreeArenaBlock *block = self->blocks;
+  if (!block || block->used + size > block->size) {
+    size_t block_size = header_size + size;
+    if (block_size < TS_SUBTREE_ARENA_BLOCK_SIZE) block_size = TS_SUBTREE_ARENA_BLOCK_SIZE;
+    block = ts_malloc(block_size);
+    block->size = block_size;
+    block->used = header_size;
+
+    // Keep the block with the most free space at the front of the list, so
+    // that an oversized allocation does not waste the rest of the current block.
+    if (self->blocks && block->size - block->used - size < self->blocks->size - self->blocks->used) {
+      block->next = self->blocks->next;
+      self->blocks->next = block;
+    } else {
+      block->next = self->blocks;
+      self->blocks = block;
+    }
+  }
+
+  void *result = (char *)block + block->used;
+  block->used += size;
+  return result;
+}
+
+SubtreeArena *ts_subtree_arena_new(SubtreeArena *dependency) {
+  SubtreeArena *self = ts_malloc(sizeof(SubtreeArena));
+  self->ref_count = 1;
+  self->blocks = NULL;
+  array_init(&self->owned_subtrees);
+  array_init(&self->dependencies);
+  if (dependency) ts_subtree_arena_add_dependency(self, dependency);
+  return self;
+}
+
+// Make an arena keep another arena alive, because its subtrees refer to
+// subtrees that were allocated from the other arena.
+void ts_subtree_arena_add_dependency(SubtreeArena *self, SubtreeArena *dependency) {
+  for (uint32_t i = 0; i < self->dependencies.size; i++) {
+    if (self->dependencies.contents[i] == dependency) return;
+  }
+  ts_subtree_arena_retain(dependency);
+  array_push(&self->dependencies, dependency);
+}
+
+void ts_subtree_arena_retain(SubtreeArena *self) {
+  assert(self->ref_count > 0);
+  atomic_inc(&self->ref_count);
+  assert(self->ref_count != 0);
+}
+
+void ts_subtree_arena_release(SubtreeArena *self) {
+  assert(self->ref_count > 0);
+  if (atomic_dec(&self->ref_count) > 0) return;
+
+  // Arenas created by successive incremental parses form long chains of
+  // dependencies, so release them iteratively rather than recursively.
+  Array(SubtreeArena *) stack = array_new();
+  array_push(&stack, self);
+  SubtreePool pool = ts_subtree_pool_new(0);
+  while (stack.size > 0) {
+    SubtreeArena *arena = array_pop(&stack);
+    ts_subtree_array_delete(&pool, &arena->owned_subtrees);
+
+    SubtreeArenaBlock *block = arena->blocks;
+    while (block) {
+      SubtreeArenaBlock *next = block->next;
+      ts_free(block);
+      block = next;
+    }
+
+    for (uint32_t i = 0; i < arena->dependencies.size; i++) {
+      SubtreeArena *dependency = arena->dependencies.contents[i];
+      assert(dependency->ref_count > 0);
+      if (atomic_dec(&dependency->ref_count) == 0) array_push(&stack, dependency);
+    }
+    array_delete(&arena->dependencies);
+    ts_free(arena);
+  }
+  ts_subtree_pool_delete(&pool);
+  array_delete(&stack);
+}
+
+// Check if anything other than the caller holds a reference to this arena.
+bool ts_subtree_arena_is_shared(const SubtreeArena *self) {
+  return self->ref_count > 1;
+}
+
+// Transfer the references that an arena-allocated parent holds on its
+// heap-allocated children to the arena itself. When arena-allocated subtrees
+// are released, their heap-allocated children are left untouched, so that
+// an arena can be deleted without traversing the subtrees allocated from it.
+static void ts_subtree_arena__adopt_children(SubtreeArena *self, MutableSubtree parent) {
+  Subtree *children = ts_subtree_children(parent);
+  for (uint32_t i = 0; i < parent.ptr->child_count; i++) {
+    Subtree child = children[i];
+    if (!child.data.is_inline && !child.ptr->in_arena) {
+      array_push(&self->owned_subtrees, child);
+    }
+  }
+}
+
+static char *ts_subtree_arena__copy_bytes(SubtreeArena *self, const char *data, unsigned length) {
+  char *result = ts_subtree_arena__allocate(self, length);
+  memcpy(result, data, length);
+  return result;
+}
+
 static SubtreeHeapData *ts_subtree_pool_allocate(SubtreePool *self) {
-  if (self->free_trees.size > 0) {
+  if (self->arena) {
+    return ts_subtree_arena__allocate(self->arena, sizeof(SubtreeHeapData));
+  } else if (self->free_trees.size > 0) {
     return array_pop(&self->free_trees).ptr;
   } else {
     return ts_malloc(sizeof(SubtreeHeapData));
@@ -149,6 +283,99 @@ static void ts_subtree_pool_free(SubtreePool *self, SubtreeHeapData *tree) {
   }
 }
 
+// SubtreeChildIndex
+
+static inline SubtreeChildIndex *volatile *ts_subtree__child_index_slot(Subtree self) {
+  return (SubtreeChildIndex *volatile *)(ts_subtree_children(self) - 1);
+}
+
+// Get the start of the memory that holds a node's children and heap data.
+static inline Subtree *ts_subtree__allocation(Subtree self) {
+  Subtree *children = ts_subtree_children(self);
+  return ts_subtree_has_child_index_slot(self.ptr->child_count) ? children - 1 : children;
+}
+
+static void ts_subtree__clear_child_index(MutableSubtree self) {
+  if (!ts_subtree_has_child_index_slot(self.ptr->child_count)) return;
+  SubtreeChildIndex *volatile *slot = ts_subtree__child_index_slot(ts_subtree_from_mut(self));
+  ts_free(*slot);
+  *slot = NULL;
+}
+
+static SubtreeChildIndex *ts_subtree__build_child_index(Subtree self, const TSLanguage *language) {
+  uint32_t child_count = self.ptr->child_count;
+  SubtreeChildIndex *result = ts_malloc(
+    sizeof(SubtreeChildIndex) + (child_count + 1) * sizeof(SubtreeChildIndexEntry)
+  );
+  result->child_count = child_count;
+
+  const TSSymbol *alias_sequence = ts_language_alias_sequence(language, self.ptr->production_id);
+  const Subtree *children = ts_subtree_children(self);
+  Length offset = length_zero();
+  uint32_t visible_index = 0, named_index = 0, structural_index = 0;
+  for (uint32_t i = 0; i < child_count; i++) {
+    Subtree child = children[i];
+    result->entries[i] = (SubtreeChildIndexEntry) {
+      .offset = offset,
+      .visible_index = visible_index,
+      .named_index = named_index,
+      .structural_index = structural_index,
+    };
+    if (i > 0) offset = length_add(offset, ts_subtree_padding(child));
+    offset = length_add(offset, ts_subtree_size(child));
+
+    // Count the child's contribution in the same way as the node's visible
+    // and named child counts.
+    TSSymbol alias = 0;
+    if (!ts_subtree_extra(child)) {
+      if (alias_sequence) alias = alias_sequence[structural_index];
+      structural_index++;
+    }
+    if (alias) {
+      visible_index++;
+      if (ts_language_symbol_metadata(language, alias).named) named_index++;
+    } else if (ts_subtree_visible(child)) {
+      visible_index++;
+      if (ts_subtree_named(child)) named_index++;
+    } else if (ts_subtree_child_count(child) > 0) {
+      visible_index += child.ptr->visible_child_count;
+      named_index += child.ptr->named_child_count;
+    }
+  }
+  result->entries[child_count] = (SubtreeChildIndexEntry) {
+    .offset = offset,
+    .visible_index = visible_index,
+    .named_index = named_index,
+    .structural_index = structural_index,
+  };
+  return result;
+}
+
+// Get the child index of a node with many children, building it if necessary.
+//
+// The index is built on demand, even though the subtree may be shared by
+// several trees that are being read on different threads. If two threads
+// build it at the same time, only one of the two indices is kept. Nodes that
+// are allocated from an arena do not have an index, because the arena is not
+// able to free it.
+const SubtreeChildIndex *ts_subtree_child_index(Subtree self, const TSLanguage *language) {
+  if (
+    self.data.is_inline ||
+    self.ptr->in_arena ||
+    !ts_subtree_has_child_index_slot(self.ptr->child_count)
+  ) return NULL;
+
+  SubtreeChildIndex *volatile *slot = ts_subtree__child_index_slot(self);
+  SubtreeChildIndex *result = *slot;
+  if (result) return result;
+  result = ts_subtree__build_child_index(self, language);
+  if (!atomic_compare_exchange_pointer((void *volatile *)slot, NULL, result)) {
+    ts_free(result);
+    result = *slot;
+  }
+  return result;
+}
+
 // Subtree
 
 static inline bool ts_subtree_can_inline(Length padding, Length size, uint32_t lookahead_bytes) {
@@ -215,6 +442,8 @@ Subtree ts_subtree_new_leaf(
       .depends_on_column = depends_on_column,
       .is_missing = false,
       .is_keyword = is_keyword,
+      .is_shared = pool->is_shared,
+      .in_arena = pool->arena != NULL,
       {{.first_leaf = {.symbol = 0, .parse_state = 0}}}
     };
     return (Subtree) {.ptr = data};
@@ -254,21 +483,40 @@ Subtree ts_subtree_new_error(
   return result;
 }
 
-// Clone a subtree.
-MutableSubtree ts_subtree_clone(Subtree self) {
-  size_t alloc_size = ts_subtree_alloc_size(self.ptr->child_count);
-  Subtree *new_children = ts_malloc(alloc_size);
-  Subtree *old_children = ts_subtree_children(self);
-  memcpy(new_children, old_children, alloc_size);
-  SubtreeHeapData *result = (SubtreeHeapData *)&new_children[self.ptr->child_count];
+// Clone a subtree, allocating the copy from the pool's arena if it has one.
+static MutableSubtree ts_subtree_clone(SubtreePool *pool, Subtree self) {
+  uint32_t child_count = self.ptr->child_count;
+  size_t alloc_size = ts_subtree_alloc_size(child_count);
+  Subtree *new_allocation = pool->arena
+    ? ts_subtree_arena__allocate(pool->arena, alloc_size)
+    : ts_malloc(alloc_size);
+  memcpy(new_allocation, ts_subtree__allocation(self), alloc_size);
+  Subtree *new_children = new_allocation;
+  if (ts_subtree_has_child_index_slot(child_count)) {
+    new_allocation[0].ptr = NULL;
+    new_children++;
+  }
+  SubtreeHeapData *result = (SubtreeHeapData *)&new_children[child_count];
+  result->in_arena = pool->arena != NULL;
   if (self.ptr->child_count > 0) {
     for (uint32_t i = 0; i < self.ptr->child_count; i++) {
       ts_subtree_retain(new_children[i]);
     }
+    if (pool->arena) {
+      ts_subtree_arena__adopt_children(pool->arena, (MutableSubtree) {.ptr = result});
+    }
   } else if (self.ptr->has_external_tokens) {
-    result->external_scanner_state = ts_external_scanner_state_copy(
-      &self.ptr->external_scanner_state
-    );
+    if (pool->arena && self.ptr->external_scanner_state.length > sizeof(result->external_scanner_state.short_data)) {
+      result->external_scanner_state.long_data = ts_subtree_arena__copy_bytes(
+        pool->arena,
+        self.ptr->external_scanner_state.long_data,
+        self.ptr->external_scanner_state.length
+      );
+    } else {
+      result->external_scanner_state = ts_external_scanner_state_copy(
+        &self.ptr->external_scanner_state
+      );
+    }
   }
   result->ref_count = 1;
   return (MutableSubtree) {.ptr = result};
@@ -278,11 +526,17 @@ MutableSubtree ts_subtree_clone(Subtree self) {
 //
 // This takes ownership of the subtree. If the subtree has only one owner,
 // this will directly convert it into a mutable version. Otherwise, it will
-// perform a copy.
+// perform a copy. Arena-allocated subtrees are only mutated in place while
+// an arena is in use, because outside of a parse, their children may be owned
+// by the arena.
 MutableSubtree ts_subtree_make_mut(SubtreePool *pool, Subtree self) {
   if (self.data.is_inline) return (MutableSubtree) {self.data};
-  if (self.ptr->ref_count == 1) return ts_subtree_to_mut_unsafe(self);
-  MutableSubtree result = ts_subtree_clone(self);
+  if (self.ptr->ref_count == 1 && (!self.ptr->in_arena || pool->arena)) {
+    MutableSubtree result = ts_subtree_to_mut_unsafe(self);
+    ts_subtree__clear_child_index(result);
+    return result;
+  }
+  MutableSubtree result = ts_subtree_clone(pool, self);
   ts_subtree_release(pool, self);
   return result;
 }
@@ -377,6 +631,7 @@ void ts_subtree_summarize_children(
   self.ptr->error_cost = 0;
   self.ptr->repeat_depth = 0;
   self.ptr->node_count = 1;
+  self.ptr->visible_descendant_count = 0;
   self.ptr->has_external_tokens = false;
   self.ptr->depends_on_column = false;
   self.ptr->has_external_scanner_state_change = false;
@@ -436,13 +691,16 @@ void ts_subtree_summarize_children(
 
     self.ptr->dynamic_precedence += ts_subtree_dynamic_precedence(child);
     self.ptr->node_count += ts_subtree_node_count(child);
+    self.ptr->visible_descendant_count += ts_subtree_visible_descendant_count(child);
 
-    if (alias_sequence && alias_sequence[structural_index] != 0 && !ts_subtree_extra(child)) {
+    if (!ts_subtree_extra(child) && alias_sequence && alias_sequence[structural_index] != 0) {
+      self.ptr->visible_descendant_count++;
       self.ptr->visible_child_count++;
       if (ts_language_symbol_metadata(language, alias_sequence[structural_index]).named) {
         self.ptr->named_child_count++;
       }
     } else if (ts_subtree_visible(child)) {
+      self.ptr->visible_descendant_count++;
       self.ptr->visible_child_count++;
       if (ts_subtree_named(child)) self.ptr->named_child_count++;
     } else if (grandchild_count > 0) {
@@ -499,8 +757,11 @@ void ts_subtree_summarize_children(
 
 // Create a new parent node with the given children.
 //
-// This takes ownership of the children array.
+// This takes ownership of the children array. If the pool has an arena, the
+// children are copied into it and the array's memory is freed. Otherwise, the
+// node's data is stored at the end of the array itself.
 MutableSubtree ts_subtree_new_node(
+  SubtreePool *pool,
   TSSymbol symbol,
   SubtreeArray *children,
   unsigned production_id,
@@ -508,19 +769,41 @@ MutableSubtree ts_subtree_new_node(
 ) {
   TSSymbolMetadata metadata = ts_language_symbol_metadata(language, symbol);
   bool fragile = symbol == ts_builtin_sym_error || symbol == ts_builtin_sym_error_repeat;
-
-  // Allocate the node's data at the end of the array of children.
-  size_t new_byte_size = ts_subtree_alloc_size(children->size);
-  if (children->capacity * sizeof(Subtree) < new_byte_size) {
-    children->contents = ts_realloc(children->contents, new_byte_size);
-    children->capacity = new_byte_size / sizeof(Subtree);
+  SubtreeArena *arena = pool ? pool->arena : NULL;
+  bool is_shared = pool ? pool->is_shared : false;
+  uint32_t child_count = children->size;
+
+  SubtreeHeapData *data;
+  size_t new_byte_size = ts_subtree_alloc_size(child_count);
+  bool has_child_index_slot = ts_subtree_has_child_index_slot(child_count);
+  if (arena) {
+    Subtree *contents = ts_subtree_arena__allocate(arena, new_byte_size);
+    if (has_child_index_slot) {
+      contents[0].ptr = NULL;
+      contents++;
+    }
+    if (child_count > 0) memcpy(contents, children->contents, child_count * sizeof(Subtree));
+    array_delete(children);
+    data = (SubtreeHeapData *)&contents[child_count];
+  } else {
+    // Allocate the node's data at the end of the array of children.
+    if (children->capacity * sizeof(Subtree) < new_byte_size) {
+      children->contents = ts_realloc(children->contents, new_byte_size);
+      children->capacity = new_byte_size / sizeof(Subtree);
+    }
+    Subtree *contents = children->contents;
+    if (has_child_index_slot) {
+      memmove(&contents[1], contents, child_count * sizeof(Subtree));
+      contents[0].ptr = NULL;
+      contents++;
+    }
+    data = (SubtreeHeapData *)&contents[child_count];
   }
-  SubtreeHeapData *data = (SubtreeHeapData *)&children->contents[children->size];
 
   *data = (SubtreeHeapData) {
     .ref_count = 1,
     .symbol = symbol,
-    .child_count = children->size,
+    .child_count = child_count,
     .visible = metadata.visible,
     .named = metadata.named,
     .has_changes = false,
@@ -528,6 +811,8 @@ MutableSubtree ts_subtree_new_node(
     .fragile_left = fragile,
     .fragile_right = fragile,
     .is_keyword = false,
+    .is_shared = is_shared,
+    .in_arena = arena != NULL,
     {{
       .node_count = 0,
       .production_id = production_id,
@@ -536,6 +821,16 @@ MutableSubtree ts_subtree_new_node(
   };
   MutableSubtree result = {.ptr = data};
   ts_subtree_summarize_children(result, language);
+  if (arena) ts_subtree_arena__adopt_children(arena, result);
+
+  // A shared subtree may adopt children that were created by a parser in
+  // single-threaded mode, for example when reusing nodes from an old tree.
+  if (is_shared) {
+    Subtree *contents = ts_subtree_children(result);
+    for (uint32_t i = 0; i < child_count; i++) {
+      ts_subtree_mark_shared(contents[i]);
+    }
+  }
   return result;
 }
 
@@ -544,12 +839,13 @@ MutableSubtree ts_subtree_new_node(
 // This node is treated as 'extra'. Its children are prevented from having
 // having any effect on the parse state.
 Subtree ts_subtree_new_error_node(
+  SubtreePool *pool,
   SubtreeArray *children,
   bool extra,
   const TSLanguage *language
 ) {
   MutableSubtree result = ts_subtree_new_node(
-    ts_builtin_sym_error, children, 0, language
+    pool, ts_builtin_sym_error, children, 0, language
   );
   result.ptr->extra = extra;
   return ts_subtree_from_mut(result);
@@ -578,35 +874,88 @@ Subtree ts_subtree_new_missing_leaf(
   return result;
 }
 
+// Copy the state of an external scanner onto a newly-created external token.
+void ts_subtree_set_external_scanner_state(
+  SubtreePool *pool,
+  MutableSubtree self,
+  const char *data,
+  unsigned length
+) {
+  ExternalScannerState *state = &self.ptr->external_scanner_state;
+  if (self.ptr->in_arena && length > sizeof(state->short_data)) {
+    state->length = length;
+    state->long_data = ts_subtree_arena__copy_bytes(pool->arena, data, length);
+  } else {
+    ts_external_scanner_state_init(state, data, length);
+  }
+}
+
+// Subtrees that are not shared are only referenced from the thread that is
+// building or editing them, so their reference counts don't need atomics.
+static inline void ts_subtree__increment_ref_count(const SubtreeHeapData *self) {
+  volatile uint32_t *ref_count = (volatile uint32_t *)&self->ref_count;
+  if (self->is_shared) {
+    atomic_inc(ref_count);
+  } else {
+    *ref_count += 1;
+  }
+}
+
+static inline uint32_t ts_subtree__decrement_ref_count(const SubtreeHeapData *self) {
+  volatile uint32_t *ref_count = (volatile uint32_t *)&self->ref_count;
+  if (self->is_shared) {
+    return atomic_dec(ref_count);
+  } else {
+    return *ref_count -= 1;
+  }
+}
+
 void ts_subtree_retain(Subtree self) {
   if (self.data.is_inline) return;
   assert(self.ptr->ref_count > 0);
-  atomic_inc((volatile uint32_t *)&self.ptr->ref_count);
+  ts_subtree__increment_ref_count(self.ptr);
   assert(self.ptr->ref_count != 0);
 }
 
-void ts_subtree_release(SubtreePool *pool, Subtree self) {
+static void ts_subtree__release(SubtreePool *pool, Subtree self, bool descend_into_arena) {
   if (self.data.is_inline) return;
   array_clear(&pool->tree_stack);
 
   assert(self.ptr->ref_count > 0);
-  if (atomic_dec((volatile uint32_t *)&self.ptr->ref_count) == 0) {
+  if (ts_subtree__decrement_ref_count(self.ptr) == 0) {
     array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(self));
   }
 
   while (pool->tree_stack.size > 0) {
     MutableSubtree tree = array_pop(&pool->tree_stack);
-    if (tree.ptr->child_count > 0) {
+
+    // The memory of arena-allocated subtrees is reclaimed when their arena is
+    // deleted, and so are their references to heap-allocated children. Only
+    // their arena-allocated children need to be released, in order to keep
+    // their reference counts accurate while the arena is still in use.
+    if (tree.ptr->in_arena) {
+      if (!descend_into_arena) continue;
+      Subtree *children = ts_subtree_children(tree);
+      for (uint32_t i = 0; i < tree.ptr->child_count; i++) {
+        Subtree child = children[i];
+        if (child.data.is_inline || !child.ptr->in_arena) continue;
+        assert(child.ptr->ref_count > 0);
+        if (ts_subtree__decrement_ref_count(child.ptr) == 0) {
+          array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(child));
+        }
+      }
+    } else if (tree.ptr->child_count > 0) {
       Subtree *children = ts_subtree_children(tree);
       for (uint32_t i = 0; i < tree.ptr->child_count; i++) {
         Subtree child = children[i];
         if (child.data.is_inline) continue;
         assert(child.ptr->ref_count > 0);
-        if (atomic_dec((volatile uint32_t *)&child.ptr->ref_count) == 0) {
+        if (ts_subtree__decrement_ref_count(child.ptr) == 0) {
           array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(child));
         }
       }
-      ts_free(children);
+      ts_subtree__clear_child_index(tree);
+      ts_free(ts_subtree__allocation(ts_subtree_from_mut(tree)));
     } else {
       if (tree.ptr->has_external_tokens) {
         ts_external_scanner_state_delete(&tree.ptr->external_scanner_state);
@@ -616,6 +965,47 @@ void ts_subtree_release(SubtreePool *pool, Subtree self) {
   }
 }
 
+void ts_subtree_release(SubtreePool *pool, Subtree self) {
+  ts_subtree__release(pool, self, true);
+}
+
+// Release a subtree whose arena-allocated descendants are about to be freed
+// along with their arena. Only the heap-allocated part of the subtree is
+// traversed.
+void ts_subtree_release_outside_arena(SubtreePool *pool, Subtree self) {
+  ts_subtree__release(pool, self, false);
+}
+
+// Mark a subtree and all of its descendants as shared, so that it can be
+// retained and released from several threads. Descendants are marked before
+// their ancestors, so that a subtree is never marked as shared while it still
+// has descendants that are not.
+void ts_subtree_mark_shared(Subtree self) {
+  if (self.data.is_inline || self.ptr->is_shared) return;
+
+  typedef struct {
+    MutableSubtree tree;
+    uint32_t child_index;
+  } StackEntry;
+
+  Array(StackEntry) stack = array_new();
+  array_push(&stack, ((StackEntry) {ts_subtree_to_mut_unsafe(self), 0}));
+  while (stack.size > 0) {
+    StackEntry *entry = array_back(&stack);
+    MutableSubtree tree = entry->tree;
+    if (entry->child_index < tree.ptr->child_count) {
+      Subtree child = ts_subtree_children(tree)[entry->child_index++];
+      if (!child.data.is_inline && !child.ptr->is_shared) {
+        array_push(&stack, ((StackEntry) {ts_subtree_to_mut_unsafe(child), 0}));
+      }
+    } else {
+      tree.ptr->is_shared = true;
+      stack.size--;
+    }
+  }
+  array_delete(&stack);
+}
+
 int ts_subtree_compare(Subtree left, Subtree right) {
   if (ts_subtree_symbol(left) < ts_subtree_symbol(right)) return -1;
   if (ts_subtree_symbol(right) < ts_subtree_symbol(left)) return 1;
@@ -645,6 +1035,7 @@ Subtree ts_subtree_edit(Subtree self, const TSInputEdit *edit, SubtreePool *pool
   typedef struct {
     Subtree *tree;
     Edit edit;
+    bool is_shared;
   } StackEntry;
 
   Array(StackEntry) stack = array_new();
@@ -712,6 +1103,7 @@ Subtree ts_subtree_edit(Subtree self, const TSInputEdit *edit, SubtreePool *pool
       } else {
         SubtreeHeapData *data = ts_subtree_pool_allocate(pool);
         data->ref_count = 1;
+        data->in_arena = pool->arena != NULL;
         data->padding = padding;
         data->size = size;
         data->lookahead_bytes = lookahead_bytes;
@@ -729,6 +1121,7 @@ Subtree ts_subtree_edit(Subtree self, const TSInputEdit *edit, SubtreePool *pool
         data->depends_on_column = false;
         data->is_missing = result.data.is_missing;
         data->is_keyword = result.data.is_keyword;
+        data->is_shared = entry.is_shared;
         result.ptr = data;
       }
     } else {
@@ -789,6 +1182,7 @@ Subtree ts_subtree_edit(Subtree self, const TSInputEdit *edit, SubtreePool *pool
       array_push(&stack, ((StackEntry) {
         .tree = child,
         .edit = child_edit,
+        .is_shared = entry.tree->ptr->is_shared,
       }));
     }
   }
@@ -1010,6 +1404,320 @@ void ts_subtree_print_dot_graph(Subtree self, const TSLanguage *language, FILE *
   fprintf(f, "}\n");
 }
 
+// Serialization
+
+enum {
+  SubtreeFlagInline = 1 << 0,
+  SubtreeFlagVisible = 1 << 1,
+  SubtreeFlagNamed = 1 << 2,
+  SubtreeFlagExtra = 1 << 3,
+  SubtreeFlagFragileLeft = 1 << 4,
+  SubtreeFlagFragileRight = 1 << 5,
+  SubtreeFlagHasChanges = 1 << 6,
+  SubtreeFlagHasExternalTokens = 1 << 7,
+  SubtreeFlagHasExternalScannerStateChange = 1 << 8,
+  SubtreeFlagDependsOnColumn = 1 << 9,
+  SubtreeFlagIsMissing = 1 << 10,
+  SubtreeFlagIsKeyword = 1 << 11,
+};
+
+static uint32_t ts_subtree__flags(Subtree self) {
+  uint32_t result = 0;
+  if (self.data.is_inline) result |= SubtreeFlagInline;
+  if (ts_subtree_visible(self)) result |= SubtreeFlagVisible;
+  if (ts_subtree_named(self)) result |= SubtreeFlagNamed;
+  if (ts_subtree_extra(self)) result |= SubtreeFlagExtra;
+  if (ts_subtree_fragile_left(self)) result |= SubtreeFlagFragileLeft;
+  if (ts_subtree_fragile_right(self)) result |= SubtreeFlagFragileRight;
+  if (ts_subtree_has_changes(self)) result |= SubtreeFlagHasChanges;
+  if (ts_subtree_has_external_tokens(self)) result |= SubtreeFlagHasExternalTokens;
+  if (ts_subtree_has_external_scanner_state_change(self)) result |= SubtreeFlagHasExternalScannerStateChange;
+  if (ts_subtree_depends_on_column(self)) result |= SubtreeFlagDependsOnColumn;
+  if (ts_subtree_missing(self)) result |= SubtreeFlagIsMissing;
+  if (ts_subtree_is_keyword(self)) result |= SubtreeFlagIsKeyword;
+  return result;
+}
+
+static void ts_subtree__serialize_length(ByteArray *buffer, Length length) {
+  byte_array_push_uint(buffer, length.bytes);
+  byte_array_push_uint(buffer, length.extent.row);
+  byte_array_push_uint(buffer, length.extent.column);
+}
+
+// Write a subtree to the given buffer.
+//
+// The nodes are written in pre-order. Only the fields that cannot be derived
+// from a node's children are written for parent nodes. The rest are computed
+// again when the subtree is deserialized.
+void ts_subtree_serialize(Subtree self, ByteArray *buffer) {
+  SubtreeArray stack = array_new();
+  array_push(&stack, self);
+  while (stack.size > 0) {
+    Subtree tree = array_pop(&stack);
+    byte_array_push_uint(buffer, ts_subtree__flags(tree));
+    byte_array_push_uint(buffer, ts_subtree_symbol(tree));
+    byte_array_push_uint(buffer, ts_subtree_parse_state(tree));
+    byte_array_push_uint(buffer, ts_subtree_lookahead_bytes(tree));
+    uint32_t child_count = ts_subtree_child_count(tree);
+    if (!tree.data.is_inline) byte_array_push_uint(buffer, child_count);
+    if (child_count == 0) {
+      ts_subtree__serialize_length(buffer, ts_subtree_padding(tree));
+      ts_subtree__serialize_length(buffer, ts_subtree_size(tree));
+    }
+    if (tree.data.is_inline) continue;
+
+    byte_array_push_uint(buffer, tree.ptr->error_cost);
+    if (child_count > 0) {
+      byte_array_push_uint(buffer, tree.ptr->production_id);
+      byte_array_push_int(buffer, tree.ptr->dynamic_precedence);
+      const Subtree *children = ts_subtree_children(tree);
+      for (uint32_t i = tree.ptr->child_count; i > 0; i--) {
+        array_push(&stack, children[i - 1]);
+      }
+    } else if (tree.ptr->has_external_tokens) {
+      const ExternalScannerState *state = &tree.ptr->external_scanner_state;
+      byte_array_push_uint(buffer, state->length);
+      byte_array_push_bytes(buffer, ts_external_scanner_state_data(state), state->length);
+    } else if (tree.ptr->symbol == ts_builtin_sym_error) {
+      byte_array_push_int(buffer, tree.ptr->lookahead_char);
+    }
+  }
+  array_delete(&stack);
+}
+
+static bool ts_subtree__deserialize_length(ByteReader *reader, Length *length) {
+  return
+    byte_reader_read_uint(reader, &length->bytes) &&
+    byte_reader_read_uint(reader, &length->extent.row) &&
+    byte_reader_read_uint(reader, &length->extent.column);
+}
+
+// The fields of a serialized node that are not derived from its children.
+typedef struct {
+  MutableSubtree tree;
+  uint32_t flags;
+  TSStateId parse_state;
+  Length padding;
+  Length size;
+  uint32_t lookahead_bytes;
+  uint32_t error_cost;
+  int32_t dynamic_precedence;
+  uint32_t child_index;
+} SubtreeDeserializationEntry;
+
+static void ts_subtree__set_flags(MutableSubtree self, uint32_t flags) {
+  self.ptr->visible = flags & SubtreeFlagVisible;
+  self.ptr->named = flags & SubtreeFlagNamed;
+  self.ptr->extra = flags & SubtreeFlagExtra;
+  self.ptr->fragile_left = flags & SubtreeFlagFragileLeft;
+  self.ptr->fragile_right = flags & SubtreeFlagFragileRight;
+  self.ptr->has_changes = flags & SubtreeFlagHasChanges;
+  self.ptr->is_missing = flags & SubtreeFlagIsMissing;
+  self.ptr->is_keyword = flags & SubtreeFlagIsKeyword;
+}
+
+// Read the next node of a serialized subtree. Leaf nodes are returned
+// completely. For parent nodes, space is allocated for the children, which
+// must be read next.
+static bool ts_subtree__deserialize_node(
+  SubtreePool *pool,
+  ByteReader *reader,
+  const TSLanguage *language,
+  SubtreeDeserializationEntry *entry
+) {
+  uint32_t symbol, parse_state;
+  if (
+    !byte_reader_read_uint(reader, &entry->flags) ||
+    !byte_reader_read_uint(reader, &symbol) ||
+    !byte_reader_read_uint(reader, &parse_state) ||
+    !byte_reader_read_uint(reader, &entry->lookahead_bytes)
+  ) return false;
+
+  if (
+    symbol >= language->symbol_count &&
+    symbol != ts_builtin_sym_error &&
+    symbol != ts_builtin_sym_error_repeat
+  ) return false;
+  if (parse_state >= language->state_count && parse_state != TS_TREE_STATE_NONE) return false;
+  bool is_error = symbol == ts_builtin_sym_error || symbol == ts_builtin_sym_error_repeat;
+  bool is_token = symbol < language->token_count;
+  entry->parse_state = parse_state;
+  entry->child_index = 0;
+  uint32_t flags = entry->flags;
+
+  uint32_t child_count = 0;
+  if (!(flags & SubtreeFlagInline) && !byte_reader_read_uint(reader, &child_count)) return false;
+  if (child_count == 0 && (
+    !ts_subtree__deserialize_length(reader, &entry->padding) ||
+    !ts_subtree__deserialize_length(reader, &entry->size)
+  )) return false;
+
+  if (flags & SubtreeFlagInline) {
+    if (
+      !is_token ||
+      symbol > UINT8_MAX ||
+      entry->size.extent.column != entry->size.bytes ||
+      !ts_subtree_can_inline(entry->padding, entry->size, entry->lookahead_bytes)
+    ) return false;
+    entry->tree = (MutableSubtree) {{
+      .parse_state = parse_state,
+      .symbol = symbol,
+      .padding_bytes = entry->padding.bytes,
+      .padding_rows = entry->padding.extent.row,
+      .padding_columns = entry->padding.extent.column,
+      .size_bytes = entry->size.bytes,
+      .lookahead_bytes = entry->lookahead_bytes,
+      .visible = flags & SubtreeFlagVisible,
+      .named = flags & SubtreeFlagNamed,
+      .extra = flags & SubtreeFlagExtra,
+      .has_changes = flags & SubtreeFlagHasChanges,
+      .is_missing = flags & SubtreeFlagIsMissing,
+      .is_keyword = flags & SubtreeFlagIsKeyword,
+      .is_inline = true,
+    }};
+    return true;
+  }
+
+  if (!byte_reader_read_uint(reader, &entry->error_cost)) return false;
+
+  // Every child takes up at least one byte, so a larger count must be invalid.
+  if (child_count > (size_t)(reader->end - reader->position)) return false;
+
+  if (child_count > 0) {
+    uint32_t production_id;
+    if (
+      !byte_reader_read_uint(reader, &production_id) ||
+      !byte_reader_read_int(reader, &entry->dynamic_precedence)
+    ) return false;
+    if (is_token) return false;
+    if (production_id > 0 && production_id >= language->production_id_count) return false;
+
+    Subtree *contents = ts_subtree_arena__allocate(pool->arena, ts_subtree_alloc_size(child_count));
+    if (ts_subtree_has_child_index_slot(child_count)) {
+      contents[0].ptr = NULL;
+      contents++;
+    }
+    memset(contents, 0, child_count * sizeof(Subtree));
+    SubtreeHeapData *data = (SubtreeHeapData *)&contents[child_count];
+    *data = (SubtreeHeapData) {
+      .ref_count = 1,
+      .symbol = symbol,
+      .child_count = child_count,
+      .is_shared = pool->is_shared,
+      .in_arena = true,
+      {{.production_id = production_id}}
+    };
+    entry->tree.ptr = data;
+    return true;
+  }
+
+  // Only empty productions can produce non-terminal nodes without children.
+  if (!is_token && !is_error && entry->size.bytes > 0) return false;
+
+  SubtreeHeapData *data = ts_subtree_pool_allocate(pool);
+  *data = (SubtreeHeapData) {
+    .ref_count = 1,
+    .padding = entry->padding,
+    .size = entry->size,
+    .lookahead_bytes = entry->lookahead_bytes,
+    .error_cost = entry->error_cost,
+    .symbol = symbol,
+    .parse_state = parse_state,
+    .has_external_tokens = flags & SubtreeFlagHasExternalTokens,
+    .has_external_scanner_state_change = flags & SubtreeFlagHasExternalScannerStateChange,
+    .depends_on_column = flags & SubtreeFlagDependsOnColumn,
+    .is_shared = pool->is_shared,
+    .in_arena = true,
+  };
+  entry->tree.ptr = data;
+  ts_subtree__set_flags(entry->tree, flags);
+
+  if (data->has_external_tokens) {
+    uint32_t length;
+    const uint8_t *bytes;
+    if (
+      !byte_reader_read_uint(reader, &length) ||
+      !byte_reader_read_bytes(reader, &bytes, length)
+    ) return false;
+    ts_subtree_set_external_scanner_state(pool, entry->tree, (const char *)bytes, length);
+  } else if (symbol == ts_builtin_sym_error) {
+    if (!byte_reader_read_int(reader, &data->lookahead_char)) return false;
+  }
+  return true;
+}
+
+// Check that a node's children can be summarized without reading past the
+// end of its alias sequence.
+static bool ts_subtree__deserialized_children_are_valid(
+  MutableSubtree self,
+  const TSLanguage *language
+) {
+  if (self.ptr->production_id == 0) return true;
+  uint32_t structural_child_count = 0;
+  const Subtree *children = ts_subtree_children(self);
+  for (uint32_t i = 0; i < self.ptr->child_count; i++) {
+    if (!ts_subtree_extra(children[i])) structural_child_count++;
+  }
+  return structural_child_count <= language->max_alias_sequence_length;
+}
+
+// Read a subtree that was written by `ts_subtree_serialize`.
+//
+// All of the nodes are allocated from the pool's arena, so if the data is
+// invalid, the partially-constructed subtree is discarded along with the
+// arena, and `NULL_SUBTREE` is returned.
+Subtree ts_subtree_deserialize(SubtreePool *pool, ByteReader *reader, const TSLanguage *language) {
+  assert(pool->arena);
+  Array(SubtreeDeserializationEntry) stack = array_new();
+  Subtree result = NULL_SUBTREE;
+
+  SubtreeDeserializationEntry entry;
+  if (!ts_subtree__deserialize_node(pool, reader, language, &entry)) goto done;
+  if (ts_subtree_child_count(ts_subtree_from_mut(entry.tree)) == 0) {
+    result = ts_subtree_from_mut(entry.tree);
+    goto done;
+  }
+  array_push(&stack, entry);
+
+  while (stack.size > 0) {
+    SubtreeDeserializationEntry *top = array_back(&stack);
+    MutableSubtree tree = top->tree;
+
+    // Once all of a node's children have been read, compute the node's
+    // derived fields, and then restore the ones that were stored.
+    if (top->child_index == tree.ptr->child_count) {
+      if (!ts_subtree__deserialized_children_are_valid(tree, language)) goto done;
+      ts_subtree__set_flags(tree, top->flags);
+      ts_subtree_summarize_children(tree, language);
+      ts_subtree__set_flags(tree, top->flags);
+      tree.ptr->parse_state = top->parse_state;
+      tree.ptr->lookahead_bytes = top->lookahead_bytes;
+      tree.ptr->error_cost = top->error_cost;
+      tree.ptr->dynamic_precedence = top->dynamic_precedence;
+
+      stack.size--;
+      if (stack.size == 0) {
+        result = ts_subtree_from_mut(tree);
+      } else {
+        SubtreeDeserializationEntry *parent = array_back(&stack);
+        ts_subtree_children(parent->tree)[parent->child_index++] = ts_subtree_from_mut(tree);
+      }
+      continue;
+    }
+
+    if (!ts_subtree__deserialize_node(pool, reader, language, &entry)) goto done;
+    if (ts_subtree_child_count(ts_subtree_from_mut(entry.tree)) == 0) {
+      ts_subtree_children(tree)[top->child_index++] = ts_subtree_from_mut(entry.tree);
+    } else {
+      array_push(&stack, entry);
+    }
+  }
+
+done:
+  array_delete(&stack);
+  return result;
+}
+
 const ExternalScannerState *ts_subtree_external_scanner_state(Subtree self) {
   static const ExternalScannerState empty_state = {{.short_data = {0}}, .length = 0};
   if (
@@ -12,6 +12,7 @@ extern "C" {
 #include "./array.h"
 #include "./error_costs.h"
 #include "./host.h"
+#include "./serialization.h"
 #include "tree_sitter/api.h"
 #include "tree_sitter/parser.h"
 
@@ -108,6 +109,10 @@ struct SubtreeInlineData {
 // This representation is used for parent nodes, external tokens,
 // errors, and other leaf nodes whose data is too large to fit into
 // the inline representation.
+//
+// The reference counts of subtrees that are marked as shared are updated
+// atomically, because they may be retained and released by several threads.
+// All of the descendants of a shared subtree are shared as well.
 typedef struct {
   volatile uint32_t ref_count;
   Length padding;
@@ -129,6 +134,8 @@ typedef struct {
   bool depends_on_column: 1;
   bool is_missing : 1;
   bool is_keyword : 1;
+  bool is_shared : 1;
+  bool in_arena : 1;
 
   union {
     // Non-terminal subtrees (`child_count > 0`)
@@ -136,6 +143,7 @@ typedef struct {
       uint32_t visible_child_count;
       uint32_t named_child_count;
       uint32_t node_count;
+      uint32_t visible_descendant_count;
       int32_t dynamic_precedence;
       uint16_t repeat_depth;
       uint16_t production_id;
@@ -168,9 +176,38 @@ typedef union {
 typedef Array(Subtree) SubtreeArray;
 typedef Array(MutableSubtree) MutableSubtreeArray;
 
+// A region of memory from which the subtrees of one syntax tree can be
+// allocated, so that they can all be freed at once.
+//
+// Subtrees that are allocated from an arena still maintain accurate reference
+// counts, but their memory is only reclaimed when the arena itself is deleted.
+// Heap-allocated subtrees that become children of arena-allocated subtrees
+// are owned by the arena and released when the arena is deleted. An arena
+// also retains any other arenas whose subtrees its own subtrees refer to.
+typedef struct SubtreeArena SubtreeArena;
+
+// A table of the positions of a node's children, along with the number of
+// visible and named descendants that precede each child, which allows the
+// children of nodes with many children to be accessed without iterating over
+// all of the preceding children. There is one more entry than there are
+// children, so that the last entry holds the totals.
+typedef struct {
+  Length offset;
+  uint32_t visible_index;
+  uint32_t named_index;
+  uint32_t structural_index;
+} SubtreeChildIndexEntry;
+
+typedef struct {
+  uint32_t child_count;
+  SubtreeChildIndexEntry entries[];
+} SubtreeChildIndex;
+
 typedef struct {
   MutableSubtreeArray free_trees;
   MutableSubtreeArray tree_stack;
+  SubtreeArena *arena;
+  bool is_shared;
 } SubtreePool;
 
 void ts_external_scanner_state_init(ExternalScannerState *, const char *, unsigned);
@@ -187,6 +224,12 @@ void ts_subtree_array_reverse(SubtreeArray *);
 SubtreePool ts_subtree_pool_new(uint32_t capacity);
 void ts_subtree_pool_delete(SubtreePool *);
 
+SubtreeArena *ts_subtree_arena_new(SubtreeArena *dependency);
+void ts_subtree_arena_add_dependency(SubtreeArena *, SubtreeArena *);
+void ts_subtree_arena_retain(SubtreeArena *);
+void ts_subtree_arena_release(SubtreeArena *);
+bool ts_subtree_arena_is_shared(const SubtreeArena *);
+
 Subtree ts_subtree_new_leaf(
   SubtreePool *, TSSymbol, Length, Length, uint32_t,
   TSStateId, bool, bool, bool, const TSLanguage *
@@ -194,12 +237,15 @@ Subtree ts_subtree_new_leaf(
 Subtree ts_subtree_new_error(
   SubtreePool *, int32_t, Length, Length, uint32_t, TSStateId, const TSLanguage *
 );
-MutableSubtree ts_subtree_new_node(TSSymbol, SubtreeArray *, unsigned, const TSLanguage *);
-Subtree ts_subtree_new_error_node(SubtreeArray *, bool, const TSLanguage *);
+MutableSubtree ts_subtree_new_node(SubtreePool *, TSSymbol, SubtreeArray *, unsigned, const TSLanguage *);
+Subtree ts_subtree_new_error_node(SubtreePool *, SubtreeArray *, bool, const TSLanguage *);
 Subtree ts_subtree_new_missing_leaf(SubtreePool *, TSSymbol, Length, uint32_t, const TSLanguage *);
 MutableSubtree ts_subtree_make_mut(SubtreePool *, Subtree);
+void ts_subtree_set_external_scanner_state(SubtreePool *, MutableSubtree, const char *, unsigned);
 void ts_subtree_retain(Subtree);
 void ts_subtree_release(SubtreePool *, Subtree);
+void ts_subtree_release_outside_arena(SubtreePool *, Subtree);
+void ts_subtree_mark_shared(Subtree);
 int ts_subtree_compare(Subtree, Subtree);
 void ts_subtree_set_symbol(MutableSubtree *, TSSymbol, const TSLanguage *);
 void ts_subtree_summarize(MutableSubtree, const Subtree *, uint32_t, const TSLanguage *);
@@ -211,6 +257,9 @@ void ts_subtree_print_dot_graph(Subtree, const TSLanguage *, FILE *);
 Subtree ts_subtree_last_external_token(Subtree);
 const ExternalScannerState *ts_subtree_external_scanner_state(Subtree self);
 bool ts_subtree_external_scanner_state_eq(Subtree, Subtree);
+const SubtreeChildIndex *ts_subtree_child_index(Subtree, const TSLanguage *);
+void ts_subtree_serialize(Subtree, ByteArray *);
+Subtree ts_subtree_deserialize(SubtreePool *, ByteReader *, const TSLanguage *);
 
 #define SUBTREE_GET(self, name) (self.data.is_inline ? self.data.name : self.ptr->name)
 
@@ -226,10 +275,20 @@ static inline uint32_t ts_subtree_lookahead_bytes(Subtree self) { return SUBTREE
 
 #undef SUBTREE_GET
 
+// Nodes with at least this many children reserve space, immediately before
+// their children, for a pointer to a lazily-built SubtreeChildIndex.
+#define TS_SUBTREE_CHILD_INDEX_MIN_CHILD_COUNT 32
+
+static inline bool ts_subtree_has_child_index_slot(uint32_t child_count) {
+  return child_count >= TS_SUBTREE_CHILD_INDEX_MIN_CHILD_COUNT;
+}
+
 // Get the size needed to store a heap-allocated subtree with the given
 // number of children.
 static inline size_t ts_subtree_alloc_size(uint32_t child_count) {
-  return child_count * sizeof(Subtree) + sizeof(SubtreeHeapData);
+  size_t result = child_count * sizeof(Subtree) + sizeof(SubtreeHeapData);
+  if (ts_subtree_has_child_index_slot(child_count)) result += sizeof(Subtree);
+  return result;
 }
 
 // Get a subtree's children, which are allocated immediately before the
@@ -295,6 +354,14 @@ static inline uint32_t ts_subtree_node_count(Subtree self) {
   return (self.data.is_inline || self.ptr->child_count == 0) ? 1 : self.ptr->node_count;
 }
 
+// Get the number of visible nodes within the subtree, not including the
+// subtree itself.
+static inline uint32_t ts_subtree_visible_descendant_count(Subtree self) {
+  return (self.data.is_inline || self.ptr->child_count == 0)
+    ? 0
+    : self.ptr->visible_descendant_count;
+}
+
 static inline uint32_t ts_subtree_visible_child_count(Subtree self) {
   if (ts_subtree_child_count(self) > 0) {
     return self.ptr->visible_child_count;
@@ -339,6 +406,10 @@ static inline bool ts_subtree_has_external_scanner_state_change(Subtree self) {
   return self.data.is_inline ? false : self.ptr->has_external_scanner_state_change;
 }
 
+static inline bool ts_subtree_in_arena(Subtree self) {
+  return self.data.is_inline ? false : self.ptr->in_arena;
+}
+
 static inline bool ts_subtree_depends_on_column(Subtree self) {
   return self.data.is_inline ? false : self.ptr->depends_on_column;
 }
@@ -1,14 +1,126 @@
 #include "tree_sitter/api.h"
 #include "./array.h"
+#include "./atomic.h"
 #include "./get_changed_ranges.h"
 #include "./length.h"
 #include "./subtree.h"
 #include "./tree_cursor.h"
 #include "./tree.h"
 
+#define TS_PARENT_CACHE_INITIAL_CAPACITY 64
+
+static inline uint32_t ts_tree__parent_cache_hash(const Subtree *child, uint32_t capacity) {
+  uint64_t key = (uint64_t)(uintptr_t)child;
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+static inline ParentCache *ts_tree__parent_cache_new(uint32_t capacity) {
+  ParentCache *result = ts_calloc(1, sizeof(ParentCache) + capacity * sizeof(ParentCacheEntry));
+  result->capacity = capacity;
+  return result;
+}
+
+static ParentCacheEntry *ts_tree__parent_cache_slot(ParentCache *self, const Subtree *child) {
+  uint32_t index = ts_tree__parent_cache_hash(child, self->capacity);
+  for (;;) {
+    ParentCacheEntry *entry = &self->entries[index];
+    if (!entry->child || entry->child == child) return entry;
+    index = (index + 1) & (self->capacity - 1);
+  }
+}
+
+static ParentCache *ts_tree__parent_cache_grow(ParentCache *self) {
+  ParentCache *result = ts_tree__parent_cache_new(self->capacity * 2);
+  for (uint32_t i = 0; i < self->capacity; i++) {
+    ParentCacheEntry *entry = &self->entries[i];
+    if (entry->child) *ts_tree__parent_cache_slot(result, entry->child) = *entry;
+  }
+  result->size = self->size;
+  ts_free(self);
+  return result;
+}
+
+static ParentCache *ts_tree__parent_cache_insert(ParentCache *self, TSNode child, TSNode parent) {
+  if (2 * (self->size + 1) > self->capacity) self = ts_tree__parent_cache_grow(self);
+  const Subtree *key = child.id;
+  ParentCacheEntry *entry = ts_tree__parent_cache_slot(self, key);
+
+  // The same subtree can appear more than once within a tree. Its parent is
+  // then ambiguous, and must be found by searching down from the root.
+  if (entry->child) {
+    entry->parent = NULL;
+    return self;
+  }
+
+  *entry = (ParentCacheEntry) {
+    .child = key,
+    .parent = parent.id,
+    .position = {ts_node_start_byte(parent), ts_node_start_point(parent)},
+    .alias_symbol = parent.context[3],
+    .child_start_byte = ts_node_start_byte(child),
+  };
+  self->size++;
+  return self;
+}
+
+static ParentCache *ts_tree__parent_cache_build(const TSTree *self) {
+  ParentCache *result = ts_tree__parent_cache_new(TS_PARENT_CACHE_INITIAL_CAPACITY);
+
+  // Walk the visible nodes in document order, maintaining the stack of their
+  // visible ancestors.
+  Array(TSNode) ancestors = array_new();
+  TSNode root = ts_tree_root_node(self);
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+  array_push(&ancestors, root);
+  for (;;) {
+    if (!ts_tree_cursor_goto_first_child(&cursor)) {
+      for (;;) {
+        if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+          ancestors.size--;
+          break;
+        }
+        if (!ts_tree_cursor_goto_parent(&cursor)) goto done;
+        ancestors.size--;
+      }
+    }
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    result = ts_tree__parent_cache_insert(result, node, *array_back(&ancestors));
+    array_push(&ancestors, node);
+  }
+
+done:
+  ts_tree_cursor_delete(&cursor);
+  array_delete(&ancestors);
+  return result;
+}
+
+// The cache is built on demand, even though the tree is otherwise immutable
+// here. Another thread that is reading the same tree may build it at the same
+// time, in which case only one of the two caches is kept.
+static ParentCache *ts_tree__parent_cache(const TSTree *self) {
+  ParentCache *cache = self->parent_cache;
+  if (cache) return cache;
+  cache = ts_tree__parent_cache_build(self);
+  TSTree *tree = (TSTree *)self;
+  if (!atomic_compare_exchange_pointer((void *volatile *)&tree->parent_cache, NULL, cache)) {
+    ts_free(cache);
+    cache = self->parent_cache;
+  }
+  return cache;
+}
+
+const ParentCacheEntry *ts_tree_parent_cache_find(const TSTree *self, const Subtree *child) {
+  if (!self->parent_cache_enabled) return NULL;
+  ParentCache *cache = ts_tree__parent_cache(self);
+  const ParentCacheEntry *entry = ts_tree__parent_cache_slot(cache, child);
+  if (!entry->child || !entry->parent) return NULL;
+  return entry;
+}
+
 TSTree *ts_tree_new(
   Subtree root, const TSLanguage *language,
-  const TSRange *included_ranges, unsigned included_range_count
+  const TSRange *included_ranges, unsigned included_range_count,
+  SubtreeArena *arena
 ) {
   TSTree *result = ts_malloc(sizeof(TSTree));
   result->root = root;
@@ -16,24 +128,55 @@ TSTree *ts_tree_new(
   result->included_ranges = ts_calloc(included_range_count, sizeof(TSRange));
   memcpy(result->included_ranges, included_ranges, included_range_count * sizeof(TSRange));
   result->included_range_count = included_range_count;
+  result->arena = arena;
+  result->parent_cache = NULL;
+  result->parent_cache_enabled = false;
   return result;
 }
 
 TSTree *ts_tree_copy(const TSTree *self) {
+  // The copy may be used on a different thread than the original tree.
+  ts_subtree_mark_shared(self->root);
   ts_subtree_retain(self->root);
-  return ts_tree_new(self->root, self->language, self->included_ranges, self->included_range_count);
+  if (self->arena) ts_subtree_arena_retain(self->arena);
+  TSTree *result = ts_tree_new(
+    self->root, self->language,
+    self->included_ranges, self->included_range_count,
+    self->arena
+  );
+  result->parent_cache_enabled = self->parent_cache_enabled;
+  return result;
 }
 
 void ts_tree_delete(TSTree *self) {
   if (!self) return;
 
+  // If no other tree shares this tree's arena, then the arena-allocated
+  // subtrees do not need to be traversed. They are all freed at once below.
   SubtreePool pool = ts_subtree_pool_new(0);
-  ts_subtree_release(&pool, self->root);
+  if (self->arena && !ts_subtree_arena_is_shared(self->arena)) {
+    ts_subtree_release_outside_arena(&pool, self->root);
+  } else {
+    ts_subtree_release(&pool, self->root);
+  }
   ts_subtree_pool_delete(&pool);
+  if (self->arena) ts_subtree_arena_release(self->arena);
+  ts_free(self->parent_cache);
   ts_free(self->included_ranges);
   ts_free(self);
 }
 
+void ts_tree_build_parent_index(TSTree *self) {
+  self->parent_cache_enabled = true;
+  ts_tree__parent_cache(self);
+}
+
+size_t ts_tree_parent_index_memory_usage(const TSTree *self) {
+  const ParentCache *cache = self->parent_cache;
+  if (!cache) return 0;
+  return sizeof(ParentCache) + (size_t)cache->capacity * sizeof(ParentCacheEntry);
+}
+
 TSNode ts_tree_root_node(const TSTree *self) {
   return ts_node_new(self, &self->root, ts_subtree_padding(self->root), 0);
 }
@@ -83,6 +226,8 @@ void ts_tree_edit(TSTree *self, const TSInputEdit *edit) {
   SubtreePool pool = ts_subtree_pool_new(0);
   self->root = ts_subtree_edit(self->root, edit, &pool);
   ts_subtree_pool_delete(&pool);
+  ts_free(self->parent_cache);
+  self->parent_cache = NULL;
 }
 
 TSRange *ts_tree_get_changed_ranges(const TSTree *self, const TSTree *other, uint32_t *count) {
@@ -113,3 +258,109 @@ TSRange *ts_tree_get_changed_ranges(const TSTree *self, const TSTree *other, uin
 void ts_tree_print_dot_graph(const TSTree *self, FILE *file) {
   ts_subtree_print_dot_graph(self->root, self->language, file);
 }
+
+// Serialized trees begin with these bytes, followed by the version of the
+// serialization format, and some properties of the language, which are used
+// to check that the tree is being loaded with the same language. They end
+// with a four-byte checksum of all of the preceding bytes.
+static const char TS_TREE_SERIALIZATION_MAGIC[4] = {'T', 'S', 'T', 'R'};
+#define TS_TREE_SERIALIZATION_VERSION 1
+
+char *ts_tree_serialize(const TSTree *self, uint32_t *length) {
+  ByteArray buffer = array_new();
+  byte_array_push_bytes(&buffer, TS_TREE_SERIALIZATION_MAGIC, sizeof(TS_TREE_SERIALIZATION_MAGIC));
+  byte_array_push_uint(&buffer, TS_TREE_SERIALIZATION_VERSION);
+  byte_array_push_uint(&buffer, self->language->version);
+  byte_array_push_uint(&buffer, self->language->symbol_count);
+  byte_array_push_uint(&buffer, self->language->state_count);
+  byte_array_push_uint(&buffer, self->language->production_id_count);
+
+  byte_array_push_uint(&buffer, self->included_range_count);
+  for (unsigned i = 0; i < self->included_range_count; i++) {
+    const TSRange *range = &self->included_ranges[i];
+    byte_array_push_uint(&buffer, range->start_point.row);
+    byte_array_push_uint(&buffer, range->start_point.column);
+    byte_array_push_uint(&buffer, range->end_point.row);
+    byte_array_push_uint(&buffer, range->end_point.column);
+    byte_array_push_uint(&buffer, range->start_byte);
+    byte_array_push_uint(&buffer, range->end_byte);
+  }
+
+  ts_subtree_serialize(self->root, &buffer);
+  uint32_t checksum = serialization_checksum(buffer.contents, buffer.size);
+  for (unsigned i = 0; i < 4; i++) {
+    array_push(&buffer, (uint8_t)(checksum >> (8 * i)));
+  }
+  *length = buffer.size;
+  return (char *)buffer.contents;
+}
+
+TSTree *ts_tree_deserialize(const char *data, uint32_t length, const TSLanguage *language) {
+  if (length < 4) return NULL;
+  length -= 4;
+  const uint8_t *trailer = (const uint8_t *)data + length;
+  uint32_t checksum = 0;
+  for (unsigned i = 0; i < 4; i++) {
+    checksum |= (uint32_t)trailer[i] << (8 * i);
+  }
+  if (checksum != serialization_checksum((const uint8_t *)data, length)) return NULL;
+
+  ByteReader reader = {(const uint8_t *)data, (const uint8_t *)data + length};
+  const uint8_t *magic;
+  uint32_t version, language_version, symbol_count, state_count, production_id_count;
+  if (
+    !byte_reader_read_bytes(&reader, &magic, sizeof(TS_TREE_SERIALIZATION_MAGIC)) ||
+    memcmp(magic, TS_TREE_SERIALIZATION_MAGIC, sizeof(TS_TREE_SERIALIZATION_MAGIC)) != 0 ||
+    !byte_reader_read_uint(&reader, &version) ||
+    version != TS_TREE_SERIALIZATION_VERSION ||
+    !byte_reader_read_uint(&reader, &language_version) ||
+    !byte_reader_read_uint(&reader, &symbol_count) ||
+    !byte_reader_read_uint(&reader, &state_count) ||
+    !byte_reader_read_uint(&reader, &production_id_count) ||
+    language_version != language->version ||
+    symbol_count != language->symbol_count ||
+    state_count != language->state_count ||
+    production_id_count != language->production_id_count
+  ) return NULL;
+
+  uint32_t included_range_count;
+  if (
+    !byte_reader_read_uint(&reader, &included_range_count) ||
+    included_range_count > (size_t)(reader.end - reader.position)
+  ) return NULL;
+  Array(TSRange) included_ranges = array_new();
+  array_reserve(&included_ranges, included_range_count);
+  for (unsigned i = 0; i < included_range_count; i++) {
+    TSRange range;
+    if (
+      !byte_reader_read_uint(&reader, &range.start_point.row) ||
+      !byte_reader_read_uint(&reader, &range.start_point.column) ||
+      !byte_reader_read_uint(&reader, &range.end_point.row) ||
+      !byte_reader_read_uint(&reader, &range.end_point.column) ||
+      !byte_reader_read_uint(&reader, &range.start_byte) ||
+      !byte_reader_read_uint(&reader, &range.end_byte)
+    ) {
+      array_delete(&included_ranges);
+      return NULL;
+    }
+    array_push(&included_ranges, range);
+  }
+
+  // Allocate all of the nodes from one arena, so that loading a tree does not
+  // require a separate allocation for every node.
+  SubtreeArena *arena = ts_subtree_arena_new(NULL);
+  SubtreePool pool = ts_subtree_pool_new(0);
+  pool.arena = arena;
+  pool.is_shared = true;
+  Subtree root = ts_subtree_deserialize(&pool, &reader, language);
+  ts_subtree_pool_delete(&pool);
+
+  TSTree *result = NULL;
+  if (root.ptr && reader.position == reader.end) {
+    result = ts_tree_new(root, language, included_ranges.contents, included_ranges.size, arena);
+  } else {
+    ts_subtree_arena_release(arena);
+  }
+  array_delete(&included_ranges);
+  return result;
+}
@@ -10,17 +10,31 @@ typedef struct {
   const Subtree *parent;
   Length position;
   TSSymbol alias_symbol;
+  uint32_t child_start_byte;
 } ParentCacheEntry;
 
+// An open-addressed hash table that maps each visible node in a tree to its
+// visible parent. Once it has been requested, it is rebuilt lazily whenever
+// it is needed after the tree is edited.
+typedef struct {
+  uint32_t capacity;
+  uint32_t size;
+  ParentCacheEntry entries[];
+} ParentCache;
+
 struct TSTree {
   Subtree root;
   const TSLanguage *language;
   TSRange *included_ranges;
   unsigned included_range_count;
+  SubtreeArena *arena;
+  ParentCache *volatile parent_cache;
+  bool parent_cache_enabled;
 };
 
-TSTree *ts_tree_new(Subtree root, const TSLanguage *language, const TSRange *, unsigned);
+TSTree *ts_tree_new(Subtree root, const TSLanguage *language, const TSRange *, unsigned, SubtreeArena *);
 TSNode ts_node_new(const TSTree *, const Subtree *, Length, TSSymbol);
+const ParentCacheEntry *ts_tree_parent_cache_find(const TSTree *, const Subtree *);
 
 #ifdef __cplusplus
 }
@@ -10,16 +10,35 @@ typedef struct {
   Length position;
   uint32_t child_index;
   uint32_t structural_child_index;
+  uint32_t descendant_index;
   const TSSymbol *alias_sequence;
 } CursorChildIterator;
 
 // CursorChildIterator
 
+static inline bool ts_tree_cursor_is_entry_visible(const TreeCursor *self, uint32_t index) {
+  TreeCursorEntry *entry = &self->stack.contents[index];
+  if (index == 0 || ts_subtree_visible(*entry->subtree)) return true;
+  if (ts_subtree_extra(*entry->subtree)) return false;
+  TreeCursorEntry *parent_entry = &self->stack.contents[index - 1];
+  return ts_language_alias_at(
+    self->tree->language,
+    parent_entry->subtree->ptr->production_id,
+    entry->structural_child_index
+  );
+}
+
 static inline CursorChildIterator ts_tree_cursor_iterate_children(const TreeCursor *self) {
   TreeCursorEntry *last_entry = array_back(&self->stack);
   if (ts_subtree_child_count(*last_entry->subtree) == 0) {
-    return (CursorChildIterator) {NULL_SUBTREE, self->tree, length_zero(), 0, 0, NULL};
+    return (CursorChildIterator) {NULL_SUBTREE, self->tree, length_zero(), 0, 0, 0, NULL};
   }
+
+  // The descendant indices of the children start after the parent's own
+  // index, if the parent is visible.
+  uint32_t descendant_index = last_entry->descendant_index;
+  if (ts_tree_cursor_is_entry_visible(self, self->stack.size - 1)) descendant_index++;
+
   const TSSymbol *alias_sequence = ts_language_alias_sequence(
     self->tree->language,
     last_entry->subtree->ptr->production_id
@@ -30,6 +49,7 @@ static inline CursorChildIterator ts_tree_cursor_iterate_children(const TreeCurs
     .position = last_entry->position,
     .child_index = 0,
     .structural_child_index = 0,
+    .descendant_index = descendant_index,
     .alias_sequence = alias_sequence,
   };
 }
@@ -46,6 +66,7 @@ static inline bool ts_tree_cursor_child_iterator_next(
     .position = self->position,
     .child_index = self->child_index,
     .structural_child_index = self->structural_child_index,
+    .descendant_index = self->descendant_index,
   };
   *visible = ts_subtree_visible(*child);
   bool extra = ts_subtree_extra(*child);
@@ -54,6 +75,9 @@ static inline bool ts_tree_cursor_child_iterator_next(
     self->structural_child_index++;
   }
 
+  self->descendant_index += ts_subtree_visible_descendant_count(*child);
+  if (*visible) self->descendant_index++;
+
   self->position = length_add(self->position, ts_subtree_size(*child));
   self->child_index++;
 
@@ -88,6 +112,7 @@ void ts_tree_cursor_init(TreeCursor *self, TSNode node) {
     },
     .child_index = 0,
     .structural_child_index = 0,
+    .descendant_index = 0,
   }));
 }
 
@@ -212,6 +237,7 @@ bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *_self) {
     CursorChildIterator iterator = ts_tree_cursor_iterate_children(self);
     iterator.child_index = entry.child_index;
     iterator.structural_child_index = entry.structural_child_index;
+    iterator.descendant_index = entry.descendant_index;
     iterator.position = entry.position;
 
     bool visible = false;
@@ -236,6 +262,109 @@ bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *_self) {
   return false;
 }
 
+// Move from an invisible node to its last visible child, descending through
+// any other invisible nodes along the way.
+static bool ts_tree_cursor__goto_last_child(TreeCursor *self) {
+  for (;;) {
+    bool visible, last_visible = false, found = false;
+    TreeCursorEntry entry, last_entry;
+    CursorChildIterator iterator = ts_tree_cursor_iterate_children(self);
+    while (ts_tree_cursor_child_iterator_next(&iterator, &entry, &visible)) {
+      if (visible || ts_subtree_visible_child_count(*entry.subtree) > 0) {
+        last_entry = entry;
+        last_visible = visible;
+        found = true;
+      }
+    }
+    if (!found) return false;
+    array_push(&self->stack, last_entry);
+    if (last_visible) return true;
+  }
+}
+
+bool ts_tree_cursor_goto_previous_sibling(TSTreeCursor *_self) {
+  TreeCursor *self = (TreeCursor *)_self;
+  uint32_t initial_size = self->stack.size;
+
+  // Sizes are only known from the start of each node, so scan the preceding
+  // children from the beginning of the parent, rather than walking backward.
+  while (self->stack.size > 1) {
+    TreeCursorEntry entry = array_pop(&self->stack);
+    CursorChildIterator iterator = ts_tree_cursor_iterate_children(self);
+
+    bool visible = false, previous_visible = false, found = false;
+    TreeCursorEntry sibling, previous;
+    while (ts_tree_cursor_child_iterator_next(&iterator, &sibling, &visible)) {
+      if (sibling.child_index == entry.child_index) break;
+      if (visible || ts_subtree_visible_child_count(*sibling.subtree) > 0) {
+        previous = sibling;
+        previous_visible = visible;
+        found = true;
+      }
+    }
+    if (visible && self->stack.size + 1 < initial_size) break;
+
+    if (found) {
+      array_push(&self->stack, previous);
+      if (!previous_visible) ts_tree_cursor__goto_last_child(self);
+      return true;
+    }
+  }
+
+  self->stack.size = initial_size;
+  return false;
+}
+
+void ts_tree_cursor_goto_descendant(TSTreeCursor *_self, uint32_t goal_descendant_index) {
+  TreeCursor *self = (TreeCursor *)_self;
+
+  // Ascend to the lowest ancestor that contains the goal node.
+  for (;;) {
+    uint32_t i = self->stack.size - 1;
+    TreeCursorEntry *entry = &self->stack.contents[i];
+    uint32_t next_descendant_index =
+      entry->descendant_index +
+      (ts_tree_cursor_is_entry_visible(self, i) ? 1 : 0) +
+      ts_subtree_visible_descendant_count(*entry->subtree);
+    if (
+      entry->descendant_index <= goal_descendant_index &&
+      next_descendant_index > goal_descendant_index
+    ) {
+      break;
+    } else if (self->stack.size <= 1) {
+      return;
+    } else {
+      self->stack.size--;
+    }
+  }
+
+  // Descend to the goal node, skipping over each child that ends before it
+  // using the child's count of visible descendants.
+  bool did_descend;
+  do {
+    did_descend = false;
+    bool visible;
+    TreeCursorEntry entry;
+    CursorChildIterator iterator = ts_tree_cursor_iterate_children(self);
+    if (iterator.descendant_index > goal_descendant_index) return;
+
+    while (ts_tree_cursor_child_iterator_next(&iterator, &entry, &visible)) {
+      if (iterator.descendant_index > goal_descendant_index) {
+        array_push(&self->stack, entry);
+        if (visible && entry.descendant_index == goal_descendant_index) return;
+        did_descend = true;
+        break;
+      }
+    }
+  } while (did_descend);
+}
+
+uint32_t ts_tree_cursor_current_descendant_index(const TSTreeCursor *_self) {
+  const TreeCursor *self = (const TreeCursor *)_self;
+  TreeCursorEntry *last_entry = array_back(&self->stack);
+  return last_entry->descendant_index;
+}
+
 bool ts_tree_cursor_goto_parent(TSTreeCursor *_self) {
   TreeCursor *self = (TreeCursor *)_self;
   for (unsigned i = self->stack.size - 2; i + 1 > 0; i--) {
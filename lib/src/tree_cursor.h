@@ -8,6 +8,7 @@ typedef struct {
   Length position;
   uint32_t child_index;
   uint32_t structural_child_index;
+  uint32_t descendant_index;
 } TreeCursorEntry;
 
 typedef struct {
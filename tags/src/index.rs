@@ -0,0 +1,703 @@
+//! A tags index that is stored in a file, so that the tags for a collection of files
+//! can be updated without generating all of them again, and looked up without reading
+//! the whole index.
+//!
+//! The index consists of a header followed by sections of fixed-size, little-endian
+//! records, so it can also be read by memory-mapping the file:
+//!
+//! * kinds: the names of the tags' syntax types
+//! * files: one record per file, sorted by path, with a hash of the file's content
+//!   and the range of its tags
+//! * tags: the tags of each file, in the order of the files
+//! * names: the indices of all of the tags, sorted by name and kind
+//! * strings: the paths, names, and docs, referenced by offset and length
+//!
+//! Byte offsets within a source file are stored as 32-bit integers, like in the syntax
+//! trees that the tags are generated from.
+
+use super::{Error, Tag, TagsConfiguration, TagsContext};
+use std::collections::{BTreeMap, HashMap};
+use std::fs::{self, File};
+use std::io::{self, BufWriter, Write};
+use std::ops::Range;
+use std::path::{Path, PathBuf};
+use std::process;
+use std::sync::atomic::AtomicUsize;
+use tree_sitter::{Point, Tree};
+
+const MAGIC: &[u8; 8] = b"TSTAGIDX";
+const VERSION: u32 = 1;
+const HEADER_SIZE: usize = 64;
+const KIND_RECORD_SIZE: usize = 16;
+const FILE_RECORD_SIZE: usize = 32;
+const TAG_RECORD_SIZE: usize = 64;
+const NAME_RECORD_SIZE: usize = 4;
+const NO_DOCS: u32 = u32::MAX;
+
+/// A tag that was read from a `TagsIndex`.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct IndexedTag {
+    pub path: String,
+    pub name: String,
+    pub kind: String,
+    pub is_definition: bool,
+    pub range: Range<usize>,
+    pub name_range: Range<usize>,
+    pub span: Range<Point>,
+    pub docs: Option<String>,
+}
+
+/// A tags index that has been written to a file by a `TagsIndexBuilder`.
+///
+/// Only the index's header and the names of its tags' kinds are read when it is opened.
+/// Everything else is read from the file as needed.
+pub struct TagsIndex {
+    file: File,
+    len: u64,
+    kinds: Vec<String>,
+    file_count: u32,
+    tag_count: u32,
+    files_offset: u64,
+    tags_offset: u64,
+    names_offset: u64,
+}
+
+/// Builds a new version of a tags index, reusing the tags from a previous version for
+/// the files whose content has not changed.
+pub struct TagsIndexBuilder {
+    old_index: Option<TagsIndex>,
+    old_files: HashMap<String, (u64, u32)>,
+    files: BTreeMap<String, FileTags>,
+}
+
+enum FileTags {
+    // A file whose tags are copied from the old index: its hash and its index there.
+    Old(u64, u32),
+    New(u64, Vec<TagRecord>),
+}
+
+// The tag records of a file in an existing index, with the strings that they refer to.
+struct RawFileTags {
+    records: Vec<u8>,
+    strings: Vec<u8>,
+    strings_offset: u64,
+}
+
+// The contents of a tag record, with its strings.
+struct TagRecord {
+    name: Vec<u8>,
+    docs: Option<Vec<u8>>,
+    kind: String,
+    is_definition: bool,
+    range: Range<usize>,
+    name_range: Range<usize>,
+    span: Range<Point>,
+}
+
+/// Compute the hash of a file's content that is stored in a tags index. This is the
+/// 64-bit FNV-1a hash, which does not depend on the platform or the version of Rust.
+pub fn content_hash(source: &[u8]) -> u64 {
+    let mut hash = 0xcbf29ce484222325u64;
+    for byte in source {
+        hash ^= *byte as u64;
+        hash = hash.wrapping_mul(0x100000001b3);
+    }
+    hash
+}
+
+impl TagsIndex {
+    pub fn open(path: &Path) -> io::Result<Self> {
+        let file = File::open(path)?;
+        let len = file.metadata()?.len();
+        let mut header = [0; HEADER_SIZE];
+        read_exact_at(&file, &mut header, 0)?;
+        if &header[0..8] != MAGIC || read_u32(&header, 8) != VERSION {
+            return Err(invalid_data("Not a tags index, or an unsupported version"));
+        }
+
+        let kind_count = read_u32(&header, 12);
+        let kinds_offset = read_u64(&header, 24);
+        let mut result = TagsIndex {
+            file,
+            len,
+            kinds: Vec::new(),
+            file_count: read_u32(&header, 16),
+            tag_count: read_u32(&header, 20),
+            files_offset: read_u64(&header, 32),
+            tags_offset: read_u64(&header, 40),
+            names_offset: read_u64(&header, 48),
+        };
+
+        // The sections must fit in the file, so that the counts in a truncated or
+        // corrupt index can't cause huge allocations.
+        for (offset, count, record_size) in &[
+            (kinds_offset, kind_count, KIND_RECORD_SIZE),
+            (result.files_offset, result.file_count, FILE_RECORD_SIZE),
+            (result.tags_offset, result.tag_count, TAG_RECORD_SIZE),
+            (result.names_offset, result.tag_count, NAME_RECORD_SIZE),
+        ] {
+            result.check_range(*offset, *count as u64 * *record_size as u64)?;
+        }
+
+        result.kinds.reserve(kind_count as usize);
+        let mut kind_records = vec![0; kind_count as usize * KIND_RECORD_SIZE];
+        read_exact_at(&result.file, &mut kind_records, kinds_offset)?;
+        for record in kind_records.chunks(KIND_RECORD_SIZE) {
+            let kind = result.read_string(read_u64(record, 0), read_u32(record, 8))?;
+            result
+                .kinds
+                .push(String::from_utf8_lossy(&kind).to_string());
+        }
+        Ok(result)
+    }
+
+    pub fn file_count(&self) -> usize {
+        self.file_count as usize
+    }
+
+    pub fn tag_count(&self) -> usize {
+        self.tag_count as usize
+    }
+
+    /// Get the hash of the content of the file at the given path, if the file is in the
+    /// index.
+    pub fn file_hash(&self, path: &str) -> io::Result<Option<u64>> {
+        let mut low = 0;
+        let mut high = self.file_count;
+        while low < high {
+            let mid = low + (high - low) / 2;
+            let record = self.read_file_record(mid)?;
+            let record_path = self.read_string(read_u64(&record, 0), read_u32(&record, 8))?;
+            match record_path.as_slice().cmp(path.as_bytes()) {
+                std::cmp::Ordering::Less => low = mid + 1,
+                std::cmp::Ordering::Greater => high = mid,
+                std::cmp::Ordering::Equal => return Ok(Some(read_u64(&record, 16))),
+            }
+        }
+        Ok(None)
+    }
+
+    /// Find all of the tags with the given name, and optionally, the given kind.
+    ///
+    /// The tags are found by binary search, so only the records that are compared and
+    /// the ones that match are read from the index.
+    pub fn find_tags(&self, name: &str, kind: Option<&str>) -> io::Result<Vec<IndexedTag>> {
+        let kind_id = match kind {
+            Some(kind) => match self.kinds.iter().position(|k| k == kind) {
+                Some(id) => Some(id as u32),
+                None => return Ok(Vec::new()),
+            },
+            None => None,
+        };
+
+        // Find the first entry in the name index whose name and kind are not less than
+        // the given ones.
+        let key = (name.as_bytes(), kind_id.unwrap_or(0));
+        let mut low = 0;
+        let mut high = self.tag_count;
+        while low < high {
+            let mid = low + (high - low) / 2;
+            let record = self.read_tag_record(self.read_name_entry(mid)?)?;
+            let record_name = self.read_string(read_u64(&record, 0), read_u32(&record, 8))?;
+            if (record_name.as_slice(), read_u32(&record, 20)) < key {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        let mut result = Vec::new();
+        for i in low..self.tag_count {
+            let record = self.read_tag_record(self.read_name_entry(i)?)?;
+            let record_name = self.read_string(read_u64(&record, 0), read_u32(&record, 8))?;
+            if record_name != name.as_bytes()
+                || kind_id.map_or(false, |id| id != read_u32(&record, 20))
+            {
+                break;
+            }
+            result.push(self.indexed_tag(&record, record_name)?);
+        }
+        Ok(result)
+    }
+
+    fn indexed_tag(&self, record: &[u8], name: Vec<u8>) -> io::Result<IndexedTag> {
+        let strings_offset = read_u64(record, 0);
+        let name_len = read_u32(record, 8);
+        let docs_len = read_u32(record, 12);
+        let docs = if docs_len == NO_DOCS {
+            None
+        } else {
+            let docs = self.read_string(strings_offset + name_len as u64, docs_len)?;
+            Some(String::from_utf8_lossy(&docs).to_string())
+        };
+
+        let file_record = self.read_file_record(read_u32(record, 16))?;
+        let path = self.read_string(read_u64(&file_record, 0), read_u32(&file_record, 8))?;
+        let kind = self
+            .kinds
+            .get(read_u32(record, 20) as usize)
+            .ok_or_else(|| invalid_data("Invalid tag kind"))?;
+
+        Ok(IndexedTag {
+            path: String::from_utf8_lossy(&path).to_string(),
+            name: String::from_utf8_lossy(&name).to_string(),
+            kind: kind.clone(),
+            is_definition: read_u32(record, 24) & 1 != 0,
+            range: read_u32(record, 28) as usize..read_u32(record, 32) as usize,
+            name_range: read_u32(record, 36) as usize..read_u32(record, 40) as usize,
+            span: Point::new(read_u32(record, 44) as usize, read_u32(record, 48) as usize)
+                ..Point::new(read_u32(record, 52) as usize, read_u32(record, 56) as usize),
+            docs,
+        })
+    }
+
+    // Read the tag records of the file with the given index, along with the block of
+    // the strings section that contains their names and docs, so that they can be
+    // copied into a new version of the index without decoding each tag.
+    fn read_raw_file_tags(&self, file_index: u32) -> io::Result<RawFileTags> {
+        let file_record = self.read_file_record(file_index)?;
+        let first_tag = read_u32(&file_record, 24);
+        let tag_count = read_u32(&file_record, 12);
+        if first_tag as u64 + tag_count as u64 > self.tag_count as u64 {
+            return Err(invalid_data("Invalid tag range"));
+        }
+        let mut records = vec![0; tag_count as usize * TAG_RECORD_SIZE];
+        read_exact_at(
+            &self.file,
+            &mut records,
+            self.tags_offset + first_tag as u64 * TAG_RECORD_SIZE as u64,
+        )?;
+
+        // The writer stores the strings of each file's tags contiguously, so they can all
+        // be read at once.
+        let mut strings_start = u64::MAX;
+        let mut strings_end = 0;
+        for record in records.chunks(TAG_RECORD_SIZE) {
+            let start = read_u64(record, 0);
+            strings_start = strings_start.min(start);
+            let end = start
+                .checked_add(tag_strings_len(record))
+                .ok_or_else(|| invalid_data("Invalid tag strings"))?;
+            strings_end = strings_end.max(end);
+        }
+        let strings = if records.is_empty() {
+            Vec::new()
+        } else {
+            self.read_string(
+                strings_start,
+                to_u32(strings_end as usize - strings_start as usize)?,
+            )?
+        };
+        Ok(RawFileTags {
+            records,
+            strings,
+            strings_offset: strings_start,
+        })
+    }
+
+    // Check that the given range of bytes is within the index.
+    fn check_range(&self, offset: u64, len: u64) -> io::Result<()> {
+        match offset.checked_add(len) {
+            Some(end) if end <= self.len => Ok(()),
+            _ => Err(invalid_data("Range extends past the end of the tags index")),
+        }
+    }
+
+    fn read_file_record(&self, index: u32) -> io::Result<[u8; FILE_RECORD_SIZE]> {
+        if index >= self.file_count {
+            return Err(invalid_data("Invalid file index"));
+        }
+        let mut record = [0; FILE_RECORD_SIZE];
+        let offset = self.files_offset + index as u64 * FILE_RECORD_SIZE as u64;
+        read_exact_at(&self.file, &mut record, offset)?;
+        Ok(record)
+    }
+
+    fn read_tag_record(&self, index: u32) -> io::Result<[u8; TAG_RECORD_SIZE]> {
+        if index >= self.tag_count {
+            return Err(invalid_data("Invalid tag index"));
+        }
+        let mut record = [0; TAG_RECORD_SIZE];
+        let offset = self.tags_offset + index as u64 * TAG_RECORD_SIZE as u64;
+        read_exact_at(&self.file, &mut record, offset)?;
+        Ok(record)
+    }
+
+    fn read_name_entry(&self, index: u32) -> io::Result<u32> {
+        let mut entry = [0; NAME_RECORD_SIZE];
+        let offset = self.names_offset + index as u64 * NAME_RECORD_SIZE as u64;
+        read_exact_at(&self.file, &mut entry, offset)?;
+        Ok(read_u32(&entry, 0))
+    }
+
+    fn read_string(&self, offset: u64, len: u32) -> io::Result<Vec<u8>> {
+        self.check_range(offset, len as u64)?;
+        let mut result = vec![0; len as usize];
+        read_exact_at(&self.file, &mut result, offset)?;
+        Ok(result)
+    }
+}
+
+impl TagsIndexBuilder {
+    /// Create a builder for a new version of the given index. The new version only
+    /// contains the files that are added to the builder.
+    pub fn new(old_index: Option<TagsIndex>) -> io::Result<Self> {
+        let mut old_files = HashMap::new();
+        if let Some(old_index) = &old_index {
+            for i in 0..old_index.file_count {
+                let record = old_index.read_file_record(i)?;
+                let path = old_index.read_string(read_u64(&record, 0), read_u32(&record, 8))?;
+                let path = String::from_utf8(path).map_err(|_| invalid_data("Invalid path"))?;
+                old_files.insert(path, (read_u64(&record, 16), i));
+            }
+        }
+        Ok(TagsIndexBuilder {
+            old_index,
+            old_files,
+            files: BTreeMap::new(),
+        })
+    }
+
+    /// Add a file to the index. Its tags are only generated if the file was not in the
+    /// previous version of the index, or if its content has changed. Returns true if
+    /// the tags were generated.
+    pub fn add_file(
+        &mut self,
+        context: &mut TagsContext,
+        config: &TagsConfiguration,
+        path: &str,
+        source: &[u8],
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<bool, Error> {
+        let hash = content_hash(source);
+        if let Some((old_hash, old_file_index)) = self.old_files.get(path) {
+            if *old_hash == hash {
+                self.files
+                    .insert(path.to_string(), FileTags::Old(hash, *old_file_index));
+                return Ok(false);
+            }
+        }
+
+        let tags = context
+            .generate_tags(config, source, cancellation_flag)?
+            .0
+            .map(|tag| tag.map(|tag| TagRecord::new(config, source, tag)))
+            .collect::<Result<Vec<_>, _>>()?;
+        self.files
+            .insert(path.to_string(), FileTags::New(hash, tags));
+        Ok(true)
+    }
+
+    /// Add a file that is being edited, reparsing it incrementally. The `old_tree` must
+    /// have been edited to match `source` using [`Tree::edit`]. Returns the new syntax
+    /// tree, which can be passed to this method again after the next edit.
+    pub fn add_edited_file(
+        &mut self,
+        context: &mut TagsContext,
+        config: &TagsConfiguration,
+        path: &str,
+        source: &[u8],
+        old_tree: Option<&Tree>,
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<Tree, Error> {
+        let (tags, tree) =
+            context.generate_tags_with_old_tree(config, source, old_tree, cancellation_flag)?;
+        let tags = tags
+            .map(|tag| tag.map(|tag| TagRecord::new(config, source, tag)))
+            .collect::<Result<Vec<_>, _>>()?;
+        self.files
+            .insert(path.to_string(), FileTags::New(content_hash(source), tags));
+        Ok(tree)
+    }
+
+    /// Write the new version of the index to the given path. The index is written to a
+    /// temporary file first, and then moved into place, so that the path always refers
+    /// to a complete index.
+    pub fn write(mut self, path: &Path) -> io::Result<()> {
+        let mut kinds = Vec::<String>::new();
+        let mut kind_ids = HashMap::<String, u32>::new();
+        let mut strings = Vec::new();
+        let mut file_records = Vec::with_capacity(self.files.len() * FILE_RECORD_SIZE);
+        let mut tag_records = Vec::new();
+        let mut names = Vec::new();
+        let mut tag_count = 0u32;
+
+        // The strings are stored after all of the other sections, so their offsets are
+        // relative to the start of the strings until the size of the sections is known.
+        for (file_index, (file_path, file_tags)) in self.files.iter().enumerate() {
+            let file_index = file_index as u32;
+            match file_tags {
+                // The tags of unchanged files are copied from the old index in bulk. Only
+                // the fields that refer to other parts of the index are updated.
+                FileTags::Old(hash, old_file_index) => {
+                    let old_index = self.old_index.as_ref().unwrap();
+                    let old_tags = old_index.read_raw_file_tags(*old_file_index)?;
+                    let tags_len = old_tags.records.len() / TAG_RECORD_SIZE;
+                    write_file_record(
+                        &mut file_records,
+                        &mut strings,
+                        file_path,
+                        tags_len,
+                        *hash,
+                        tag_count,
+                    )?;
+
+                    let strings_start = strings.len() as u64;
+                    for record in old_tags.records.chunks(TAG_RECORD_SIZE) {
+                        let string_offset =
+                            (read_u64(record, 0) - old_tags.strings_offset) as usize;
+                        let name_len = read_u32(record, 8) as usize;
+                        let kind = old_index
+                            .kinds
+                            .get(read_u32(record, 20) as usize)
+                            .ok_or_else(|| invalid_data("Invalid tag kind"))?;
+                        let kind_id = intern_kind(&mut kinds, &mut kind_ids, kind);
+                        let name = &old_tags.strings[string_offset..string_offset + name_len];
+                        names.push((name.to_vec(), kind_id, tag_count));
+                        tag_count = tag_count
+                            .checked_add(1)
+                            .ok_or_else(|| invalid_data("Too many tags"))?;
+
+                        let start = tag_records.len();
+                        tag_records.extend_from_slice(record);
+                        let record = &mut tag_records[start..start + TAG_RECORD_SIZE];
+                        record[0..8]
+                            .copy_from_slice(&(strings_start + string_offset as u64).to_le_bytes());
+                        record[16..20].copy_from_slice(&file_index.to_le_bytes());
+                        record[20..24].copy_from_slice(&kind_id.to_le_bytes());
+                    }
+                    strings.extend_from_slice(&old_tags.strings);
+                }
+
+                FileTags::New(hash, tags) => {
+                    write_file_record(
+                        &mut file_records,
+                        &mut strings,
+                        file_path,
+                        tags.len(),
+                        *hash,
+                        tag_count,
+                    )?;
+                    for tag in tags {
+                        let kind_id = intern_kind(&mut kinds, &mut kind_ids, &tag.kind);
+                        names.push((tag.name.clone(), kind_id, tag_count));
+                        tag_count = tag_count
+                            .checked_add(1)
+                            .ok_or_else(|| invalid_data("Too many tags"))?;
+
+                        write_u64(&mut tag_records, strings.len() as u64);
+                        write_u32(&mut tag_records, to_u32(tag.name.len())?);
+                        match &tag.docs {
+                            Some(docs) if docs.len() < NO_DOCS as usize => {
+                                write_u32(&mut tag_records, docs.len() as u32)
+                            }
+                            _ => write_u32(&mut tag_records, NO_DOCS),
+                        }
+                        write_u32(&mut tag_records, file_index);
+                        write_u32(&mut tag_records, kind_id);
+                        write_u32(&mut tag_records, tag.is_definition as u32);
+                        for value in &[
+                            tag.range.start,
+                            tag.range.end,
+                            tag.name_range.start,
+                            tag.name_range.end,
+                            tag.span.start.row,
+                            tag.span.start.column,
+                            tag.span.end.row,
+                            tag.span.end.column,
+                        ] {
+                            write_u32(&mut tag_records, to_u32(*value)?);
+                        }
+                        write_u32(&mut tag_records, 0);
+                        strings.extend_from_slice(&tag.name);
+                        if let Some(docs) = &tag.docs {
+                            strings.extend_from_slice(docs);
+                        }
+                    }
+                }
+            }
+        }
+
+        let mut kind_records = Vec::with_capacity(kinds.len() * KIND_RECORD_SIZE);
+        for kind in &kinds {
+            write_u64(&mut kind_records, strings.len() as u64);
+            write_u32(&mut kind_records, to_u32(kind.len())?);
+            write_u32(&mut kind_records, 0);
+            strings.extend_from_slice(kind.as_bytes());
+        }
+
+        names.sort_unstable();
+        let mut name_records = Vec::with_capacity(names.len() * NAME_RECORD_SIZE);
+        for (_, _, tag_index) in &names {
+            write_u32(&mut name_records, *tag_index);
+        }
+
+        let kinds_offset = HEADER_SIZE as u64;
+        let files_offset = kinds_offset + kind_records.len() as u64;
+        let tags_offset = files_offset + file_records.len() as u64;
+        let names_offset = tags_offset + tag_records.len() as u64;
+        let strings_offset = names_offset + name_records.len() as u64;
+        relocate_strings(&mut kind_records, KIND_RECORD_SIZE, strings_offset);
+        relocate_strings(&mut file_records, FILE_RECORD_SIZE, strings_offset);
+        relocate_strings(&mut tag_records, TAG_RECORD_SIZE, strings_offset);
+
+        let mut header = Vec::with_capacity(HEADER_SIZE);
+        header.extend_from_slice(MAGIC);
+        write_u32(&mut header, VERSION);
+        write_u32(&mut header, kinds.len() as u32);
+        write_u32(&mut header, to_u32(self.files.len())?);
+        write_u32(&mut header, tag_count);
+        for offset in &[
+            kinds_offset,
+            files_offset,
+            tags_offset,
+            names_offset,
+            strings_offset,
+        ] {
+            write_u64(&mut header, *offset);
+        }
+        header.resize(HEADER_SIZE, 0);
+
+        // The temporary file's name extends the index's name, so that it can't be the
+        // index itself, and includes the process id, so that processes that update the
+        // same index at once don't write to the same file.
+        let mut temp_path = path.as_os_str().to_owned();
+        temp_path.push(format!(".tmp.{}", process::id()));
+        let temp_path = PathBuf::from(temp_path);
+        let mut file = BufWriter::new(File::create(&temp_path)?);
+        for section in &[
+            &header,
+            &kind_records,
+            &file_records,
+            &tag_records,
+            &name_records,
+            &strings,
+        ] {
+            file.write_all(section)?;
+        }
+        file.into_inner()?.sync_all()?;
+
+        // The old index must be closed before it is replaced on some platforms.
+        self.old_index.take();
+        fs::rename(&temp_path, path)
+    }
+}
+
+impl TagRecord {
+    fn new(config: &TagsConfiguration, source: &[u8], tag: Tag) -> Self {
+        TagRecord {
+            name: source[tag.name_range.clone()].to_vec(),
+            docs: tag.docs.map(String::into_bytes),
+            kind: config.syntax_type_name(tag.syntax_type_id).to_string(),
+            is_definition: tag.is_definition,
+            range: tag.range,
+            name_range: tag.name_range,
+            span: tag.span,
+        }
+    }
+}
+
+fn write_file_record(
+    file_records: &mut Vec<u8>,
+    strings: &mut Vec<u8>,
+    path: &str,
+    tag_count: usize,
+    hash: u64,
+    first_tag: u32,
+) -> io::Result<()> {
+    write_u64(file_records, strings.len() as u64);
+    write_u32(file_records, to_u32(path.len())?);
+    write_u32(file_records, to_u32(tag_count)?);
+    write_u64(file_records, hash);
+    write_u32(file_records, first_tag);
+    write_u32(file_records, 0);
+    strings.extend_from_slice(path.as_bytes());
+    Ok(())
+}
+
+// Get the id of the given kind, adding it to the index's kinds if it is new.
+fn intern_kind(kinds: &mut Vec<String>, kind_ids: &mut HashMap<String, u32>, kind: &str) -> u32 {
+    if let Some(id) = kind_ids.get(kind) {
+        return *id;
+    }
+    kinds.push(kind.to_string());
+    let id = kinds.len() as u32 - 1;
+    kind_ids.insert(kind.to_string(), id);
+    id
+}
+
+// Get the total length of the name and docs of the given tag record.
+fn tag_strings_len(record: &[u8]) -> u64 {
+    let docs_len = read_u32(record, 12);
+    read_u32(record, 8) as u64
+        + if docs_len == NO_DOCS {
+            0
+        } else {
+            docs_len as u64
+        }
+}
+
+// Add the given offset to the string offset at the start of each record.
+fn relocate_strings(records: &mut [u8], record_size: usize, strings_offset: u64) {
+    for record in records.chunks_mut(record_size) {
+        let offset = read_u64(record, 0) + strings_offset;
+        record[0..8].copy_from_slice(&offset.to_le_bytes());
+    }
+}
+
+fn read_u32(bytes: &[u8], offset: usize) -> u32 {
+    let mut result = [0; 4];
+    result.copy_from_slice(&bytes[offset..offset + 4]);
+    u32::from_le_bytes(result)
+}
+
+fn read_u64(bytes: &[u8], offset: usize) -> u64 {
+    let mut result = [0; 8];
+    result.copy_from_slice(&bytes[offset..offset + 8]);
+    u64::from_le_bytes(result)
+}
+
+fn write_u32(bytes: &mut Vec<u8>, value: u32) {
+    bytes.extend_from_slice(&value.to_le_bytes());
+}
+
+fn write_u64(bytes: &mut Vec<u8>, value: u64) {
+    bytes.extend_from_slice(&value.to_le_bytes());
+}
+
+fn to_u32(value: usize) -> io::Result<u32> {
+    if value <= u32::MAX as usize {
+        Ok(value as u32)
+    } else {
+        Err(invalid_data("Value is too large for a tags index"))
+    }
+}
+
+fn invalid_data(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message)
+}
+
+// Read from the given position in the file, without using the file's cursor, so that
+// an index can be read from multiple threads at once.
+#[cfg(unix)]
+fn read_exact_at(file: &File, buf: &mut [u8], offset: u64) -> io::Result<()> {
+    use std::os::unix::fs::FileExt;
+    file.read_exact_at(buf, offset)
+}
+
+#[cfg(windows)]
+fn read_exact_at(file: &File, mut buf: &mut [u8], mut offset: u64) -> io::Result<()> {
+    use std::os::windows::fs::FileExt;
+    while !buf.is_empty() {
+        match file.seek_read(buf, offset) {
+            Ok(0) => return Err(io::ErrorKind::UnexpectedEof.into()),
+            Ok(n) => {
+                buf = &mut buf[n..];
+                offset += n as u64;
+            }
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+            Err(e) => return Err(e),
+        }
+    }
+    Ok(())
+}
@@ -1,4 +1,5 @@
 pub mod c_lib;
+pub mod index;
 
 use memchr::memchr;
 use regex::Regex;
@@ -262,22 +263,45 @@ impl TagsContext {
         source: &'a [u8],
         cancellation_flag: Option<&'a AtomicUsize>,
     ) -> Result<(impl Iterator<Item = Result<Tag, Error>> + 'a, bool), Error> {
+        let (tags, tree) =
+            self.generate_tags_with_old_tree(config, source, None, cancellation_flag)?;
+        Ok((tags, tree.root_node().has_error()))
+    }
+
+    /// Generate tags for a document, reusing the syntax tree from a previous version
+    /// of the document, which must have been edited to match `source` using
+    /// [`Tree::edit`]. The new syntax tree is returned along with the tags, so that it
+    /// can be reused for the next version.
+    pub fn generate_tags_with_old_tree<'a>(
+        &'a mut self,
+        config: &'a TagsConfiguration,
+        source: &'a [u8],
+        old_tree: Option<&Tree>,
+        cancellation_flag: Option<&'a AtomicUsize>,
+    ) -> Result<(impl Iterator<Item = Result<Tag, Error>> + 'a, Tree), Error> {
         self.parser
             .set_language(config.language)
             .map_err(|_| Error::InvalidLanguage)?;
         self.parser.reset();
         unsafe { self.parser.set_cancellation_flag(cancellation_flag) };
-        let tree = self.parser.parse(source, None).ok_or(Error::Cancelled)?;
+        let tree = self
+            .parser
+            .parse(source, old_tree)
+            .ok_or(Error::Cancelled)?;
+
+        // The iterator owns its own copy of the tree, so that the returned tree can be
+        // dropped or edited independently of it.
+        let iter_tree = tree.clone();
 
         // The `matches` iterator borrows the `Tree`, which prevents it from being moved.
         // But the tree is really just a pointer, so it's actually ok to move it.
-        let tree_ref = unsafe { mem::transmute::<_, &'static Tree>(&tree) };
+        let tree_ref = unsafe { mem::transmute::<_, &'static Tree>(&iter_tree) };
         let matches = self
             .cursor
             .matches(&config.query, tree_ref.root_node(), source);
         Ok((
             TagsIter {
-                _tree: tree,
+                _tree: iter_tree,
                 matches,
                 source,
                 config,
@@ -291,7 +315,7 @@ impl TagsContext {
                     local_defs: Vec::new(),
                 }],
             },
-            tree_ref.root_node().has_error(),
+            tree,
         ))
     }
 }
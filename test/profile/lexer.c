@@ -0,0 +1,92 @@
+// Measure the speed at which the lexer reads through a source file, without
+// running any generated lexing functions. The file is read both as UTF8 and,
+// after widening each byte to a code unit, as UTF16.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lexer.h"
+
+#define SOURCE_PATH "javascript/examples/jquery.js"
+#define REPETITION_COUNT 20
+
+typedef struct {
+  const char *string;
+  uint32_t length;
+} Source;
+
+static const char *read_source(void *payload, uint32_t byte, TSPoint point, uint32_t *bytes_read) {
+  (void)point;
+  Source *source = payload;
+  if (byte >= source->length) {
+    *bytes_read = 0;
+    return "";
+  }
+  *bytes_read = source->length - byte;
+  return source->string + byte;
+}
+
+static double elapsed_ms(struct timespec start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+static double lex(Lexer *lexer, Source *source, TSInputEncoding encoding) {
+  double best_duration = -1;
+  for (unsigned i = 0; i < REPETITION_COUNT; i++) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ts_lexer_set_input(lexer, (TSInput) {
+      .payload = source,
+      .read = read_source,
+      .encoding = encoding,
+    });
+    ts_lexer_reset(lexer, length_zero());
+    ts_lexer_start(lexer);
+    while (!lexer->data.eof(&lexer->data)) {
+      lexer->data.advance(&lexer->data, false);
+    }
+    double duration = elapsed_ms(start);
+    if (best_duration < 0 || duration < best_duration) best_duration = duration;
+  }
+  return best_duration;
+}
+
+int main(int argc, char **argv) {
+  const char *source_path = argc > 1 ? argv[1] : GRAMMARS_DIR SOURCE_PATH;
+  FILE *file = fopen(source_path, "rb");
+  if (!file) {
+    fprintf(stderr, "Invalid source path %s\n", source_path);
+    exit(1);
+  }
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *utf8 = malloc(length);
+  if (fread(utf8, 1, length, file) != (size_t)length) {
+    fprintf(stderr, "Failed to read %s\n", source_path);
+    exit(1);
+  }
+  fclose(file);
+
+  uint16_t *utf16 = malloc(length * sizeof(uint16_t));
+  for (long i = 0; i < length; i++) utf16[i] = (uint8_t)utf8[i];
+
+  Lexer lexer;
+  ts_lexer_init(&lexer);
+
+  printf("Lexing %s\n", source_path);
+  Source source = {utf8, length};
+  double duration = lex(&lexer, &source, TSInputEncodingUTF8);
+  printf("  UTF8:  %.3f ms\t%.0f bytes/ms\n", duration, length / duration);
+
+  source = (Source) {(const char *)utf16, length * sizeof(uint16_t)};
+  duration = lex(&lexer, &source, TSInputEncodingUTF16);
+  printf("  UTF16: %.3f ms\t%.0f characters/ms\n", duration, length / duration);
+
+  ts_lexer_delete(&lexer);
+  free(utf16);
+  free(utf8);
+  return 0;
+}